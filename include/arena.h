@@ -0,0 +1,32 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/* bump pointer allocator, memory is only released all at once by arena_destroy */
+typedef struct ArenaChunk ArenaChunk;
+
+typedef struct {
+    ArenaChunk* head;       // chunk allocations are served from
+    size_t next_size;       // size of the next chunk, doubles up to a cap
+    size_t bytes_used;
+    void** adopted;         // malloc blocks released together with the chunks
+    int adopted_count;
+    int adopted_capacity;
+} Arena;
+
+Arena* arena_create(void);
+void arena_destroy(Arena* arena);
+
+/* 8 byte aligned, never NULL for a live arena */
+void* arena_alloc(Arena* arena, size_t size);
+char* arena_strndup(Arena* arena, const char* s, size_t n);
+char* arena_strdup(Arena* arena, const char* s);
+
+/* take ownership of a malloc block, it is freed by arena_destroy */
+void arena_adopt(Arena* arena, void* block);
+
+/* move every chunk and adopted block of src into dst, src is left empty and memory allocated from it stays valid */
+void arena_absorb(Arena* dst, Arena* src);
+
+#endif /* ARENA_H */
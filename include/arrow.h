@@ -0,0 +1,67 @@
+#ifndef ARROW_H
+#define ARROW_H
+
+#include <stdint.h>
+#include "row_sink.h"
+#include "csv_reader.h"
+
+/* Apache Arrow IPC output, written without the Arrow library: the metadata is encoded with
+ * flatbuffer.h, the columns go out as record batches of up to ARROW_BATCH_ROWS rows.
+ *
+ * column types come from the values of the first batch: integers become int64, numbers with
+ * a double among them float64, dates date32 and anything else utf8. NULL cells, and string
+ * cells reading NULL as in the JSON output, are nulls */
+#define ARROW_BATCH_ROWS 65536
+
+/* magic at the start and the end of an Arrow file */
+#define ARROW_MAGIC "ARROW1"
+
+/* ids of the Arrow flatbuffer schema: MetadataVersion, the MessageHeader union and the
+ * Type union */
+#define ARROW_METADATA_V5 4
+#define ARROW_HEADER_SCHEMA 1
+#define ARROW_HEADER_DICTIONARY_BATCH 2
+#define ARROW_HEADER_RECORD_BATCH 3
+#define ARROW_TYPE_NULL 1
+#define ARROW_TYPE_INT 2
+#define ARROW_TYPE_FLOATING_POINT 3
+#define ARROW_TYPE_UTF8 5
+#define ARROW_TYPE_BOOL 6
+#define ARROW_TYPE_DATE 8
+#define ARROW_TYPE_LARGE_UTF8 20
+
+/* a message starts with this marker, then its metadata length; a zero length ends the stream */
+#define ARROW_CONTINUATION 0xFFFFFFFFu
+
+/* structs of Message.fbs and File.fbs, laid out as FlatBuffers stores them */
+typedef struct {
+    int64_t length;
+    int64_t null_count;
+} ArrowFieldNode;
+
+typedef struct {
+    int64_t offset;
+    int64_t length;
+} ArrowBuffer;
+
+typedef struct {
+    int64_t offset;
+    int32_t metadata_length;
+    int32_t padding;
+    int64_t body_length;
+} ArrowBlock;
+
+/* Arrow IPC file (Feather v2) written to filename, or with a NULL filename the IPC stream
+ * format on standard output */
+RowSink* arrow_sink_create(const char* filename);
+
+/* true if data holds an Arrow IPC file or stream rather than text */
+bool arrow_detect(const char* data, size_t size);
+
+/* Arrow input: fills the columns and rows of a table whose data is an Arrow IPC file or
+ * stream, cells are allocated from the table arena when it has one. the supported subset is
+ * uncompressed record batches of null, bool, signed and unsigned int, float, double, utf8,
+ * large utf8 and date columns; anything else is reported and false returned */
+bool arrow_load(CsvTable* table);
+
+#endif /* ARROW_H */
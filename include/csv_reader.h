@@ -3,12 +3,13 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include "arena.h"
 
-/* date value structure */
+/* date value structure, packed into 32 bits so that a Value is 16 bytes */
 typedef struct {
-    int year;   // 1000-9999
-    int month;  // 1-12
-    int day;    // 1-31
+    signed int year : 16;   // DATE_MIN_YEAR..DATE_MAX_YEAR of date_utils.h, text parses 1000-9999
+    signed int month : 8;   // 1-12
+    signed int day : 8;     // 1-31
 } DateValue;
 
 /* data types for CSV values */
@@ -60,21 +61,73 @@ typedef struct {
     
     char delimiter;      // field delimiter (default: ',')
     char quote;          // quote character (default: '"')
+    
+    Arena* arena;        // if set, row value arrays and string cells live here and are
+                         // released with the table, never one by one
+    bool arrow;          // read from an Arrow IPC file, which csv_save will not overwrite
 } CsvTable;
 
+/* declared column types, columns it names skip type inference */
+typedef struct {
+    char* name;
+    ValueType type;
+} SchemaColumn;
+
+typedef struct {
+    SchemaColumn* columns;
+    int column_count;
+} CsvSchema;
+
+/* data lines sampled per column to pick its parser when the config does not say */
+#define CSV_SAMPLE_ROWS 1000
+
 /* configuration for CSV parsing */
 typedef struct {
     char delimiter;
     char quote;
     bool has_header;
+    bool arena;          // allocate cells from a per table arena, for tables that are only read
+    int sample_rows;     // lines sampled for type inference, 0 for CSV_SAMPLE_ROWS
+    const CsvSchema* schema;  // declared column types, NULL to infer every column
 } CsvConfig;
 
 /* create default CSV config used in tests */
 CsvConfig csv_config_default(void);
 
-/* load CSV file into memory using mmap */
+/* parse "name:type,name:type" or a file with one name:type per line (or comma separated),
+ * types are int, double, string and date with their usual SQL spellings; NULL on error */
+CsvSchema* csv_schema_parse(const char* spec);
+void csv_schema_free(CsvSchema* schema);
+
+/* table name of standard input, read as a stream since a pipe cannot be mapped */
+#define CSV_STDIN "-"
+
+/* load CSV file into memory using mmap, or standard input for CSV_STDIN */
 CsvTable* csv_load(const char* filename, CsvConfig config);
 
+/* the columns of a CSV file from its first line, without reading the rows: what appending
+ * to it needs. terminated is set when the file ends with a line break */
+CsvTable* csv_load_header(const char* filename, CsvConfig config, bool* terminated);
+
+/* a CSV file read one record at a time, in constant memory, for statements that rewrite it:
+ * each record comes parsed and as the bytes it takes in the file, so an unchanged record can
+ * be copied through as it is */
+typedef struct CsvRecordReader CsvRecordReader;
+
+/* NULL with an error for files csv_save could not write back, as csv_load_header */
+CsvRecordReader* csv_records_open(const char* filename, CsvConfig config);
+/* the file's columns, for evaluating conditions on its records */
+CsvTable* csv_records_table(CsvRecordReader* reader);
+/* the bytes before the first record: the header line and its line break */
+const char* csv_records_head(const CsvRecordReader* reader, size_t* length);
+/* the next record, valid until the following call, and its bytes with the line breaks after
+ * it; NULL at the end of the file */
+Row* csv_records_next(CsvRecordReader* reader, const char** record, size_t* length);
+void csv_records_close(CsvRecordReader* reader);
+
+/* standard input can be read once, by the query or by one table: false if it already was */
+bool csv_claim_stdin(void);
+
 /* save CSV table to file */
 bool csv_save(const char* filename, CsvTable* table);
 
@@ -4,6 +4,10 @@
 #include "csv_reader.h"
 #include <time.h>
 
+/* years a DateValue holds, the range of its 16 bit year field */
+#define DATE_MIN_YEAR (-32768)
+#define DATE_MAX_YEAR 32767
+
 /* date format types */
 typedef enum {
     DATE_FORMAT_ISO,       // YYYY-MM-DD (default, SQL standard)
@@ -15,6 +19,9 @@ typedef enum {
 /* parse date string to DateValue, returns 1 on success, 0 on failure */
 int parse_date(const char* str, DateValue* date);
 
+/* fixed layout YYYY-MM-DD of exactly len bytes, the fast path of parse_date, returns 1 on success */
+int parse_date_iso(const char* str, size_t len, DateValue* date);
+
 /* parse date with specific format */
 int parse_date_format(const char* str, DateValue* date, DateFormat format);
 
@@ -33,16 +40,24 @@ int days_in_month(int year, int month);
 /* convert date to days since Unix epoch (1970-01-01) */
 long date_to_days(DateValue date);
 
-/* convert days since epoch to date */
-DateValue days_to_date(long days);
+/* convert days since epoch to date, returns 0 if the year is out of the DateValue range */
+int days_to_date(long long days, DateValue* date);
 
 /* compare two dates, returns -1, 0, or 1 */
 int compare_dates(DateValue d1, DateValue d2);
 
-/* date arithmetic: add days/months/years */
-DateValue date_add_days(DateValue date, int days);
-DateValue date_add_months(DateValue date, int months);
-DateValue date_add_years(DateValue date, int years);
+/* integer with the same order as the date, for comparisons and hashing: the year is offset
+ * to be non-negative so the shift is defined, and the key fits in 25 bits */
+static inline int date_key(DateValue date) {
+    unsigned year = (unsigned)(date.year - DATE_MIN_YEAR);
+    return (int)((year << 9) | ((unsigned)date.month << 5) | (unsigned)date.day);
+}
+
+/* date arithmetic: add days/months/years into result, returns 0 when the year would leave
+ * the DateValue range */
+int date_add_days(DateValue date, long long days, DateValue* result);
+int date_add_months(DateValue date, long long months, DateValue* result);
+int date_add_years(DateValue date, long long years, DateValue* result);
 
 /* date difference in days/months/years */
 long date_diff_days(DateValue d1, DateValue d2);
@@ -3,6 +3,7 @@
 
 #include "parser.h"
 #include "csv_reader.h"
+#include "row_sink.h"
 
 /* table reference with alias */
 typedef struct {
@@ -20,6 +21,15 @@ typedef struct {
     /* for correlated subqueries */
     Row* outer_row;       // row from outer query (NULL if not in correlated subquery)
     CsvTable* outer_table; // table from outer query (NULL if not in correlated subquery)
+    bool* outer_columns_read; // optional, marks outer columns resolved (one flag per outer column)
+    
+    /* IN predicates materialized once per query (see evaluator_conditions.c) */
+    struct CompiledInList* in_lists;
+    int in_list_count;
+    
+    /* scalar subquery results memoized by outer column values (see evaluator_subquery.c) */
+    struct SubqueryCache* subquery_caches;
+    int subquery_cache_count;
 } QueryContext;
 
 /* result set, essentially a CSV table built from query results */
@@ -28,9 +38,17 @@ typedef CsvTable ResultSet;
 /* global CSV configuration */
 extern CsvConfig global_csv_config;
 
+/* print the join order picked from table statistics to stderr (-c) */
+extern bool report_join_order;
+
 /* main evaluation function */
 ResultSet* evaluate_query(ASTNode* query_ast);
 
+/* evaluate a query into sink: queries without an aggregate, sort, DISTINCT, window function
+ * or set operation push every row as it is produced, others push their finished result.
+ * false if evaluation failed, the sink is never ended here */
+bool evaluate_query_to_sink(ASTNode* query_ast, RowSink* sink);
+
 /* helper functions */
 QueryContext* context_create(ASTNode* query_ast);
 void context_free(QueryContext* ctx);
@@ -27,8 +27,11 @@ GroupResult* create_groups(Row** rows, int row_count, CsvTable* table, const cha
 GroupResult* create_groups_by_expression(QueryContext* ctx, Row** rows, int row_count, ASTNode* group_expr);
 void free_groups(GroupResult* groups);
 
-/* aggregate evaluation */
-Value evaluate_aggregate(const char* func_name, Row** rows, int row_count, CsvTable* table, const char* column_name);
+/* aggregate evaluation. SUM gives one type to every group of a column: sum_type is the
+ * sum_cell_type of all of the column's rows, not only of this group's */
+ValueType sum_cell_type(Row** rows, int row_count, CsvTable* table, const char* column_name);
+Value evaluate_aggregate(const char* func_name, Row** rows, int row_count, CsvTable* table,
+                         const char* column_name, ValueType sum_type);
 ResultSet* build_aggregated_result(QueryContext* ctx, GroupResult* groups, ASTNode* select_node);
 
 /* HAVING clause support */
@@ -3,8 +3,17 @@
 
 #include "evaluator.h"
 #include "parser.h"
+#include "evaluator/evaluator_hash.h"
+
+/* value set built from a constant IN list or an IN subquery */
+typedef struct CompiledInList {
+    ASTNode* condition;      // IN / NOT IN condition the set belongs to
+    ValueHashSet* values;    // NULL when the list must be evaluated per row
+    bool invalid;            // subquery did not return exactly one column
+} CompiledInList;
 
 /* condition evaluation */
 bool evaluate_condition(QueryContext* ctx, ASTNode* condition, Row* current_row, int table_index);
+void free_compiled_in_lists(QueryContext* ctx);
 
 #endif /* EVALUATOR_CONDITIONS_H */
@@ -0,0 +1,18 @@
+#ifndef EVALUATOR_FILES_H
+#define EVALUATOR_FILES_H
+
+#include <stdbool.h>
+#include "evaluator.h"
+#include "csv_reader.h"
+#include "parser.h"
+
+/* true if a FROM or JOIN table is read as several files, a read_csv list or a glob pattern */
+bool is_file_set_source(const char* table, int file_count);
+
+/* load the table of a FROM or JOIN clause. a file set is loaded as one table; conditions whose
+ * columns are all partition columns (or FILE_SET_COLUMN) are tried on each file's path first
+ * and skip the files they reject. conditions may be NULL */
+CsvTable* load_scan_table(QueryContext* ctx, const char* table, char** files, int file_count, const char* alias,
+                          ASTNode** conditions, int condition_count, bool file_column);
+
+#endif /* EVALUATOR_FILES_H */
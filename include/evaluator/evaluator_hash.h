@@ -0,0 +1,65 @@
+#ifndef EVALUATOR_HASH_H
+#define EVALUATOR_HASH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "csv_reader.h"
+
+/* kinds of value, value_compare reports 0 for non-NULL values of different classes. bit flags,
+ * so the classes found in a column can be collected with | */
+typedef enum {
+    VALUE_CLASS_NONE = 0,       // NULL
+    VALUE_CLASS_NUMERIC = 1,
+    VALUE_CLASS_STRING = 2,
+    VALUE_CLASS_DATE = 4
+} ValueClass;
+
+ValueClass value_class(const Value* value);
+
+/* typed hashing of values and rows, consistent with value_compare equality */
+uint64_t value_hash(const Value* value);
+uint64_t row_hash(const Row* row, int column_count);
+bool values_equal(const Value* a, const Value* b);
+bool rows_equal(const Row* row1, const Row* row2, int column_count);
+
+/* open addressing set of rows, rows are borrowed and must outlive the set */
+typedef struct {
+    uint64_t hash;
+    const Row* row;       // NULL marks an empty slot
+} RowHashEntry;
+
+typedef struct {
+    RowHashEntry* entries;
+    int capacity;         // always a power of two
+    int count;
+    int column_count;     // number of leading values hashed and compared
+} RowHashSet;
+
+RowHashSet* row_hash_set_create(int column_count, int expected_rows);
+void row_hash_set_free(RowHashSet* set);
+
+/* returns true if the row was added, false if an equal row was already present */
+bool row_hash_set_insert(RowHashSet* set, const Row* row);
+bool row_hash_set_contains(const RowHashSet* set, const Row* row);
+
+/* open addressing set of values, values are deep copied into the set */
+typedef struct {
+    uint64_t hash;
+    Value value;
+    bool used;
+} ValueHashEntry;
+
+typedef struct {
+    ValueHashEntry* entries;
+    int capacity;         // always a power of two
+    int count;
+} ValueHashSet;
+
+ValueHashSet* value_hash_set_create(int expected_values);
+void value_hash_set_free(ValueHashSet* set);
+
+/* returns true if the value was added, false if an equal value was already present */
+bool value_hash_set_add(ValueHashSet* set, const Value* value);
+bool value_hash_set_contains(const ValueHashSet* set, const Value* value);
+
+#endif /* EVALUATOR_HASH_H */
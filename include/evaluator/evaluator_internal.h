@@ -9,6 +9,7 @@
 
 /* from evaluator.c */
 ResultSet* evaluate_query_internal(ASTNode* query_ast, Row* outer_row, CsvTable* outer_table);
+ResultSet* evaluate_correlated_query(ASTNode* query_ast, Row* outer_row, CsvTable* outer_table, bool* outer_columns_read);
 
 /* from evaluator_aggregates.c */
 int find_column_index(CsvTable* table, const char* col_name);
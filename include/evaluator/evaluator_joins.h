@@ -4,9 +4,12 @@
 #include "evaluator.h"
 #include "csv_reader.h"
 #include "parser.h"
+#include "row_sink.h"
 
 /* JOIN operations */
 CsvTable* load_from_table(ASTNode* from_clause, const char** out_alias, QueryContext* ctx);
-CsvTable* process_joins(ASTNode* query_ast, QueryContext* ctx, CsvTable* base_table, const char* base_alias);
+CsvTable* perform_join(QueryContext* ctx, CsvTable* left_table, const char* left_alias, bool left_is_joined,
+                       CsvTable* right_table, const char* right_alias,
+                       ASTNode* on_condition, JoinType join_type, bool build_left, RowSink* sink);
 
 #endif /* EVALUATOR_JOINS_H */
@@ -0,0 +1,109 @@
+#ifndef EVALUATOR_PLAN_H
+#define EVALUATOR_PLAN_H
+
+#include <stdbool.h>
+#include "evaluator.h"
+#include "parser.h"
+#include "csv_reader.h"
+
+/* logical plan operators, a query becomes a left-deep tree
+ *
+ *   Limit -> Distinct -> Sort -> Project | Aggregate -> Filter -> Join ... -> Scan
+ *
+ * set operations combine the plans of their two queries */
+typedef enum {
+    PLAN_SCAN,
+    PLAN_JOIN,
+    PLAN_FILTER,
+    PLAN_AGGREGATE,
+    PLAN_PROJECT,
+    PLAN_SORT,
+    PLAN_DISTINCT,
+    PLAN_LIMIT,
+    PLAN_SET_OP
+} PlanNodeType;
+
+typedef struct PlanNode PlanNode;
+
+/* runtime statistics of an operator, only collected for EXPLAIN ANALYZE */
+typedef struct {
+    bool enabled;
+    int executions;
+    double elapsed_ms;          // time spent in the operator itself, inputs excluded
+    long long rows_in;
+    long long rows_out;
+    long long bytes_read;       // size of the files a scan loaded
+    long peak_memory_kb;        // peak resident set of the process when the operator finished
+} PlanStats;
+
+struct PlanNode {
+    PlanNodeType type;
+    PlanNode* input;            // single input, or the left input of a join / set operation
+    PlanNode* right;            // right input of a join / set operation
+
+    /* scan: FROM clause or the table side of a JOIN node */
+    ASTNode* source;            // NODE_TYPE_FROM or NODE_TYPE_JOIN
+    const char* alias;          // alias the scan is visible under, borrowed from the AST
+    int table_index;            // position in FROM + JOIN order, 0 for FROM
+
+    /* scan predicates pushed below joins, or filter conjuncts; nodes are retained */
+    ASTNode** predicates;
+    int predicate_count;
+    bool always_false;          // a conjunct folded to false, no row can pass
+
+    /* scan of a file set: filter conjuncts of a single-table query, tried on partition columns
+     * to skip files (the filter still runs), and whether the query names FILE_SET_COLUMN */
+    ASTNode** prune_predicates;
+    int prune_predicate_count;
+    bool file_column;
+
+    /* scan: projection pruning keeps only columns named here, all columns if NULL */
+    char** referenced_columns;
+    int referenced_column_count;
+
+    /* join: the JOIN clause, its condition is evaluated as written */
+    ASTNode* join;
+    bool cost_based;            // top of an inner equi-join chain reordered from table statistics at run time
+    bool build_left;            // hash table built on the left input instead of the right one
+
+    /* aggregate / project / sort / distinct / limit read these from the query */
+    ASTNode* query;             // NODE_TYPE_QUERY the operator belongs to
+    int row_limit;              // project / filter: stop after this many rows, -1 if unbounded
+    int limit;
+    int offset;
+
+    /* set operation */
+    SetOpType set_op;
+
+    PlanStats stats;
+};
+
+/* a built and optimized plan for one query or set operation */
+typedef struct {
+    PlanNode* root;
+    ASTNode* query;
+    double execution_ms;        // wall time of the whole execution under EXPLAIN ANALYZE
+} QueryPlan;
+
+/* plan construction */
+QueryPlan* plan_build(ASTNode* query_ast);
+void plan_free(QueryPlan* plan);
+
+/* rewrite rules, see evaluator_optimizer.c */
+void plan_optimize(QueryPlan* plan);
+
+/* helpers shared by the planner and optimizer */
+PlanNode* plan_node_create(PlanNodeType type);
+void plan_free_node(PlanNode* node);
+void plan_add_predicate(PlanNode* node, ASTNode* predicate);
+void plan_collect_conjuncts(ASTNode* condition, ASTNode*** conjuncts, int* count);
+PlanNode* plan_find_node(PlanNode* root, PlanNodeType type);
+const char* plan_node_name(PlanNodeType type);
+
+/* EXPLAIN support, see evaluator_explain.c */
+void plan_enable_stats(PlanNode* node);
+double plan_stats_start(PlanNode* node);
+void plan_stats_finish(PlanNode* node, double start_ms, long long rows_in, long long rows_out);
+ResultSet* plan_explain(QueryPlan* plan, bool analyze);
+
+#endif /* EVALUATOR_PLAN_H */
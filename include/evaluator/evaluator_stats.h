@@ -0,0 +1,58 @@
+#ifndef EVALUATOR_STATS_H
+#define EVALUATOR_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "csv_reader.h"
+
+/* HyperLogLog distinct count sketch, 2^10 one byte registers, about 3% standard error */
+#define HLL_PRECISION 10
+#define HLL_REGISTERS (1 << HLL_PRECISION)
+
+typedef struct {
+    uint8_t registers[HLL_REGISTERS];
+} HyperLogLog;
+
+void hll_init(HyperLogLog* hll);
+void hll_add(HyperLogLog* hll, uint64_t hash);
+double hll_estimate(const HyperLogLog* hll);
+
+/* per column statistics of a loaded table */
+typedef struct {
+    long long null_count;
+    double distinct;            // estimated distinct non NULL values
+    bool has_range;             // min / max are set when the column has a non NULL value
+    Value min;
+    Value max;
+} ColumnStats;
+
+typedef struct {
+    long long row_count;
+    int column_count;
+    ColumnStats* columns;
+} TableStats;
+
+/* one pass over the table: row count, HyperLogLog distinct estimates, min / max;
+ * only the columns flagged in wanted are summarized, all of them when it is NULL */
+TableStats* table_stats_collect(CsvTable* table, const bool* wanted);
+void table_stats_free(TableStats* stats);
+
+/* fraction of the cross product an equi-join on the two columns keeps */
+double stats_join_selectivity(const ColumnStats* left, double left_rows,
+                              const ColumnStats* right, double right_rows);
+
+/* an inner equi-join to place: relation 0 is the FROM table, join j adds relation j + 1 */
+typedef struct {
+    int left_relation;          // relation providing the left key column
+    const ColumnStats* left_key;
+    const ColumnStats* right_key;
+    double right_rows;
+} JoinCandidate;
+
+/* cheapest order by sum of estimated intermediate rows, a join can only follow its left
+ * relation; fills order and the estimated rows after each step, returns false if no
+ * order places every join */
+bool join_order_choose(double base_rows, const JoinCandidate* joins, int join_count,
+                       int* order, double* estimated_rows);
+
+#endif /* EVALUATOR_STATS_H */
@@ -0,0 +1,60 @@
+#ifndef EVALUATOR_SUBQUERY_H
+#define EVALUATOR_SUBQUERY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "evaluator.h"
+#include "parser.h"
+#include "csv_reader.h"
+#include "evaluator/evaluator_hash.h"
+
+/* memoized scalar result for one combination of outer column values */
+typedef struct {
+    uint64_t hash;
+    Row key;              // values of the key columns, deep copied
+    Value value;          // the single value returned by the subquery
+    int row_count;        // shape of the subquery result, -1 if evaluation failed
+    int column_count;
+    ValueHashSet* members;  // IN subqueries: the values of a one column result
+    bool used;
+} SubqueryMemoEntry;
+
+/* per-query cache of a scalar or IN subquery, keyed by the outer columns it reads */
+typedef struct SubqueryCache {
+    ASTNode* subquery;            // the NODE_TYPE_QUERY being cached
+    CsvTable* outer_table;        // outer table the key columns index into
+    int* key_columns;             // outer columns read by any evaluation so far
+    int key_count;                // 0 for an uncorrelated subquery
+    Value* probe_values;          // scratch key built from the current outer row
+    SubqueryMemoEntry* entries;   // open addressing table, power of two capacity
+    int capacity;
+    int count;
+    int evaluations;              // times the subquery was actually executed
+
+    /* aggregate and IN subqueries correlated only through equalities are decorrelated:
+     * one grouped pass over the inner table fills entries for every key, and keys
+     * without a group get the aggregate over no rows, or the empty set */
+    bool decorrelation_tried;
+    bool decorrelated;
+    Value empty_group_value;
+    int* inner_key_types;         // per key column, value classes seen on the inner side
+} SubqueryCache;
+
+/* evaluate a scalar subquery for the given outer row, reusing an earlier result
+ * when no outer column it depends on has changed. returns true and deep copies
+ * the value into *out when the subquery produced exactly one row and one column,
+ * otherwise reports the shape (row_count -1 on failure) and returns false */
+bool evaluate_scalar_subquery(QueryContext* ctx, ASTNode* subquery, Row* outer_row,
+                              CsvTable* outer_table, Value* out,
+                              int* row_count, int* column_count);
+
+/* whether needle is in the result of an IN subquery for the given outer row, cached like
+ * evaluate_scalar_subquery: an uncorrelated subquery runs once, an equality-correlated
+ * one becomes one hash set per key. a failed subquery is an empty set; returns false
+ * when the subquery does not return exactly one column */
+bool evaluate_in_subquery(QueryContext* ctx, ASTNode* subquery, Row* outer_row, CsvTable* outer_table,
+                          const Value* needle, bool* found);
+
+void free_subquery_caches(QueryContext* ctx);
+
+#endif /* EVALUATOR_SUBQUERY_H */
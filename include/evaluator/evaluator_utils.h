@@ -7,9 +7,25 @@
 /* utility functions */
 void value_deep_copy(Value* dst, const Value* src);
 
+/* the SELECT list of a query resolved against its source table, shared by build_result
+ * and the streamed output of evaluator.c */
+typedef struct {
+    int column_count;
+    Column* columns;            // result column names
+    char** specs;               // SELECT text of each column, star columns are the table column name
+    int* column_indices;        // source table column of a plain column reference, -1 otherwise
+    ASTNode** nodes;            // expression of each column, NULL for star columns
+} Projection;
+
+Projection* projection_create(QueryContext* ctx);
+/* true if a column is a window function, those need every row and are left NULL by projection_row */
+bool projection_has_window(Projection* projection);
+/* evaluate every output column of row into values, which hold column_count values owned by the caller */
+void projection_row(Projection* projection, QueryContext* ctx, Row* row, Value* values);
+void projection_free(Projection* projection);
+
 /* result building */
 ResultSet* build_result(QueryContext* ctx, Row** filtered_rows, int row_count);
-Row** filter_rows(QueryContext* ctx, ASTNode* where_clause, int* out_filtered_count);
 
 /* result processing */
 void sort_result(ResultSet* result, ASTNode* select_node, const char* column_spec, bool descending);
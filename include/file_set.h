@@ -0,0 +1,44 @@
+#ifndef FILE_SET_H
+#define FILE_SET_H
+
+#include <stdbool.h>
+#include "csv_reader.h"
+
+/* a table made of several files: a glob pattern such as 'logs/day-??.csv', a read_csv list, or
+ * both. the files are read as one table with the union of their columns, by name and in the
+ * order they first appear, so a column a file lacks reads as NULL in its rows.
+ *
+ * directories named key=value along a path (hive partitioning, 'events/dt=2024-01-01/x.csv')
+ * add a column per key after the data columns, holding the value typed like a CSV cell, and
+ * FILE_SET_COLUMN can name the file each row came from */
+#define FILE_SET_COLUMN "_file"
+
+/* files loaded at the same time */
+#define FILE_SET_THREADS 8
+
+typedef struct {
+    char** paths;               // sorted by name within each pattern
+    int count;
+    char** partition_names;     // keys of the key=value directories, in order of appearance
+    int partition_count;
+    Value* partition_values;    // count x partition_count, NULL where a path lacks a key
+} FileSet;
+
+/* true if name should be expanded: it holds glob characters and is not itself a file */
+bool file_set_is_pattern(const char* name);
+
+/* the files named by a list of names and patterns, NULL with an error when a pattern
+ * matches nothing */
+FileSet* file_set_expand(char** names, int name_count);
+void file_set_free(FileSet* set);
+
+/* one row per file of its partition values and, with file_column, its path: the table the
+ * WHERE clause is tried on to skip files before loading them. rows share the set's values */
+CsvTable* file_set_partitions(const FileSet* set, bool file_column);
+void file_set_partitions_free(CsvTable* partitions);
+
+/* load the files with keep[i] set (all of them for a NULL keep), up to FILE_SET_THREADS at a
+ * time, into one table named name; NULL if one of them fails to load */
+CsvTable* file_set_load(const FileSet* set, const bool* keep, bool file_column, const char* name, CsvConfig config);
+
+#endif /* FILE_SET_H */
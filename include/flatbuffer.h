@@ -0,0 +1,76 @@
+#ifndef FLATBUFFER_H
+#define FLATBUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* minimal FlatBuffers encoder and decoder, enough for the Arrow IPC metadata: tables of
+ * scalars and references, strings, vectors of structs and vectors of tables. like the
+ * reference implementation the buffer is filled from the end towards the front, so an object
+ * is always built before the table that refers to it. values are stored in host byte order,
+ * which is the little endian order FlatBuffers requires on the platforms cq builds for */
+
+#define FLATBUF_MAX_FIELDS 16
+
+/* position of a finished object, counted from the end of the buffer */
+typedef uint32_t FlatRef;
+
+typedef struct {
+    uint8_t* data;
+    size_t capacity;
+    size_t size;                // bytes in use at the end of data
+    size_t min_align;           // largest alignment requested, the finished size is a multiple of it
+    /* table under construction */
+    size_t table_start;
+    FlatRef fields[FLATBUF_MAX_FIELDS];     // position of each field written, 0 if absent
+    int field_count;
+} FlatBuilder;
+
+void flatbuf_init(FlatBuilder* fb);
+/* forget the contents, the memory is kept for the next buffer */
+void flatbuf_reset(FlatBuilder* fb);
+void flatbuf_free(FlatBuilder* fb);
+
+FlatRef flatbuf_string(FlatBuilder* fb, const char* str);
+/* count structs of elem_size bytes each, copied as they are */
+FlatRef flatbuf_struct_vector(FlatBuilder* fb, const void* elems, size_t elem_size, int count, size_t align);
+FlatRef flatbuf_table_vector(FlatBuilder* fb, const FlatRef* tables, int count);
+
+/* fields are added by their id in the schema, any order; the table must be ended before
+ * another object is built */
+void flatbuf_start_table(FlatBuilder* fb);
+void flatbuf_add_u8(FlatBuilder* fb, int field, uint8_t value);
+void flatbuf_add_i16(FlatBuilder* fb, int field, int16_t value);
+void flatbuf_add_i32(FlatBuilder* fb, int field, int32_t value);
+void flatbuf_add_i64(FlatBuilder* fb, int field, int64_t value);
+void flatbuf_add_ref(FlatBuilder* fb, int field, FlatRef ref);
+FlatRef flatbuf_end_table(FlatBuilder* fb);
+
+/* finish with root as the root table; the buffer stays valid until the next reset */
+const uint8_t* flatbuf_finish(FlatBuilder* fb, FlatRef root, size_t* size);
+
+/* decoding: a table inside a finished buffer. every offset is checked against the buffer
+ * size, so a damaged file reads as absent fields instead of out of bounds memory */
+typedef struct {
+    const uint8_t* buffer;
+    size_t size;
+    size_t position;            // start of the table
+} FlatTable;
+
+/* false if the buffer does not start with a valid root table */
+bool flatbuf_root(const uint8_t* buffer, size_t size, FlatTable* root);
+/* integer field of width 1, 2, 4 or 8 bytes, one byte fields (bools, union types) are
+ * unsigned; default_value when the field is absent */
+int64_t flatbuf_get_int(const FlatTable* table, int field, int width, int64_t default_value);
+/* true if the field is set, whatever its type */
+bool flatbuf_has_field(const FlatTable* table, int field);
+bool flatbuf_get_table(const FlatTable* table, int field, FlatTable* child);
+/* bytes of a string field, not terminated; NULL if absent */
+const char* flatbuf_get_string(const FlatTable* table, int field, size_t* len);
+/* element count of a vector field, -1 if absent; elements gets the position of the first one */
+int flatbuf_get_vector(const FlatTable* table, int field, size_t elem_size, size_t* elements);
+/* element index of a vector of tables */
+bool flatbuf_vector_table(const FlatTable* table, size_t elements, int index, FlatTable* child);
+
+#endif /* FLATBUFFER_H */
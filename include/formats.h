@@ -2,15 +2,39 @@
 #define FORMATS_H
 
 #include "utils.h"
+#include "row_sink.h"
 
-typedef enum { FMT_AUTO = 0, FMT_CSV, FMT_TABLE, FMT_MARKDOWN, FMT_YAML, FMT_JSON } OutputFormat;
+typedef enum { FMT_AUTO = 0, FMT_CSV, FMT_TABLE, FMT_MARKDOWN, FMT_YAML, FMT_JSON, FMT_NDJSON, FMT_ARROW } OutputFormat;
+
+/* streamed rows the table printer reads before it fixes the column widths, a wider cell of a
+ * later row is printed whole and pushes the rest of its line out of alignment. a whole result
+ * pushed by row_sink_push_result is measured in full */
+#define TABLE_WIDTH_ROWS 1000
+
+/* batches of rows given to a sink at once are cut into chunks of FORMAT_CHUNK_ROWS, formatted
+ * on worker threads and written out in order; a batch smaller than two chunks stays on the
+ * calling thread */
+#define FORMAT_CHUNK_ROWS 4096
+#define MAX_OUTPUT_THREADS 8
+
+/* formatting threads, 0 takes one per processor up to MAX_OUTPUT_THREADS (--output-threads) */
+extern int output_threads;
 
 /* Printers for various output formats */
 void print_json(ResultSet* res);
+void print_ndjson(ResultSet* res);
 void print_markdown(ResultSet* res);
 void print_yaml(ResultSet* res);
+void print_csv(ResultSet* res);
 
 /* Write result set to file in given format. Returns true on success. */
 bool write_output_file(const char* filename, ResultSet* res, OutputFormat fmt, char delimiter);
 
+/* the same formats as sinks, each row is written as it arrives (see row_sink.h).
+ * the stdout sink prints like the printers above, vertical selects the one column per
+ * line table; the file is created by begin, table is written as CSV. FMT_ARROW is the
+ * Arrow IPC file format in a file and the IPC stream format on stdout (arrow.h) */
+RowSink* format_sink_create(OutputFormat fmt, bool vertical);
+RowSink* format_file_sink_create(const char* filename, OutputFormat fmt, char delimiter);
+
 #endif
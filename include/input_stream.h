@@ -0,0 +1,40 @@
+#ifndef INPUT_STREAM_H
+#define INPUT_STREAM_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/* sequential input that cannot be parsed in place, decompressed or read from a pipe block
+ * by block. where threads are available a background thread fills the next blocks while the
+ * caller parses the current one, and at most INPUT_BLOCKS blocks are held at any time.
+ *
+ * gzip needs cq built with zlib (the default, ZLIB=0 turns it off), zstd with ZSTD=1 */
+#define INPUT_BLOCK_SIZE (1 << 20)
+#define INPUT_BLOCKS 4
+
+typedef enum {
+    INPUT_PLAIN,
+    INPUT_GZIP,
+    INPUT_ZSTD,
+} InputCompression;
+
+/* compression of a file from its first bytes */
+InputCompression input_compression(const char* data, size_t size);
+
+typedef struct InputStream InputStream;
+
+/* decompress the size bytes at data, which must stay valid until input_stream_close */
+InputStream* input_stream_open(const char* data, size_t size, InputCompression compression);
+
+/* read a pipe or other descriptor that cannot be mapped, such as standard input, until end
+ * of file. the descriptor is not closed; compressed input is reported as an error */
+InputStream* input_stream_open_fd(int fd);
+
+/* next block of bytes, valid until the next call: returns its length, 0 at the end and -1
+ * on damaged or unsupported input, with the reason in input_stream_error */
+long input_stream_next(InputStream* in, const char** block);
+const char* input_stream_error(const InputStream* in);
+
+void input_stream_close(InputStream* in);
+
+#endif /* INPUT_STREAM_H */
@@ -0,0 +1,13 @@
+#ifndef NUMBER_UTILS_H
+#define NUMBER_UTILS_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "csv_reader.h"
+
+/* parse exactly [sign]digits[.digits] of len bytes, no surrounding space, into an INTEGER
+ * (without a dot) or a DOUBLE value; returns false for anything else.
+ * integers out of the 64 bit range saturate like strtoll, doubles round like strtod */
+bool parse_number(const char* str, size_t len, Value* value);
+
+#endif /* NUMBER_UTILS_H */
@@ -0,0 +1,86 @@
+#ifndef OUTPUT_WRITER_H
+#define OUTPUT_WRITER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "csv_reader.h"
+
+/* buffered writer behind every output format: values are formatted straight into one large
+ * buffer, without a malloc per cell, and the buffer goes to the file descriptor with write(2)
+ * whenever it fills up */
+#define WRITER_BUFFER_SIZE (256 * 1024)
+
+/* longest text of a non string value, "%.2f" of the largest double, see value_text */
+#define VALUE_TEXT_SIZE 320
+
+typedef struct {
+    int fd;                     // WRITER_MEMORY collects the output in memory
+    bool owns_fd;               // opened by writer_open, closed by writer_close
+    bool failed;                // a write(2) failed, later output is dropped
+    size_t length;
+    char* buffer;
+    char* memory;               // flushed output of a memory writer
+    size_t memory_length;
+    size_t memory_capacity;
+    char* replace_path;         // temporary file writer_close renames over target_path
+    char* target_path;
+} OutputWriter;
+
+/* descriptor of standard output, for writer_open_fd */
+#define WRITER_STDOUT 1
+/* no descriptor, see writer_open_memory */
+#define WRITER_MEMORY (-1)
+
+/* create or truncate filename, false if it cannot be opened */
+bool writer_open(OutputWriter* writer, const char* filename);
+/* append to an existing filename, false if it cannot be opened; every flush is one write(2)
+ * at the end of the file */
+bool writer_open_append(OutputWriter* writer, const char* filename);
+/* write a new version of filename into a temporary file beside it, which writer_close renames
+ * over filename once everything is written: the file is never seen half written, not even
+ * after a crash. false if the temporary file cannot be created */
+bool writer_open_replace(OutputWriter* writer, const char* filename);
+/* write to an open descriptor such as STDOUT_FILENO, pending stdio output is flushed first */
+void writer_open_fd(OutputWriter* writer, int fd);
+/* collect the output in a growing block instead of writing it, for formatting on a worker
+ * thread; the buffer is the writer's own, so memory writers may run concurrently */
+void writer_open_memory(OutputWriter* writer);
+/* everything written to a memory writer since the last call, the caller frees it; the writer
+ * starts over empty */
+char* writer_take_memory(OutputWriter* writer, size_t* len);
+/* flush, close the descriptor if the writer opened it; false if any write failed */
+bool writer_close(OutputWriter* writer);
+/* close without keeping the output, the temporary file of writer_open_replace is removed */
+void writer_discard(OutputWriter* writer);
+void writer_flush(OutputWriter* writer);
+
+void writer_write(OutputWriter* writer, const char* data, size_t len);
+void writer_puts(OutputWriter* writer, const char* str);
+void writer_pad(OutputWriter* writer, char c, int count);
+
+static inline void writer_putc(OutputWriter* writer, char c) {
+    if (writer->length == WRITER_BUFFER_SIZE) writer_flush(writer);
+    writer->buffer[writer->length++] = c;
+}
+
+/* numbers and dates in the same text as printf "%lld", "%.2f" and "%04d-%02d-%02d" */
+void writer_int(OutputWriter* writer, long long value);
+void writer_fixed2(OutputWriter* writer, double value);
+void writer_date(OutputWriter* writer, DateValue date);
+
+/* a value as value_to_string prints it, NULL as "NULL" */
+void writer_value(OutputWriter* writer, const Value* value);
+
+/* a CSV field, quoted when it holds the delimiter, the quote or a line break; quotes are doubled */
+void writer_csv_string(OutputWriter* writer, const char* str, char delimiter, char quote);
+/* a CSV record and its newline as csv_save writes it: NULL as an empty field, doubles with
+ * full precision */
+void writer_csv_row(OutputWriter* writer, const Value* values, int count, char delimiter, char quote);
+/* a JSON string literal with quotes, backslashes and newlines escaped */
+void writer_json_string(OutputWriter* writer, const char* str);
+
+/* the text value_to_string would return for value, without allocating: string cells are returned
+ * as they are, other values are formatted into scratch; the length is stored in len */
+const char* value_text(const Value* value, char scratch[VALUE_TEXT_SIZE], size_t* len);
+
+#endif /* OUTPUT_WRITER_H */
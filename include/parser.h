@@ -33,6 +33,7 @@ typedef enum {
     NODE_TYPE_ALTER_TABLE,
     NODE_TYPE_CASE,
     NODE_TYPE_WINDOW_FUNCTION,
+    NODE_TYPE_EXPLAIN,
 } ASTNodeType;
 
 typedef enum {
@@ -117,6 +118,8 @@ struct ASTNode {
             char* table;  // filename or table name (NULL if subquery)
             ASTNode* subquery;  // subquery node (NULL if table)
             char* alias;  // optional alias
+            char** files;  // files of read_csv([...]) (NULL for a single table or pattern)
+            int file_count;
         } from;
         
         struct {
@@ -124,6 +127,8 @@ struct ASTNode {
             char* table;       // right table filename
             char* alias;       // optional alias for right table
             ASTNode* condition; // ON condition
+            char** files;      // files of read_csv([...]), as in from
+            int file_count;
         } join;
         
         struct {
@@ -146,8 +151,10 @@ struct ASTNode {
             char* table;           // target CSV file
             char** columns;        // column names (NULL if not specified)
             int column_count;
-            ASTNode** values;      // values to insert
-            int value_count;
+            ASTNode** values;      // values to insert, row by row
+            int value_count;       // values in each row
+            int row_count;         // rows of VALUES (...), (...)
+            ASTNode* query;        // INSERT ... SELECT instead of VALUES (NULL otherwise)
         } insert;
 
         struct {
@@ -194,6 +201,11 @@ struct ASTNode {
             ASTNode* else_expr;     // ELSE expression (NULL if not present)
         } case_expr;
 
+        struct {
+            ASTNode* query;         // query or set operation to describe
+            bool analyze;           // EXPLAIN ANALYZE executes it and reports timings
+        } explain;
+
         char* literal;
         char* identifier;  // used for generic identifiers, not GROUP BY
         char* alias;
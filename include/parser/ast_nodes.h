@@ -1,6 +1,7 @@
 #ifndef AST_NODES_H
 #define AST_NODES_H
 
+#include <stddef.h>
 #include "parser.h"
 
 /* AST node memory management */
@@ -11,8 +12,11 @@ void releaseNode(ASTNode* node);
 ASTNode* create_node(ASTNodeType type);
 ASTNode* create_identifier_node(const char* name);
 ASTNode* create_literal_node(const char* value);
+ASTNode* create_condition_node(ASTNode* left, const char* op, ASTNode* right);
+ASTNode* create_binary_op_node(ASTNode* left, const char* op, ASTNode* right);
 
 /* debugging */
 void printAst(ASTNode* node, int depth);
+void generate_column_name(ASTNode* node, char* buf, size_t buf_size);
 
 #endif /* AST_NODES_H */
@@ -10,6 +10,7 @@ void* ensure_capacity(void* array, int* capacity, int current_count, size_t elem
 char* parse_qualified_identifier(Parser* parser);
 char* parse_optional_alias(Parser* parser, const char** excluded_keywords, int excluded_count);
 char* parse_table_name(Parser* parser);
+char* parse_table_source(Parser* parser, char*** files, int* file_count);
 JoinType parse_join_type(Parser* parser);
 char* build_function_string(Parser* parser);
 void parse_limit_offset(Parser* parser, int* limit, int* offset);
@@ -24,5 +25,6 @@ ASTNode* create_binary_op_node(ASTNode* left, const char* op, ASTNode* right);
 
 /* from parser.c */
 ASTNode* parse_query_internal(Parser* parser);
+ASTNode* parse_compound_query(Parser* parser);
 
 #endif /* PARSER_INTERNAL_H */
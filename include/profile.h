@@ -0,0 +1,53 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/* engine wide counters for --profile, only updated while profiling is enabled */
+typedef struct {
+    bool enabled;
+    bool tracing;               // spans are recorded for --trace
+
+    long long csv_files;        // csv_load calls that produced a table
+    long long csv_rows;
+    long long csv_bytes;
+    double csv_ms;
+
+    long long parse_values[5];  // parse_value calls by resulting ValueType
+    long long expressions;      // evaluate_expression invocations
+    long long deep_copies;      // value_deep_copy calls
+    long long hash_probes;      // slots inspected by the open addressing hash tables
+
+    long long allocations;      // string buffers allocated for values
+    long long allocated_bytes;
+} ProfileCounters;
+
+extern ProfileCounters profile_counters;
+
+#define PROFILE_COUNT(field) \
+    do { if (profile_counters.enabled) profile_counters.field++; } while (0)
+
+#define PROFILE_ADD(field, amount) \
+    do { if (profile_counters.enabled) profile_counters.field += (amount); } while (0)
+
+/* start collecting counters, and spans when record_trace is set */
+void profile_begin(bool record_trace);
+/* stop collecting, drop counters and recorded spans */
+void profile_reset(void);
+
+/* monotonic wall clock in milliseconds and peak resident set of the process */
+double profile_clock_ms(void);
+long profile_peak_memory_kb(void);
+
+/* record a complete span, detail is optional and shown as an argument in the trace viewer */
+void profile_span(const char* category, const char* name, const char* detail,
+                  double start_ms, double end_ms);
+
+/* human readable counter summary */
+void profile_report(FILE* out);
+
+/* write recorded spans as Chrome trace event JSON (chrome://tracing, Perfetto) */
+bool profile_write_trace(const char* filename);
+
+#endif /* PROFILE_H */
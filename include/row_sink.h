@@ -0,0 +1,40 @@
+#ifndef ROW_SINK_H
+#define ROW_SINK_H
+
+#include <stdbool.h>
+#include "csv_reader.h"
+
+#ifndef RESULTSET_TYPEDEF
+#define RESULTSET_TYPEDEF
+typedef CsvTable ResultSet;
+#endif
+
+/* push based consumer of query rows: the producer calls begin once with the columns, then
+ * row for every row in order. rows and columns are only borrowed for the duration of the
+ * call, a sink copies whatever it keeps */
+typedef struct RowSink RowSink;
+
+struct RowSink {
+    void (*begin)(RowSink* sink, const Column* columns, int column_count);
+    /* false asks the producer to stop, no more rows are wanted */
+    bool (*row)(RowSink* sink, const Row* row);
+    /* flush and release the sink, also when begin was never called; false if the output failed */
+    bool (*end)(RowSink* sink);
+    /* optional, count consecutive rows at once so the sink can work on them in parallel;
+     * NULL feeds them to row one by one */
+    bool (*rows)(RowSink* sink, const Row* rows, int count);
+    /* optional, called by row_sink_push_result between begin and the rows: the whole result,
+     * row_count rows, follows in a single batch. streamed rows come without it */
+    void (*expect)(RowSink* sink, int row_count);
+};
+
+/* count rows through the rows method of sink, or row by row; false when the sink wants no more */
+bool row_sink_push_rows(RowSink* sink, const Row* rows, int count);
+
+/* begin, then every row of a materialized result; the sink is not ended */
+void row_sink_push_result(RowSink* sink, ResultSet* result);
+
+/* a sink feeding every row to both first and second, ending it ends both */
+RowSink* row_sink_tee(RowSink* first, RowSink* second);
+
+#endif /* ROW_SINK_H */
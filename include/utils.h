@@ -12,7 +12,6 @@ typedef CsvTable ResultSet;
 
 char* skipWhitespaces(char* str);
 void print_help(const char* program_name);
-void write_csv_file(const char* filename, ResultSet* result, char delimiter);
 char* read_query_from_file(const char* filename);
 char* read_query_from_stdin(void);
 
@@ -0,0 +1,121 @@
+/* arena.c - bump pointer allocator for table cells */
+
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "profile.h"
+
+#define ARENA_FIRST_CHUNK 4096
+#define ARENA_MAX_CHUNK (4 * 1024 * 1024)
+#define ARENA_ALIGN 8
+
+struct ArenaChunk {
+    ArenaChunk* next;
+    size_t size;
+    size_t used;
+    char data[];
+};
+
+Arena* arena_create(void) {
+    Arena* arena = calloc(1, sizeof(Arena));
+    arena->next_size = ARENA_FIRST_CHUNK;
+    return arena;
+}
+
+void arena_destroy(Arena* arena) {
+    if (!arena) return;
+    ArenaChunk* chunk = arena->head;
+    while (chunk) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    for (int i = 0; i < arena->adopted_count; i++) {
+        free(arena->adopted[i]);
+    }
+    free(arena->adopted);
+    free(arena);
+}
+
+static ArenaChunk* add_chunk(Arena* arena, size_t min_size) {
+    size_t size = arena->next_size;
+    if (size < min_size) size = min_size;
+    if (arena->next_size < ARENA_MAX_CHUNK) arena->next_size *= 2;
+
+    ArenaChunk* chunk = malloc(sizeof(ArenaChunk) + size);
+    chunk->size = size;
+    chunk->used = 0;
+    chunk->next = arena->head;
+    arena->head = chunk;
+    PROFILE_COUNT(allocations);
+    PROFILE_ADD(allocated_bytes, (long long)size);
+    return chunk;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (size == 0) size = ARENA_ALIGN;
+
+    ArenaChunk* chunk = arena->head;
+    if (!chunk || chunk->size - chunk->used < size) {
+        chunk = add_chunk(arena, size);
+    }
+    void* ptr = chunk->data + chunk->used;
+    chunk->used += size;
+    arena->bytes_used += size;
+    return ptr;
+}
+
+char* arena_strndup(Arena* arena, const char* s, size_t n) {
+    char* copy = arena_alloc(arena, n + 1);
+    memcpy(copy, s, n);
+    copy[n] = '\0';
+    return copy;
+}
+
+char* arena_strdup(Arena* arena, const char* s) {
+    return arena_strndup(arena, s, strlen(s));
+}
+
+void arena_adopt(Arena* arena, void* block) {
+    if (!block) return;
+    if (arena->adopted_count >= arena->adopted_capacity) {
+        arena->adopted_capacity = arena->adopted_capacity ? arena->adopted_capacity * 2 : 64;
+        arena->adopted = realloc(arena->adopted, sizeof(void*) * arena->adopted_capacity);
+    }
+    arena->adopted[arena->adopted_count++] = block;
+}
+
+void arena_absorb(Arena* dst, Arena* src) {
+    if (!src) return;
+
+    if (dst->adopted_count == 0) {
+        void** adopted = dst->adopted;
+        int capacity = dst->adopted_capacity;
+        dst->adopted = src->adopted;
+        dst->adopted_count = src->adopted_count;
+        dst->adopted_capacity = src->adopted_capacity;
+        src->adopted = adopted;
+        src->adopted_capacity = capacity;
+    } else {
+        for (int i = 0; i < src->adopted_count; i++) {
+            arena_adopt(dst, src->adopted[i]);
+        }
+    }
+    src->adopted_count = 0;
+    if (!src->head) return;
+
+    ArenaChunk* tail = src->head;
+    while (tail->next) tail = tail->next;
+
+    // keep allocating from the current chunk of dst
+    if (dst->head) {
+        tail->next = dst->head->next;
+        dst->head->next = src->head;
+    } else {
+        dst->head = src->head;
+    }
+    dst->bytes_used += src->bytes_used;
+    src->head = NULL;
+    src->bytes_used = 0;
+}
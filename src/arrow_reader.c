@@ -0,0 +1,458 @@
+/* arrow_reader.c - Arrow IPC file and stream input */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdint.h>
+
+#include "arrow.h"
+#include "date_utils.h"
+#include "flatbuffer.h"
+#include "string_utils.h"
+#include "profile.h"
+
+#define MS_PER_DAY 86400000LL
+
+/* how the values of a column are decoded */
+typedef enum {
+    READ_NULL,
+    READ_BOOL,
+    READ_INT,
+    READ_UINT,
+    READ_FLOAT,
+    READ_UTF8,
+    READ_DATE_DAYS,
+    READ_DATE_MS,
+} ArrowReadType;
+
+typedef struct {
+    ArrowReadType type;
+    int width;                  // bytes per value, or per utf8 offset
+} ArrowField;
+
+/* one column of the record batch being converted, pointers into the mapped file */
+typedef struct {
+    const uint8_t* validity;    // NULL when the batch has no nulls in the column
+    const uint8_t* values;
+    const uint8_t* offsets;     // utf8 only
+    size_t values_length;
+} ArrowSlice;
+
+typedef struct {
+    CsvTable* table;
+    const uint8_t* data;
+    size_t size;
+    ArrowField* fields;         // NULL until the schema message
+    char error[256];
+} ArrowReader;
+
+/* names of the Type union, for the error about an unsupported column */
+static const char* type_name(int type) {
+    static const char* names[] = {
+        "none", "null", "int", "floating point", "binary", "utf8", "bool", "decimal", "date",
+        "time", "timestamp", "interval", "list", "struct", "union", "fixed size binary",
+        "fixed size list", "map", "duration", "large binary", "large utf8", "large list",
+        "run end encoded", "binary view", "utf8 view", "list view", "large list view",
+    };
+    return type >= 0 && type < (int)(sizeof(names) / sizeof(names[0])) ? names[type] : "unknown";
+}
+
+static bool fail(ArrowReader* reader, const char* message) {
+    snprintf(reader->error, sizeof(reader->error), "%s", message);
+    return false;
+}
+
+bool arrow_detect(const char* data, size_t size) {
+    if (size >= 8 && memcmp(data, ARROW_MAGIC, 6) == 0) return true;
+    uint32_t marker;
+    if (size < 8) return false;
+    memcpy(&marker, data, 4);
+    return marker == ARROW_CONTINUATION;
+}
+
+/* ===== schema ===== */
+
+static bool field_type(ArrowReader* reader, const FlatTable* field, const char* name, ArrowField* out, ValueType* type) {
+    int type_id = (int)flatbuf_get_int(field, 2, 1, 0);
+    FlatTable params;
+    bool has_params = flatbuf_get_table(field, 3, &params);
+
+    switch (type_id) {
+        case ARROW_TYPE_NULL:
+            out->type = READ_NULL;
+            *type = VALUE_TYPE_STRING;
+            return true;
+        case ARROW_TYPE_BOOL:
+            out->type = READ_BOOL;
+            *type = VALUE_TYPE_INTEGER;
+            return true;
+        case ARROW_TYPE_INT: {
+            int bits = has_params ? (int)flatbuf_get_int(&params, 0, 4, 0) : 0;
+            if (bits != 8 && bits != 16 && bits != 32 && bits != 64) break;
+            out->type = flatbuf_get_int(&params, 1, 1, 0) ? READ_INT : READ_UINT;
+            out->width = bits / 8;
+            *type = VALUE_TYPE_INTEGER;
+            return true;
+        }
+        case ARROW_TYPE_FLOATING_POINT: {
+            // precision HALF is 0, SINGLE 1, DOUBLE 2
+            int precision = has_params ? (int)flatbuf_get_int(&params, 0, 2, 0) : 0;
+            if (precision != 1 && precision != 2) {
+                snprintf(reader->error, sizeof(reader->error),
+                         "column '%s' has half precision floats, which are not supported", name);
+                return false;
+            }
+            out->type = READ_FLOAT;
+            out->width = precision == 1 ? 4 : 8;
+            *type = VALUE_TYPE_DOUBLE;
+            return true;
+        }
+        case ARROW_TYPE_UTF8:
+        case ARROW_TYPE_LARGE_UTF8:
+            out->type = READ_UTF8;
+            out->width = type_id == ARROW_TYPE_UTF8 ? 4 : 8;
+            *type = VALUE_TYPE_STRING;
+            return true;
+        case ARROW_TYPE_DATE: {
+            // unit DAY is 0, MILLISECOND 1 and the default
+            int unit = has_params ? (int)flatbuf_get_int(&params, 0, 2, 1) : 1;
+            out->type = unit == 0 ? READ_DATE_DAYS : READ_DATE_MS;
+            out->width = unit == 0 ? 4 : 8;
+            *type = VALUE_TYPE_DATE;
+            return true;
+        }
+    }
+    snprintf(reader->error, sizeof(reader->error), "column '%s' has Arrow type %s, which is not supported",
+             name, type_name(type_id));
+    return false;
+}
+
+static bool read_schema(ArrowReader* reader, const FlatTable* schema) {
+    CsvTable* table = reader->table;
+    if (reader->fields) return fail(reader, "more than one schema");
+
+    size_t elements;
+    int count = flatbuf_get_vector(schema, 1, 4, &elements);
+    if (count <= 0) return fail(reader, "the schema has no columns");
+
+    table->columns = calloc(count, sizeof(Column));
+    table->column_count = count;
+    reader->fields = calloc(count, sizeof(ArrowField));
+
+    for (int i = 0; i < count; i++) {
+        FlatTable field;
+        if (!flatbuf_vector_table(schema, elements, i, &field)) return fail(reader, "damaged schema");
+
+        size_t len = 0;
+        const char* name = flatbuf_get_string(&field, 0, &len);
+        if (name && len > 0) {
+            table->columns[i].name = cq_strndup(name, len);
+        } else {
+            // unnamed columns get the names of a CSV file without header
+            char col_name[16];
+            snprintf(col_name, sizeof(col_name), "$%d", i);
+            table->columns[i].name = strdup(col_name);
+        }
+
+        size_t children;
+        if (flatbuf_has_field(&field, 4)) {
+            snprintf(reader->error, sizeof(reader->error),
+                     "column '%s' is dictionary encoded, which is not supported", table->columns[i].name);
+            return false;
+        }
+        if (flatbuf_get_vector(&field, 5, 4, &children) > 0) {
+            snprintf(reader->error, sizeof(reader->error),
+                     "column '%s' is nested, which is not supported", table->columns[i].name);
+            return false;
+        }
+        if (!field_type(reader, &field, table->columns[i].name, &reader->fields[i],
+                        &table->columns[i].inferred_type)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* ===== record batches ===== */
+
+/* buffer index of the batch, checked against the body; a zero length buffer gives NULL */
+static bool body_buffer(const FlatTable* batch, size_t buffers, int index, const uint8_t* body,
+                        int64_t body_length, const uint8_t** out, size_t* length) {
+    ArrowBuffer buffer;
+    memcpy(&buffer, batch->buffer + buffers + (size_t)index * sizeof(ArrowBuffer), sizeof(ArrowBuffer));
+    if (buffer.offset < 0 || buffer.length < 0 || buffer.offset > body_length ||
+        buffer.length > body_length - buffer.offset) {
+        return false;
+    }
+    *out = buffer.length ? body + buffer.offset : NULL;
+    *length = (size_t)buffer.length;
+    return true;
+}
+
+static int64_t read_offset(const uint8_t* offsets, int width, int64_t row) {
+    if (width == 4) {
+        int32_t offset;
+        memcpy(&offset, offsets + row * 4, 4);
+        return offset;
+    }
+    int64_t offset;
+    memcpy(&offset, offsets + row * 8, 8);
+    return offset;
+}
+
+/* find the buffers of every column and check that they hold length rows */
+static bool slice_columns(ArrowReader* reader, const FlatTable* batch, const uint8_t* body, int64_t body_length,
+                          int64_t length, ArrowSlice* slices) {
+    CsvTable* table = reader->table;
+    size_t nodes, buffers;
+    int node_count = flatbuf_get_vector(batch, 1, sizeof(ArrowFieldNode), &nodes);
+    int buffer_count = flatbuf_get_vector(batch, 2, sizeof(ArrowBuffer), &buffers);
+    if (node_count != table->column_count || buffer_count < 0) {
+        return fail(reader, "a record batch does not match the schema");
+    }
+
+    int next_buffer = 0;
+    for (int i = 0; i < table->column_count; i++) {
+        const ArrowField* field = &reader->fields[i];
+        ArrowSlice* slice = &slices[i];
+        ArrowFieldNode node;
+        memcpy(&node, batch->buffer + nodes + (size_t)i * sizeof(ArrowFieldNode), sizeof(ArrowFieldNode));
+        if (node.length != length) return fail(reader, "a record batch does not match the schema");
+        if (field->type == READ_NULL) continue;     // no buffers at all
+
+        int needed = field->type == READ_UTF8 ? 3 : 2;
+        if (next_buffer + needed > buffer_count) return fail(reader, "a record batch does not match the schema");
+        const uint8_t* validity;
+        const uint8_t* offsets = NULL;
+        size_t validity_length, offsets_length = 0;
+        bool ok = body_buffer(batch, buffers, next_buffer++, body, body_length, &validity, &validity_length);
+        if (field->type == READ_UTF8) {
+            ok = ok && body_buffer(batch, buffers, next_buffer++, body, body_length, &offsets, &offsets_length);
+        }
+        ok = ok && body_buffer(batch, buffers, next_buffer++, body, body_length, &slice->values, &slice->values_length);
+        if (!ok) return fail(reader, "a buffer lies outside its record batch");
+
+        size_t bitmap_bytes = (size_t)(length + 7) / 8;
+        slice->validity = node.null_count > 0 ? validity : NULL;
+        if (slice->validity && validity_length < bitmap_bytes) return fail(reader, "a validity bitmap is too short");
+
+        size_t values_needed = field->type == READ_BOOL ? bitmap_bytes
+                             : field->type == READ_UTF8 ? 0 : (size_t)length * field->width;
+        if (slice->values_length < values_needed) return fail(reader, "a column buffer is too short");
+
+        if (field->type == READ_UTF8) {
+            if (length > 0 && offsets_length < (size_t)(length + 1) * field->width) {
+                return fail(reader, "a string offsets buffer is too short");
+            }
+            slice->offsets = offsets;
+            // offsets must rise within the data, every string is then in bounds
+            int64_t previous = length > 0 ? read_offset(offsets, field->width, 0) : 0;
+            if (previous < 0) return fail(reader, "damaged string offsets");
+            for (int64_t row = 1; row <= length; row++) {
+                int64_t offset = read_offset(offsets, field->width, row);
+                if (offset < previous) return fail(reader, "damaged string offsets");
+                previous = offset;
+            }
+            if ((uint64_t)previous > slice->values_length) return fail(reader, "damaged string offsets");
+        }
+    }
+    return true;
+}
+
+static Value read_value(const ArrowField* field, const ArrowSlice* slice, int64_t row, Arena* arena) {
+    Value value;
+    value.int_value = 0;
+    if (slice->validity && !(slice->validity[row / 8] & (1 << (row % 8)))) {
+        value.type = VALUE_TYPE_NULL;
+        return value;
+    }
+
+    const uint8_t* p = slice->values + (field->type == READ_BOOL || field->type == READ_UTF8 ? 0 : row * field->width);
+    switch (field->type) {
+        case READ_NULL:
+            value.type = VALUE_TYPE_NULL;
+            break;
+        case READ_BOOL:
+            value.type = VALUE_TYPE_INTEGER;
+            value.int_value = (slice->values[row / 8] >> (row % 8)) & 1;
+            break;
+        case READ_INT: {
+            value.type = VALUE_TYPE_INTEGER;
+            switch (field->width) {
+                case 1: value.int_value = (int8_t)*p; break;
+                case 2: { int16_t v; memcpy(&v, p, 2); value.int_value = v; break; }
+                case 4: { int32_t v; memcpy(&v, p, 4); value.int_value = v; break; }
+                default: { int64_t v; memcpy(&v, p, 8); value.int_value = v; break; }
+            }
+            break;
+        }
+        case READ_UINT: {
+            uint64_t v = 0;
+            switch (field->width) {
+                case 1: v = *p; break;
+                case 2: { uint16_t u; memcpy(&u, p, 2); v = u; break; }
+                case 4: { uint32_t u; memcpy(&u, p, 4); v = u; break; }
+                default: memcpy(&v, p, 8); break;
+            }
+            // past the range of INTEGER the value is kept approximately, as in CSV input
+            if (v > INT64_MAX) {
+                value.type = VALUE_TYPE_DOUBLE;
+                value.double_value = (double)v;
+            } else {
+                value.type = VALUE_TYPE_INTEGER;
+                value.int_value = (long long)v;
+            }
+            break;
+        }
+        case READ_FLOAT:
+            value.type = VALUE_TYPE_DOUBLE;
+            if (field->width == 4) {
+                float f;
+                memcpy(&f, p, 4);
+                value.double_value = f;
+            } else {
+                memcpy(&value.double_value, p, 8);
+            }
+            break;
+        case READ_UTF8: {
+            int64_t start = read_offset(slice->offsets, field->width, row);
+            size_t len = (size_t)(read_offset(slice->offsets, field->width, row + 1) - start);
+            const char* str = (const char*)slice->values + start;
+            value.type = VALUE_TYPE_STRING;
+            if (arena) {
+                value.string_value = arena_strndup(arena, str, len);
+            } else {
+                value.string_value = cq_strndup(str, len);
+                PROFILE_COUNT(allocations);
+                PROFILE_ADD(allocated_bytes, (long long)len + 1);
+            }
+            break;
+        }
+        case READ_DATE_DAYS: {
+            int32_t days;
+            memcpy(&days, p, 4);
+            // a day past the years a DateValue holds reads as NULL
+            value.type = days_to_date(days, &value.date_value) ? VALUE_TYPE_DATE : VALUE_TYPE_NULL;
+            break;
+        }
+        case READ_DATE_MS: {
+            int64_t ms;
+            memcpy(&ms, p, 8);
+            int64_t days = ms / MS_PER_DAY - (ms % MS_PER_DAY < 0);
+            value.type = days_to_date(days, &value.date_value) ? VALUE_TYPE_DATE : VALUE_TYPE_NULL;
+            break;
+        }
+    }
+    return value;
+}
+
+/* a batch is checked as a whole before any of it is converted, so rows are never half read */
+static bool read_batch(ArrowReader* reader, const FlatTable* batch, const uint8_t* body, int64_t body_length) {
+    CsvTable* table = reader->table;
+    if (!reader->fields) return fail(reader, "a record batch comes before the schema");
+    if (flatbuf_has_field(batch, 3)) return fail(reader, "compressed record batches are not supported");
+
+    int64_t length = flatbuf_get_int(batch, 0, 8, 0);
+    if (length < 0 || length > INT_MAX - table->row_count) return fail(reader, "too many rows");
+
+    ArrowSlice* slices = calloc(table->column_count, sizeof(ArrowSlice));
+    if (!slice_columns(reader, batch, body, body_length, length, slices)) {
+        free(slices);
+        return false;
+    }
+
+    int first = table->row_count;
+    if (first + length > table->row_capacity) {
+        int capacity = table->row_capacity ? table->row_capacity : 64;
+        while (capacity < first + length) capacity = capacity > INT_MAX / 2 ? INT_MAX : capacity * 2;
+        table->rows = realloc(table->rows, sizeof(Row) * capacity);
+        table->row_capacity = capacity;
+    }
+    for (int64_t row = 0; row < length; row++) {
+        Row* out = &table->rows[first + row];
+        out->column_count = table->column_count;
+        size_t bytes = sizeof(Value) * table->column_count;
+        out->values = table->arena ? arena_alloc(table->arena, bytes) : malloc(bytes);
+    }
+    table->row_count += (int)length;
+
+    // column by column, each one walks its own buffers in order
+    for (int i = 0; i < table->column_count; i++) {
+        for (int64_t row = 0; row < length; row++) {
+            table->rows[first + row].values[i] = read_value(&reader->fields[i], &slices[i], row, table->arena);
+        }
+    }
+    free(slices);
+    return true;
+}
+
+/* ===== messages ===== */
+
+static bool read_messages(ArrowReader* reader) {
+    const uint8_t* data = reader->data;
+    size_t position = 0;
+    size_t end = reader->size;
+
+    if (end >= 8 && memcmp(data, ARROW_MAGIC, 6) == 0) {
+        // file format: magic, the messages as in a stream, then the footer, its length and the magic
+        position = 8;
+        int32_t footer_length;
+        if (end < 18 || memcmp(data + end - 6, ARROW_MAGIC, 6) != 0) return fail(reader, "the file is truncated");
+        memcpy(&footer_length, data + end - 10, 4);
+        if (footer_length <= 0 || (size_t)footer_length > end - 18) return fail(reader, "damaged footer");
+        end -= 10 + (size_t)footer_length;
+    }
+
+    while (end - position >= 4) {
+        uint32_t length;
+        memcpy(&length, data + position, 4);
+        position += 4;
+        if (length == ARROW_CONTINUATION) {
+            if (end - position < 4) break;
+            memcpy(&length, data + position, 4);
+            position += 4;
+        }
+        if (length == 0) break;         // end of stream
+        if (length > end - position) return fail(reader, "a message is truncated");
+
+        FlatTable message, header;
+        if (!flatbuf_root(data + position, length, &message) || !flatbuf_get_table(&message, 2, &header)) {
+            return fail(reader, "damaged message");
+        }
+        position += length;
+        int64_t body_length = flatbuf_get_int(&message, 3, 8, 0);
+        if (body_length < 0 || (uint64_t)body_length > end - position) return fail(reader, "a message body is truncated");
+
+        int header_type = (int)flatbuf_get_int(&message, 1, 1, 0);
+        bool ok = true;
+        if (header_type == ARROW_HEADER_SCHEMA) {
+            ok = read_schema(reader, &header);
+        } else if (header_type == ARROW_HEADER_RECORD_BATCH) {
+            ok = read_batch(reader, &header, data + position, body_length);
+        } else if (header_type == ARROW_HEADER_DICTIONARY_BATCH) {
+            ok = fail(reader, "dictionary batches are not supported");
+        } else {
+            ok = fail(reader, "the file holds a tensor, not a table");
+        }
+        if (!ok) return false;
+        position += (size_t)body_length;
+    }
+    if (!reader->fields) return fail(reader, "the file has no schema");
+    return true;
+}
+
+bool arrow_load(CsvTable* table) {
+    ArrowReader reader;
+    memset(&reader, 0, sizeof(reader));
+    reader.table = table;
+    reader.data = (const uint8_t*)table->data;
+    reader.size = table->file_size;
+    table->has_header = true;
+    table->arrow = true;
+
+    bool ok = read_messages(&reader);
+    if (!ok) fprintf(stderr, "Error: cannot read Arrow file '%s': %s\n", table->filename, reader.error);
+    free(reader.fields);
+    return ok;
+}
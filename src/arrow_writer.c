@@ -0,0 +1,468 @@
+/* arrow_writer.c - Arrow IPC stream and file output */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+
+#include "arrow.h"
+#include "date_utils.h"
+#include "flatbuffer.h"
+#include "output_writer.h"
+
+/* a batch is cut short before its utf8 data outgrows the 32 bit offsets */
+#define ARROW_BATCH_TEXT (1 << 30)
+
+typedef enum { ARROW_UTF8, ARROW_INT64, ARROW_FLOAT64, ARROW_DATE32 } ArrowColumnType;
+
+/* one column of the batch being collected */
+typedef struct {
+    ArrowColumnType type;
+    bool mismatch_reported;
+    uint8_t* validity;          // bit per row, set for the non null ones
+    int64_t null_count;
+    char* values;               // int64, double or int32 days per row, utf8 bytes
+    size_t values_length;
+    size_t values_capacity;
+    int32_t* offsets;           // utf8: start of every row in values, and the end
+} ArrowColumn;
+
+typedef struct {
+    RowSink base;
+    char* filename;             // NULL writes the stream format to standard output
+    bool opened;
+    int open_errno;
+    OutputWriter out;
+    int64_t position;           // bytes written, the footer points back into the file
+    FlatBuilder fb;
+
+    Column* columns;            // names copied by begin
+    int column_count;
+    ArrowColumn* arrays;
+    bool typed;                 // types fixed and schema written
+    Value* pending;             // the first batch, copied until the types are known
+    int rows;                   // rows in the current batch
+    size_t text_bytes;          // utf8 bytes in the current batch
+
+    ArrowBlock* blocks;         // record batches, for the footer
+    int block_count;
+    int block_capacity;
+} ArrowSink;
+
+/* ===== output ===== */
+
+static void arrow_write(ArrowSink* sink, const void* data, size_t len) {
+    writer_write(&sink->out, data, len);
+    sink->position += (int64_t)len;
+}
+
+static size_t padded(size_t len) {
+    return (len + 7) & ~(size_t)7;
+}
+
+/* zeros up to the next multiple of 8 after len bytes */
+static void arrow_pad(ArrowSink* sink, size_t len) {
+    static const char zeros[8] = {0};
+    arrow_write(sink, zeros, padded(len) - len);
+}
+
+/* wrap header in a Message and write it framed: continuation marker, metadata length, the
+ * metadata padded to 8 bytes; returns the framed length */
+static int32_t arrow_message(ArrowSink* sink, uint8_t header_type, FlatRef header, int64_t body_length) {
+    FlatBuilder* fb = &sink->fb;
+    flatbuf_start_table(fb);
+    flatbuf_add_i16(fb, 0, ARROW_METADATA_V5);     // version
+    flatbuf_add_u8(fb, 1, header_type);
+    flatbuf_add_ref(fb, 2, header);
+    flatbuf_add_i64(fb, 3, body_length);
+    FlatRef message = flatbuf_end_table(fb);
+
+    size_t size;
+    const uint8_t* bytes = flatbuf_finish(fb, message, &size);
+    uint32_t continuation = ARROW_CONTINUATION;
+    int32_t length = (int32_t)padded(size);
+    arrow_write(sink, &continuation, 4);
+    arrow_write(sink, &length, 4);
+    arrow_write(sink, bytes, size);
+    arrow_pad(sink, size);
+    flatbuf_reset(fb);
+    return length + 8;
+}
+
+/* ===== schema ===== */
+
+static uint8_t arrow_type_id(ArrowColumnType type) {
+    switch (type) {
+        case ARROW_INT64: return ARROW_TYPE_INT;
+        case ARROW_FLOAT64: return ARROW_TYPE_FLOATING_POINT;
+        case ARROW_DATE32: return ARROW_TYPE_DATE;
+        case ARROW_UTF8: break;
+    }
+    return ARROW_TYPE_UTF8;
+}
+
+static FlatRef arrow_type_table(FlatBuilder* fb, ArrowColumnType type) {
+    flatbuf_start_table(fb);
+    switch (type) {
+        case ARROW_INT64:
+            flatbuf_add_i32(fb, 0, 64);                 // bitWidth
+            flatbuf_add_u8(fb, 1, 1);                   // is_signed
+            break;
+        case ARROW_FLOAT64:
+            flatbuf_add_i16(fb, 0, 2);                  // precision DOUBLE
+            break;
+        case ARROW_DATE32:
+            flatbuf_add_i16(fb, 0, 0);                  // unit DAY
+            break;
+        case ARROW_UTF8:
+            break;
+    }
+    return flatbuf_end_table(fb);
+}
+
+static FlatRef arrow_schema(ArrowSink* sink) {
+    FlatBuilder* fb = &sink->fb;
+    FlatRef* fields = malloc(sizeof(FlatRef) * (sink->column_count > 0 ? sink->column_count : 1));
+    for (int c = 0; c < sink->column_count; c++) {
+        FlatRef name = flatbuf_string(fb, sink->columns[c].name);
+        FlatRef type = arrow_type_table(fb, sink->arrays[c].type);
+        FlatRef children = flatbuf_table_vector(fb, NULL, 0);
+        flatbuf_start_table(fb);
+        flatbuf_add_ref(fb, 0, name);
+        flatbuf_add_u8(fb, 1, 1);                       // nullable
+        flatbuf_add_u8(fb, 2, arrow_type_id(sink->arrays[c].type));
+        flatbuf_add_ref(fb, 3, type);
+        flatbuf_add_ref(fb, 5, children);
+        fields[c] = flatbuf_end_table(fb);
+    }
+    FlatRef vector = flatbuf_table_vector(fb, fields, sink->column_count);
+    free(fields);
+
+    flatbuf_start_table(fb);
+    flatbuf_add_i16(fb, 0, 0);                          // endianness Little
+    flatbuf_add_ref(fb, 1, vector);
+    return flatbuf_end_table(fb);
+}
+
+/* ===== record batches ===== */
+
+/* a NULL cell, or a string cell reading NULL, is null as in the JSON output */
+static bool arrow_null(const Value* value) {
+    return value->type == VALUE_TYPE_NULL ||
+           (value->type == VALUE_TYPE_STRING && value->string_value && strcmp(value->string_value, "NULL") == 0);
+}
+
+/* a value of a later batch that does not fit the type of its column is written as null */
+static bool arrow_mismatch(ArrowSink* sink, int c) {
+    ArrowColumn* array = &sink->arrays[c];
+    if (!array->mismatch_reported) {
+        fprintf(stderr, "Warning: column '%s' has values that do not fit its Arrow type, they are written as null\n",
+                sink->columns[c].name);
+        array->mismatch_reported = true;
+    }
+    return false;
+}
+
+static void arrow_reserve(ArrowColumn* array, size_t len) {
+    if (array->values_length + len <= array->values_capacity) return;
+    size_t capacity = array->values_capacity ? array->values_capacity * 2 : 4096;
+    while (capacity < array->values_length + len) capacity *= 2;
+    array->values = realloc(array->values, capacity);
+    array->values_capacity = capacity;
+}
+
+static void arrow_append(ArrowSink* sink, int c, const Value* value) {
+    ArrowColumn* array = &sink->arrays[c];
+    int row = sink->rows;
+    bool valid = !arrow_null(value);
+
+    switch (array->type) {
+        case ARROW_INT64: {
+            int64_t number = 0;
+            if (valid && value->type == VALUE_TYPE_INTEGER) number = value->int_value;
+            else if (valid) valid = arrow_mismatch(sink, c);
+            memcpy(array->values + (size_t)row * 8, &number, 8);
+            break;
+        }
+        case ARROW_FLOAT64: {
+            double number = 0;
+            if (valid && value->type == VALUE_TYPE_DOUBLE) number = value->double_value;
+            else if (valid && value->type == VALUE_TYPE_INTEGER) number = (double)value->int_value;
+            else if (valid) valid = arrow_mismatch(sink, c);
+            memcpy(array->values + (size_t)row * 8, &number, 8);
+            break;
+        }
+        case ARROW_DATE32: {
+            int32_t days = 0;
+            if (valid && value->type == VALUE_TYPE_DATE) days = (int32_t)date_to_days(value->date_value);
+            else if (valid) valid = arrow_mismatch(sink, c);
+            memcpy(array->values + (size_t)row * 4, &days, 4);
+            break;
+        }
+        case ARROW_UTF8:
+            if (valid) {
+                char scratch[VALUE_TEXT_SIZE];
+                size_t len;
+                const char* text = scratch;
+                if (value->type == VALUE_TYPE_DOUBLE) {
+                    // full precision as in CSV files, not the two decimals of the display
+                    len = (size_t)snprintf(scratch, sizeof(scratch), "%.15g", value->double_value);
+                } else {
+                    text = value_text(value, scratch, &len);
+                }
+                arrow_reserve(array, len);
+                memcpy(array->values + array->values_length, text, len);
+                array->values_length += len;
+                sink->text_bytes += len;
+            }
+            array->offsets[row + 1] = (int32_t)array->values_length;
+            break;
+    }
+
+    if (row % 8 == 0) array->validity[row / 8] = 0;
+    if (valid) array->validity[row / 8] |= (uint8_t)(1 << (row % 8));
+    else array->null_count++;
+}
+
+static void arrow_write_batch(ArrowSink* sink) {
+    int columns = sink->column_count;
+    int64_t rows = sink->rows;
+    ArrowFieldNode* nodes = calloc(columns > 0 ? columns : 1, sizeof(ArrowFieldNode));
+    ArrowBuffer* buffers = calloc(3 * (columns > 0 ? columns : 1), sizeof(ArrowBuffer));
+    int buffer_count = 0;
+    int64_t body = 0;
+
+    // every buffer starts at a multiple of 8 in the body, the validity bitmap is left out
+    // when the column has no nulls
+    for (int c = 0; c < columns; c++) {
+        ArrowColumn* array = &sink->arrays[c];
+        nodes[c].length = rows;
+        nodes[c].null_count = array->null_count;
+        int64_t validity = array->null_count ? (rows + 7) / 8 : 0;
+        buffers[buffer_count++] = (ArrowBuffer){body, validity};
+        body += (int64_t)padded((size_t)validity);
+        if (array->type == ARROW_UTF8) {
+            int64_t offsets = (rows + 1) * 4;
+            buffers[buffer_count++] = (ArrowBuffer){body, offsets};
+            body += (int64_t)padded((size_t)offsets);
+        } else {
+            array->values_length = (size_t)rows * (array->type == ARROW_DATE32 ? 4 : 8);
+        }
+        buffers[buffer_count++] = (ArrowBuffer){body, (int64_t)array->values_length};
+        body += (int64_t)padded(array->values_length);
+    }
+
+    FlatBuilder* fb = &sink->fb;
+    FlatRef node_vector = flatbuf_struct_vector(fb, nodes, sizeof(ArrowFieldNode), columns, 8);
+    FlatRef buffer_vector = flatbuf_struct_vector(fb, buffers, sizeof(ArrowBuffer), buffer_count, 8);
+    flatbuf_start_table(fb);
+    flatbuf_add_i64(fb, 0, rows);                       // length
+    flatbuf_add_ref(fb, 1, node_vector);
+    flatbuf_add_ref(fb, 2, buffer_vector);
+    FlatRef batch = flatbuf_end_table(fb);
+    free(nodes);
+    free(buffers);
+
+    int64_t offset = sink->position;
+    int32_t metadata_length = arrow_message(sink, ARROW_HEADER_RECORD_BATCH, batch, body);
+    for (int c = 0; c < columns; c++) {
+        ArrowColumn* array = &sink->arrays[c];
+        if (array->null_count) {
+            size_t validity = (size_t)(rows + 7) / 8;
+            arrow_write(sink, array->validity, validity);
+            arrow_pad(sink, validity);
+        }
+        if (array->type == ARROW_UTF8) {
+            size_t offsets = (size_t)(rows + 1) * 4;
+            arrow_write(sink, array->offsets, offsets);
+            arrow_pad(sink, offsets);
+        }
+        arrow_write(sink, array->values, array->values_length);
+        arrow_pad(sink, array->values_length);
+
+        array->null_count = 0;
+        if (array->type == ARROW_UTF8) array->values_length = 0;
+    }
+
+    if (sink->filename) {
+        if (sink->block_count == sink->block_capacity) {
+            sink->block_capacity = sink->block_capacity ? sink->block_capacity * 2 : 16;
+            sink->blocks = realloc(sink->blocks, sizeof(ArrowBlock) * sink->block_capacity);
+        }
+        sink->blocks[sink->block_count++] = (ArrowBlock){offset, metadata_length, 0, body};
+    }
+    sink->rows = 0;
+    sink->text_bytes = 0;
+}
+
+/* add one row to the batch, the batch goes out when it is full */
+static void arrow_push(ArrowSink* sink, const Value* values, int value_count) {
+    static const Value null_value = {.type = VALUE_TYPE_NULL};
+    if (sink->rows > 0 && sink->text_bytes > ARROW_BATCH_TEXT) arrow_write_batch(sink);
+    for (int c = 0; c < sink->column_count; c++) {
+        arrow_append(sink, c, c < value_count ? &values[c] : &null_value);
+    }
+    if (++sink->rows == ARROW_BATCH_ROWS) arrow_write_batch(sink);
+}
+
+/* pick the column types from the pending rows, write the schema, then those rows */
+static void arrow_fix_types(ArrowSink* sink) {
+    int columns = sink->column_count;
+    int pending = sink->rows;
+    sink->arrays = calloc(columns > 0 ? columns : 1, sizeof(ArrowColumn));
+    for (int c = 0; c < columns; c++) {
+        bool integers = false, doubles = false, dates = false, others = false;
+        for (int r = 0; r < pending; r++) {
+            const Value* value = &sink->pending[(size_t)r * columns + c];
+            if (arrow_null(value)) continue;
+            if (value->type == VALUE_TYPE_INTEGER) integers = true;
+            else if (value->type == VALUE_TYPE_DOUBLE) doubles = true;
+            else if (value->type == VALUE_TYPE_DATE) dates = true;
+            else others = true;
+        }
+
+        ArrowColumn* array = &sink->arrays[c];
+        if (others || (dates && (integers || doubles)) || !(integers || doubles || dates)) array->type = ARROW_UTF8;
+        else if (dates) array->type = ARROW_DATE32;
+        else if (doubles) array->type = ARROW_FLOAT64;
+        else array->type = ARROW_INT64;
+
+        array->validity = malloc(ARROW_BATCH_ROWS / 8);
+        if (array->type == ARROW_UTF8) {
+            array->offsets = malloc(sizeof(int32_t) * (ARROW_BATCH_ROWS + 1));
+            array->offsets[0] = 0;
+        } else {
+            array->values_capacity = (size_t)ARROW_BATCH_ROWS * 8;
+            array->values = malloc(array->values_capacity);
+        }
+    }
+    sink->typed = true;
+    arrow_message(sink, ARROW_HEADER_SCHEMA, arrow_schema(sink), 0);
+
+    sink->rows = 0;
+    for (int r = 0; r < pending; r++) {
+        Value* values = &sink->pending[(size_t)r * columns];
+        arrow_push(sink, values, columns);
+        for (int c = 0; c < columns; c++) {
+            if (values[c].type == VALUE_TYPE_STRING) free(values[c].string_value);
+        }
+    }
+    free(sink->pending);
+    sink->pending = NULL;
+}
+
+/* ===== sink ===== */
+
+static void arrow_begin(RowSink* base, const Column* columns, int column_count) {
+    ArrowSink* sink = (ArrowSink*)base;
+    sink->column_count = column_count;
+    sink->columns = malloc(sizeof(Column) * (column_count > 0 ? column_count : 1));
+    for (int c = 0; c < column_count; c++) {
+        sink->columns[c].name = strdup(columns[c].name);
+        sink->columns[c].inferred_type = columns[c].inferred_type;
+    }
+    sink->pending = malloc(sizeof(Value) * (size_t)ARROW_BATCH_ROWS * (column_count > 0 ? column_count : 1));
+
+    if (sink->filename) {
+        if (!writer_open(&sink->out, sink->filename)) {
+            sink->open_errno = errno;
+            return;
+        }
+        arrow_write(sink, ARROW_MAGIC "\0\0", 8);
+    } else {
+        writer_open_fd(&sink->out, WRITER_STDOUT);
+    }
+    sink->opened = true;
+}
+
+static bool arrow_row(RowSink* base, const Row* row) {
+    ArrowSink* sink = (ArrowSink*)base;
+    if (!sink->opened) return false;
+    if (sink->typed) {
+        arrow_push(sink, row->values, row->column_count);
+        return true;
+    }
+
+    Value* copy = &sink->pending[(size_t)sink->rows * sink->column_count];
+    for (int c = 0; c < sink->column_count; c++) {
+        copy[c].type = VALUE_TYPE_NULL;
+        if (c >= row->column_count) continue;
+        copy[c] = row->values[c];
+        if (copy[c].type == VALUE_TYPE_STRING && copy[c].string_value) {
+            copy[c].string_value = strdup(copy[c].string_value);
+        }
+    }
+    if (++sink->rows == ARROW_BATCH_ROWS) arrow_fix_types(sink);
+    return true;
+}
+
+/* the file ends with a footer repeating the schema and locating every record batch */
+static void arrow_footer(ArrowSink* sink) {
+    FlatBuilder* fb = &sink->fb;
+    FlatRef schema = arrow_schema(sink);
+    FlatRef dictionaries = flatbuf_struct_vector(fb, NULL, sizeof(ArrowBlock), 0, 8);
+    FlatRef batches = flatbuf_struct_vector(fb, sink->blocks, sizeof(ArrowBlock), sink->block_count, 8);
+    flatbuf_start_table(fb);
+    flatbuf_add_i16(fb, 0, ARROW_METADATA_V5);
+    flatbuf_add_ref(fb, 1, schema);
+    flatbuf_add_ref(fb, 2, dictionaries);
+    flatbuf_add_ref(fb, 3, batches);
+    FlatRef footer = flatbuf_end_table(fb);
+
+    size_t size;
+    const uint8_t* bytes = flatbuf_finish(fb, footer, &size);
+    int32_t length = (int32_t)size;
+    arrow_write(sink, bytes, size);
+    arrow_write(sink, &length, 4);
+    arrow_write(sink, ARROW_MAGIC, 6);
+    flatbuf_reset(fb);
+}
+
+static bool arrow_end(RowSink* base) {
+    ArrowSink* sink = (ArrowSink*)base;
+    bool ok = true;
+
+    if (sink->opened) {
+        if (!sink->typed) arrow_fix_types(sink);
+        if (sink->rows > 0) arrow_write_batch(sink);
+        uint32_t end_of_stream[2] = {ARROW_CONTINUATION, 0};
+        arrow_write(sink, end_of_stream, 8);
+        if (sink->filename) arrow_footer(sink);
+
+        ok = writer_close(&sink->out);
+        // standard output never reports failure, as with the other formats
+        if (!sink->filename) ok = true;
+    } else if (sink->open_errno) {
+        ok = false;
+        errno = sink->open_errno;
+    }
+
+    for (int c = 0; c < sink->column_count; c++) {
+        free(sink->columns[c].name);
+        if (sink->arrays) {
+            free(sink->arrays[c].validity);
+            free(sink->arrays[c].values);
+            free(sink->arrays[c].offsets);
+        }
+    }
+    free(sink->columns);
+    free(sink->arrays);
+    free(sink->pending);
+    free(sink->blocks);
+    flatbuf_free(&sink->fb);
+    free(sink->filename);
+    free(sink);
+    return ok;
+}
+
+RowSink* arrow_sink_create(const char* filename) {
+    ArrowSink* sink = calloc(1, sizeof(ArrowSink));
+    sink->base.begin = arrow_begin;
+    sink->base.row = arrow_row;
+    sink->base.end = arrow_end;
+    sink->filename = filename ? strdup(filename) : NULL;
+    flatbuf_init(&sink->fb);
+    flatbuf_reset(&sink->fb);
+    return &sink->base;
+}
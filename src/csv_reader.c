@@ -11,7 +11,12 @@
 #include "string_utils.h"
 #include "utils.h"
 #include "date_utils.h"
+#include "number_utils.h"
+#include "output_writer.h"
 #include "mmap.h"
+#include "profile.h"
+#include "arrow.h"
+#include "input_stream.h"
 
 
 /* CSV configuration used in tests */
@@ -20,6 +25,9 @@ CsvConfig csv_config_default(void) {
     config.delimiter = ',';
     config.quote = '"';
     config.has_header = true;
+    config.arena = false;
+    config.sample_rows = 0;
+    config.schema = NULL;
     return config;
 }
 
@@ -50,22 +58,6 @@ static void* ensure_field_capacity(void* array, int* capacity, int current_count
     return array;
 }
 
-/* helper: convert value to numeric (double) */
-static double value_to_numeric(Value* value) {
-    if (!value) return 0.0;
-    
-    switch (value->type) {
-        case VALUE_TYPE_INTEGER:
-            return (double)value->int_value;
-        case VALUE_TYPE_DOUBLE:
-            return value->double_value;
-        case VALUE_TYPE_STRING:
-            return strtod(value->string_value, NULL);
-        default:
-            return 0.0;
-    }
-}
-
 /* value utilities */
 void value_free(Value* value) {
     if (value && value->type == VALUE_TYPE_STRING && value->string_value) {
@@ -95,6 +87,18 @@ char* value_to_string(Value* value) {
     return strdup("");
 }
 
+/* exact ordering of an integer and a double, without rounding the integer */
+static int compare_int_double(long long i, double d) {
+    if (d != d) return 0;                               // NaN is not ordered
+    if (d >= 9223372036854775808.0) return -1;
+    if (d < -9223372036854775808.0) return 1;
+    
+    long long whole = (long long)d;                     // truncated toward zero, exact
+    if (i != whole) return i < whole ? -1 : 1;
+    double fraction = d - (double)whole;
+    return fraction > 0 ? -1 : (fraction < 0 ? 1 : 0);
+}
+
 int value_compare(Value* a, Value* b) {
     if (!a || !b) return 0;
     
@@ -108,20 +112,23 @@ int value_compare(Value* a, Value* b) {
         return compare_dates(a->date_value, b->date_value);
     }
     
-    // handle numeric comparisons (int vs int, double vs double, int vs double)
-    if ((a->type == VALUE_TYPE_INTEGER || a->type == VALUE_TYPE_DOUBLE) &&
-        (b->type == VALUE_TYPE_INTEGER || b->type == VALUE_TYPE_DOUBLE)) {
-        
-        double a_val = value_to_numeric(a);
-        double b_val = value_to_numeric(b);
-        
-        if (a_val < b_val) return -1;
-        if (a_val > b_val) return 1;
-        return 0;
+    // handle numeric comparisons, each type pair compares exactly in its own kernel
+    if (a->type == VALUE_TYPE_INTEGER && b->type == VALUE_TYPE_INTEGER) {
+        return (a->int_value > b->int_value) - (a->int_value < b->int_value);
+    }
+    if (a->type == VALUE_TYPE_DOUBLE && b->type == VALUE_TYPE_DOUBLE) {
+        return (a->double_value > b->double_value) - (a->double_value < b->double_value);
+    }
+    if (a->type == VALUE_TYPE_INTEGER && b->type == VALUE_TYPE_DOUBLE) {
+        return compare_int_double(a->int_value, b->double_value);
+    }
+    if (a->type == VALUE_TYPE_DOUBLE && b->type == VALUE_TYPE_INTEGER) {
+        return -compare_int_double(b->int_value, a->double_value);
     }
     
-    // handle string comparisons
+    // handle string comparisons, interned cells of a column share one pointer
     if (a->type == VALUE_TYPE_STRING && b->type == VALUE_TYPE_STRING) {
+        if (a->string_value == b->string_value) return 0;
         return strcmp(a->string_value, b->string_value);
     }
     
@@ -130,110 +137,240 @@ int value_compare(Value* a, Value* b) {
 }
 
 /* ===== type inference ===== */
+
+/* a cell of 8 to 10 bytes that parse_date accepts once trimmed */
+static bool scan_date(const char* str, size_t len, DateValue* date) {
+    if (len < 8 || len > 10) return false;
+    const char* start = str;
+    const char* end = str + len;
+    while (start < end && isspace((unsigned char)*start)) start++;
+    while (end > start && isspace((unsigned char)end[-1])) end--;
+    if (parse_date_iso(start, end - start, date)) return true;
+    
+    char date_str[16];
+    memcpy(date_str, start, end - start);
+    date_str[end - start] = '\0';
+    return parse_date(date_str, date);
+}
+
+/* [space][sign]digits[.digits][space] */
+static bool scan_number(const char* str, size_t len, Value* value) {
+    const char* start = str;
+    const char* end = str + len;
+    while (start < end && isspace((unsigned char)*start)) start++;
+    while (end > start && isspace((unsigned char)end[-1])) end--;
+    return parse_number(start, end - start, value);
+}
+
+/* infers the type of a cell and parses numbers and dates in the same pass, strings are left
+ * to the caller: a DATE when parse_date accepts a cell of 8 to 10 bytes, an INTEGER or DOUBLE
+ * for [space][sign]digits[.digits][space], a STRING otherwise */
+static ValueType scan_cell(const char* str, size_t len, Value* value) {
+    if (scan_date(str, len, &value->date_value)) return value->type = VALUE_TYPE_DATE;
+    if (scan_number(str, len, value)) return value->type;
+    return value->type = VALUE_TYPE_STRING;
+}
+
 static ValueType infer_type(const char* str, size_t len) {
-    // try to parse as date first (YYYY-MM-DD format)
-    if (len >= 8 && len <= 10) {
-        char date_str[32];
-        if (len < sizeof(date_str)) {
-            memcpy(date_str, str, len);
-            date_str[len] = '\0';
-            
-            // trim whitespace
-            char* trimmed = date_str;
-            while (*trimmed && isspace(*trimmed)) trimmed++;
-            size_t trimmed_len = strlen(trimmed);
-            while (trimmed_len > 0 && isspace(trimmed[trimmed_len - 1])) {
-                trimmed[--trimmed_len] = '\0';
-            }
-            
-            DateValue date;
-            if (parse_date(trimmed, &date)) {
-                return VALUE_TYPE_DATE;
-            }
-        }
+    Value value;
+    return scan_cell(str, len, &value);
+}
+
+/* ===== string interning ===== */
+
+/* strings of an arena table column are interned while enough of them repeat */
+#define INTERN_SAMPLE 1024      // lookups before a column decides whether to keep interning
+#define INTERN_MIN_HITS 4       // keep interning if at least 1 in INTERN_MIN_HITS lookups hits
+
+typedef struct {
+    char** strings;             // open addressing slots, NULL when empty
+    unsigned* hashes;
+    size_t* lengths;
+    int capacity;
+    int count;
+    long long lookups;
+    long long hits;
+    bool enabled;
+} InternPool;
+
+static unsigned hash_bytes(const char* str, size_t len) {
+    unsigned hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (unsigned char)str[i]) * 16777619u;
     }
-    
-    // check if it's a number
-    bool has_dot = false;
-    bool is_number = true;
-    size_t i = 0;
-    
-    // skip leading whitespace
-    while (i < len && isspace(str[i])) i++;
-    
-    // check for sign
-    if (i < len && (str[i] == '+' || str[i] == '-')) i++;
-    
-    if (i >= len) return VALUE_TYPE_STRING;
-    
-    // check digits
-    bool has_digit = false;
-    while (i < len && !isspace(str[i])) {
-        if (isdigit(str[i])) {
-            has_digit = true;
-        } else if (str[i] == '.' && !has_dot) {
-            has_dot = true;
-        } else {
-            is_number = false;
-            break;
+    return hash;
+}
+
+static void intern_pool_release(InternPool* pool) {
+    free(pool->strings);
+    free(pool->hashes);
+    free(pool->lengths);
+    pool->strings = NULL;
+    pool->hashes = NULL;
+    pool->lengths = NULL;
+    pool->capacity = 0;
+    pool->count = 0;
+}
+
+static void intern_pool_insert(InternPool* pool, char* str, unsigned hash, size_t len) {
+    int mask = pool->capacity - 1;
+    int slot = (int)(hash & mask);
+    while (pool->strings[slot]) slot = (slot + 1) & mask;
+    pool->strings[slot] = str;
+    pool->hashes[slot] = hash;
+    pool->lengths[slot] = len;
+    pool->count++;
+}
+
+static void intern_pool_grow(InternPool* pool) {
+    InternPool old = *pool;
+    pool->capacity = old.capacity ? old.capacity * 2 : 256;
+    pool->count = 0;
+    pool->strings = calloc(pool->capacity, sizeof(char*));
+    pool->hashes = malloc(sizeof(unsigned) * pool->capacity);
+    pool->lengths = malloc(sizeof(size_t) * pool->capacity);
+    for (int i = 0; i < old.capacity; i++) {
+        if (old.strings[i]) intern_pool_insert(pool, old.strings[i], old.hashes[i], old.lengths[i]);
+    }
+    intern_pool_release(&old);
+}
+
+/* the shared copy of str in the arena, added on first sight */
+static char* intern_string(InternPool* pool, Arena* arena, const char* str, size_t len) {
+    // mostly unique columns are not worth the lookups
+    if (++pool->lookups == INTERN_SAMPLE && pool->hits * INTERN_MIN_HITS < pool->lookups) {
+        pool->enabled = false;
+        intern_pool_release(pool);
+        return arena_strndup(arena, str, len);
+    }
+
+    unsigned hash = hash_bytes(str, len);
+
+    int mask = pool->capacity - 1;
+    for (int slot = (int)(hash & mask); pool->capacity && pool->strings[slot]; slot = (slot + 1) & mask) {
+        if (pool->hashes[slot] == hash && pool->lengths[slot] == len &&
+            memcmp(pool->strings[slot], str, len) == 0) {
+            pool->hits++;
+            return pool->strings[slot];
         }
-        i++;
     }
-    
-    // skip trailing whitespace
-    while (i < len && isspace(str[i])) i++;
-    
-    if (is_number && has_digit && i == len) {
-        return has_dot ? VALUE_TYPE_DOUBLE : VALUE_TYPE_INTEGER;
+
+    char* copy = arena_strndup(arena, str, len);
+    if (pool->count * 2 >= pool->capacity) intern_pool_grow(pool);
+    intern_pool_insert(pool, copy, hash, len);
+    return copy;
+}
+
+/* copy a string cell into the arena with surrounding whitespace removed,
+ * sharing the copy of an equal earlier cell when the column is interned */
+static char* arena_string_cell(Arena* arena, InternPool* pool, const char* str, size_t len) {
+    const char* end = str + len;
+    while (str < end && isspace((unsigned char)*str)) str++;
+    while (end > str && isspace((unsigned char)end[-1])) end--;
+
+    if (pool && pool->enabled) {
+        return intern_string(pool, arena, str, end - str);
     }
-    
-    return VALUE_TYPE_STRING;
+    return arena_strndup(arena, str, end - str);
 }
 
-Value parse_value(const char* str, size_t len) {
+static Value string_cell(const char* str, size_t len, Arena* arena, InternPool* pool) {
+    Value value;
+    value.type = VALUE_TYPE_STRING;
+    if (arena) {
+        value.string_value = arena_string_cell(arena, pool, str, len);
+    } else {
+        value.string_value = cq_strndup(str, len);
+        trim_whitespace(value.string_value);
+        PROFILE_COUNT(allocations);
+        PROFILE_ADD(allocated_bytes, (long long)len + 1);
+    }
+    return value;
+}
+
+/* strings are copied into the arena when one is given */
+static Value parse_cell(const char* str, size_t len, Arena* arena, InternPool* pool) {
     Value value;
-    value.type = VALUE_TYPE_NULL;  // initialize
     value.int_value = 0;  // initialize union
     
-    ValueType type = infer_type(str, len);
-    value.type = type;
+    if (scan_cell(str, len, &value) == VALUE_TYPE_STRING) {
+        value = string_cell(str, len, arena, pool);
+    }
+    PROFILE_COUNT(parse_values[value.type]);
+    return value;
+}
+
+Value parse_value(const char* str, size_t len) {
+    return parse_cell(str, len, NULL, NULL);
+}
+
+/* ===== column typed cell parsers ===== */
+
+/* how the cells of a column are parsed, every fast path falls back to parse_cell for
+ * a cell it does not recognize, so values never depend on the chosen parser */
+typedef enum {
+    CELL_PARSER_ANY,            // infer the type of every cell
+    CELL_PARSER_NUMBER,
+    CELL_PARSER_DATE,
+    CELL_PARSER_STRING,
+    CELL_PARSER_INT,            // declared in the schema, the cells are not probed for dates
+    CELL_PARSER_REAL,           // declared double, integer cells are widened
+    CELL_PARSER_TEXT,           // declared string, cells are never probed
+} CellParser;
+
+/* infer_type reads a 8 to 10 byte cell that starts with a valid YYYYMMDD as a date */
+static bool may_be_compact_date(const char* str, size_t len) {
+    if (len < 8 || len > 10) return false;
+    while (len > 0 && isspace((unsigned char)*str)) {
+        str++;
+        len--;
+    }
+    if (len < 8) return false;
     
-    switch (type) {
-        case VALUE_TYPE_NULL:
-            break;
-        case VALUE_TYPE_INTEGER:
-            value.int_value = strtoll(str, NULL, 10);
+    int digits = 0;
+    for (int i = 0; i < 8; i++) {
+        if (!isdigit((unsigned char)str[i])) return false;
+        digits = digits * 10 + (str[i] - '0');
+    }
+    return is_valid_date(digits / 10000, digits / 100 % 100, digits % 100);
+}
+
+static Value parse_typed_cell(CellParser parser, const char* str, size_t len, Arena* arena, InternPool* pool) {
+    Value value;
+    value.int_value = 0;
+    
+    switch (parser) {
+        case CELL_PARSER_ANY:
+            return parse_cell(str, len, arena, pool);
+        case CELL_PARSER_NUMBER:
+            if (may_be_compact_date(str, len) || !scan_number(str, len, &value)) {
+                return parse_cell(str, len, arena, pool);
+            }
             break;
-        case VALUE_TYPE_DOUBLE:
-            value.double_value = strtod(str, NULL);
+        case CELL_PARSER_INT:
+            if (!scan_number(str, len, &value)) return parse_cell(str, len, arena, pool);
             break;
-        case VALUE_TYPE_DATE: {
-            char date_str[32];
-            if (len < sizeof(date_str)) {
-                memcpy(date_str, str, len);
-                date_str[len] = '\0';
-                
-                // trim whitespace
-                char* trimmed = date_str;
-                while (*trimmed && isspace(*trimmed)) trimmed++;
-                size_t trimmed_len = strlen(trimmed);
-                while (trimmed_len > 0 && isspace(trimmed[trimmed_len - 1])) {
-                    trimmed[--trimmed_len] = '\0';
-                }
-                
-                if (!parse_date(trimmed, &value.date_value)) {
-                    // fallback to null if parse fails
-                    value.type = VALUE_TYPE_NULL;
-                }
+        case CELL_PARSER_REAL:
+            if (!scan_number(str, len, &value)) return parse_cell(str, len, arena, pool);
+            if (value.type == VALUE_TYPE_INTEGER) {
+                value.type = VALUE_TYPE_DOUBLE;
+                value.double_value = (double)value.int_value;
             }
             break;
-        }
-        case VALUE_TYPE_STRING:
-            value.string_value = cq_strndup(str, len);
-            trim_whitespace(value.string_value);
+        case CELL_PARSER_DATE:
+            if (!parse_date_iso(str, len, &value.date_value)) return parse_cell(str, len, arena, pool);
+            value.type = VALUE_TYPE_DATE;
+            break;
+        case CELL_PARSER_STRING:
+            // neither a number nor a date can start with a letter
+            if (len > 0 && !isalpha((unsigned char)str[0])) return parse_cell(str, len, arena, pool);
+            value = string_cell(str, len, arena, pool);
+            break;
+        case CELL_PARSER_TEXT:
+            value = string_cell(str, len, arena, pool);
             break;
     }
-    
+    PROFILE_COUNT(parse_values[value.type]);
     return value;
 }
 
@@ -273,13 +410,23 @@ static void add_row(CsvTable* table, Row row) {
     table->rows[table->row_count++] = row;
 }
 
-static void parse_line(CsvTable* table, const char* line_start, const char* line_end, bool is_header) {
+/* field boundaries of the current line, reused for every line of a file */
+typedef struct {
+    char** fields;
+    size_t* lengths;
+    int capacity;
+    int lengths_capacity;
+    InternPool* pools;          // per column, arena tables only
+    CellParser* parsers;        // per column, chosen from the sample or the schema
+    bool header_read;           // the first line went through, whether header or not
+} LineFields;
+
+/* split a line into the scratch field arrays, returns the field count */
+static int split_line(CsvTable* table, LineFields* scratch, const char* line_start, const char* line_end) {
     const char* ptr = line_start;
     int field_count = 0;
-    int field_capacity = 16;
-    int field_lengths_capacity = 16;
-    char** fields = malloc(sizeof(char*) * field_capacity);
-    size_t* field_lengths = malloc(sizeof(size_t) * field_lengths_capacity);
+    char** fields = scratch->fields;
+    size_t* field_lengths = scratch->lengths;
     
     while (ptr < line_end) {
         // skip leading whitespace
@@ -323,8 +470,10 @@ static void parse_line(CsvTable* table, const char* line_start, const char* line
         }
         
         // store field
-        fields = ensure_field_capacity(fields, &field_capacity, field_count, sizeof(char*));
-        field_lengths = ensure_field_capacity(field_lengths, &field_lengths_capacity, field_count, sizeof(size_t));
+        fields = ensure_field_capacity(fields, &scratch->capacity, field_count, sizeof(char*));
+        field_lengths = ensure_field_capacity(field_lengths, &scratch->lengths_capacity, field_count, sizeof(size_t));
+        scratch->fields = fields;
+        scratch->lengths = field_lengths;
         
         fields[field_count] = (char*)field_start;
         field_lengths[field_count] = field_len;
@@ -335,6 +484,13 @@ static void parse_line(CsvTable* table, const char* line_start, const char* line
             ptr++;
         }
     }
+    return field_count;
+}
+
+static void parse_line(CsvTable* table, LineFields* scratch, const char* line_start, const char* line_end, bool is_header) {
+    int field_count = split_line(table, scratch, line_start, line_end);
+    char** fields = scratch->fields;
+    size_t* field_lengths = scratch->lengths;
     
     // process fields
     if (is_header) {
@@ -359,10 +515,16 @@ static void parse_line(CsvTable* table, const char* line_start, const char* line
         int col_count = table->column_count > 0 ? table->column_count : field_count;
         Row row;
         row.column_count = col_count;
-        row.values = malloc(sizeof(Value) * col_count);
+        if (table->arena) {
+            row.values = arena_alloc(table->arena, sizeof(Value) * col_count);
+        } else {
+            row.values = malloc(sizeof(Value) * col_count);
+        }
         for (int i = 0; i < col_count; i++) {
             if (i < field_count) {
-                row.values[i] = parse_value(fields[i], field_lengths[i]);
+                row.values[i] = parse_typed_cell(scratch->parsers ? scratch->parsers[i] : CELL_PARSER_ANY,
+                                                 fields[i], field_lengths[i], table->arena,
+                                                 scratch->pools ? &scratch->pools[i] : NULL);
             } else {
                 // pad missing columns with NULL
                 row.values[i].type = VALUE_TYPE_NULL;
@@ -371,39 +533,140 @@ static void parse_line(CsvTable* table, const char* line_start, const char* line
         }
         add_row(table, row);
     }
-    
-    free(fields);
-    free(field_lengths);
 }
 
-CsvTable* csv_load(const char* filename, CsvConfig config) {
-    size_t file_size;
-    int fd;
+/* the line starting at ptr, returns where the next one starts */
+static const char* next_line(const char* ptr, const char* end, const char** line_end) {
+    while (ptr < end && *ptr != '\n' && *ptr != '\r') ptr++;
+    *line_end = ptr;
+    while (ptr < end && (*ptr == '\n' || *ptr == '\r')) ptr++;
+    return ptr;
+}
+
+static void sample_line(CsvTable* table, LineFields* scratch, const char* line_start,
+                        const char* line_end, int (*type_counts)[5]) {
+    if (line_end == line_start) return;
+    int field_count = split_line(table, scratch, line_start, line_end);
+    for (int i = 0; i < field_count && i < table->column_count; i++) {
+        type_counts[i][infer_type(scratch->fields[i], scratch->lengths[i])]++;
+    }
+}
+
+static const SchemaColumn* schema_find(const CsvSchema* schema, const char* name) {
+    if (!schema) return NULL;
+    for (int i = 0; i < schema->column_count; i++) {
+        if (strcasecmp(schema->columns[i].name, name) == 0) return &schema->columns[i];
+    }
+    return NULL;
+}
+
+/* runs type inference once per column: over the first half of the sample and as many lines
+ * spread evenly over the rest of the file, columns declared in the schema are not sampled.
+ * sets inferred_type and returns the parser of each column */
+static CellParser* choose_parsers(CsvTable* table, LineFields* scratch, const char* body,
+                                  const char* end, CsvConfig config) {
+    int columns = table->column_count;
+    CellParser* parsers = calloc(columns, sizeof(CellParser));
+    int (*type_counts)[5] = calloc(columns, sizeof(*type_counts));
     
-    // Use portable mmap wrapper
-    char* data = portable_mmap(filename, &file_size, &fd);
-    if (!data) {
-        perror("Error loading file");
-        return NULL;
+    bool needs_sample = false;
+    for (int i = 0; i < columns; i++) {
+        if (!schema_find(config.schema, table->columns[i].name)) needs_sample = true;
     }
     
-    // create table structure
-    CsvTable* table = calloc(1, sizeof(CsvTable));
-    table->filename = strdup(filename);
-    table->data = data;
-    table->file_size = file_size;
-    table->fd = fd;
-    table->delimiter = config.delimiter;
-    table->quote = config.quote;
-    table->has_header = config.has_header;
-    table->rows = NULL;
-    table->row_count = 0;
-    table->row_capacity = 0;
+    if (needs_sample) {
+        int sample = config.sample_rows > 0 ? config.sample_rows : CSV_SAMPLE_ROWS;
+        int head = (sample + 1) / 2;
+        const char* ptr = body;
+        for (int n = 0; n < head && ptr < end; n++) {
+            const char* line_end;
+            const char* line_start = ptr;
+            ptr = next_line(ptr, end, &line_end);
+            sample_line(table, scratch, line_start, line_end, type_counts);
+        }
+        
+        // stratified probes, each reads the first whole line after an even byte offset
+        const char* rest = ptr;
+        int probes = sample - head;
+        for (int n = 0; n < probes && rest < end; n++) {
+            const char* line_end;
+            const char* line_start = next_line(rest + (end - rest) * n / probes, end, &line_end);
+            next_line(line_start, end, &line_end);
+            sample_line(table, scratch, line_start, line_end, type_counts);
+        }
+    }
     
-    // parse CSV
-    const char* ptr = data;
-    const char* end = data + file_size;
-    bool first_line = true;
+    for (int i = 0; i < columns; i++) {
+        Column* column = &table->columns[i];
+        const SchemaColumn* declared = schema_find(config.schema, column->name);
+        if (declared) {
+            column->inferred_type = declared->type;
+            switch (declared->type) {
+                case VALUE_TYPE_INTEGER: parsers[i] = CELL_PARSER_INT; break;
+                case VALUE_TYPE_DOUBLE: parsers[i] = CELL_PARSER_REAL; break;
+                case VALUE_TYPE_DATE: parsers[i] = CELL_PARSER_DATE; break;
+                default: parsers[i] = CELL_PARSER_TEXT; break;
+            }
+            continue;
+        }
+        
+        // the column type prefers DATE > DOUBLE > INTEGER > STRING, ignoring NULL values
+        int* counts = type_counts[i];
+        if (counts[VALUE_TYPE_DATE] > 0) {
+            column->inferred_type = VALUE_TYPE_DATE;
+        } else if (counts[VALUE_TYPE_DOUBLE] > 0) {
+            column->inferred_type = VALUE_TYPE_DOUBLE;
+        } else if (counts[VALUE_TYPE_INTEGER] > 0) {
+            column->inferred_type = VALUE_TYPE_INTEGER;
+        } else {
+            column->inferred_type = VALUE_TYPE_STRING;
+        }
+        
+        // while the parser follows the majority, so that few cells take the slow path
+        int numbers = counts[VALUE_TYPE_INTEGER] + counts[VALUE_TYPE_DOUBLE];
+        int dates = counts[VALUE_TYPE_DATE];
+        int strings = counts[VALUE_TYPE_STRING];
+        if (numbers + dates + strings == 0) {
+            parsers[i] = CELL_PARSER_ANY;
+        } else if (numbers >= dates && numbers >= strings) {
+            parsers[i] = CELL_PARSER_NUMBER;
+        } else if (dates >= strings) {
+            parsers[i] = CELL_PARSER_DATE;
+        } else {
+            parsers[i] = CELL_PARSER_STRING;
+        }
+    }
+    free(type_counts);
+    return parsers;
+}
+
+static void line_fields_init(LineFields* scratch) {
+    scratch->capacity = 16;
+    scratch->lengths_capacity = 16;
+    scratch->fields = malloc(sizeof(char*) * scratch->capacity);
+    scratch->lengths = malloc(sizeof(size_t) * scratch->lengths_capacity);
+    scratch->pools = NULL;
+    scratch->parsers = NULL;
+    scratch->header_read = false;
+}
+
+static void line_fields_release(LineFields* scratch, int column_count) {
+    free(scratch->fields);
+    free(scratch->lengths);
+    if (scratch->pools) {
+        for (int i = 0; i < column_count; i++) intern_pool_release(&scratch->pools[i]);
+        free(scratch->pools);
+    }
+    free(scratch->parsers);
+}
+
+/* parse the lines from ptr to end. unless final the last line may continue past end, so
+ * parsing stops after the last line terminator; returns where it stopped */
+static const char* parse_lines(CsvTable* table, LineFields* scratch, const char* ptr, const char* end,
+                               bool final, CsvConfig config) {
+    if (!final) {
+        while (end > ptr && end[-1] != '\n' && end[-1] != '\r') end--;
+    }
     
     while (ptr < end) {
         // find end of line
@@ -413,70 +676,340 @@ CsvTable* csv_load(const char* filename, CsvConfig config) {
         
         // skip empty lines
         if (line_end > line_start) {
-            if (first_line) {
-                parse_line(table, line_start, line_end, true);
-                first_line = false;
+            if (!scratch->header_read) {
+                parse_line(table, scratch, line_start, line_end, true);
+                scratch->header_read = true;
+                
+                if (table->arena && table->column_count > 0) {
+                    scratch->pools = calloc(table->column_count, sizeof(InternPool));
+                    for (int i = 0; i < table->column_count; i++) scratch->pools[i].enabled = true;
+                }
+                if (table->column_count > 0) {
+                    // without a header the first line is sampled as data too
+                    const char* body = config.has_header ? ptr : line_start;
+                    scratch->parsers = choose_parsers(table, scratch, body, end, config);
+                }
                 
                 // if no header, also parse as data
                 if (!config.has_header) {
-                    parse_line(table, line_start, line_end, false);
+                    parse_line(table, scratch, line_start, line_end, false);
                 }
             } else {
-                parse_line(table, line_start, line_end, false);
+                parse_line(table, scratch, line_start, line_end, false);
             }
         }
         
         // skip line terminators
         while (ptr < end && (*ptr == '\n' || *ptr == '\r')) ptr++;
     }
+    return end;
+}
+
+/* parse decompressed input as it arrives, block by block. the types are sampled from the
+ * first block only, since the rest of the file cannot be probed ahead; a line cut by the end
+ * of a block is carried over to the next. closes the stream, false on damaged input */
+static bool parse_stream(CsvTable* table, LineFields* scratch, InputStream* in, CsvConfig config) {
+    char* carry = NULL;
+    size_t carry_length = 0;
+    size_t carry_capacity = 0;
+    bool first = true;
+    bool ok = true;
     
-    // infer column types from data
-    if (table->row_count > 0 && table->column_count > 0) {
-        int sample_size = table->row_count < 20 ? table->row_count : 20;
+    for (;;) {
+        const char* block;
+        long length = input_stream_next(in, &block);
+        if (length < 0) {
+            fprintf(stderr, "Error: cannot read '%s': %s\n", table->filename, input_stream_error(in));
+            ok = false;
+            break;
+        }
+        if (first && arrow_detect(block, (size_t)length)) {
+            fprintf(stderr, "Error: cannot read '%s': Arrow input must be an uncompressed file\n", table->filename);
+            ok = false;
+            break;
+        }
+        first = false;
+        // a pipe has no size, count what it delivered
+        if (table->fd < 0) table->file_size += (size_t)length;
         
-        for (int col = 0; col < table->column_count; col++) {
-            // count occurrences of each type
-            int type_counts[5] = {0}; // NULL, INTEGER, DOUBLE, STRING, DATE
-            
-            for (int row = 0; row < sample_size; row++) {
-                if (row < table->row_count && col < table->rows[row].column_count) {
-                    ValueType type = table->rows[row].values[col].type;
-                    if (type >= 0 && type < 5) {
-                        type_counts[type]++;
-                    }
-                }
+        const char* ptr = block;
+        const char* end = block + length;
+        if (carry_length > 0 || length == 0) {
+            // complete the line carried over from the previous block
+            const char* tail = ptr;
+            while (tail < end && *tail != '\n' && *tail != '\r') tail++;
+            size_t needed = carry_length + (size_t)(tail - ptr);
+            if (needed > carry_capacity) {
+                carry_capacity = needed * 2;
+                carry = realloc(carry, carry_capacity);
             }
-            
-            // determine predominant type (prefer DATE > DOUBLE > INTEGER > STRING > NULL)
-            // ignore NULL values in type inference
-            ValueType inferred = VALUE_TYPE_STRING;
-            
-            if (type_counts[VALUE_TYPE_DATE] > 0) {
-                inferred = VALUE_TYPE_DATE;
-            } else if (type_counts[VALUE_TYPE_DOUBLE] > 0) {
-                inferred = VALUE_TYPE_DOUBLE;
-            } else if (type_counts[VALUE_TYPE_INTEGER] > 0) {
-                inferred = VALUE_TYPE_INTEGER;
-            } else if (type_counts[VALUE_TYPE_STRING] > 0) {
-                inferred = VALUE_TYPE_STRING;
+            memcpy(carry + carry_length, ptr, tail - ptr);
+            carry_length = needed;
+            ptr = tail;
+            if (tail < end || length == 0) {
+                parse_lines(table, scratch, carry, carry + carry_length, true, config);
+                carry_length = 0;
             }
-            
-            table->columns[col].inferred_type = inferred;
         }
+        if (length == 0) break;
+        
+        const char* rest = parse_lines(table, scratch, ptr, end, false, config);
+        if (rest < end) {
+            size_t needed = carry_length + (size_t)(end - rest);
+            if (needed > carry_capacity) {
+                carry_capacity = needed * 2;
+                carry = realloc(carry, carry_capacity);
+            }
+            memcpy(carry + carry_length, rest, end - rest);
+            carry_length = needed;
+        }
+    }
+    free(carry);
+    input_stream_close(in);
+    return ok;
+}
+
+static void profile_load(const CsvTable* table, double start_ms) {
+    if (profile_counters.enabled) {
+        double end_ms = profile_clock_ms();
+        profile_counters.csv_files++;
+        profile_counters.csv_rows += table->row_count;
+        profile_counters.csv_bytes += (long long)table->file_size;
+        profile_counters.csv_ms += end_ms - start_ms;
+        profile_span("io", "csv_load", table->filename, start_ms, end_ms);
+    }
+}
+
+bool csv_claim_stdin(void) {
+    static bool claimed = false;
+    bool first = !claimed;
+    claimed = true;
+    return first;
+}
+
+/* standard input is parsed block by block as it arrives, like a compressed file */
+static CsvTable* load_stdin(CsvConfig config, double start_ms) {
+    if (!csv_claim_stdin()) {
+        fprintf(stderr, "Error: standard input was already read, by -q - or another FROM -\n");
+        return NULL;
+    }
+    CsvTable* table = calloc(1, sizeof(CsvTable));
+    table->filename = strdup(CSV_STDIN);
+    table->fd = -1;
+    table->delimiter = config.delimiter;
+    table->quote = config.quote;
+    table->has_header = config.has_header;
+    table->arena = config.arena ? arena_create() : NULL;
+    
+    LineFields scratch;
+    line_fields_init(&scratch);
+    bool ok = parse_stream(table, &scratch, input_stream_open_fd(0), config);
+    line_fields_release(&scratch, table->column_count);
+    if (!ok) {
+        csv_free(table);
+        return NULL;
+    }
+    profile_load(table, start_ms);
+    return table;
+}
+
+CsvTable* csv_load(const char* filename, CsvConfig config) {
+    size_t file_size;
+    int fd;
+    double start_ms = profile_counters.enabled ? profile_clock_ms() : 0;
+    
+    if (strcmp(filename, CSV_STDIN) == 0) return load_stdin(config, start_ms);
+    
+    // Use portable mmap wrapper
+    char* data = portable_mmap(filename, &file_size, &fd);
+    if (!data) {
+        perror("Error loading file");
+        return NULL;
+    }
+    
+    // create table structure
+    CsvTable* table = calloc(1, sizeof(CsvTable));
+    table->filename = strdup(filename);
+    table->data = data;
+    table->file_size = file_size;
+    table->fd = fd;
+    table->delimiter = config.delimiter;
+    table->quote = config.quote;
+    table->has_header = config.has_header;
+    table->rows = NULL;
+    table->row_count = 0;
+    table->row_capacity = 0;
+    table->arena = config.arena ? arena_create() : NULL;
+    
+    // Arrow IPC files carry their own schema and typed columns, nothing to parse
+    if (arrow_detect(data, file_size)) {
+        if (!arrow_load(table)) {
+            csv_free(table);
+            return NULL;
+        }
+        profile_load(table, start_ms);
+        return table;
     }
     
+    LineFields scratch;
+    line_fields_init(&scratch);
+    
+    InputCompression compression = input_compression(data, file_size);
+    if (compression == INPUT_PLAIN) {
+        parse_lines(table, &scratch, data, data + file_size, true, config);
+    } else if (!parse_stream(table, &scratch, input_stream_open(data, file_size, compression), config)) {
+        line_fields_release(&scratch, table->column_count);
+        csv_free(table);
+        return NULL;
+    }
+    line_fields_release(&scratch, table->column_count);
+    
+    profile_load(table, start_ms);
     return table;
 }
 
+/* a table for a CSV file about to be changed, mapped but not parsed: NULL with an error for
+ * standard input and for files that are not plain CSV text */
+static CsvTable* map_for_change(const char* filename, CsvConfig config) {
+    if (strcmp(filename, CSV_STDIN) == 0) {
+        fprintf(stderr, "Error: standard input cannot be modified\n");
+        return NULL;
+    }
+
+    size_t file_size;
+    int fd;
+    char* data = portable_mmap(filename, &file_size, &fd);
+    if (!data) {
+        perror("Error loading file");
+        return NULL;
+    }
+    if (arrow_detect(data, file_size) || input_compression(data, file_size) != INPUT_PLAIN) {
+        fprintf(stderr, "Error: '%s' is not a plain CSV file, only CSV tables can be modified\n", filename);
+        portable_munmap(data, file_size, fd);
+        return NULL;
+    }
+
+    CsvTable* table = calloc(1, sizeof(CsvTable));
+    table->filename = strdup(filename);
+    table->data = data;
+    table->file_size = file_size;
+    table->fd = fd;
+    table->delimiter = config.delimiter;
+    table->quote = config.quote;
+    table->has_header = config.has_header;
+    return table;
+}
+
+/* the first line of a mapped table, blank lines before it skipped */
+static const char* first_line(const CsvTable* table, const char** line_end) {
+    const char* end = table->data + table->file_size;
+    const char* line = table->data;
+    while (line < end && (*line == '\n' || *line == '\r')) line++;
+    next_line(line, end, line_end);
+    return line;
+}
+
+CsvTable* csv_load_header(const char* filename, CsvConfig config, bool* terminated) {
+    CsvTable* table = map_for_change(filename, config);
+    if (!table) return NULL;
+
+    // only the pages holding the first line and the last byte are read
+    const char* line_end;
+    const char* line = first_line(table, &line_end);
+    LineFields scratch;
+    line_fields_init(&scratch);
+    parse_lines(table, &scratch, line, line_end, true, config);
+    line_fields_release(&scratch, table->column_count);
+
+    char last = table->data[table->file_size - 1];
+    *terminated = last == '\n' || last == '\r';
+    return table;
+}
+
+struct CsvRecordReader {
+    CsvTable* table;            // the file's columns, rows holds the current record only
+    LineFields scratch;
+    const char* body;           // the first record
+    const char* position;       // the record after the current one
+};
+
+CsvRecordReader* csv_records_open(const char* filename, CsvConfig config) {
+    config.arena = false;
+    CsvTable* table = map_for_change(filename, config);
+    if (!table) return NULL;
+
+    CsvRecordReader* reader = calloc(1, sizeof(CsvRecordReader));
+    reader->table = table;
+    line_fields_init(&reader->scratch);
+
+    // the header, and the types sampled over the whole file as csv_load samples them
+    const char* end = table->data + table->file_size;
+    const char* line_end;
+    const char* line = first_line(table, &line_end);
+    parse_line(table, &reader->scratch, line, line_end, true);
+    reader->scratch.header_read = true;
+    reader->body = config.has_header ? next_line(line, end, &line_end) : line;
+    if (table->column_count > 0) {
+        reader->scratch.parsers = choose_parsers(table, &reader->scratch, reader->body, end, config);
+    }
+    reader->position = reader->body;
+    return reader;
+}
+
+CsvTable* csv_records_table(CsvRecordReader* reader) {
+    return reader->table;
+}
+
+const char* csv_records_head(const CsvRecordReader* reader, size_t* length) {
+    *length = (size_t)(reader->body - reader->table->data);
+    return reader->table->data;
+}
+
+/* free the current record, the rows array is kept for the next one */
+static void release_record(CsvTable* table) {
+    for (int i = 0; i < table->row_count; i++) {
+        for (int j = 0; j < table->rows[i].column_count; j++) value_free(&table->rows[i].values[j]);
+        free(table->rows[i].values);
+    }
+    table->row_count = 0;
+}
+
+Row* csv_records_next(CsvRecordReader* reader, const char** record, size_t* length) {
+    CsvTable* table = reader->table;
+    release_record(table);
+    const char* end = table->data + table->file_size;
+    if (reader->position >= end) return NULL;
+
+    // records start after the line breaks of the one before, so none is blank
+    const char* line_end;
+    const char* start = reader->position;
+    reader->position = next_line(start, end, &line_end);
+    parse_line(table, &reader->scratch, start, line_end, false);
+    *record = start;
+    *length = (size_t)(reader->position - start);
+    return &table->rows[0];
+}
+
+void csv_records_close(CsvRecordReader* reader) {
+    if (!reader) return;
+    line_fields_release(&reader->scratch, reader->table->column_count);
+    csv_free(reader->table);
+    free(reader);
+}
+
 void csv_free(CsvTable* table) {
     if (!table) return;
     
-    // free rows
-    for (int i = 0; i < table->row_count; i++) {
-        for (int j = 0; j < table->rows[i].column_count; j++) {
-            value_free(&table->rows[i].values[j]);
+    // free rows, arena cells go with the arena
+    if (table->arena) {
+        arena_destroy(table->arena);
+    } else {
+        for (int i = 0; i < table->row_count; i++) {
+            for (int j = 0; j < table->rows[i].column_count; j++) {
+                value_free(&table->rows[i].values[j]);
+            }
+            free(table->rows[i].values);
         }
-        free(table->rows[i].values);
     }
     free(table->rows);
     
@@ -486,8 +1019,9 @@ void csv_free(CsvTable* table) {
     }
     free(table->columns);
     
-    // unmap/free file data using portable wrapper
-    portable_munmap(table->data, table->file_size, table->fd);
+    // unmap/free file data using portable wrapper, tables built in memory have no descriptor
+    // (a zeroed fd would close standard input, or whatever file reuses descriptor 0)
+    if (table->data) portable_munmap(table->data, table->file_size, table->fd);
     
     free(table->filename);
     free(table);
@@ -521,103 +1055,137 @@ Value* csv_get_value_by_name(CsvTable* table, int row_index, const char* col_nam
 
 /* save CSV table to file */
 bool csv_save(const char* filename, CsvTable* table) {
-    FILE* f = fopen(filename, "w");
-    if (!f) {
-        perror("fopen");
+    if (strcmp(filename, CSV_STDIN) == 0) {
+        fprintf(stderr, "Error: standard input cannot be modified\n");
+        return false;
+    }
+    if (table->arrow) {
+        fprintf(stderr, "Error: '%s' is an Arrow file, only CSV tables can be modified\n", table->filename);
+        return false;
+    }
+    // written beside the file and renamed over it, a failed save leaves the old version
+    OutputWriter out;
+    if (!writer_open_replace(&out, filename)) {
+        perror("open");
         return false;
     }
     
-    // write header
+    // write header, names holding the delimiter, quote or a newline are quoted
     if (table->has_header) {
         for (int i = 0; i < table->column_count; i++) {
-            if (i > 0) fprintf(f, "%c", table->delimiter);
-            
-            // check if column name needs quoting, it contains delimiter, quote, or newline
-            const char* col_name = table->columns[i].name;
-            bool needs_quote = false;
-            for (const char* p = col_name; *p; p++) {
-                if (*p == table->delimiter || *p == table->quote || *p == '\n' || *p == '\r') {
-                    needs_quote = true;
-                    break;
-                }
-            }
-            
-            if (needs_quote) {
-                fprintf(f, "%c", table->quote);
-                for (const char* p = col_name; *p; p++) {
-                    if (*p == table->quote) {
-                        fprintf(f, "%c%c", table->quote, table->quote); // escape quote
-                    } else {
-                        fprintf(f, "%c", *p);
-                    }
-                }
-                fprintf(f, "%c", table->quote);
-            } else {
-                fprintf(f, "%s", col_name);
-            }
+            if (i > 0) writer_putc(&out, table->delimiter);
+            writer_csv_string(&out, table->columns[i].name, table->delimiter, table->quote);
         }
-        fprintf(f, "\n");
+        writer_putc(&out, '\n');
     }
     
     // write rows
     for (int row = 0; row < table->row_count; row++) {
-        for (int col = 0; col < table->rows[row].column_count && col < table->column_count; col++) {
-            if (col > 0) fprintf(f, "%c", table->delimiter);
-            
-            Value* val = &table->rows[row].values[col];
-            
-            switch (val->type) {
-                case VALUE_TYPE_NULL:
-                    // write nothing (empty field)
-                    break;
-                    
-                case VALUE_TYPE_INTEGER:
-                    fprintf(f, "%lld", val->int_value);
-                    break;
-                    
-                case VALUE_TYPE_DOUBLE:
-                    fprintf(f, "%.15g", val->double_value);
-                    break;
-                    
-                case VALUE_TYPE_DATE:
-                    fprintf(f, "%04d-%02d-%02d",
-                            val->date_value.year,
-                            val->date_value.month,
-                            val->date_value.day);
-                    break;
-                    
-                case VALUE_TYPE_STRING: {
-                    // check if string needs quoting
-                    bool needs_quote = false;
-                    const char* str = val->string_value;
-                    for (const char* p = str; *p; p++) {
-                        if (*p == table->delimiter || *p == table->quote || *p == '\n' || *p == '\r') {
-                            needs_quote = true;
-                            break;
-                        }
-                    }
-                    
-                    if (needs_quote) {
-                        fprintf(f, "%c", table->quote);
-                        for (const char* p = str; *p; p++) {
-                            if (*p == table->quote) {
-                                fprintf(f, "%c%c", table->quote, table->quote);
-                            } else {
-                                fprintf(f, "%c", *p);
-                            }
-                        }
-                        fprintf(f, "%c", table->quote);
-                    } else {
-                        fprintf(f, "%s", str);
-                    }
-                    break;
-                }
-            }
-        }
-        fprintf(f, "\n");
+        int count = table->rows[row].column_count < table->column_count ? table->rows[row].column_count
+                                                                        : table->column_count;
+        writer_csv_row(&out, table->rows[row].values, count, table->delimiter, table->quote);
     }
     
-    fclose(f);
+    if (!writer_close(&out)) {
+        perror("write");
+        return false;
+    }
     return true;
 }
 
+
+/* ===== declared schema ===== */
+
+static bool schema_type(const char* name, ValueType* type) {
+    static const struct {
+        const char* name;
+        ValueType type;
+    } types[] = {
+        {"int", VALUE_TYPE_INTEGER}, {"integer", VALUE_TYPE_INTEGER}, {"bigint", VALUE_TYPE_INTEGER},
+        {"double", VALUE_TYPE_DOUBLE}, {"float", VALUE_TYPE_DOUBLE}, {"real", VALUE_TYPE_DOUBLE},
+        {"decimal", VALUE_TYPE_DOUBLE}, {"string", VALUE_TYPE_STRING}, {"text", VALUE_TYPE_STRING},
+        {"varchar", VALUE_TYPE_STRING}, {"date", VALUE_TYPE_DATE},
+    };
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        if (strcasecmp(types[i].name, name) == 0) {
+            *type = types[i].type;
+            return true;
+        }
+    }
+    return false;
+}
+
+static char* read_schema_file(const char* filename) {
+    FILE* f = fopen(filename, "r");
+    if (!f) return NULL;
+    size_t size = 0;
+    size_t capacity = 256;
+    char* text = malloc(capacity);
+    size_t n;
+    while ((n = fread(text + size, 1, capacity - size - 1, f)) > 0) {
+        size += n;
+        if (size + 1 >= capacity) {
+            capacity *= 2;
+            text = realloc(text, capacity);
+        }
+    }
+    text[size] = '\0';
+    fclose(f);
+    return text;
+}
+
+CsvSchema* csv_schema_parse(const char* spec) {
+    if (!spec) return NULL;
+    
+    // a readable file holds the spec, otherwise the argument is the spec itself
+    char* text = read_schema_file(spec);
+    if (!text) text = strdup(spec);
+    
+    CsvSchema* schema = calloc(1, sizeof(CsvSchema));
+    int capacity = 0;
+    bool ok = true;
+    char* saveptr = NULL;
+    for (char* entry = strtok_r(text, ",\n", &saveptr); entry; entry = strtok_r(NULL, ",\n", &saveptr)) {
+        trim_whitespace(entry);
+        if (*entry == '\0' || *entry == '#') continue;
+        
+        char* colon = strchr(entry, ':');
+        if (!colon || colon == entry) {
+            fprintf(stderr, "Error: Invalid schema entry '%s', expected name:type\n", entry);
+            ok = false;
+            break;
+        }
+        *colon = '\0';
+        trim_whitespace(entry);
+        trim_whitespace(colon + 1);
+        ValueType type;
+        if (!schema_type(colon + 1, &type)) {
+            fprintf(stderr, "Error: Unknown type '%s' for schema column '%s', expected int, double, string or date\n",
+                    colon + 1, entry);
+            ok = false;
+            break;
+        }
+        
+        if (schema->column_count >= capacity) {
+            capacity = capacity ? capacity * 2 : 8;
+            schema->columns = realloc(schema->columns, sizeof(SchemaColumn) * capacity);
+        }
+        schema->columns[schema->column_count].name = strdup(entry);
+        schema->columns[schema->column_count].type = type;
+        schema->column_count++;
+    }
+    free(text);
+    
+    if (!ok) {
+        csv_schema_free(schema);
+        return NULL;
+    }
+    return schema;
+}
+
+void csv_schema_free(CsvSchema* schema) {
+    if (!schema) return;
+    for (int i = 0; i < schema->column_count; i++) free(schema->columns[i].name);
+    free(schema->columns);
+    free(schema);
+}
@@ -85,10 +85,31 @@ int parse_date_format(const char* str, DateValue* date, DateFormat format) {
     return 0;
 }
 
+int parse_date_iso(const char* str, size_t len, DateValue* date) {
+    if (len != 10 || str[4] != '-' || str[7] != '-') return 0;
+    
+    static const int positions[8] = {0, 1, 2, 3, 5, 6, 8, 9};
+    int digits[8];
+    for (int i = 0; i < 8; i++) {
+        digits[i] = str[positions[i]] - '0';
+        if (digits[i] < 0 || digits[i] > 9) return 0;
+    }
+    int y = digits[0] * 1000 + digits[1] * 100 + digits[2] * 10 + digits[3];
+    int m = digits[4] * 10 + digits[5];
+    int d = digits[6] * 10 + digits[7];
+    if (!is_valid_date(y, m, d)) return 0;
+    
+    date->year = y;
+    date->month = m;
+    date->day = d;
+    return 1;
+}
+
 int parse_date(const char* str, DateValue* date) {
     if (!str || !date) return 0;
     
-    // try ISO format first (most common in SQL)
+    // try ISO format first (most common in SQL), the fixed layout without sscanf
+    if (parse_date_iso(str, strlen(str), date)) return 1;
     if (parse_date_format(str, date, DATE_FORMAT_ISO)) return 1;
     
     // try other formats
@@ -123,124 +144,84 @@ char* format_date(DateValue date, DateFormat format) {
     return result;
 }
 
+/* closed form conversions on the proleptic Gregorian calendar, years are
+ * shifted to start in March so the leap day is the last day of a year */
 long date_to_days(DateValue date) {
-    // algorithm: count days since 1970-01-01 (Unix epoch)
-    long days = 0;
-    
-    // add days for complete years
-    for (int y = 1970; y < date.year; y++) {
-        days += is_leap_year(y) ? 366 : 365;
-    }
-    
-    // handle negative years (before 1970)
-    for (int y = 1969; y >= date.year; y--) {
-        days -= is_leap_year(y) ? 366 : 365;
-    }
-    
-    // add days for complete months in current year
-    for (int m = 1; m < date.month; m++) {
-        days += days_in_month(date.year, m);
-    }
-    
-    // add remaining days
-    days += date.day - 1;
-    
-    return days;
+    long y = date.year - (date.month <= 2);
+    long era = (y >= 0 ? y : y - 399) / 400;
+    long year_of_era = y - era * 400;
+    long day_of_year = (153 * (date.month + (date.month > 2 ? -3 : 9)) + 2) / 5 + date.day - 1;
+    long day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
 }
 
-DateValue days_to_date(long days) {
-    DateValue result;
-    
-    // start from epoch
-    result.year = 1970;
-    result.month = 1;
-    result.day = 1;
-    
-    // handle negative days (before epoch)
-    if (days < 0) {
-        while (days < 0) {
-            result.year--;
-            int year_days = is_leap_year(result.year) ? 366 : 365;
-            days += year_days;
-        }
-    } else {
-        // add complete years
-        while (1) {
-            int year_days = is_leap_year(result.year) ? 366 : 365;
-            if (days >= year_days) {
-                days -= year_days;
-                result.year++;
-            } else {
-                break;
-            }
-        }
-    }
-    
-    // add complete months
-    while (days >= days_in_month(result.year, result.month)) {
-        days -= days_in_month(result.year, result.month);
-        result.month++;
-        if (result.month > 12) {
-            result.month = 1;
-            result.year++;
-        }
-    }
+/* day numbers of DATE_MIN_YEAR-01-01 and DATE_MAX_YEAR-12-31 */
+#define DATE_MIN_DAYS (-12687795LL)
+#define DATE_MAX_DAYS 11248737LL
+
+int days_to_date(long long days, DateValue* date) {
+    if (days < DATE_MIN_DAYS || days > DATE_MAX_DAYS) return 0;
     
-    // remaining days
-    result.day += (int)days;
+    days += 719468;
+    long era = (long)((days >= 0 ? days : days - 146096) / 146097);
+    long day_of_era = (long)(days - era * 146097L);
+    long year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    long day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    long shifted_month = (5 * day_of_year + 2) / 153;
+    int month = (int)(shifted_month < 10 ? shifted_month + 3 : shifted_month - 9);
     
-    return result;
+    date->year = (int)(year_of_era + era * 400 + (month <= 2));
+    date->month = month;
+    date->day = (int)(day_of_year - (153 * shifted_month + 2) / 5 + 1);
+    return 1;
 }
 
 int compare_dates(DateValue d1, DateValue d2) {
-    if (d1.year != d2.year) return d1.year - d2.year;
-    if (d1.month != d2.month) return d1.month - d2.month;
-    return d1.day - d2.day;
+    int k1 = date_key(d1);
+    int k2 = date_key(d2);
+    return (k1 > k2) - (k1 < k2);
 }
 
-DateValue date_add_days(DateValue date, int days) {
-    long total_days = date_to_days(date);
-    total_days += days;
-    return days_to_date(total_days);
+int date_add_days(DateValue date, long long days, DateValue* result) {
+    // bounded first so the sum cannot overflow, anything past the span is out of range
+    if (days < DATE_MIN_DAYS - DATE_MAX_DAYS || days > DATE_MAX_DAYS - DATE_MIN_DAYS) return 0;
+    return days_to_date(date_to_days(date) + days, result);
 }
 
-DateValue date_add_months(DateValue date, int months) {
-    int new_month = date.month + months;
-    int year_offset = 0;
+int date_add_months(DateValue date, long long months, DateValue* result) {
+    long long span = (long long)(DATE_MAX_YEAR - DATE_MIN_YEAR + 1) * 12;
+    if (months < -span || months > span) return 0;
     
-    // handle month overflow/underflow
-    while (new_month > 12) {
-        new_month -= 12;
-        year_offset++;
-    }
-    while (new_month < 1) {
-        new_month += 12;
-        year_offset--;
-    }
+    // months since year 0, floored back into a year and a month
+    long long total = (long long)date.year * 12 + (date.month - 1) + months;
+    long long year = (total >= 0 ? total : total - 11) / 12;
+    if (year < DATE_MIN_YEAR || year > DATE_MAX_YEAR) return 0;
     
-    DateValue result = date;
-    result.year += year_offset;
-    result.month = new_month;
+    *result = date;
+    result->year = (int)year;
+    result->month = (int)(total - year * 12) + 1;
     
     // adjust day if it exceeds days in new month
-    int max_day = days_in_month(result.year, result.month);
-    if (result.day > max_day) {
-        result.day = max_day;
+    int max_day = days_in_month(result->year, result->month);
+    if (result->day > max_day) {
+        result->day = max_day;
     }
-    
-    return result;
+    return 1;
 }
 
-DateValue date_add_years(DateValue date, int years) {
-    DateValue result = date;
-    result.year += years;
+int date_add_years(DateValue date, long long years, DateValue* result) {
+    if (years < DATE_MIN_YEAR - DATE_MAX_YEAR || years > DATE_MAX_YEAR - DATE_MIN_YEAR) return 0;
+    long long year = date.year + years;
+    if (year < DATE_MIN_YEAR || year > DATE_MAX_YEAR) return 0;
+    
+    *result = date;
+    result->year = (int)year;
     
     // handle Feb 29 on non-leap year
-    if (result.month == 2 && result.day == 29 && !is_leap_year(result.year)) {
-        result.day = 28;
+    if (result->month == 2 && result->day == 29 && !is_leap_year(result->year)) {
+        result->day = 28;
     }
-    
-    return result;
+    return 1;
 }
 
 long date_diff_days(DateValue d1, DateValue d2) {
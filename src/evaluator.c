@@ -16,53 +16,460 @@
 #include "evaluator/evaluator_aggregates.h"
 #include "evaluator/evaluator_window.h"
 #include "evaluator/evaluator_joins.h"
+#include "evaluator/evaluator_files.h"
 #include "evaluator/evaluator_statements.h"
 #include "evaluator/evaluator_utils.h"
+#include "evaluator/evaluator_internal.h"
+#include "evaluator/evaluator_plan.h"
+#include "evaluator/evaluator_stats.h"
+#include "profile.h"
 
 /* global csv configuration to can be set before calling evaluate_query */
 CsvConfig global_csv_config = {.delimiter = ',', .quote = '"', .has_header = true};
+bool report_join_order = false;
 
 /* main internal query evaluation logic */
 ResultSet* evaluate_query_internal(ASTNode* query_ast, Row* outer_row, CsvTable* outer_table) {
-    if (!query_ast || query_ast->type != NODE_TYPE_QUERY) {
-        fprintf(stderr, "Invalid query AST\n");
-        return NULL;
+    return evaluate_correlated_query(query_ast, outer_row, outer_table, NULL);
+}
+
+/* joined table under construction, blocks record which scan each column range came from */
+typedef struct {
+    CsvTable* table;
+    const char* alias;      // alias of the FROM table
+    bool joined;
+    int* block_tables;      // table_index per block
+    int* block_widths;
+    int block_count;
+} Relation;
+
+static void relation_add_block(Relation* rel, int table_index, int width) {
+    rel->block_tables = realloc(rel->block_tables, sizeof(int) * (rel->block_count + 1));
+    rel->block_widths = realloc(rel->block_widths, sizeof(int) * (rel->block_count + 1));
+    rel->block_tables[rel->block_count] = table_index;
+    rel->block_widths[rel->block_count] = width;
+    rel->block_count++;
+}
+
+static void relation_free_blocks(Relation* rel) {
+    free(rel->block_tables);
+    free(rel->block_widths);
+    rel->block_tables = NULL;
+    rel->block_widths = NULL;
+    rel->block_count = 0;
+}
+
+/* keep the rows of a scan that pass its pushed down predicates */
+static void filter_scan_rows(QueryContext* ctx, CsvTable* table, const char* alias, PlanNode* scan) {
+    int orig_table_count = ctx->table_count;
+    TableRef* orig_tables = ctx->tables;
+    
+    TableRef scan_table = {.alias = strdup(alias), .table = table};
+    ctx->tables = &scan_table;
+    ctx->table_count = 1;
+    
+    int kept = 0;
+    for (int i = 0; i < table->row_count; i++) {
+        bool matches = true;
+        for (int p = 0; p < scan->predicate_count && matches; p++) {
+            matches = evaluate_condition(ctx, scan->predicates[p], &table->rows[i], 0);
+        }
+        
+        if (matches) {
+            table->rows[kept++] = table->rows[i];
+        } else if (!table->arena) {
+            free_row_range(table->rows, i, i + 1);
+        }
     }
+    table->row_count = kept;
     
-    // execution context
-    QueryContext* ctx = context_create(query_ast);
+    free(scan_table.alias);
+    ctx->tables = orig_tables;
+    ctx->table_count = orig_table_count;
+}
+
+static bool is_referenced_column(PlanNode* scan, const char* column_name) {
+    for (int i = 0; i < scan->referenced_column_count; i++) {
+        const char* ref = scan->referenced_columns[i];
+        const char* dot = strrchr(ref, '.');
+        if (strcasecmp(ref, column_name) == 0 || (dot && strcasecmp(dot + 1, column_name) == 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* drop the columns of a scan the query never names, at least one column is kept */
+static void prune_scan_columns(CsvTable* table, PlanNode* scan) {
+    bool* keep = malloc(sizeof(bool) * (table->column_count > 0 ? table->column_count : 1));
+    int kept = 0;
+    for (int c = 0; c < table->column_count; c++) {
+        keep[c] = is_referenced_column(scan, table->columns[c].name);
+        if (keep[c]) kept++;
+    }
+    if (kept == table->column_count) {
+        free(keep);
+        return;
+    }
+    if (kept == 0 && table->column_count > 0) {
+        keep[0] = true;
+    }
     
-    // set outer context for correlated subqueries
-    ctx->outer_row = outer_row;
-    ctx->outer_table = outer_table;
+    for (int i = 0; i < table->row_count; i++) {
+        Row* row = &table->rows[i];
+        int out = 0;
+        for (int c = 0; c < row->column_count; c++) {
+            if (c < table->column_count && keep[c]) {
+                row->values[out++] = row->values[c];
+            } else if (!table->arena) {
+                value_free(&row->values[c]);
+            }
+        }
+        row->column_count = out;
+    }
     
-    // load table from FROM clause
-    const char* table_alias = NULL;
-    CsvTable* source_table = load_from_table(query_ast->query.from, &table_alias, ctx);
-    if (!source_table) {
-        context_free(ctx);
-        return NULL;
+    int out = 0;
+    for (int c = 0; c < table->column_count; c++) {
+        if (keep[c]) {
+            table->columns[out++] = table->columns[c];
+        } else {
+            free(table->columns[c].name);
+        }
     }
+    table->column_count = out;
+    free(keep);
+}
+
+static bool execute_scan(QueryContext* ctx, PlanNode* scan, Relation* rel) {
+    CsvTable* table = NULL;
+    const char* alias = scan->alias;
+    double start = plan_stats_start(scan);
     
-    ctx->table_count = 1;
-    ctx->tables = malloc(sizeof(TableRef) * 1);
-    ctx->tables[0].alias = strdup(table_alias);
-    ctx->tables[0].table = source_table;
+    if (scan->source && scan->source->type == NODE_TYPE_JOIN) {
+        ASTNode* join = scan->source;
+        table = load_scan_table(ctx, join->join.table, join->join.files, join->join.file_count, alias,
+                                scan->predicates, scan->predicate_count, scan->file_column);
+        if (!table) {
+            fprintf(stderr, "Failed to load join table from '%s'\n", scan->source->join.table);
+            return false;
+        }
+    } else if (scan->source && scan->source->type == NODE_TYPE_FROM && scan->source->from.table) {
+        ASTNode* from = scan->source;
+        ASTNode** conditions = scan->predicate_count ? scan->predicates : scan->prune_predicates;
+        int condition_count = scan->predicate_count ? scan->predicate_count : scan->prune_predicate_count;
+        table = load_scan_table(ctx, from->from.table, from->from.files, from->from.file_count, alias,
+                                conditions, condition_count, scan->file_column);
+        if (!table) {
+            fprintf(stderr, "Failed to load table from '%s'\n", from->from.table);
+            return false;
+        }
+    } else {
+        table = load_from_table(scan->source, &alias, ctx);
+        if (!table) return false;
+    }
+    
+    long long rows_loaded = table->row_count;
+    if (scan->predicate_count > 0) {
+        filter_scan_rows(ctx, table, alias, scan);
+    }
+    if (scan->referenced_columns) {
+        prune_scan_columns(table, scan);
+    }
+    
+    scan->stats.bytes_read += (long long)table->file_size;
+    plan_stats_finish(scan, start, rows_loaded, table->row_count);
+    
+    rel->table = table;
+    rel->alias = alias;
+    rel->joined = false;
+    relation_add_block(rel, scan->table_index, table->column_count);
+    return true;
+}
+
+/* join the loaded right scan into the relation, both inputs are consumed; with a sink the
+ * joined rows go into it and the relation keeps only their columns */
+static void join_relation(QueryContext* ctx, PlanNode* node, Relation* rel, Relation* right, RowSink* sink) {
+    double start = plan_stats_start(node);
+    long long rows_in = (long long)rel->table->row_count + right->table->row_count;
+    relation_add_block(rel, right->block_tables[0], right->block_widths[0]);
+    relation_free_blocks(right);
+    CsvTable* joined_table = perform_join(ctx, rel->table, rel->joined ? "joined" : rel->alias, rel->joined,
+                                          right->table, right->alias,
+                                          node->join->join.condition,
+                                          node->join->join.join_type,
+                                          node->build_left, sink);
+    
+    plan_stats_finish(node, start, rows_in, joined_table->row_count);
+    
+    csv_free(rel->table);
+    csv_free(right->table);
     
-    // process JOINs if there are any
-    CsvTable* working_table = process_joins(query_ast, ctx, ctx->tables[0].table, ctx->tables[0].alias);
+    rel->table = joined_table;
+    rel->joined = true;
+}
+
+/* statistics of the key column named by a qualified identifier, NULL if it is not a scan column */
+static const ColumnStats* key_column_stats(const char* identifier, PlanNode** scans, Relation* loaded,
+                                           TableStats** stats, int scan_count, int* relation) {
+    const char* dot = strchr(identifier, '.');
+    if (!dot) return NULL;
+    size_t alias_len = dot - identifier;
     
-    // replace context table with joined result if needed
-    if (working_table != ctx->tables[0].table) {
-        csv_free(ctx->tables[0].table);
-        ctx->tables[0].table = working_table;
+    for (int i = 0; i < scan_count; i++) {
+        if (strlen(scans[i]->alias) != alias_len || strncasecmp(scans[i]->alias, identifier, alias_len) != 0) continue;
+        int column = csv_get_column_index(loaded[i].table, dot + 1);
+        if (column < 0) return NULL;
+        *relation = i;
+        return &stats[i]->columns[column];
+    }
+    return NULL;
+}
+
+/* flag the columns of a scan that appear in any join condition of the chain */
+static void mark_key_columns(PlanNode** joins, int join_count, const char* alias, CsvTable* table, bool* keys) {
+    size_t alias_len = strlen(alias);
+    for (int j = 0; j < join_count; j++) {
+        ASTNode* on = joins[j]->join->join.condition;
+        const char* identifiers[2] = {on->condition.left->identifier, on->condition.right->identifier};
+        for (int k = 0; k < 2; k++) {
+            const char* dot = strchr(identifiers[k], '.');
+            if (!dot || (size_t)(dot - identifiers[k]) != alias_len ||
+                strncasecmp(identifiers[k], alias, alias_len) != 0) continue;
+            int column = csv_get_column_index(table, dot + 1);
+            if (column >= 0) keys[column] = true;
+        }
     }
+}
+
+static void print_join_order(PlanNode** joins, int join_count, PlanNode* base, double* estimated_rows, bool estimated) {
+    fprintf(stderr, "Join order: %s", base->alias);
+    for (int j = 0; j < join_count; j++) {
+        fprintf(stderr, ", %s", joins[j]->right->alias);
+        if (estimated) {
+            fprintf(stderr, " (build %s, ~%.0f rows)", joins[j]->build_left ? "left" : "right", estimated_rows[j]);
+        } else {
+            fprintf(stderr, " (build %s)", joins[j]->build_left ? "left" : "right");
+        }
+    }
+    fprintf(stderr, "\n");
+}
+
+/* an inner equi-join chain whose output order does not matter: load every scan, collect
+ * statistics, then run the joins cheapest order first, each one hashing its smaller input */
+static bool execute_cost_based_joins(QueryContext* ctx, PlanNode* top, Relation* rel, RowSink* sink) {
+    int join_count = 0;
+    for (PlanNode* node = top; node->type == PLAN_JOIN; node = node->input) join_count++;
     
-    // apply WHERE filtering
-    int filtered_count = 0;
-    Row** filtered_rows = filter_rows(ctx, query_ast->query.where, &filtered_count);
+    // joins[0] is the bottom join, scans[0] the FROM table and scans[j + 1] the right side of joins[j]
+    PlanNode** joins = malloc(sizeof(PlanNode*) * join_count);
+    PlanNode** scans = malloc(sizeof(PlanNode*) * (join_count + 1));
+    int index = join_count;
+    PlanNode* node = top;
+    for (; node->type == PLAN_JOIN; node = node->input) joins[--index] = node;
+    scans[0] = node;
+    for (int j = 0; j < join_count; j++) scans[j + 1] = joins[j]->right;
+    
+    Relation* loaded = calloc(join_count + 1, sizeof(Relation));
+    bool* available = calloc(join_count + 1, sizeof(bool));
+    if (!execute_scan(ctx, scans[0], &loaded[0])) {
+        free(available);
+        free(loaded);
+        free(scans);
+        free(joins);
+        return false;
+    }
+    available[0] = true;
+    bool all_loaded = true;
+    for (int j = 1; j <= join_count; j++) {
+        available[j] = execute_scan(ctx, scans[j], &loaded[j]);
+        if (!available[j]) all_loaded = false;
+    }
+    
+    int* order = malloc(sizeof(int) * join_count);
+    double* estimated_rows = calloc(join_count, sizeof(double));
+    for (int j = 0; j < join_count; j++) order[j] = j;
+    
+    bool estimated = false;
+    if (all_loaded) {
+        TableStats** stats = malloc(sizeof(TableStats*) * (join_count + 1));
+        for (int i = 0; i <= join_count; i++) {
+            bool* keys = calloc(loaded[i].table->column_count + 1, sizeof(bool));
+            mark_key_columns(joins, join_count, scans[i]->alias, loaded[i].table, keys);
+            stats[i] = table_stats_collect(loaded[i].table, keys);
+            free(keys);
+        }
+        
+        JoinCandidate* candidates = malloc(sizeof(JoinCandidate) * join_count);
+        bool keys_found = true;
+        for (int j = 0; j < join_count && keys_found; j++) {
+            ASTNode* on = joins[j]->join->join.condition;
+            int right_relation = -1;
+            candidates[j].left_key = key_column_stats(on->condition.left->identifier, scans, loaded, stats,
+                                                      join_count + 1, &candidates[j].left_relation);
+            candidates[j].right_key = key_column_stats(on->condition.right->identifier, scans, loaded, stats,
+                                                       join_count + 1, &right_relation);
+            candidates[j].right_rows = loaded[j + 1].table->row_count;
+            keys_found = candidates[j].left_key && candidates[j].right_key && right_relation == j + 1;
+        }
+        
+        if (keys_found) {
+            estimated = join_order_choose(loaded[0].table->row_count, candidates, join_count, order, estimated_rows);
+            if (!estimated) {
+                for (int j = 0; j < join_count; j++) order[j] = j;
+            }
+        }
+        
+        free(candidates);
+        for (int i = 0; i <= join_count; i++) table_stats_free(stats[i]);
+        free(stats);
+    }
+    
+    // the join nodes keep their place in the tree and take the clause and scan of the chosen join
+    PlanNode** chosen_right = malloc(sizeof(PlanNode*) * join_count);
+    ASTNode** chosen_join = malloc(sizeof(ASTNode*) * join_count);
+    Relation* chosen_loaded = malloc(sizeof(Relation) * join_count);
+    bool* chosen_available = malloc(sizeof(bool) * join_count);
+    for (int step = 0; step < join_count; step++) {
+        chosen_right[step] = joins[order[step]]->right;
+        chosen_join[step] = joins[order[step]]->join;
+        chosen_loaded[step] = loaded[order[step] + 1];
+        chosen_available[step] = available[order[step] + 1];
+    }
+    
+    // the last join that runs feeds the sink
+    int last_step = -1;
+    for (int step = 0; step < join_count; step++) {
+        if (chosen_available[step]) last_step = step;
+    }
+    
+    *rel = loaded[0];
+    for (int step = 0; step < join_count; step++) {
+        joins[step]->right = chosen_right[step];
+        joins[step]->join = chosen_join[step];
+        
+        // a join table that fails to load is skipped
+        if (!chosen_available[step]) continue;
+        joins[step]->build_left = rel->table->row_count < chosen_loaded[step].table->row_count;
+        join_relation(ctx, joins[step], rel, &chosen_loaded[step], step == last_step ? sink : NULL);
+    }
+    
+    if (report_join_order) {
+        print_join_order(joins, join_count, scans[0], estimated_rows, estimated);
+    }
+    
+    free(chosen_available);
+    free(chosen_loaded);
+    free(chosen_join);
+    free(chosen_right);
+    free(estimated_rows);
+    free(order);
+    free(available);
+    free(loaded);
+    free(scans);
+    free(joins);
+    return true;
+}
+
+/* scans and joins of a query; a sink given here receives the rows of the last join instead
+ * of the relation, the relation then has no rows */
+static bool execute_relation(QueryContext* ctx, PlanNode* node, Relation* rel, RowSink* sink) {
+    if (node->type == PLAN_SCAN) {
+        return execute_scan(ctx, node, rel);
+    }
+    if (node->cost_based) {
+        return execute_cost_based_joins(ctx, node, rel, sink);
+    }
+    
+    if (!execute_relation(ctx, node->input, rel, NULL)) return false;
+    
+    // a join table that fails to load is skipped
+    Relation right = {0};
+    if (!execute_scan(ctx, node->right, &right)) return true;
+    
+    join_relation(ctx, node, rel, &right, sink);
+    return true;
+}
+
+/* reordered joins produce their column blocks out of order: for each column in FROM + JOIN
+ * order its position in the joined rows, NULL if the blocks are in order already */
+static int* relation_column_order(Relation* rel, int column_count) {
+    bool ordered = true;
+    for (int b = 1; b < rel->block_count; b++) {
+        if (rel->block_tables[b] < rel->block_tables[b - 1]) ordered = false;
+    }
+    if (ordered) return NULL;
     
-    // check GROUP BY or aggregate functions
+    int* source = malloc(sizeof(int) * (column_count > 0 ? column_count : 1));
+    int out = 0;
+    
+    // blocks are few, pick the next smallest table index each round
+    bool* done = calloc(rel->block_count, sizeof(bool));
+    for (int round = 0; round < rel->block_count; round++) {
+        int pick = -1;
+        for (int b = 0; b < rel->block_count; b++) {
+            if (!done[b] && (pick < 0 || rel->block_tables[b] < rel->block_tables[pick])) pick = b;
+        }
+        done[pick] = true;
+        
+        int start = 0;
+        for (int b = 0; b < pick; b++) start += rel->block_widths[b];
+        for (int c = 0; c < rel->block_widths[pick]; c++) source[out++] = start + c;
+    }
+    free(done);
+    return source;
+}
+
+/* put the columns of a reordered join back in FROM + JOIN order */
+static void restore_column_order(Relation* rel) {
+    CsvTable* table = rel->table;
+    int* source = relation_column_order(rel, table->column_count);
+    if (!source) return;
+    
+    Column* columns = malloc(sizeof(Column) * table->column_count);
+    for (int c = 0; c < table->column_count; c++) columns[c] = table->columns[source[c]];
+    free(table->columns);
+    table->columns = columns;
+    
+    Value* values = malloc(sizeof(Value) * (table->column_count > 0 ? table->column_count : 1));
+    for (int i = 0; i < table->row_count; i++) {
+        Row* row = &table->rows[i];
+        for (int c = 0; c < table->column_count; c++) values[c] = row->values[source[c]];
+        memcpy(row->values, values, sizeof(Value) * table->column_count);
+    }
+    free(values);
+    free(source);
+}
+
+/* rows passing the WHERE conjuncts left after optimization */
+static Row** filter_plan_rows(QueryContext* ctx, PlanNode* filter, int row_limit, int* out_count) {
+    CsvTable* table = ctx->tables[0].table;
+    Row** rows = malloc(sizeof(Row*) * (table->row_count > 0 ? table->row_count : 1));
+    int count = 0;
+    double start = plan_stats_start(filter);
+    
+    if (filter && filter->row_limit >= 0) row_limit = filter->row_limit;
+    
+    for (int i = 0; i < table->row_count; i++) {
+        if (row_limit >= 0 && count >= row_limit) break;
+        if (filter && filter->always_false) break;
+        
+        bool matches = true;
+        for (int p = 0; filter && p < filter->predicate_count && matches; p++) {
+            matches = evaluate_condition(ctx, filter->predicates[p], &table->rows[i], 0);
+        }
+        
+        if (matches) {
+            rows[count++] = &table->rows[i];
+        }
+    }
+    
+    plan_stats_finish(filter, start, table->row_count, count);
+    *out_count = count;
+    return rows;
+}
+
+/* GROUP BY, or aggregate functions over all rows, followed by HAVING */
+static ResultSet* aggregate_rows(QueryContext* ctx, ASTNode* query_ast, Row** filtered_rows, int filtered_count) {
     ASTNode* group_by = query_ast->query.group_by;
     ResultSet* result;
     
@@ -218,18 +625,7 @@ ResultSet* evaluate_query_internal(ASTNode* query_ast, Row* outer_row, CsvTable*
         result = build_aggregated_result(ctx, groups, query_ast->query.select);
         
         free_groups(groups);
-        
-        // evaluate HAVING filter if present
-        if (query_ast->query.having) {
-            apply_having_filter(result, query_ast->query.having, query_ast->query.select);
-        }
-        
-        // apply ORDER BY to the aggregated result
-        ASTNode* order_by = query_ast->query.order_by;
-        if (order_by && order_by->type == NODE_TYPE_ORDER_BY && order_by->order_by.column) {
-            sort_result(result, query_ast->query.select, order_by->order_by.column, order_by->order_by.descending);
-        }
-    } else if (has_aggregate_functions(query_ast->query.select)) {
+    } else {
         // aggregate functions without GROUP BY - entire result is a single group
         GroupResult* groups = malloc(sizeof(GroupResult));
         groups->group_count = 1;
@@ -245,47 +641,396 @@ ResultSet* evaluate_query_internal(ASTNode* query_ast, Row* outer_row, CsvTable*
         free(groups->groups[0].group_key);
         free(groups->groups);
         free(groups);
-        
-        // evaluate HAVING filter if present
-        if (query_ast->query.having) {
-            apply_having_filter(result, query_ast->query.having, query_ast->query.select);
-        }
-        
-        // apply ORDER BY to aggregated result
-        ASTNode* order_by = query_ast->query.order_by;
-        if (order_by && order_by->type == NODE_TYPE_ORDER_BY && order_by->order_by.column) {
-            sort_result(result, query_ast->query.select, order_by->order_by.column, order_by->order_by.descending);
-        }
+    }
+    
+    // evaluate HAVING filter if present
+    if (query_ast->query.having) {
+        apply_having_filter(result, query_ast->query.having, query_ast->query.select);
+    }
+    
+    return result;
+}
+
+/* sort, distinct and limit run on the result in plan order */
+static void finish_result(PlanNode* node, PlanNode* output, ResultSet* result) {
+    if (!node || node == output) return;
+    finish_result(node->input, output, result);
+    
+    ASTNode* query_ast = node->query;
+    double start = plan_stats_start(node);
+    long long rows_in = result->row_count;
+    
+    switch (node->type) {
+        case PLAN_SORT:
+            sort_result(result, query_ast->query.select, query_ast->query.order_by->order_by.column,
+                        query_ast->query.order_by->order_by.descending);
+            break;
+        case PLAN_DISTINCT:
+            apply_distinct(result);
+            break;
+        case PLAN_LIMIT:
+            apply_limit_offset(result, node->limit, node->offset);
+            break;
+        default:
+            break;
+    }
+    
+    plan_stats_finish(node, start, rows_in, result->row_count);
+}
+
+/* execute the operators of one query, top is its outermost plan node */
+static ResultSet* execute_query_plan(PlanNode* top, Row* outer_row, CsvTable* outer_table, bool* outer_columns_read) {
+    ASTNode* query_ast = top->query;
+    
+    PlanNode* output = top;
+    while (output->type != PLAN_PROJECT && output->type != PLAN_AGGREGATE) {
+        output = output->input;
+    }
+    PlanNode* filter = output->input->type == PLAN_FILTER ? output->input : NULL;
+    
+    // execution context
+    QueryContext* ctx = context_create(query_ast);
+    
+    // set outer context for correlated subqueries
+    ctx->outer_row = outer_row;
+    ctx->outer_table = outer_table;
+    ctx->outer_columns_read = outer_columns_read;
+    
+    // scans with their pushed down filters, then JOINs
+    Relation rel = {0};
+    if (!execute_relation(ctx, filter ? filter->input : output->input, &rel, NULL)) {
+        relation_free_blocks(&rel);
+        context_free(ctx);
+        return NULL;
+    }
+    restore_column_order(&rel);
+    relation_free_blocks(&rel);
+    
+    ctx->table_count = 1;
+    ctx->tables = malloc(sizeof(TableRef) * 1);
+    ctx->tables[0].alias = strdup(rel.alias);
+    ctx->tables[0].table = rel.table;
+    
+    // apply WHERE filtering
+    int filtered_count = 0;
+    Row** filtered_rows = filter_plan_rows(ctx, filter, output->row_limit, &filtered_count);
+    
+    ResultSet* result;
+    double start = plan_stats_start(output);
+    if (output->type == PLAN_AGGREGATE) {
+        result = aggregate_rows(ctx, query_ast, filtered_rows, filtered_count);
     } else {
         // build result first so ORDER BY can use aliases
         result = build_result(ctx, filtered_rows, filtered_count);
-        
-        // apply ORDER BY for non-aggregated results
-        ASTNode* order_by = query_ast->query.order_by;
-        if (order_by && order_by->type == NODE_TYPE_ORDER_BY) {
-            const char* col_name = order_by->order_by.column;
-            bool descending = order_by->order_by.descending;
-            
-            if (col_name) {
-                sort_result(result, query_ast->query.select, col_name, descending);
-            }
-        }
     }
+    plan_stats_finish(output, start, filtered_count, result ? result->row_count : 0);
     
     free(filtered_rows);
     context_free(ctx);
     
-    // apply DISTINCT if specified
-    if (query_ast->query.select && query_ast->query.select->select.distinct) {
-        apply_distinct(result);
+    if (result) {
+        finish_result(top, output, result);
+    }
+    return result;
+}
+
+/* output stage of a streamed query: the rows of the scan or of the last join probe are
+ * filtered, projected and cut by OFFSET / LIMIT one at a time, then pushed into the output */
+typedef struct {
+    RowSink base;
+    QueryContext* ctx;          // WHERE and SELECT list, the scans and joins use their own context
+    Relation* rel;              // block layout of the rows that arrive
+    PlanNode* filter;
+    RowSink* output;
+    bool begun;
+    CsvTable header;            // the incoming columns in FROM + JOIN order, without rows
+    int* source;                // position of each header column in the incoming rows, NULL if the same
+    Row ordered;
+    Projection* projection;
+    Row projected;
+    /* an output taking batches gets the projected rows STREAM_BATCH_ROWS at a time */
+    Row* batch;
+    int batched;
+    int batch_capacity;
+    long long offset;           // rows still to skip
+    long long limit;            // rows still to emit, -1 if unbounded
+} RowStream;
+
+/* enough rows for the output sink to split among its formatting threads */
+#define STREAM_BATCH_ROWS 65536
+
+static void stream_begin(RowSink* sink, const Column* columns, int column_count) {
+    RowStream* stream = (RowStream*)sink;
+    stream->begun = true;
+    
+    // the names stay owned by the relation table
+    stream->source = relation_column_order(stream->rel, column_count);
+    stream->header.column_count = column_count;
+    stream->header.columns = malloc(sizeof(Column) * (column_count > 0 ? column_count : 1));
+    for (int c = 0; c < column_count; c++) {
+        stream->header.columns[c] = columns[stream->source ? stream->source[c] : c];
+    }
+    if (stream->source) {
+        stream->ordered.column_count = column_count;
+        stream->ordered.values = malloc(sizeof(Value) * (column_count > 0 ? column_count : 1));
+    }
+    
+    QueryContext* ctx = stream->ctx;
+    ctx->table_count = 1;
+    ctx->tables = malloc(sizeof(TableRef));
+    ctx->tables[0].alias = strdup(stream->rel->alias);
+    ctx->tables[0].table = &stream->header;
+    
+    stream->projection = projection_create(ctx);
+    stream->projected.column_count = stream->projection->column_count;
+    stream->projected.values = malloc(sizeof(Value) * (stream->projected.column_count > 0 ? stream->projected.column_count : 1));
+    if (stream->output->rows) {
+        int capacity = stream->limit > 0 && stream->limit < STREAM_BATCH_ROWS ? (int)stream->limit : STREAM_BATCH_ROWS;
+        int width = stream->projected.column_count > 0 ? stream->projected.column_count : 1;
+        Value* values = malloc(sizeof(Value) * (size_t)capacity * width);
+        stream->batch = malloc(sizeof(Row) * capacity);
+        for (int r = 0; r < capacity; r++) {
+            stream->batch[r].column_count = stream->projected.column_count;
+            stream->batch[r].values = values + (size_t)r * width;
+        }
+        stream->batch_capacity = capacity;
+    }
+    stream->output->begin(stream->output, stream->projection->columns, stream->projection->column_count);
+}
+
+/* hand the batched rows to the output and release them */
+static bool stream_flush(RowStream* stream) {
+    bool more = row_sink_push_rows(stream->output, stream->batch, stream->batched);
+    for (int r = 0; r < stream->batched; r++) {
+        for (int c = 0; c < stream->batch[r].column_count; c++) value_free(&stream->batch[r].values[c]);
+    }
+    stream->batched = 0;
+    return more;
+}
+
+static bool stream_row(RowSink* sink, const Row* input) {
+    RowStream* stream = (RowStream*)sink;
+    if (stream->limit == 0 || (stream->filter && stream->filter->always_false)) return false;
+    
+    Row* row = (Row*)input;
+    if (stream->source) {
+        for (int c = 0; c < stream->ordered.column_count; c++) {
+            stream->ordered.values[c] = input->values[stream->source[c]];
+        }
+        row = &stream->ordered;
     }
     
-    // apply LIMIT and OFFSET
-    apply_limit_offset(result, query_ast->query.limit, query_ast->query.offset);
+    PlanNode* filter = stream->filter;
+    for (int p = 0; filter && p < filter->predicate_count; p++) {
+        if (!evaluate_condition(stream->ctx, filter->predicates[p], row, 0)) return true;
+    }
+    if (stream->offset > 0) {
+        stream->offset--;
+        return true;
+    }
+    
+    bool more;
+    if (stream->batch) {
+        projection_row(stream->projection, stream->ctx, row, stream->batch[stream->batched++].values);
+        more = stream->batched < stream->batch_capacity || stream_flush(stream);
+    } else {
+        projection_row(stream->projection, stream->ctx, row, stream->projected.values);
+        more = stream->output->row(stream->output, &stream->projected);
+        for (int c = 0; c < stream->projected.column_count; c++) value_free(&stream->projected.values[c]);
+    }
+    
+    if (stream->limit > 0) stream->limit--;
+    return more && stream->limit != 0;
+}
+
+/* a query streams when nothing above its projection needs all rows: no aggregate, sort,
+ * DISTINCT or window function, only LIMIT / OFFSET */
+static PlanNode* streamed_output(PlanNode* top) {
+    if (top->type != PLAN_LIMIT && top->type != PLAN_PROJECT) return NULL;
+    PlanNode* output = top->type == PLAN_LIMIT ? top->input : top;
+    if (output->type != PLAN_PROJECT) return NULL;
+    
+    ASTNode* select_node = output->query->query.select;
+    if (!select_node || select_node->type != NODE_TYPE_SELECT) return NULL;
+    for (int i = 0; select_node->select.column_nodes && i < select_node->select.column_count; i++) {
+        ASTNode* column = select_node->select.column_nodes[i];
+        if (column && column->type == NODE_TYPE_WINDOW_FUNCTION) return NULL;
+    }
+    return output;
+}
+
+/* run a streamable plan, every result row goes into sink as soon as it is produced and is
+ * released again, so memory does not grow with the result */
+static bool stream_query_plan(PlanNode* top, PlanNode* output, RowSink* sink) {
+    PlanNode* filter = output->input->type == PLAN_FILTER ? output->input : NULL;
+    QueryContext* ctx = context_create(top->query);
+    Relation rel = {0};
     
+    RowStream stream = {
+        .base = {.begin = stream_begin, .row = stream_row},
+        .ctx = context_create(top->query),
+        .rel = &rel,
+        .filter = filter,
+        .output = sink,
+        .offset = top->type == PLAN_LIMIT && top->offset > 0 ? top->offset : 0,
+        .limit = top->type == PLAN_LIMIT && top->limit >= 0 ? top->limit : -1,
+    };
+    
+    // the last join probe feeds the stream directly, a scan or a skipped join leaves the rows in rel
+    bool ok = execute_relation(ctx, filter ? filter->input : output->input, &rel, &stream.base);
+    if (ok && !stream.begun) {
+        CsvTable* table = rel.table;
+        stream_begin(&stream.base, table->columns, table->column_count);
+        for (int i = 0; i < table->row_count; i++) {
+            if (!stream_row(&stream.base, &table->rows[i])) break;
+        }
+    }
+    
+    if (stream.batched > 0) stream_flush(&stream);
+    
+    if (rel.table) csv_free(rel.table);
+    relation_free_blocks(&rel);
+    if (stream.batch) free(stream.batch[0].values);
+    free(stream.batch);
+    projection_free(stream.projection);
+    free(stream.projected.values);
+    free(stream.ordered.values);
+    free(stream.source);
+    free(stream.header.columns);
+    // the header belongs to the stream, not to its context
+    if (stream.ctx->tables) stream.ctx->tables[0].table = NULL;
+    context_free(stream.ctx);
+    context_free(ctx);
+    return ok;
+}
+
+static ResultSet* execute_plan_node(PlanNode* node, Row* outer_row, CsvTable* outer_table, bool* outer_columns_read) {
+    if (node->type != PLAN_SET_OP) {
+        return execute_query_plan(node, outer_row, outer_table, outer_columns_read);
+    }
+    
+    ResultSet* left = execute_plan_node(node->input, NULL, NULL, NULL);
+    if (!left) return NULL;
+    
+    ResultSet* right = execute_plan_node(node->right, NULL, NULL, NULL);
+    if (!right) {
+        csv_free(left);
+        return NULL;
+    }
+    
+    // check column count compatibility
+    if (left->column_count != right->column_count) {
+        fprintf(stderr, "Error: SET operation queries must have the same number of columns\n");
+        csv_free(left);
+        csv_free(right);
+        return NULL;
+    }
+    
+    ResultSet* result = NULL;
+    double start = plan_stats_start(node);
+    long long rows_in = (long long)left->row_count + right->row_count;
+    
+    // the set operations move the kept rows out of their inputs
+    
+    switch (node->set_op) {
+        case SET_OP_UNION:
+            result = set_union(left, right, false);
+            break;
+        case SET_OP_UNION_ALL:
+            result = set_union(left, right, true);
+            break;
+        case SET_OP_INTERSECT:
+            result = set_intersect(left, right);
+            break;
+        case SET_OP_EXCEPT:
+            result = set_except(left, right);
+            break;
+    }
+    plan_stats_finish(node, start, rows_in, result ? result->row_count : 0);
+    
+    csv_free(left);
+    csv_free(right);
     return result;
 }
 
+/* build, optimize and execute the plan of a query or set operation */
+static ResultSet* evaluate_plan(ASTNode* query_ast, Row* outer_row, CsvTable* outer_table, bool* outer_columns_read) {
+    double start = profile_counters.tracing ? profile_clock_ms() : 0;
+    QueryPlan* plan = plan_build(query_ast);
+    if (!plan) {
+        fprintf(stderr, "Invalid query AST\n");
+        return NULL;
+    }
+    
+    plan_optimize(plan);
+    if (profile_counters.tracing) profile_span("phase", "plan", NULL, start, profile_clock_ms());
+    ResultSet* result = execute_plan_node(plan->root, outer_row, outer_table, outer_columns_read);
+    plan_free(plan);
+    return result;
+}
+
+/* EXPLAIN lists the optimized plan, EXPLAIN ANALYZE runs it first and adds per operator statistics */
+static ResultSet* evaluate_explain(ASTNode* explain_ast) {
+    QueryPlan* plan = plan_build(explain_ast->explain.query);
+    if (!plan) {
+        fprintf(stderr, "Error: EXPLAIN supports SELECT queries and set operations\n");
+        return NULL;
+    }
+    plan_optimize(plan);
+    
+    bool analyze = explain_ast->explain.analyze;
+    if (analyze) {
+        plan_enable_stats(plan->root);
+        double start = profile_clock_ms();
+        ResultSet* result = execute_plan_node(plan->root, NULL, NULL, NULL);
+        if (!result) {
+            plan_free(plan);
+            return NULL;
+        }
+        csv_free(result);
+        plan->execution_ms = profile_clock_ms() - start;
+    }
+    
+    ResultSet* explained = plan_explain(plan, analyze);
+    plan_free(plan);
+    return explained;
+}
+
+/* evaluate a query, optionally marking in outer_columns_read every outer column it resolves */
+ResultSet* evaluate_correlated_query(ASTNode* query_ast, Row* outer_row, CsvTable* outer_table, bool* outer_columns_read) {
+    if (!query_ast || query_ast->type != NODE_TYPE_QUERY) {
+        fprintf(stderr, "Invalid query AST\n");
+        return NULL;
+    }
+    
+    return evaluate_plan(query_ast, outer_row, outer_table, outer_columns_read);
+}
+
+bool evaluate_query_to_sink(ASTNode* query_ast, RowSink* sink) {
+    if (query_ast && query_ast->type == NODE_TYPE_QUERY) {
+        QueryPlan* plan = plan_build(query_ast);
+        if (!plan) {
+            fprintf(stderr, "Invalid query AST\n");
+            return false;
+        }
+        plan_optimize(plan);
+        PlanNode* output = streamed_output(plan->root);
+        if (output) {
+            bool ok = stream_query_plan(plan->root, output, sink);
+            plan_free(plan);
+            return ok;
+        }
+        plan_free(plan);
+    }
+    
+    // blocking operators, set operations and statements: the whole result, then its rows
+    ResultSet* result = evaluate_query(query_ast);
+    if (!result) return false;
+    row_sink_push_result(sink, result);
+    csv_free(result);
+    return true;
+}
+
 /* api wrapper to evaluates query without outer context */
 ResultSet* evaluate_query(ASTNode* query_ast) {
     if (!query_ast) return NULL;
@@ -303,45 +1048,13 @@ ResultSet* evaluate_query(ASTNode* query_ast) {
         return evaluate_alter_table(query_ast);
     }
     
+    if (query_ast->type == NODE_TYPE_EXPLAIN) {
+        return evaluate_explain(query_ast);
+    }
+    
     // handle set operations
     if (query_ast->type == NODE_TYPE_SET_OP) {
-        ResultSet* left = evaluate_query(query_ast->set_op.left);
-        if (!left) return NULL;
-        
-        ResultSet* right = evaluate_query(query_ast->set_op.right);
-        if (!right) {
-            csv_free(left);
-            return NULL;
-        }
-        
-        // check column count compatibility
-        if (left->column_count != right->column_count) {
-            fprintf(stderr, "Error: SET operation queries must have the same number of columns\n");
-            csv_free(left);
-            csv_free(right);
-            return NULL;
-        }
-        
-        ResultSet* result = NULL;
-        
-        switch (query_ast->set_op.op_type) {
-            case SET_OP_UNION:
-                result = set_union(left, right, false);
-                break;
-            case SET_OP_UNION_ALL:
-                result = set_union(left, right, true);
-                break;
-            case SET_OP_INTERSECT:
-                result = set_intersect(left, right);
-                break;
-            case SET_OP_EXCEPT:
-                result = set_except(left, right);
-                break;
-        }
-        
-        csv_free(left);
-        csv_free(right);
-        return result;
+        return evaluate_plan(query_ast, NULL, NULL, NULL);
     }
     
     return evaluate_query_internal(query_ast, NULL, NULL);
@@ -3,6 +3,7 @@
 #include <string.h>
 #include <strings.h>
 #include <math.h>
+#include <limits.h>
 #include "evaluator.h"
 #include "parser.h"
 #include "csv_reader.h"
@@ -260,7 +261,65 @@ void free_groups(GroupResult* groups) {
     free(groups);
 }
 
-Value evaluate_aggregate(const char* func_name, Row** rows, int row_count, CsvTable* table, const char* column_name) {
+/* SUM / AVG accumulator, integers are added exactly and kept apart from doubles */
+typedef struct {
+#if defined(__SIZEOF_INT128__)
+    __int128 int_sum;
+#else
+    long double int_sum;
+#endif
+    double double_sum;
+    bool has_double;
+    int count;
+} NumericSum;
+
+/* the integer kernel runs until the first double, the rest of the column goes
+ * through the double kernel, so a cell is never tested for both */
+static NumericSum sum_column(Row** rows, int row_count, int col_idx) {
+    NumericSum sum = {0};
+    int i = 0;
+    
+    for (; i < row_count; i++) {
+        Value* val = &rows[i]->values[col_idx];
+        if (val->type == VALUE_TYPE_INTEGER) {
+            sum.int_sum += val->int_value;
+            sum.count++;
+        } else if (val->type == VALUE_TYPE_DOUBLE) {
+            break;
+        }
+    }
+    if (i < row_count) sum.has_double = true;
+    
+    for (; i < row_count; i++) {
+        Value* val = &rows[i]->values[col_idx];
+        if (val->type == VALUE_TYPE_DOUBLE) {
+            sum.double_sum += val->double_value;
+            sum.count++;
+        } else if (val->type == VALUE_TYPE_INTEGER) {
+            sum.double_sum += (double)val->int_value;
+            sum.count++;
+        }
+    }
+    return sum;
+}
+
+/* DOUBLE if any of the rows holds a double in the column, else INTEGER if any holds an
+ * integer, NULL when there are no numbers to go by */
+ValueType sum_cell_type(Row** rows, int row_count, CsvTable* table, const char* column_name) {
+    int col_idx = find_column_index_with_fallback(table, column_name);
+    if (col_idx < 0) return VALUE_TYPE_NULL;
+    
+    ValueType type = VALUE_TYPE_NULL;
+    for (int i = 0; i < row_count; i++) {
+        ValueType cell = rows[i]->values[col_idx].type;
+        if (cell == VALUE_TYPE_DOUBLE) return VALUE_TYPE_DOUBLE;
+        if (cell == VALUE_TYPE_INTEGER) type = VALUE_TYPE_INTEGER;
+    }
+    return type;
+}
+
+Value evaluate_aggregate(const char* func_name, Row** rows, int row_count, CsvTable* table,
+                         const char* column_name, ValueType sum_type) {
     Value result;
     result.type = VALUE_TYPE_NULL;
     
@@ -284,26 +343,24 @@ Value evaluate_aggregate(const char* func_name, Row** rows, int row_count, CsvTa
     }
     
     if (strcasecmp(func_name, "AVG") == 0 || strcasecmp(func_name, "SUM") == 0) {
-        double sum = 0;
-        int count = 0;
-        
-        for (int i = 0; i < row_count; i++) {
-            Value* val = &rows[i]->values[col_idx];
-            if (val->type == VALUE_TYPE_INTEGER) {
-                sum += val->int_value;
-                count++;
-            } else if (val->type == VALUE_TYPE_DOUBLE) {
-                sum += val->double_value;
-                count++;
-            }
-        }
+        NumericSum sum = sum_column(rows, row_count, col_idx);
         
         if (strcasecmp(func_name, "SUM") == 0) {
-            result.type = VALUE_TYPE_DOUBLE;
-            result.double_value = sum;
+            // integer columns sum exactly, doubles only once a value of the column or the total
+            // needs them. with no numbers to go by, the sum takes the column's type
+            bool integer_sum = sum_type == VALUE_TYPE_NULL
+                               ? table->columns[col_idx].inferred_type == VALUE_TYPE_INTEGER
+                               : sum_type == VALUE_TYPE_INTEGER && !sum.has_double;
+            if (integer_sum && sum.int_sum >= LLONG_MIN && sum.int_sum <= LLONG_MAX) {
+                result.type = VALUE_TYPE_INTEGER;
+                result.int_value = (long long)sum.int_sum;
+            } else {
+                result.type = VALUE_TYPE_DOUBLE;
+                result.double_value = (double)sum.int_sum + sum.double_sum;
+            }
         } else {
             result.type = VALUE_TYPE_DOUBLE;
-            result.double_value = count > 0 ? sum / count : 0;
+            result.double_value = sum.count > 0 ? ((double)sum.int_sum + sum.double_sum) / sum.count : 0;
         }
         return result;
     }
@@ -529,6 +586,16 @@ void apply_having_filter(ResultSet* result, ASTNode* having, ASTNode* select_nod
     result->row_capacity = result->row_count;
 }
 
+/* sum_cell_type over the rows of every group */
+static ValueType groups_sum_type(GroupResult* groups, CsvTable* table, const char* column_name) {
+    ValueType type = VALUE_TYPE_NULL;
+    for (int g = 0; g < groups->group_count && type != VALUE_TYPE_DOUBLE; g++) {
+        ValueType group_type = sum_cell_type(groups->groups[g].rows, groups->groups[g].row_count, table, column_name);
+        if (group_type != VALUE_TYPE_NULL) type = group_type;
+    }
+    return type;
+}
+
 /* function to build aggregated result */
 ResultSet* build_aggregated_result(QueryContext* ctx, GroupResult* groups, ASTNode* select_node) {
     ResultSet* result = calloc(1, sizeof(ResultSet));
@@ -597,6 +664,10 @@ ResultSet* build_aggregated_result(QueryContext* ctx, GroupResult* groups, ASTNo
     result->row_capacity = groups->group_count;
     result->rows = malloc(sizeof(Row) * result->row_count);
     
+    /* the type of each SUM column, found on its first group from the rows of all of them */
+    int* sum_types = malloc(sizeof(int) * (result->column_count > 0 ? result->column_count : 1));
+    for (int col = 0; col < result->column_count; col++) sum_types[col] = -1;
+    
     for (int g = 0; g < groups->group_count; g++) {
         GroupedRows* group = &groups->groups[g];
         result->rows[g].column_count = result->column_count;
@@ -651,14 +722,18 @@ ResultSet* build_aggregated_result(QueryContext* ctx, GroupResult* groups, ASTNo
                        it will try exact match first, then strip prefix if needed */
                     
                     /* evaluate aggregate function */
+                    if (sum_types[col] < 0 && strcasecmp(func_name, "SUM") == 0) {
+                        sum_types[col] = (int)groups_sum_type(groups, ctx->tables[0].table, col_name);
+                    }
                     Value tmp = evaluate_aggregate(func_name, group->rows, group->row_count, 
-                                                   ctx->tables[0].table, col_name);
+                                                   ctx->tables[0].table, col_name,
+                                                   sum_types[col] < 0 ? VALUE_TYPE_NULL : (ValueType)sum_types[col]);
                     result->rows[g].values[col] = value_copy(&tmp);
                 } else {
                     /* scalar function - evaluate on first row of the group */
                     if (group->row_count > 0) {
                         Value tmp = evaluate_column_expression(col_spec, ctx, group->rows[0], NULL, col);
-                        result->rows[g].values[col] = value_copy(&tmp);
+                        result->rows[g].values[col] = tmp;
                     } else {
                         result->rows[g].values[col].type = VALUE_TYPE_NULL;
                     }
@@ -671,7 +746,7 @@ ResultSet* build_aggregated_result(QueryContext* ctx, GroupResult* groups, ASTNo
                     /* this is an expression (CASE, function call, etc.) - evaluate it on first row */
                     if (group->row_count > 0) {
                         Value tmp = evaluate_expression(ctx, col_node, group->rows[0], 0);
-                        result->rows[g].values[col] = value_copy(&tmp);
+                        result->rows[g].values[col] = tmp;
                     } else {
                         result->rows[g].values[col].type = VALUE_TYPE_NULL;
                     }
@@ -691,6 +766,7 @@ ResultSet* build_aggregated_result(QueryContext* ctx, GroupResult* groups, ASTNo
             }
         }
     }
+    free(sum_types);
     
     return result;
 }
@@ -8,9 +8,7 @@
 #include "csv_reader.h"
 #include "evaluator/evaluator_conditions.h"
 #include "evaluator/evaluator_expressions.h"
-
-// forward declarations
-ResultSet* evaluate_query(ASTNode* query_ast);
+#include "evaluator/evaluator_subquery.h"
 
 // pattern matching helper for like/ilike operators
 static bool match_pattern(const char* str, const char* pattern, bool case_sensitive) {
@@ -58,6 +56,72 @@ static bool match_pattern(const char* str, const char* pattern, bool case_sensit
     return *p == '\0';
 }
 
+/* list elements that do not depend on the current row */
+static bool is_constant_expression(ASTNode* node) {
+    if (!node) return true;
+    
+    switch (node->type) {
+        case NODE_TYPE_LITERAL:
+            return true;
+        case NODE_TYPE_BINARY_OP:
+            return is_constant_expression(node->binary_op.left) &&
+                   is_constant_expression(node->binary_op.right);
+        default:
+            return false;
+    }
+}
+
+/* materialize a constant IN list into a value set, subqueries are cached per outer row by
+ * evaluate_in_subquery, which runs an uncorrelated one once */
+static void compile_in_list(QueryContext* ctx, CompiledInList* compiled) {
+    ASTNode* right_node = compiled->condition->condition.right;
+    
+    if (right_node->type == NODE_TYPE_LIST) {
+        ASTNode* list = right_node;
+        for (int i = 0; i < list->list.node_count; i++) {
+            if (!is_constant_expression(list->list.nodes[i])) return;
+        }
+        
+        compiled->values = value_hash_set_create(list->list.node_count);
+        for (int i = 0; i < list->list.node_count; i++) {
+            Value list_val = evaluate_expression(ctx, list->list.nodes[i], NULL, 0);
+            value_hash_set_add(compiled->values, &list_val);
+            value_free(&list_val);
+        }
+    }
+}
+
+/* find the compiled set for an IN condition, building it on first use */
+static CompiledInList* get_compiled_in_list(QueryContext* ctx, ASTNode* condition) {
+    if (!ctx) return NULL;
+    
+    for (int i = 0; i < ctx->in_list_count; i++) {
+        if (ctx->in_lists[i].condition == condition) {
+            return &ctx->in_lists[i];
+        }
+    }
+    
+    ctx->in_lists = realloc(ctx->in_lists, sizeof(CompiledInList) * (ctx->in_list_count + 1));
+    CompiledInList* compiled = &ctx->in_lists[ctx->in_list_count++];
+    compiled->condition = condition;
+    compiled->values = NULL;
+    compiled->invalid = false;
+    
+    compile_in_list(ctx, compiled);
+    return compiled;
+}
+
+void free_compiled_in_lists(QueryContext* ctx) {
+    if (!ctx) return;
+    
+    for (int i = 0; i < ctx->in_list_count; i++) {
+        value_hash_set_free(ctx->in_lists[i].values);
+    }
+    free(ctx->in_lists);
+    ctx->in_lists = NULL;
+    ctx->in_list_count = 0;
+}
+
 // evaluate condition expressions, handles logical operators and comparisons
 bool evaluate_condition(QueryContext* ctx, ASTNode* condition, Row* current_row, int table_index) {
     if (!condition) return true;
@@ -85,80 +149,65 @@ bool evaluate_condition(QueryContext* ctx, ASTNode* condition, Row* current_row,
         return left || right;
     }
     
-    // handle comparison operators
-    Value left = evaluate_expression(ctx, condition->condition.left, current_row, table_index);
-    Value right = evaluate_expression(ctx, condition->condition.right, current_row, table_index);
-    
-    int cmp = value_compare(&left, &right);
-    
-    if (strcmp(op, "=") == 0) return cmp == 0;
-    if (strcmp(op, "!=") == 0) return cmp != 0;
-    if (strcmp(op, "<>") == 0) return cmp != 0;
-    if (strcmp(op, ">") == 0) return cmp > 0;
-    if (strcmp(op, "<") == 0) return cmp < 0;
-    if (strcmp(op, ">=") == 0) return cmp >= 0;
-    if (strcmp(op, "<=") == 0) return cmp <= 0;
-    
-    // handle IN and NOT IN operators
+    // handle IN and NOT IN operators, the right side is a list or subquery, not a value
     if (strcasecmp(op, "IN") == 0 || strcasecmp(op, "NOT IN") == 0) {
         bool is_not_in = (strcasecmp(op, "NOT IN") == 0);
         ASTNode* right_node = condition->condition.right;
+        if (!right_node) return is_not_in; // empty list: NOT IN = true, IN = false
         
-        // check if it's a subquery or a list
-        if (right_node->type == NODE_TYPE_SUBQUERY) {
-            // evaluate the subquery
-            if (!right_node->subquery.query) return is_not_in; // NOT IN empty = true
-            
-            ResultSet* subquery_result = evaluate_query(right_node->subquery.query);
-            if (!subquery_result) return is_not_in;
-            
-            // the subquery should return a single column
-            if (subquery_result->column_count != 1) {
+        CompiledInList* compiled = get_compiled_in_list(ctx, condition);
+        if (compiled && compiled->invalid) return false;
+        
+        Value left = evaluate_expression(ctx, condition->condition.left, current_row, table_index);
+        bool found = false;
+        
+        if (compiled && compiled->values) {
+            // single hash probe per row
+            found = value_hash_set_contains(compiled->values, &left);
+        } else if (compiled && right_node->type == NODE_TYPE_SUBQUERY) {
+            // a hash probe too, into the set of the outer row's correlation key
+            if (!evaluate_in_subquery(ctx, right_node->subquery.query, current_row,
+                                      ctx->tables ? ctx->tables[table_index].table : NULL, &left, &found)) {
                 fprintf(stderr, "Error: IN subquery must return exactly one column\n");
-                csv_free(subquery_result);
-                return false;
+                compiled->invalid = true;
             }
-            
-            // check if left value matches any value in the subquery result
-            bool found = false;
-            for (int i = 0; i < subquery_result->row_count; i++) {
-                Value* subquery_val = &subquery_result->rows[i].values[0];
-                if (value_compare(&left, subquery_val) == 0) {
-                    found = true;
-                    break;
-                }
-            }
-            
-            csv_free(subquery_result);
-            return is_not_in ? !found : found;
         } else if (right_node->type == NODE_TYPE_LIST) {
-            // list-based IN operator
+            // list references columns, evaluate its elements for this row
             ASTNode* list = right_node;
-            for (int i = 0; i < list->list.node_count; i++) {
+            for (int i = 0; i < list->list.node_count && !found; i++) {
                 Value list_val = evaluate_expression(ctx, list->list.nodes[i], current_row, table_index);
-                if (value_compare(&left, &list_val) == 0) {
-                    value_free(&list_val);
-                    return is_not_in ? false : true;
-                }
+                found = (value_compare(&left, &list_val) == 0);
                 value_free(&list_val);
             }
-            return is_not_in ? true : false;
         }
         
-        return is_not_in; // empty list: NOT IN = true, IN = false
+        value_free(&left);
+        return is_not_in ? !found : found;
     }
     
-    // handle LIKE and ILIKE operators
-    if (strcasecmp(op, "LIKE") == 0 || strcasecmp(op, "ILIKE") == 0) {
+    // handle comparison operators, both sides are freed once compared
+    Value left = evaluate_expression(ctx, condition->condition.left, current_row, table_index);
+    Value right = evaluate_expression(ctx, condition->condition.right, current_row, table_index);
+    
+    int cmp = value_compare(&left, &right);
+    bool result = false;
+    
+    if (strcmp(op, "=") == 0) result = cmp == 0;
+    else if (strcmp(op, "!=") == 0) result = cmp != 0;
+    else if (strcmp(op, "<>") == 0) result = cmp != 0;
+    else if (strcmp(op, ">") == 0) result = cmp > 0;
+    else if (strcmp(op, "<") == 0) result = cmp < 0;
+    else if (strcmp(op, ">=") == 0) result = cmp >= 0;
+    else if (strcmp(op, "<=") == 0) result = cmp <= 0;
+    else if (strcasecmp(op, "LIKE") == 0 || strcasecmp(op, "ILIKE") == 0) {
+        // handle LIKE and ILIKE operators, both operands must be strings
         bool case_sensitive = (strcasecmp(op, "LIKE") == 0);
-        
-        // both operands must be strings
-        if (left.type != VALUE_TYPE_STRING || right.type != VALUE_TYPE_STRING) {
-            return false;
+        if (left.type == VALUE_TYPE_STRING && right.type == VALUE_TYPE_STRING) {
+            result = match_pattern(left.string_value, right.string_value, case_sensitive);
         }
-        
-        return match_pattern(left.string_value, right.string_value, case_sensitive);
     }
     
-    return false;
+    value_free(&left);
+    value_free(&right);
+    return result;
 }
@@ -11,6 +11,8 @@
 #include "string_utils.h"
 #include "evaluator/evaluator_core.h"
 #include "evaluator/evaluator_expressions.h"
+#include "evaluator/evaluator_conditions.h"
+#include "evaluator/evaluator_subquery.h"
 
 // forward declarations
 extern CsvConfig global_csv_config;
@@ -22,6 +24,7 @@ QueryContext* context_create(ASTNode* query_ast) {
     ctx->table_count = 0;
     ctx->outer_row = NULL;
     ctx->outer_table = NULL;
+    ctx->outer_columns_read = NULL;
     return ctx;
 }
 
@@ -34,6 +37,8 @@ void context_free(QueryContext* ctx) {
         csv_free(ctx->tables[i].table);
     }
     free(ctx->tables);
+    free_compiled_in_lists(ctx);
+    free_subquery_caches(ctx);
     free(ctx);
 }
 
@@ -66,6 +71,19 @@ TableRef* context_get_table(QueryContext* ctx, const char* alias) {
     return NULL;
 }
 
+/* look up a column of the outer query row, recording the read for subquery memoization */
+static Value* resolve_outer_column(QueryContext* ctx, const char* col_name) {
+    if (!ctx->outer_row || !ctx->outer_table) return NULL;
+    
+    int col_index = csv_get_column_index(ctx->outer_table, col_name);
+    if (col_index < 0) return NULL;
+    
+    if (ctx->outer_columns_read) {
+        ctx->outer_columns_read[col_index] = true;
+    }
+    return &ctx->outer_row->values[col_index];
+}
+
 /* function to resolve column by name */
 Value* resolve_column(QueryContext* ctx, const char* column_name, Row* current_row, int table_index) {
     if (!ctx || !column_name || !current_row) return NULL;
@@ -94,26 +112,14 @@ Value* resolve_column(QueryContext* ctx, const char* column_name, Row* current_r
         
         if (!table_ref) {
             // if not found in current query check if it's referencing outer table in correlated subquery
-            if (ctx->outer_row && ctx->outer_table) {
-                col_index = csv_get_column_index(ctx->outer_table, col_name);
-                if (col_index >= 0) {
-                    return &ctx->outer_row->values[col_index];
-                }
-            }
-            return NULL;
+            return resolve_outer_column(ctx, col_name);
         }
         
         // get column index
         col_index = csv_get_column_index(table_ref->table, col_name);
         if (col_index < 0) {
             // if not found in current query check outer context for correlated subquery
-            if (ctx->outer_row && ctx->outer_table) {
-                col_index = csv_get_column_index(ctx->outer_table, col_name);
-                if (col_index >= 0) {
-                    return &ctx->outer_row->values[col_index];
-                }
-            }
-            return NULL;
+            return resolve_outer_column(ctx, col_name);
         }
         
         return &current_row->values[col_index];
@@ -122,11 +128,9 @@ Value* resolve_column(QueryContext* ctx, const char* column_name, Row* current_r
         int col_index = csv_get_column_index(table, column_name);
         if (col_index < 0) {
             // if not found in current query check outer context for correlated subquery
-            if (ctx->outer_row && ctx->outer_table) {
-                col_index = csv_get_column_index(ctx->outer_table, column_name);
-                if (col_index >= 0) {
-                    return &ctx->outer_row->values[col_index];
-                }
+            Value* outer_value = resolve_outer_column(ctx, column_name);
+            if (outer_value) {
+                return outer_value;
             }
             
             // EXTENSION: if still not found, check if it's a SELECT alias (non-standard SQL)
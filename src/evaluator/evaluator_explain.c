@@ -0,0 +1,342 @@
+/* evaluator_explain.c - EXPLAIN output and EXPLAIN ANALYZE statistics */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include "evaluator.h"
+#include "parser.h"
+#include "parser/ast_nodes.h"
+#include "csv_reader.h"
+#include "evaluator/evaluator_plan.h"
+#include "profile.h"
+
+/* statistics */
+
+void plan_enable_stats(PlanNode* node) {
+    if (!node) return;
+    node->stats.enabled = true;
+    plan_enable_stats(node->input);
+    plan_enable_stats(node->right);
+}
+
+/* returns the start time to pass to plan_stats_finish, 0 when stats and tracing are off */
+double plan_stats_start(PlanNode* node) {
+    if (!node || (!node->stats.enabled && !profile_counters.tracing)) return 0;
+    return profile_clock_ms();
+}
+
+/* the operator also becomes a span in the --trace output */
+void plan_stats_finish(PlanNode* node, double start_ms, long long rows_in, long long rows_out) {
+    if (!node || (!node->stats.enabled && !profile_counters.tracing)) return;
+    double end_ms = profile_clock_ms();
+
+    if (profile_counters.tracing) {
+        profile_span("operator", plan_node_name(node->type),
+                     node->type == PLAN_SCAN ? node->alias : NULL, start_ms, end_ms);
+    }
+    if (!node->stats.enabled) return;
+
+    node->stats.executions++;
+    node->stats.elapsed_ms += end_ms - start_ms;
+    node->stats.rows_in += rows_in;
+    node->stats.rows_out += rows_out;
+    node->stats.peak_memory_kb = profile_peak_memory_kb();
+}
+
+/* text rendering */
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} TextBuffer;
+
+static void text_append(TextBuffer* text, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    va_list copy;
+    va_copy(copy, args);
+    int needed = vsnprintf(NULL, 0, format, copy);
+    va_end(copy);
+
+    if (needed > 0) {
+        if (text->length + needed + 1 > text->capacity) {
+            text->capacity = (text->length + needed + 1) * 2;
+            text->data = realloc(text->data, text->capacity);
+        }
+        vsnprintf(text->data + text->length, text->capacity - text->length, format, args);
+        text->length += needed;
+    }
+    va_end(args);
+}
+
+static void format_expression(TextBuffer* text, ASTNode* node);
+
+static void format_operand(TextBuffer* text, ASTNode* node) {
+    bool nested = node && (node->type == NODE_TYPE_BINARY_OP ||
+                           (node->type == NODE_TYPE_CONDITION &&
+                            (strcasecmp(node->condition.operator, "AND") == 0 ||
+                             strcasecmp(node->condition.operator, "OR") == 0)));
+    if (nested) text_append(text, "(");
+    format_expression(text, node);
+    if (nested) text_append(text, ")");
+}
+
+static void format_expression(TextBuffer* text, ASTNode* node) {
+    if (!node) return;
+
+    switch (node->type) {
+        case NODE_TYPE_LITERAL: {
+            Value value = parse_value(node->literal, strlen(node->literal));
+            bool numeric = value.type == VALUE_TYPE_INTEGER || value.type == VALUE_TYPE_DOUBLE;
+            value_free(&value);
+            if (numeric || strcmp(node->literal, "*") == 0) {
+                text_append(text, "%s", node->literal);
+            } else {
+                text_append(text, "'%s'", node->literal);
+            }
+            break;
+        }
+        case NODE_TYPE_IDENTIFIER:
+            text_append(text, "%s", node->identifier);
+            break;
+        case NODE_TYPE_BINARY_OP:
+            format_operand(text, node->binary_op.left);
+            text_append(text, " %s ", node->binary_op.operator);
+            format_operand(text, node->binary_op.right);
+            break;
+        case NODE_TYPE_CONDITION: {
+            const char* op = node->condition.operator;
+            if (strcasecmp(op, "NOT") == 0) {
+                text_append(text, "NOT (");
+                format_expression(text, node->condition.left);
+                text_append(text, ")");
+            } else if (strcasecmp(op, "IN") == 0 || strcasecmp(op, "NOT IN") == 0) {
+                format_operand(text, node->condition.left);
+                text_append(text, " %s (", op);
+                format_expression(text, node->condition.right);
+                text_append(text, ")");
+            } else {
+                format_operand(text, node->condition.left);
+                text_append(text, " %s ", op);
+                format_operand(text, node->condition.right);
+            }
+            break;
+        }
+        case NODE_TYPE_LIST:
+            for (int i = 0; i < node->list.node_count; i++) {
+                if (i > 0) text_append(text, ", ");
+                format_expression(text, node->list.nodes[i]);
+            }
+            break;
+        case NODE_TYPE_SUBQUERY:
+            text_append(text, "subquery");
+            break;
+        default: {
+            char name[256];
+            name[0] = '\0';
+            generate_column_name(node, name, sizeof(name));
+            text_append(text, "%s", name);
+            break;
+        }
+    }
+}
+
+static void format_predicates(TextBuffer* text, ASTNode** predicates, int count) {
+    for (int i = 0; i < count; i++) {
+        if (i > 0) text_append(text, " AND ");
+        format_operand(text, predicates[i]);
+    }
+}
+
+static const char* join_type_name(JoinType type) {
+    switch (type) {
+        case JOIN_TYPE_INNER: return "INNER";
+        case JOIN_TYPE_LEFT: return "LEFT";
+        case JOIN_TYPE_RIGHT: return "RIGHT";
+        case JOIN_TYPE_FULL: return "FULL";
+    }
+    return "INNER";
+}
+
+static const char* set_op_name(SetOpType type) {
+    switch (type) {
+        case SET_OP_UNION: return "Union (hash)";
+        case SET_OP_UNION_ALL: return "Union All";
+        case SET_OP_INTERSECT: return "Intersect (hash)";
+        case SET_OP_EXCEPT: return "Except (hash)";
+    }
+    return "SetOp";
+}
+
+static void describe_node(TextBuffer* text, PlanNode* node) {
+    ASTNode* query_ast = node->query;
+
+    switch (node->type) {
+        case PLAN_SCAN: {
+            ASTNode* source = node->source;
+            if (source && source->type == NODE_TYPE_JOIN) {
+                text_append(text, "Scan '%s'", source->join.table);
+            } else if (source && source->type == NODE_TYPE_FROM && source->from.table) {
+                text_append(text, "Scan '%s'", source->from.table);
+            } else {
+                text_append(text, "Scan subquery");
+            }
+            if (node->alias) text_append(text, " AS %s", node->alias);
+            if (node->predicate_count > 0) {
+                text_append(text, ", filter: ");
+                format_predicates(text, node->predicates, node->predicate_count);
+            }
+            if (node->referenced_columns) text_append(text, ", referenced columns only");
+            break;
+        }
+        case PLAN_JOIN: {
+            ASTNode* condition = node->join->join.condition;
+            JoinType join_type = node->join->join.join_type;
+            bool hashed = (join_type == JOIN_TYPE_INNER || join_type == JOIN_TYPE_LEFT) && condition &&
+                          condition->type == NODE_TYPE_CONDITION &&
+                          strcmp(condition->condition.operator, "=") == 0 &&
+                          condition->condition.left && condition->condition.left->type == NODE_TYPE_IDENTIFIER &&
+                          condition->condition.right && condition->condition.right->type == NODE_TYPE_IDENTIFIER;
+            text_append(text, "Join %s %s", join_type_name(join_type),
+                        hashed ? (node->build_left ? "hash (build left)" : "hash") : "nested loop");
+            if (condition) {
+                text_append(text, " ON ");
+                format_expression(text, condition);
+            } else {
+                text_append(text, ", cross product");
+            }
+            if (node->cost_based) text_append(text, ", order from table statistics");
+            break;
+        }
+        case PLAN_FILTER:
+            text_append(text, "Filter: ");
+            if (node->always_false) {
+                text_append(text, "always false");
+            } else {
+                format_predicates(text, node->predicates, node->predicate_count);
+            }
+            if (node->row_limit >= 0) text_append(text, ", stop after %d rows", node->row_limit);
+            break;
+        case PLAN_AGGREGATE: {
+            ASTNode* group_by = query_ast->query.group_by;
+            if (group_by && group_by->group_by.column_count > 0) {
+                text_append(text, "Aggregate GROUP BY ");
+                for (int i = 0; i < group_by->group_by.column_count; i++) {
+                    text_append(text, "%s%s", i > 0 ? ", " : "", group_by->group_by.columns[i]);
+                }
+                text_append(text, group_by->group_by.column_count > 1 ? " (composite string key" : " (string key");
+                text_append(text, ", linear group lookup)");
+            } else {
+                text_append(text, "Aggregate over all rows");
+            }
+            if (query_ast->query.having) {
+                text_append(text, ", having: ");
+                format_expression(text, query_ast->query.having);
+            }
+            break;
+        }
+        case PLAN_PROJECT: {
+            ASTNode* select_node = query_ast->query.select;
+            int count = select_node ? select_node->select.column_count : 0;
+            // a star stands for the columns of a table not read yet, it is shown as written
+            int stars = 0;
+            for (int i = 0; i < count; i++) {
+                const char* spec = select_node->select.columns[i];
+                size_t len = strlen(spec);
+                if (strcmp(spec, "*") == 0 || (len > 2 && strcmp(spec + len - 2, ".*") == 0)) {
+                    text_append(text, stars++ ? ", %s" : "Project %s", spec);
+                }
+            }
+            count -= stars;
+            if (stars == 0) {
+                text_append(text, "Project %d column%s", count, count == 1 ? "" : "s");
+            } else if (count > 0) {
+                text_append(text, " and %d column%s", count, count == 1 ? "" : "s");
+            }
+            if (node->row_limit >= 0) text_append(text, ", stop after %d rows", node->row_limit);
+            break;
+        }
+        case PLAN_SORT:
+            text_append(text, "Sort by %s%s", query_ast->query.order_by->order_by.column,
+                        query_ast->query.order_by->order_by.descending ? " DESC" : "");
+            break;
+        case PLAN_DISTINCT:
+            text_append(text, "Distinct (hash)");
+            break;
+        case PLAN_LIMIT:
+            if (node->limit >= 0) {
+                text_append(text, "Limit %d", node->limit);
+                if (node->offset > 0) text_append(text, " offset %d", node->offset);
+            } else {
+                text_append(text, "Offset %d", node->offset);
+            }
+            break;
+        case PLAN_SET_OP:
+            text_append(text, "%s", set_op_name(node->set_op));
+            break;
+    }
+}
+
+static void describe_stats(TextBuffer* text, PlanNode* node) {
+    PlanStats* stats = &node->stats;
+    if (stats->executions == 0) {
+        text_append(text, " (not executed)");
+        return;
+    }
+
+    text_append(text, " (time=%.3f ms, rows in=%lld out=%lld", stats->elapsed_ms, stats->rows_in, stats->rows_out);
+    if (stats->bytes_read > 0) text_append(text, ", read=%lld bytes", stats->bytes_read);
+    text_append(text, ", peak memory=%ld KB)", stats->peak_memory_kb);
+}
+
+static void add_line(ResultSet* result, const char* line) {
+    if (result->row_count >= result->row_capacity) {
+        result->row_capacity = result->row_capacity ? result->row_capacity * 2 : 16;
+        result->rows = realloc(result->rows, sizeof(Row) * result->row_capacity);
+    }
+    Row* row = &result->rows[result->row_count++];
+    row->column_count = 1;
+    row->values = malloc(sizeof(Value));
+    row->values[0].type = VALUE_TYPE_STRING;
+    row->values[0].string_value = strdup(line);
+}
+
+static void explain_node(ResultSet* result, PlanNode* node, int depth, bool analyze) {
+    if (!node) return;
+
+    TextBuffer text = {0};
+    text_append(&text, "%*s%s", depth * 2, "", depth > 0 ? "-> " : "");
+    describe_node(&text, node);
+    if (analyze) describe_stats(&text, node);
+    add_line(result, text.data);
+    free(text.data);
+
+    explain_node(result, node->input, depth + 1, analyze);
+    explain_node(result, node->right, depth + 1, analyze);
+}
+
+/* one row per operator, indented by depth, optionally annotated with runtime statistics */
+ResultSet* plan_explain(QueryPlan* plan, bool analyze) {
+    ResultSet* result = calloc(1, sizeof(ResultSet));
+    result->filename = strdup("query_result");
+    result->has_header = true;
+    result->delimiter = ',';
+    result->quote = '"';
+    result->column_count = 1;
+    result->columns = malloc(sizeof(Column));
+    result->columns[0].name = strdup("QUERY PLAN");
+    result->columns[0].inferred_type = VALUE_TYPE_STRING;
+
+    explain_node(result, plan->root, 0, analyze);
+
+    if (analyze) {
+        char line[128];
+        snprintf(line, sizeof(line), "Execution time: %.3f ms, peak memory: %ld KB",
+                 plan->execution_ms, profile_peak_memory_kb());
+        add_line(result, line);
+    }
+    return result;
+}
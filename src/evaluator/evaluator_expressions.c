@@ -9,6 +9,7 @@
 #include <strings.h>
 #include <ctype.h>
 #include <math.h>
+#include <limits.h>
 #include "evaluator.h"
 #include "parser.h"
 #include "csv_reader.h"
@@ -19,10 +20,32 @@
 #include "evaluator/evaluator_conditions.h"
 #include "evaluator/evaluator_utils.h"
 #include "evaluator/evaluator_internal.h"
+#include "evaluator/evaluator_subquery.h"
+#include "profile.h"
+
+/* exact + - * / on int64, false when the result does not fit or is not a whole number */
+static bool int_arithmetic(const char* op, long long left, long long right, long long* out) {
+    if (op[0] == '\0' || op[1] != '\0') return false;
+    
+    switch (op[0]) {
+        case '+':
+            return !__builtin_add_overflow(left, right, out);
+        case '-':
+            return !__builtin_sub_overflow(left, right, out);
+        case '*':
+            return !__builtin_mul_overflow(left, right, out);
+        case '/':
+            if (right == 0 || (left == LLONG_MIN && right == -1) || left % right != 0) return false;
+            *out = left / right;
+            return true;
+    }
+    return false;
+}
 
 Value evaluate_expression(QueryContext* ctx, ASTNode* expr, Row* current_row, int table_index) {
     Value result;
     result.type = VALUE_TYPE_NULL;
+    PROFILE_COUNT(expressions);
     
     if (!expr) return result;
     
@@ -47,24 +70,13 @@ Value evaluate_expression(QueryContext* ctx, ASTNode* expr, Row* current_row, in
             // IN operator handles multi-row subqueries separately in evaluate_condition
             if (!expr->subquery.query) break;
             
-            // pass the outer context for correlated subqueries
-            ResultSet* subquery_result = evaluate_query_internal(expr->subquery.query, 
-                current_row, ctx->tables[table_index].table);
-            
-            if (!subquery_result) break;
-            
-            // validation only in scalar context (not for IN operator)
-            // IN operator is handled separately and allows multi-row results
-            if (subquery_result->row_count != 1 || subquery_result->column_count != 1) {
-                // only report error if it's truly being used as scalar
-                // don't report for IN operator which is handled elsewhere
-                csv_free(subquery_result);
+            // pass the outer context for correlated subqueries, results are cached
+            // per query and only recomputed when an outer column they read changes
+            // a result without exactly one row and one column evaluates to NULL
+            if (!evaluate_scalar_subquery(ctx, expr->subquery.query, current_row,
+                                          ctx->tables[table_index].table, &result, NULL, NULL)) {
                 break;
             }
-            
-            // copy the single value from subquery result
-            value_deep_copy(&result, &subquery_result->rows[0].values[0]);
-            csv_free(subquery_result);
             return result;
         }
         
@@ -183,6 +195,16 @@ Value evaluate_expression(QueryContext* ctx, ASTNode* expr, Row* current_row, in
                 return result;
             }
             
+            // integer operands stay in int64 unless the result overflows or a quotient has a fraction
+            if (left_is_int && right_is_int) {
+                long long exact;
+                if (int_arithmetic(op, left_int, right_int, &exact)) {
+                    result.type = VALUE_TYPE_INTEGER;
+                    result.int_value = exact;
+                    return result;
+                }
+            }
+            
             // perform the operation
             double result_val = 0;
             long long result_int = 0;
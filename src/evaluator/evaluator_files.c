@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "evaluator.h"
+#include "parser.h"
+#include "csv_reader.h"
+#include "file_set.h"
+#include "evaluator/evaluator_files.h"
+#include "evaluator/evaluator_conditions.h"
+#include "evaluator/evaluator_aggregates.h"
+
+bool is_file_set_source(const char* table, int file_count) {
+    return file_count > 1 || (table && file_set_is_pattern(table));
+}
+
+/* true if every column of a condition is one of the partitions table, unqualified or under
+ * the scan alias; anything that might read a data column keeps the condition out */
+static bool names_only_partitions(ASTNode* node, CsvTable* partitions, const char* alias) {
+    if (!node) return true;
+
+    switch (node->type) {
+        case NODE_TYPE_LITERAL:
+            return true;
+        case NODE_TYPE_IDENTIFIER: {
+            const char* column = node->identifier;
+            const char* dot = strchr(column, '.');
+            if (dot) {
+                size_t len = dot - column;
+                if (strlen(alias) != len || strncasecmp(alias, column, len) != 0) return false;
+                column = dot + 1;
+            }
+            return csv_get_column_index(partitions, column) >= 0;
+        }
+        case NODE_TYPE_BINARY_OP:
+            return names_only_partitions(node->binary_op.left, partitions, alias) &&
+                   names_only_partitions(node->binary_op.right, partitions, alias);
+        case NODE_TYPE_CONDITION:
+            return names_only_partitions(node->condition.left, partitions, alias) &&
+                   names_only_partitions(node->condition.right, partitions, alias);
+        case NODE_TYPE_FUNCTION:
+            if (is_aggregate_function(node->function.name)) return false;
+            for (int i = 0; i < node->function.arg_count; i++) {
+                if (!names_only_partitions(node->function.args[i], partitions, alias)) return false;
+            }
+            return true;
+        case NODE_TYPE_LIST:
+            for (int i = 0; i < node->list.node_count; i++) {
+                if (!names_only_partitions(node->list.nodes[i], partitions, alias)) return false;
+            }
+            return true;
+        case NODE_TYPE_CASE:
+            if (!names_only_partitions(node->case_expr.case_expr, partitions, alias)) return false;
+            for (int i = 0; i < node->case_expr.when_count; i++) {
+                if (!names_only_partitions(node->case_expr.when_exprs[i], partitions, alias) ||
+                    !names_only_partitions(node->case_expr.then_exprs[i], partitions, alias)) {
+                    return false;
+                }
+            }
+            return names_only_partitions(node->case_expr.else_expr, partitions, alias);
+        default:
+            return false;
+    }
+}
+
+/* files of the set that can hold a row passing the conditions, NULL to keep them all */
+static bool* prune_files(QueryContext* ctx, const FileSet* set, const char* alias, ASTNode** conditions,
+                         int condition_count, bool file_column) {
+    if (condition_count == 0 || (set->partition_count == 0 && !file_column)) return NULL;
+
+    CsvTable* partitions = file_set_partitions(set, file_column);
+    ASTNode** usable = malloc(sizeof(ASTNode*) * condition_count);
+    int usable_count = 0;
+    for (int i = 0; i < condition_count; i++) {
+        if (names_only_partitions(conditions[i], partitions, alias)) usable[usable_count++] = conditions[i];
+    }
+
+    bool* keep = NULL;
+    if (usable_count > 0) {
+        int orig_table_count = ctx->table_count;
+        TableRef* orig_tables = ctx->tables;
+        TableRef partition_table = {.alias = strdup(alias), .table = partitions};
+        ctx->tables = &partition_table;
+        ctx->table_count = 1;
+
+        keep = malloc(sizeof(bool) * set->count);
+        int kept = 0;
+        for (int f = 0; f < set->count; f++) {
+            keep[f] = true;
+            for (int i = 0; i < usable_count && keep[f]; i++) {
+                keep[f] = evaluate_condition(ctx, usable[i], &partitions->rows[f], 0);
+            }
+            kept += keep[f];
+        }
+        // the conditions are evaluated again on the rows, one file still gives the columns
+        if (kept == 0 && set->count > 0) keep[0] = true;
+
+        free(partition_table.alias);
+        ctx->tables = orig_tables;
+        ctx->table_count = orig_table_count;
+    }
+    free(usable);
+    file_set_partitions_free(partitions);
+    return keep;
+}
+
+CsvTable* load_scan_table(QueryContext* ctx, const char* table, char** files, int file_count, const char* alias,
+                          ASTNode** conditions, int condition_count, bool file_column) {
+    CsvConfig config = global_csv_config;
+    config.arena = true;
+    if (!is_file_set_source(table, file_count)) return csv_load(table, config);
+
+    char* single[1] = {(char*)table};
+    FileSet* set = file_count > 1 ? file_set_expand(files, file_count) : file_set_expand(single, 1);
+    if (!set) return NULL;
+
+    bool* keep = prune_files(ctx, set, alias, conditions, condition_count, file_column);
+    CsvTable* loaded = file_set_load(set, keep, file_column, table, config);
+    free(keep);
+    file_set_free(set);
+    return loaded;
+}
@@ -4,6 +4,7 @@
 #include <strings.h>
 #include <ctype.h>
 #include <math.h>
+#include <limits.h>
 #include "evaluator.h"
 #include "evaluator/evaluator_functions.h"
 #include "utils.h"
@@ -443,50 +444,31 @@ Value evaluate_scalar_function(const char* func_name, Value* args, int arg_count
         return result;
     }
     
-    // DATE_ADD(date, interval, unit)
-    if (strcasecmp(func_name, "DATE_ADD") == 0 && arg_count >= 3) {
+    // DATE_ADD(date, interval, unit) and DATE_SUB(date, interval, unit)
+    bool date_sub = strcasecmp(func_name, "DATE_SUB") == 0;
+    if ((date_sub || strcasecmp(func_name, "DATE_ADD") == 0) && arg_count >= 3) {
         if (args[0].type == VALUE_TYPE_DATE && 
             args[1].type == VALUE_TYPE_INTEGER &&
             args[2].type == VALUE_TYPE_STRING) {
             
             DateValue date = args[0].date_value;
-            int interval = (int)args[1].int_value;
-            const char* unit = args[2].string_value;
-            
-            if (strcasecmp(unit, "DAYS") == 0 || strcasecmp(unit, "DAY") == 0) {
-                result.type = VALUE_TYPE_DATE;
-                result.date_value = date_add_days(date, interval);
-            } else if (strcasecmp(unit, "MONTHS") == 0 || strcasecmp(unit, "MONTH") == 0) {
-                result.type = VALUE_TYPE_DATE;
-                result.date_value = date_add_months(date, interval);
-            } else if (strcasecmp(unit, "YEARS") == 0 || strcasecmp(unit, "YEAR") == 0) {
-                result.type = VALUE_TYPE_DATE;
-                result.date_value = date_add_years(date, interval);
+            long long interval = args[1].int_value;
+            if (date_sub) {
+                // LLONG_MIN has no negation, it is out of range either way
+                interval = interval == LLONG_MIN ? LLONG_MAX : -interval;
             }
-        }
-        return result;
-    }
-    
-    // DATE_SUB(date, interval, unit)
-    if (strcasecmp(func_name, "DATE_SUB") == 0 && arg_count >= 3) {
-        if (args[0].type == VALUE_TYPE_DATE && 
-            args[1].type == VALUE_TYPE_INTEGER &&
-            args[2].type == VALUE_TYPE_STRING) {
-            
-            DateValue date = args[0].date_value;
-            int interval = -(int)args[1].int_value;  // negate for subtraction
             const char* unit = args[2].string_value;
             
+            // a result past the years a date holds is NULL
+            int ok = 0;
             if (strcasecmp(unit, "DAYS") == 0 || strcasecmp(unit, "DAY") == 0) {
-                result.type = VALUE_TYPE_DATE;
-                result.date_value = date_add_days(date, interval);
+                ok = date_add_days(date, interval, &result.date_value);
             } else if (strcasecmp(unit, "MONTHS") == 0 || strcasecmp(unit, "MONTH") == 0) {
-                result.type = VALUE_TYPE_DATE;
-                result.date_value = date_add_months(date, interval);
+                ok = date_add_months(date, interval, &result.date_value);
             } else if (strcasecmp(unit, "YEARS") == 0 || strcasecmp(unit, "YEAR") == 0) {
-                result.type = VALUE_TYPE_DATE;
-                result.date_value = date_add_years(date, interval);
+                ok = date_add_years(date, interval, &result.date_value);
             }
+            if (ok) result.type = VALUE_TYPE_DATE;
         }
         return result;
     }
@@ -0,0 +1,273 @@
+/* evaluator_hash.c - value and row hashing shared by DISTINCT, set operations and IN */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "csv_reader.h"
+#include "date_utils.h"
+#include "evaluator/evaluator_hash.h"
+#include "profile.h"
+
+/* per-type seeds so that e.g. NULL and integer 0 do not collide trivially */
+#define HASH_SEED_NULL    0x6a09e667f3bcc908ULL
+#define HASH_SEED_NUMERIC 0xbb67ae8584caa73bULL
+#define HASH_SEED_STRING  0x3c6ef372fe94f82bULL
+#define HASH_SEED_DATE    0xa54ff53a5f1d36f1ULL
+
+/* finalizer from splitmix64, spreads low-entropy integers over all bits */
+static uint64_t hash_mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/* FNV-1a over the string bytes */
+static uint64_t hash_string(const char* str) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    if (!str) return h;
+    for (const unsigned char* p = (const unsigned char*)str; *p; p++) {
+        h ^= *p;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+uint64_t value_hash(const Value* value) {
+    if (!value) return hash_mix(HASH_SEED_NULL);
+
+    switch (value->type) {
+        case VALUE_TYPE_NULL:
+            return hash_mix(HASH_SEED_NULL);
+        case VALUE_TYPE_INTEGER:
+            return hash_mix(HASH_SEED_NUMERIC ^ (uint64_t)value->int_value);
+        case VALUE_TYPE_DOUBLE: {
+            // value_compare treats 2 and 2.0 as equal, so integral doubles hash like integers;
+            // the range is checked first, the cast is undefined for NaN, inf and beyond 2^63
+            double d = value->double_value;
+            if (d >= -9.2e18 && d <= 9.2e18 && d == (double)(long long)d) {
+                return hash_mix(HASH_SEED_NUMERIC ^ (uint64_t)(long long)d);
+            }
+            uint64_t bits;
+            memcpy(&bits, &d, sizeof(bits));
+            return hash_mix(HASH_SEED_NUMERIC ^ bits);
+        }
+        case VALUE_TYPE_STRING:
+            return hash_mix(HASH_SEED_STRING ^ hash_string(value->string_value));
+        case VALUE_TYPE_DATE: {
+            return hash_mix(HASH_SEED_DATE ^ (uint64_t)(unsigned)date_key(value->date_value));
+        }
+    }
+    return 0;
+}
+
+uint64_t row_hash(const Row* row, int column_count) {
+    uint64_t h = 0x84222325cbf29ce4ULL;
+    for (int i = 0; i < column_count; i++) {
+        h = hash_mix(h ^ value_hash(&row->values[i])) + (uint64_t)i;
+    }
+    return h;
+}
+
+ValueClass value_class(const Value* value) {
+    switch (value->type) {
+        case VALUE_TYPE_INTEGER:
+        case VALUE_TYPE_DOUBLE:
+            return VALUE_CLASS_NUMERIC;
+        case VALUE_TYPE_STRING:
+            return VALUE_CLASS_STRING;
+        case VALUE_TYPE_DATE:
+            return VALUE_CLASS_DATE;
+        default:
+            return VALUE_CLASS_NONE;
+    }
+}
+
+/* equality matching value_hash: value_compare within one class only,
+ * since value_compare reports 0 for e.g. a string against a number */
+bool values_equal(const Value* a, const Value* b) {
+    if (value_class(a) != value_class(b)) {
+        return false;
+    }
+    return value_compare((Value*)a, (Value*)b) == 0;
+}
+
+/* check if two rows are equal (all values match) */
+bool rows_equal(const Row* row1, const Row* row2, int column_count) {
+    if (!row1 || !row2) return false;
+
+    for (int i = 0; i < column_count; i++) {
+        if (!values_equal(&row1->values[i], &row2->values[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* smallest power of two keeping the load factor under 1/2 */
+static int initial_capacity(int expected) {
+    int capacity = 16;
+    while (capacity < expected * 2) capacity *= 2;
+    return capacity;
+}
+
+/* ===== row hash set ===== */
+
+RowHashSet* row_hash_set_create(int column_count, int expected_rows) {
+    RowHashSet* set = calloc(1, sizeof(RowHashSet));
+    set->column_count = column_count;
+
+    int capacity = initial_capacity(expected_rows);
+    set->capacity = capacity;
+    set->entries = calloc(capacity, sizeof(RowHashEntry));
+    return set;
+}
+
+void row_hash_set_free(RowHashSet* set) {
+    if (!set) return;
+    free(set->entries);
+    free(set);
+}
+
+/* find slot holding an equal row or the empty slot where it would go */
+static int find_slot(RowHashEntry* entries, int capacity, uint64_t hash,
+                     const Row* row, int column_count) {
+    int mask = capacity - 1;
+    int slot = (int)(hash & (uint64_t)mask);
+
+    PROFILE_COUNT(hash_probes);
+    while (entries[slot].row) {
+        if (entries[slot].hash == hash && rows_equal(entries[slot].row, row, column_count)) {
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+        PROFILE_COUNT(hash_probes);
+    }
+    return slot;
+}
+
+static void row_set_grow(RowHashSet* set) {
+    int new_capacity = set->capacity * 2;
+    RowHashEntry* new_entries = calloc(new_capacity, sizeof(RowHashEntry));
+    int mask = new_capacity - 1;
+
+    for (int i = 0; i < set->capacity; i++) {
+        if (!set->entries[i].row) continue;
+        int slot = (int)(set->entries[i].hash & (uint64_t)mask);
+        while (new_entries[slot].row) slot = (slot + 1) & mask;
+        new_entries[slot] = set->entries[i];
+    }
+
+    free(set->entries);
+    set->entries = new_entries;
+    set->capacity = new_capacity;
+}
+
+bool row_hash_set_insert(RowHashSet* set, const Row* row) {
+    if (!set || !row) return false;
+
+    if ((set->count + 1) * 2 > set->capacity) {
+        row_set_grow(set);
+    }
+
+    uint64_t hash = row_hash(row, set->column_count);
+    int slot = find_slot(set->entries, set->capacity, hash, row, set->column_count);
+    if (set->entries[slot].row) {
+        return false;
+    }
+
+    set->entries[slot].hash = hash;
+    set->entries[slot].row = row;
+    set->count++;
+    return true;
+}
+
+bool row_hash_set_contains(const RowHashSet* set, const Row* row) {
+    if (!set || !row) return false;
+
+    uint64_t hash = row_hash(row, set->column_count);
+    int slot = find_slot(set->entries, set->capacity, hash, row, set->column_count);
+    return set->entries[slot].row != NULL;
+}
+
+/* ===== value hash set ===== */
+
+ValueHashSet* value_hash_set_create(int expected_values) {
+    ValueHashSet* set = calloc(1, sizeof(ValueHashSet));
+    set->capacity = initial_capacity(expected_values);
+    set->entries = calloc(set->capacity, sizeof(ValueHashEntry));
+    return set;
+}
+
+void value_hash_set_free(ValueHashSet* set) {
+    if (!set) return;
+    for (int i = 0; i < set->capacity; i++) {
+        if (set->entries[i].used) {
+            value_free(&set->entries[i].value);
+        }
+    }
+    free(set->entries);
+    free(set);
+}
+
+static int find_value_slot(ValueHashEntry* entries, int capacity, uint64_t hash, const Value* value) {
+    int mask = capacity - 1;
+    int slot = (int)(hash & (uint64_t)mask);
+
+    PROFILE_COUNT(hash_probes);
+    while (entries[slot].used) {
+        if (entries[slot].hash == hash && values_equal(&entries[slot].value, value)) {
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+        PROFILE_COUNT(hash_probes);
+    }
+    return slot;
+}
+
+static void value_set_grow(ValueHashSet* set) {
+    int new_capacity = set->capacity * 2;
+    ValueHashEntry* new_entries = calloc(new_capacity, sizeof(ValueHashEntry));
+    int mask = new_capacity - 1;
+
+    for (int i = 0; i < set->capacity; i++) {
+        if (!set->entries[i].used) continue;
+        int slot = (int)(set->entries[i].hash & (uint64_t)mask);
+        while (new_entries[slot].used) slot = (slot + 1) & mask;
+        new_entries[slot] = set->entries[i];
+    }
+
+    free(set->entries);
+    set->entries = new_entries;
+    set->capacity = new_capacity;
+}
+
+bool value_hash_set_add(ValueHashSet* set, const Value* value) {
+    if (!set || !value) return false;
+
+    if ((set->count + 1) * 2 > set->capacity) {
+        value_set_grow(set);
+    }
+
+    uint64_t hash = value_hash(value);
+    int slot = find_value_slot(set->entries, set->capacity, hash, value);
+    if (set->entries[slot].used) {
+        return false;
+    }
+
+    set->entries[slot].hash = hash;
+    set->entries[slot].value = value_copy(value);
+    set->entries[slot].used = true;
+    set->count++;
+    return true;
+}
+
+bool value_hash_set_contains(const ValueHashSet* set, const Value* value) {
+    if (!set || !value) return false;
+
+    uint64_t hash = value_hash(value);
+    int slot = find_value_slot(set->entries, set->capacity, hash, value);
+    return set->entries[slot].used;
+}
@@ -10,6 +10,9 @@
 #include "evaluator/evaluator_conditions.h"
 #include "evaluator/evaluator_utils.h"
 #include "evaluator/evaluator_internal.h"
+#include "evaluator/evaluator_hash.h"
+#include "evaluator/evaluator_files.h"
+#include "profile.h"
 
 /* helper to set values to NULL */
 static void set_null_values(Value* values, int start, int count) {
@@ -18,14 +21,44 @@ static void set_null_values(Value* values, int start, int count) {
     }
 }
 
+/* where joined rows go: appended to the result table, or pushed one at a time into a sink */
+typedef struct {
+    CsvTable* result;
+    RowSink* sink;
+    Row scratch;                // the row handed to the sink, refilled for every joined row
+    bool stopped;               // the sink asked for no more rows
+} JoinOutput;
+
 /* helper to create a joined row with allocated values */
-static Row* create_joined_row(CsvTable* result, int column_count) {
+static Row* create_joined_row(JoinOutput* output, int column_count) {
+    if (output->sink) return &output->scratch;
+    
+    CsvTable* result = output->result;
+    if (result->row_count >= result->row_capacity) {
+        result->row_capacity = result->row_capacity ? result->row_capacity * 2 : 64;
+        result->rows = realloc(result->rows, sizeof(Row) * result->row_capacity);
+    }
     Row* new_row = &result->rows[result->row_count++];
     new_row->column_count = column_count;
-    new_row->values = malloc(sizeof(Value) * column_count);
+    new_row->values = arena_alloc(result->arena, sizeof(Value) * column_count);
     return new_row;
 }
 
+/* cells of an arena backed input are shared, its arena moves into the result after the join;
+ * strings of other inputs are copied into the result arena. a sink only borrows the row, it
+ * can share every cell */
+static void copy_cell(JoinOutput* output, CsvTable* source, Value* dst, const Value* src) {
+    *dst = *src;
+    if (!output->sink && !source->arena && src->type == VALUE_TYPE_STRING && src->string_value) {
+        dst->string_value = arena_strdup(output->result->arena, src->string_value);
+    }
+}
+
+/* joined row filled in, hand it to the sink */
+static void finish_joined_row(JoinOutput* output) {
+    if (output->sink && !output->sink->row(output->sink, &output->scratch)) output->stopped = true;
+}
+
 /* helper to copy table columns to result with alias prefix */
 static void copy_columns_with_prefix(Column* dest, int dest_offset, CsvTable* table, const char* alias) {
     for (int i = 0; i < table->column_count; i++) {
@@ -59,89 +92,49 @@ static bool evaluate_join_condition(QueryContext* ctx, ASTNode* on_condition,
     return false;
 }
 
-/* simple JOIN implementation that creates a temporary joined table */
-static CsvTable* perform_join(QueryContext* ctx, CsvTable* left_table, const char* left_alias,
-                               CsvTable* right_table, const char* right_alias,
-                               ASTNode* on_condition, JoinType join_type) {
-    // create result table with combined columns
-    CsvTable* result = calloc(1, sizeof(CsvTable));
-    result->filename = strdup("joined_result");
-    result->has_header = true;
-    result->delimiter = ',';
-    
-    // combine column names with table prefixes
-    result->column_count = left_table->column_count + right_table->column_count;
-    result->columns = malloc(sizeof(Column) * result->column_count);
-    
-    copy_columns_with_prefix(result->columns, 0, left_table, left_alias);
-    copy_columns_with_prefix(result->columns, left_table->column_count, right_table, right_alias);
-    
-    // allocate rows
-    result->row_capacity = left_table->row_count * right_table->row_count;
-    result->rows = malloc(sizeof(Row) * result->row_capacity);
-    result->row_count = 0;
-    
-    // extend querycontext to include both tables temporarily for condition evaluation
-    int orig_table_count = ctx->table_count;
-    TableRef* orig_tables = ctx->tables;
-    
-    ctx->table_count = 2;
-    ctx->tables = malloc(sizeof(TableRef) * 2);
-    ctx->tables[0].alias = strdup(left_alias);
-    ctx->tables[0].table = left_table;
-    ctx->tables[1].alias = strdup(right_alias);
-    ctx->tables[1].table = right_table;
-    
-    // perform join
-    for (int l = 0; l < left_table->row_count; l++) {
+static void append_joined_row(JoinOutput* output, CsvTable* left_table, Row* left_row,
+                              CsvTable* right_table, Row* right_row) {
+    int left_columns = left_table->column_count;
+    int right_columns = right_table->column_count;
+    Row* new_row = create_joined_row(output, output->result->column_count);
+    if (left_row) {
+        for (int i = 0; i < left_columns; i++) copy_cell(output, left_table, &new_row->values[i], &left_row->values[i]);
+    } else {
+        set_null_values(new_row->values, 0, left_columns);
+    }
+    if (right_row) {
+        for (int i = 0; i < right_columns; i++) copy_cell(output, right_table, &new_row->values[left_columns + i], &right_row->values[i]);
+    } else {
+        set_null_values(new_row->values, left_columns, right_columns);
+    }
+    finish_joined_row(output);
+}
+
+/* compare every left row with every right row */
+static void nested_loop_join(QueryContext* ctx, JoinOutput* output, CsvTable* left_table, CsvTable* right_table,
+                             ASTNode* on_condition, JoinType join_type) {
+    for (int l = 0; l < left_table->row_count && !output->stopped; l++) {
         bool found_match = false;
         
-        for (int r = 0; r < right_table->row_count; r++) {
-            // create temporary combined row for condition evaluation
-            // for condition evaluation we need to check if rows match
-            
+        for (int r = 0; r < right_table->row_count && !output->stopped; r++) {
             bool matches = evaluate_join_condition(ctx, on_condition,
                                                     &left_table->rows[l], &right_table->rows[r]);
             
             if (matches || (join_type == JOIN_TYPE_INNER && on_condition == NULL)) {
                 found_match = true;
-                
-                // create combined row
-                Row* new_row = create_joined_row(result, result->column_count);
-                
-                // copy left table values
-                for (int i = 0; i < left_table->column_count; i++) {
-                    value_deep_copy(&new_row->values[i], &left_table->rows[l].values[i]);
-                }
-                
-                // copy right table values
-                for (int i = 0; i < right_table->column_count; i++) {
-                    value_deep_copy(&new_row->values[left_table->column_count + i], &right_table->rows[r].values[i]);
-                }
-                
-                if (result->row_count == 1) {
-                    // debug
-                }
+                append_joined_row(output, left_table, &left_table->rows[l], right_table, &right_table->rows[r]);
             }
         }
         
         // left/full join if no match found add left row with nulls for right
         if (!found_match && (join_type == JOIN_TYPE_LEFT || join_type == JOIN_TYPE_FULL)) {
-            Row* new_row = create_joined_row(result, result->column_count);
-            
-            // copy left table values
-            for (int i = 0; i < left_table->column_count; i++) {
-                value_deep_copy(&new_row->values[i], &left_table->rows[l].values[i]);
-            }
-            
-            // null values for right table
-            set_null_values(new_row->values, left_table->column_count, right_table->column_count);
+            append_joined_row(output, left_table, &left_table->rows[l], right_table, NULL);
         }
     }
     
     // right/full join: add unmatched rows from right table with nulls for left
     if (join_type == JOIN_TYPE_RIGHT || join_type == JOIN_TYPE_FULL) {
-        for (int r = 0; r < right_table->row_count; r++) {
+        for (int r = 0; r < right_table->row_count && !output->stopped; r++) {
             bool found_match = false;
             
             // check if this right row matched any left row
@@ -157,18 +150,195 @@ static CsvTable* perform_join(QueryContext* ctx, CsvTable* left_table, const cha
             
             // if no match add right row with nulls for left
             if (!found_match) {
-                Row* new_row = create_joined_row(result, result->column_count);
-                
-                // null values for left table
-                set_null_values(new_row->values, 0, left_table->column_count);
-                
-                // copy right table values
-                for (int i = 0; i < right_table->column_count; i++) {
-                    value_deep_copy(&new_row->values[left_table->column_count + i], &right_table->rows[r].values[i]);
-                }
+                append_joined_row(output, left_table, NULL, right_table, &right_table->rows[r]);
+            }
+        }
+    }
+}
+
+/* position of a join key column, resolved on the first row the way evaluate_join_condition does */
+static int join_key_position(QueryContext* ctx, const char* identifier, CsvTable* table, int table_index) {
+    Row* first = &table->rows[0];
+    Value* value = resolve_column(ctx, identifier, first, table_index);
+    if (!value || value < first->values || value >= first->values + first->column_count) return -1;
+    
+    int position = (int)(value - first->values);
+    for (int r = 0; r < table->row_count; r++) {
+        if (table->rows[r].column_count <= position) return -1;
+    }
+    return position;
+}
+
+/* a hash join applies to `a = b` over two columns holding one kind of value, value_compare
+ * reports 0 for e.g. a string against a number which hashing cannot reproduce */
+static bool equi_join_keys(QueryContext* ctx, ASTNode* on_condition, CsvTable* left_table,
+                           CsvTable* right_table, int* left_key, int* right_key) {
+    if (!on_condition || on_condition->type != NODE_TYPE_CONDITION ||
+        strcmp(on_condition->condition.operator, "=") != 0 ||
+        !on_condition->condition.left || on_condition->condition.left->type != NODE_TYPE_IDENTIFIER ||
+        !on_condition->condition.right || on_condition->condition.right->type != NODE_TYPE_IDENTIFIER) {
+        return false;
+    }
+    if (left_table->row_count == 0 || right_table->row_count == 0) return false;
+    
+    *left_key = join_key_position(ctx, on_condition->condition.left->identifier, left_table, 0);
+    *right_key = join_key_position(ctx, on_condition->condition.right->identifier, right_table, 1);
+    if (*left_key < 0 || *right_key < 0) return false;
+    
+    int classes = 0;
+    for (int r = 0; r < left_table->row_count; r++) {
+        classes |= value_class(&left_table->rows[r].values[*left_key]);
+    }
+    for (int r = 0; r < right_table->row_count; r++) {
+        classes |= value_class(&right_table->rows[r].values[*right_key]);
+    }
+    return (classes & (classes - 1)) == 0;
+}
+
+/* one slot per distinct key, rows with that key chained in table order */
+typedef struct {
+    uint64_t hash;
+    int first;                  // -1 marks an empty slot
+    int last;
+} JoinSlot;
+
+/* build a hash table on one side and probe it with the other, probing the left side keeps
+ * the nested loop output order */
+static void hash_join(JoinOutput* output, CsvTable* left_table, int left_key, CsvTable* right_table, int right_key,
+                      JoinType join_type, bool build_left) {
+    CsvTable* build = build_left ? left_table : right_table;
+    CsvTable* probe = build_left ? right_table : left_table;
+    int build_key = build_left ? left_key : right_key;
+    int probe_key = build_left ? right_key : left_key;
+    
+    int capacity = 16;
+    while (capacity < build->row_count * 2) capacity *= 2;
+    int mask = capacity - 1;
+    JoinSlot* slots = malloc(sizeof(JoinSlot) * capacity);
+    for (int i = 0; i < capacity; i++) slots[i].first = -1;
+    int* next = malloc(sizeof(int) * build->row_count);
+    
+    for (int b = 0; b < build->row_count; b++) {
+        Value* key = &build->rows[b].values[build_key];
+        uint64_t hash = value_hash(key);
+        int slot = (int)(hash & (uint64_t)mask);
+        PROFILE_COUNT(hash_probes);
+        while (slots[slot].first >= 0 &&
+               !(slots[slot].hash == hash && values_equal(&build->rows[slots[slot].first].values[build_key], key))) {
+            slot = (slot + 1) & mask;
+            PROFILE_COUNT(hash_probes);
+        }
+        next[b] = -1;
+        if (slots[slot].first < 0) {
+            slots[slot].hash = hash;
+            slots[slot].first = b;
+        } else {
+            next[slots[slot].last] = b;
+        }
+        slots[slot].last = b;
+    }
+    
+    if (!output->sink) {
+        CsvTable* result = output->result;
+        result->row_capacity = left_table->row_count > right_table->row_count ? left_table->row_count : right_table->row_count;
+        result->rows = malloc(sizeof(Row) * result->row_capacity);
+    }
+    
+    for (int p = 0; p < probe->row_count && !output->stopped; p++) {
+        Row* probe_row = &probe->rows[p];
+        Value* key = &probe_row->values[probe_key];
+        uint64_t hash = value_hash(key);
+        int slot = (int)(hash & (uint64_t)mask);
+        PROFILE_COUNT(hash_probes);
+        while (slots[slot].first >= 0 &&
+               !(slots[slot].hash == hash && values_equal(&build->rows[slots[slot].first].values[build_key], key))) {
+            slot = (slot + 1) & mask;
+            PROFILE_COUNT(hash_probes);
+        }
+        
+        if (slots[slot].first < 0) {
+            if (join_type == JOIN_TYPE_LEFT) {
+                append_joined_row(output, left_table, probe_row, right_table, NULL);
             }
+            continue;
+        }
+        for (int b = slots[slot].first; b >= 0 && !output->stopped; b = next[b]) {
+            Row* left_row = build_left ? &build->rows[b] : probe_row;
+            Row* right_row = build_left ? probe_row : &build->rows[b];
+            append_joined_row(output, left_table, left_row, right_table, right_row);
+        }
+    }
+    
+    free(next);
+    free(slots);
+}
+
+/* JOIN that creates a temporary joined table, equi-joins hash one side and any other
+ * condition is evaluated for every pair of rows. with a sink the joined rows are pushed into
+ * it as the probe finds them and the returned table only carries the columns */
+CsvTable* perform_join(QueryContext* ctx, CsvTable* left_table, const char* left_alias, bool left_is_joined,
+                       CsvTable* right_table, const char* right_alias,
+                       ASTNode* on_condition, JoinType join_type, bool build_left, RowSink* sink) {
+    // create result table with combined columns
+    CsvTable* result = calloc(1, sizeof(CsvTable));
+    result->filename = strdup("joined_result");
+    result->arena = arena_create();
+    result->has_header = true;
+    result->delimiter = ',';
+    
+    // combine column names with table prefixes
+    result->column_count = left_table->column_count + right_table->column_count;
+    result->columns = malloc(sizeof(Column) * result->column_count);
+    
+    // columns of an earlier join already carry their table prefix
+    if (left_is_joined) {
+        for (int i = 0; i < left_table->column_count; i++) {
+            result->columns[i].name = strdup(left_table->columns[i].name);
+            result->columns[i].inferred_type = left_table->columns[i].inferred_type;
         }
+    } else {
+        copy_columns_with_prefix(result->columns, 0, left_table, left_alias);
     }
+    copy_columns_with_prefix(result->columns, left_table->column_count, right_table, right_alias);
+    
+    result->row_count = 0;
+    
+    JoinOutput output = {.result = result, .sink = sink};
+    if (sink) {
+        output.scratch.column_count = result->column_count;
+        output.scratch.values = malloc(sizeof(Value) * (result->column_count > 0 ? result->column_count : 1));
+        sink->begin(sink, result->columns, result->column_count);
+    }
+    
+    // extend querycontext to include both tables temporarily for condition evaluation
+    int orig_table_count = ctx->table_count;
+    TableRef* orig_tables = ctx->tables;
+    
+    ctx->table_count = 2;
+    ctx->tables = malloc(sizeof(TableRef) * 2);
+    ctx->tables[0].alias = strdup(left_alias);
+    ctx->tables[0].table = left_table;
+    ctx->tables[1].alias = strdup(right_alias);
+    ctx->tables[1].table = right_table;
+    
+    int left_key = -1;
+    int right_key = -1;
+    if ((join_type == JOIN_TYPE_INNER || join_type == JOIN_TYPE_LEFT) &&
+        equi_join_keys(ctx, on_condition, left_table, right_table, &left_key, &right_key)) {
+        // unmatched left rows of a LEFT JOIN are found by probing with the left side
+        hash_join(&output, left_table, left_key, right_table, right_key, join_type,
+                  build_left && join_type == JOIN_TYPE_INNER);
+    } else {
+        // allocate rows
+        if (!sink) {
+            result->row_capacity = left_table->row_count * right_table->row_count;
+            result->rows = malloc(sizeof(Row) * result->row_capacity);
+        }
+        nested_loop_join(ctx, &output, left_table, right_table, on_condition, join_type);
+    }
+    free(output.scratch.values);
+    arena_absorb(result->arena, left_table->arena);
+    arena_absorb(result->arena, right_table->arena);
     
     // restore original context
     free(ctx->tables[0].alias);
@@ -182,8 +352,6 @@ static CsvTable* perform_join(QueryContext* ctx, CsvTable* left_table, const cha
 
 /* load table from FROM clause */
 CsvTable* load_from_table(ASTNode* from_clause, const char** out_alias, QueryContext* ctx) {
-    (void)ctx; // unused parameter kept for future extensions
-    
     if (!from_clause || from_clause->type != NODE_TYPE_FROM) {
         fprintf(stderr, "Error: FROM clause is required\n");
         return NULL;
@@ -216,7 +384,8 @@ CsvTable* load_from_table(ASTNode* from_clause, const char** out_alias, QueryCon
         table_alias = from_clause->from.alias ? from_clause->from.alias : "subquery";
     } else if (from_clause->from.table) {
         const char* filename = from_clause->from.table;
-        source_table = csv_load(filename, global_csv_config);
+        source_table = load_scan_table(ctx, filename, from_clause->from.files, from_clause->from.file_count,
+                                       from_clause->from.alias ? from_clause->from.alias : "main", NULL, 0, false);
         
         if (!source_table) {
             fprintf(stderr, "Failed to load table from '%s'\n", filename);
@@ -232,43 +401,3 @@ CsvTable* load_from_table(ASTNode* from_clause, const char** out_alias, QueryCon
     *out_alias = table_alias;
     return source_table;
 }
-
-/* process all JOIN clauses */
-CsvTable* process_joins(ASTNode* query_ast, QueryContext* ctx, CsvTable* base_table, const char* base_alias) {
-    if (query_ast->query.join_count == 0) {
-        return base_table;
-    }
-    
-    CsvTable* working_table = base_table;
-    const char* working_alias = base_alias;
-    bool joined = false;
-    
-    for (int j = 0; j < query_ast->query.join_count; j++) {
-        ASTNode* join_node = query_ast->query.joins[j];
-        if (join_node->type != NODE_TYPE_JOIN) continue;
-        
-        CsvTable* right_table = csv_load(join_node->join.table, global_csv_config);
-        if (!right_table) {
-            fprintf(stderr, "Failed to load join table from '%s'\n", join_node->join.table);
-            continue;
-        }
-        
-        const char* right_alias = join_node->join.alias ? join_node->join.alias : "right";
-        
-        CsvTable* joined_table = perform_join(ctx, working_table, working_alias,
-                                               right_table, right_alias,
-                                               join_node->join.condition,
-                                               join_node->join.join_type);
-        
-        if (joined) {
-            csv_free(working_table);
-        }
-        csv_free(right_table);
-        
-        working_table = joined_table;
-        working_alias = "joined";
-        joined = true;
-    }
-    
-    return joined ? working_table : base_table;
-}
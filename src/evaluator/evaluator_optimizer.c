@@ -0,0 +1,783 @@
+/* evaluator_optimizer.c - rule based rewrites of the logical plan
+ *
+ * rules run once per query, in this order:
+ *   constant folding   literal subexpressions of WHERE are evaluated once,
+ *                      constant conjuncts are dropped or mark the filter always false
+ *   predicate pushdown conjuncts over a single joined table move to its scan
+ *   join reordering    equi-join chains put filtered tables first when row order
+ *                      is not observable (ORDER BY or a single aggregate row)
+ *   projection pruning scans below joins drop columns the query never names
+ *   file sets          scans of several files get the filter for partition pruning and
+ *                      add the file column when the query names it
+ *   limit pushdown     a LIMIT without sort, aggregate or distinct stops filtering early */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <limits.h>
+#include <math.h>
+#include "evaluator.h"
+#include "parser.h"
+#include "parser/ast_nodes.h"
+#include "csv_reader.h"
+#include "file_set.h"
+#include "evaluator/evaluator_plan.h"
+#include "evaluator/evaluator_files.h"
+#include "evaluator/evaluator_aggregates.h"
+#include "evaluator/evaluator_conditions.h"
+#include "evaluator/evaluator_expressions.h"
+
+/* constant folding */
+
+static bool is_literal(ASTNode* node) {
+    return node && node->type == NODE_TYPE_LITERAL && node->literal && strcmp(node->literal, "*") != 0;
+}
+
+/* literal text for a value, NULL unless it parses back to exactly the same value */
+static char* value_to_literal(Value* value) {
+    char buf[64];
+    char* text = NULL;
+
+    switch (value->type) {
+        case VALUE_TYPE_INTEGER:
+            snprintf(buf, sizeof(buf), "%lld", value->int_value);
+            text = strdup(buf);
+            break;
+        case VALUE_TYPE_DOUBLE:
+            if (!isfinite(value->double_value)) return NULL;
+            snprintf(buf, sizeof(buf), "%.17g", value->double_value);
+            if (!strpbrk(buf, ".eE")) strcat(buf, ".0");
+            text = strdup(buf);
+            break;
+        case VALUE_TYPE_DATE:
+            snprintf(buf, sizeof(buf), "%04d-%02d-%02d",
+                     value->date_value.year, value->date_value.month, value->date_value.day);
+            text = strdup(buf);
+            break;
+        case VALUE_TYPE_STRING:
+            if (!value->string_value) return NULL;
+            text = strdup(value->string_value);
+            break;
+        case VALUE_TYPE_NULL:
+            return NULL;
+    }
+
+    Value parsed = parse_value(text, strlen(text));
+    bool same = parsed.type == value->type;
+    if (same) {
+        switch (value->type) {
+            case VALUE_TYPE_DOUBLE:
+                same = parsed.double_value == value->double_value;
+                break;
+            case VALUE_TYPE_STRING:
+                same = strcmp(parsed.string_value, value->string_value) == 0;
+                break;
+            default:
+                same = value_compare(&parsed, value) == 0;
+                break;
+        }
+    }
+    value_free(&parsed);
+
+    if (!same) {
+        free(text);
+        return NULL;
+    }
+    return text;
+}
+
+/* evaluate an expression over literals, NULL if the result has no literal form */
+static ASTNode* fold_constant(QueryContext* scratch, ASTNode* expr) {
+    Value value = evaluate_expression(scratch, expr, NULL, 0);
+    char* text = value_to_literal(&value);
+    value_free(&value);
+    if (!text) return NULL;
+
+    ASTNode* literal = create_literal_node(text);
+    free(text);
+    return literal;
+}
+
+/* returns a new reference, either expr itself or a rewritten copy */
+static ASTNode* fold_expression(QueryContext* scratch, ASTNode* expr) {
+    if (!expr) return NULL;
+
+    if (expr->type == NODE_TYPE_BINARY_OP) {
+        ASTNode* left = fold_expression(scratch, expr->binary_op.left);
+        ASTNode* right = fold_expression(scratch, expr->binary_op.right);
+
+        ASTNode* node;
+        if (left == expr->binary_op.left && right == expr->binary_op.right) {
+            releaseNode(left);
+            releaseNode(right);
+            retainNode(expr);
+            node = expr;
+        } else {
+            node = create_binary_op_node(left, expr->binary_op.operator, right);
+        }
+
+        if (is_literal(left) && is_literal(right)) {
+            ASTNode* folded = fold_constant(scratch, node);
+            if (folded) {
+                releaseNode(node);
+                return folded;
+            }
+        }
+        return node;
+    }
+
+    if (expr->type == NODE_TYPE_FUNCTION && !is_aggregate_function(expr->function.name)) {
+        int arg_count = expr->function.arg_count;
+        ASTNode** args = arg_count > 0 ? malloc(sizeof(ASTNode*) * arg_count) : NULL;
+        bool changed = false;
+        bool all_literal = true;
+
+        for (int i = 0; i < arg_count; i++) {
+            args[i] = fold_expression(scratch, expr->function.args[i]);
+            if (args[i] != expr->function.args[i]) changed = true;
+            if (!is_literal(args[i])) all_literal = false;
+        }
+
+        ASTNode* node;
+        if (changed) {
+            node = create_node(NODE_TYPE_FUNCTION);
+            node->function.name = strdup(expr->function.name);
+            node->function.args = args;
+            node->function.arg_count = arg_count;
+        } else {
+            for (int i = 0; i < arg_count; i++) {
+                releaseNode(args[i]);
+            }
+            free(args);
+            retainNode(expr);
+            node = expr;
+        }
+
+        if (all_literal) {
+            ASTNode* folded = fold_constant(scratch, node);
+            if (folded) {
+                releaseNode(node);
+                return folded;
+            }
+        }
+        return node;
+    }
+
+    retainNode(expr);
+    return expr;
+}
+
+/* fold the operands of a condition, returns a new reference */
+static ASTNode* fold_condition(QueryContext* scratch, ASTNode* condition) {
+    if (!condition || condition->type != NODE_TYPE_CONDITION) {
+        if (condition) retainNode(condition);
+        return condition;
+    }
+
+    const char* op = condition->condition.operator;
+    ASTNode* left;
+    ASTNode* right;
+
+    if (strcasecmp(op, "AND") == 0 || strcasecmp(op, "OR") == 0 || strcasecmp(op, "NOT") == 0) {
+        left = fold_condition(scratch, condition->condition.left);
+        right = fold_condition(scratch, condition->condition.right);
+    } else if (strcasecmp(op, "IN") == 0 || strcasecmp(op, "NOT IN") == 0) {
+        // the list side is already materialized once per query
+        left = fold_expression(scratch, condition->condition.left);
+        right = condition->condition.right;
+        if (right) retainNode(right);
+    } else {
+        left = fold_expression(scratch, condition->condition.left);
+        right = fold_expression(scratch, condition->condition.right);
+    }
+
+    if (left == condition->condition.left && right == condition->condition.right) {
+        releaseNode(left);
+        releaseNode(right);
+        retainNode(condition);
+        return condition;
+    }
+    return create_condition_node(left, op, right);
+}
+
+/* true when the node reads no column, subquery or aggregate */
+static bool is_constant_node(ASTNode* node) {
+    if (!node) return true;
+
+    switch (node->type) {
+        case NODE_TYPE_LITERAL:
+            return true;
+        case NODE_TYPE_BINARY_OP:
+            return is_constant_node(node->binary_op.left) && is_constant_node(node->binary_op.right);
+        case NODE_TYPE_CONDITION:
+            return is_constant_node(node->condition.left) && is_constant_node(node->condition.right);
+        case NODE_TYPE_FUNCTION:
+            if (is_aggregate_function(node->function.name)) return false;
+            for (int i = 0; i < node->function.arg_count; i++) {
+                if (!is_constant_node(node->function.args[i])) return false;
+            }
+            return true;
+        case NODE_TYPE_LIST:
+            for (int i = 0; i < node->list.node_count; i++) {
+                if (!is_constant_node(node->list.nodes[i])) return false;
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void fold_filter_constants(QueryContext* scratch, PlanNode* filter) {
+    int kept = 0;
+
+    for (int i = 0; i < filter->predicate_count; i++) {
+        ASTNode* original = filter->predicates[i];
+        ASTNode* folded = fold_condition(scratch, original);
+        releaseNode(original);
+
+        if (is_constant_node(folded)) {
+            if (evaluate_condition(scratch, folded, NULL, 0)) {
+                // always true, nothing to check per row
+                releaseNode(folded);
+                continue;
+            }
+            filter->always_false = true;
+        }
+        filter->predicates[kept++] = folded;
+    }
+    filter->predicate_count = kept;
+}
+
+/* predicate pushdown */
+
+/* table alias every identifier is qualified with, false if the node cannot be pushed */
+static bool find_single_qualifier(ASTNode* node, const char** alias, size_t* alias_len) {
+    if (!node) return true;
+
+    switch (node->type) {
+        case NODE_TYPE_LITERAL:
+            return true;
+        case NODE_TYPE_IDENTIFIER: {
+            const char* dot = strchr(node->identifier, '.');
+            if (!dot) return false;
+            size_t len = dot - node->identifier;
+            if (!*alias) {
+                *alias = node->identifier;
+                *alias_len = len;
+                return true;
+            }
+            return len == *alias_len && strncasecmp(*alias, node->identifier, len) == 0;
+        }
+        case NODE_TYPE_BINARY_OP:
+            return find_single_qualifier(node->binary_op.left, alias, alias_len) &&
+                   find_single_qualifier(node->binary_op.right, alias, alias_len);
+        case NODE_TYPE_CONDITION:
+            return find_single_qualifier(node->condition.left, alias, alias_len) &&
+                   find_single_qualifier(node->condition.right, alias, alias_len);
+        case NODE_TYPE_FUNCTION:
+            if (is_aggregate_function(node->function.name)) return false;
+            for (int i = 0; i < node->function.arg_count; i++) {
+                if (!find_single_qualifier(node->function.args[i], alias, alias_len)) return false;
+            }
+            return true;
+        case NODE_TYPE_LIST:
+            for (int i = 0; i < node->list.node_count; i++) {
+                if (!find_single_qualifier(node->list.nodes[i], alias, alias_len)) return false;
+            }
+            return true;
+        case NODE_TYPE_CASE:
+            if (!find_single_qualifier(node->case_expr.case_expr, alias, alias_len)) return false;
+            for (int i = 0; i < node->case_expr.when_count; i++) {
+                if (!find_single_qualifier(node->case_expr.when_exprs[i], alias, alias_len) ||
+                    !find_single_qualifier(node->case_expr.then_exprs[i], alias, alias_len)) {
+                    return false;
+                }
+            }
+            return find_single_qualifier(node->case_expr.else_expr, alias, alias_len);
+        default:
+            // subqueries and window functions stay above the joins
+            return false;
+    }
+}
+
+/* joins of a relation from the bottom up, returns the count */
+static int collect_joins(PlanNode* relation, PlanNode*** joins) {
+    int count = 0;
+    for (PlanNode* node = relation; node && node->type == PLAN_JOIN; node = node->input) {
+        count++;
+    }
+
+    *joins = count > 0 ? malloc(sizeof(PlanNode*) * count) : NULL;
+    int i = count;
+    for (PlanNode* node = relation; node && node->type == PLAN_JOIN; node = node->input) {
+        (*joins)[--i] = node;
+    }
+    return count;
+}
+
+static PlanNode* base_scan(PlanNode* relation) {
+    PlanNode* node = relation;
+    while (node && node->type == PLAN_JOIN) node = node->input;
+    return node;
+}
+
+/* scan visible under the alias, NULL if no scan or more than one uses it */
+static PlanNode* find_scan_by_alias(PlanNode* relation, const char* alias, size_t alias_len) {
+    PlanNode* found = NULL;
+    for (PlanNode* node = relation; node; node = node->input) {
+        PlanNode* scan = node->type == PLAN_JOIN ? node->right : node;
+        if (scan->type == PLAN_SCAN && scan->alias && strlen(scan->alias) == alias_len &&
+            strncasecmp(scan->alias, alias, alias_len) == 0) {
+            if (found) return NULL;
+            found = scan;
+        }
+        if (node->type != PLAN_JOIN) break;
+    }
+    return found;
+}
+
+/* a filter below an outer join must not remove rows the join would null extend */
+static bool can_push_to_scan(PlanNode** joins, int join_count, PlanNode* scan) {
+    int first_above = 0;
+
+    if (scan->table_index > 0) {
+        for (first_above = 0; first_above < join_count; first_above++) {
+            if (joins[first_above]->right == scan) break;
+        }
+        if (first_above == join_count) return false;
+
+        JoinType type = joins[first_above]->join->join.join_type;
+        if (type != JOIN_TYPE_INNER && type != JOIN_TYPE_RIGHT) return false;
+        first_above++;
+    }
+
+    // the scan is on the preserved left side of every join above it
+    for (int j = first_above; j < join_count; j++) {
+        JoinType type = joins[j]->join->join.join_type;
+        if (type != JOIN_TYPE_INNER && type != JOIN_TYPE_LEFT) return false;
+    }
+    return true;
+}
+
+static void push_down_predicates(PlanNode* filter) {
+    PlanNode** joins = NULL;
+    int join_count = collect_joins(filter->input, &joins);
+    if (join_count == 0 || filter->always_false) {
+        free(joins);
+        return;
+    }
+
+    int kept = 0;
+    for (int i = 0; i < filter->predicate_count; i++) {
+        ASTNode* predicate = filter->predicates[i];
+        const char* alias = NULL;
+        size_t alias_len = 0;
+
+        PlanNode* scan = NULL;
+        if (find_single_qualifier(predicate, &alias, &alias_len) && alias) {
+            scan = find_scan_by_alias(filter->input, alias, alias_len);
+        }
+
+        if (scan && can_push_to_scan(joins, join_count, scan)) {
+            plan_add_predicate(scan, predicate);
+            releaseNode(predicate);
+            continue;
+        }
+        filter->predicates[kept++] = predicate;
+    }
+    filter->predicate_count = kept;
+    free(joins);
+}
+
+/* join reordering */
+
+static bool alias_matches(const char* qualified, const char* alias) {
+    const char* dot = strchr(qualified, '.');
+    if (!dot || !alias) return false;
+    size_t len = dot - qualified;
+    return strlen(alias) == len && strncasecmp(qualified, alias, len) == 0;
+}
+
+static bool alias_is_placed(const char* qualified, PlanNode** placed, int placed_count) {
+    for (int i = 0; i < placed_count; i++) {
+        if (alias_matches(qualified, placed[i]->alias)) return true;
+    }
+    return false;
+}
+
+/* inner equi-join whose left column comes from a table joined earlier */
+static bool is_reorderable_join(PlanNode* join) {
+    ASTNode* on = join->join->join.condition;
+    if (join->join->join.join_type != JOIN_TYPE_INNER || !on) return false;
+    if (on->type != NODE_TYPE_CONDITION || strcmp(on->condition.operator, "=") != 0) return false;
+    if (!on->condition.left || on->condition.left->type != NODE_TYPE_IDENTIFIER) return false;
+    if (!on->condition.right || on->condition.right->type != NODE_TYPE_IDENTIFIER) return false;
+    return alias_matches(on->condition.right->identifier, join->right->alias);
+}
+
+/* returns the new top of the join chain; the order here only uses pushed predicates,
+ * the executor refines it from table statistics once the scans are loaded */
+static PlanNode* reorder_joins(PlanNode* relation) {
+    PlanNode** joins = NULL;
+    int join_count = collect_joins(relation, &joins);
+    if (join_count <= 0) {
+        free(joins);
+        return relation;
+    }
+
+    PlanNode* base = base_scan(relation);
+    if (!base->alias) {
+        free(joins);
+        return relation;
+    }
+
+    for (int j = 0; j < join_count; j++) {
+        if (!is_reorderable_join(joins[j]) || !joins[j]->right->alias ||
+            find_scan_by_alias(relation, joins[j]->right->alias, strlen(joins[j]->right->alias)) != joins[j]->right) {
+            free(joins);
+            return relation;
+        }
+    }
+    if (!find_scan_by_alias(relation, base->alias, strlen(base->alias))) {
+        free(joins);
+        return relation;
+    }
+
+    // greedy: among joins whose left side is available, filtered tables first
+    PlanNode** placed = malloc(sizeof(PlanNode*) * (join_count + 1));
+    PlanNode** order = malloc(sizeof(PlanNode*) * join_count);
+    bool* used = calloc(join_count, sizeof(bool));
+    int placed_count = 0;
+    placed[placed_count++] = base;
+
+    bool complete = true;
+    for (int step = 0; step < join_count; step++) {
+        int pick = -1;
+        for (int j = 0; j < join_count; j++) {
+            if (used[j]) continue;
+            const char* left = joins[j]->join->join.condition->condition.left->identifier;
+            if (!alias_is_placed(left, placed, placed_count)) continue;
+            if (pick < 0) pick = j;
+            if (joins[j]->right->predicate_count > 0) {
+                pick = j;
+                break;
+            }
+        }
+        if (pick < 0) {
+            complete = false;
+            break;
+        }
+        used[pick] = true;
+        order[step] = joins[pick];
+        placed[placed_count++] = joins[pick]->right;
+    }
+
+    PlanNode* top = relation;
+    if (complete) {
+        PlanNode* input = base;
+        for (int step = 0; step < join_count; step++) {
+            order[step]->input = input;
+            input = order[step];
+        }
+        top = input;
+        top->cost_based = true;
+    }
+
+    free(used);
+    free(order);
+    free(placed);
+    free(joins);
+    return top;
+}
+
+/* projection pruning */
+
+typedef struct {
+    char** names;
+    int count;
+    int capacity;
+} ReferenceList;
+
+static void add_reference(ReferenceList* refs, const char* name, size_t len) {
+    if (len == 0) return;
+    if (refs->count >= refs->capacity) {
+        refs->capacity = refs->capacity ? refs->capacity * 2 : 16;
+        refs->names = realloc(refs->names, sizeof(char*) * refs->capacity);
+    }
+    refs->names[refs->count] = malloc(len + 1);
+    memcpy(refs->names[refs->count], name, len);
+    refs->names[refs->count][len] = '\0';
+    refs->count++;
+}
+
+/* column specs are still evaluated from their text, keep every word they contain */
+static void add_words(ReferenceList* refs, const char* text) {
+    if (!text) return;
+    const char* p = text;
+    while (*p) {
+        if (isalnum((unsigned char)*p) || *p == '_' || *p == '.') {
+            const char* start = p;
+            while (*p && (isalnum((unsigned char)*p) || *p == '_' || *p == '.')) p++;
+            add_reference(refs, start, p - start);
+        } else {
+            p++;
+        }
+    }
+}
+
+static void collect_references(ASTNode* node, ReferenceList* refs) {
+    if (!node) return;
+
+    switch (node->type) {
+        case NODE_TYPE_IDENTIFIER:
+            if (node->identifier) add_reference(refs, node->identifier, strlen(node->identifier));
+            break;
+        case NODE_TYPE_QUERY:
+            collect_references(node->query.select, refs);
+            collect_references(node->query.from, refs);
+            for (int i = 0; i < node->query.join_count; i++) {
+                collect_references(node->query.joins[i], refs);
+            }
+            collect_references(node->query.where, refs);
+            collect_references(node->query.group_by, refs);
+            collect_references(node->query.having, refs);
+            collect_references(node->query.order_by, refs);
+            break;
+        case NODE_TYPE_SELECT:
+            for (int i = 0; i < node->select.column_count; i++) {
+                add_words(refs, node->select.columns[i]);
+                if (node->select.column_nodes) collect_references(node->select.column_nodes[i], refs);
+            }
+            break;
+        case NODE_TYPE_FROM:
+            collect_references(node->from.subquery, refs);
+            break;
+        case NODE_TYPE_JOIN:
+            collect_references(node->join.condition, refs);
+            break;
+        case NODE_TYPE_GROUP_BY:
+            for (int i = 0; i < node->group_by.column_count; i++) {
+                add_words(refs, node->group_by.columns[i]);
+            }
+            break;
+        case NODE_TYPE_ORDER_BY:
+            add_words(refs, node->order_by.column);
+            break;
+        case NODE_TYPE_CONDITION:
+            collect_references(node->condition.left, refs);
+            collect_references(node->condition.right, refs);
+            break;
+        case NODE_TYPE_BINARY_OP:
+            collect_references(node->binary_op.left, refs);
+            collect_references(node->binary_op.right, refs);
+            break;
+        case NODE_TYPE_FUNCTION:
+            for (int i = 0; i < node->function.arg_count; i++) {
+                collect_references(node->function.args[i], refs);
+            }
+            break;
+        case NODE_TYPE_WINDOW_FUNCTION:
+            for (int i = 0; i < node->window_function.arg_count; i++) {
+                collect_references(node->window_function.args[i], refs);
+            }
+            for (int i = 0; i < node->window_function.partition_count; i++) {
+                add_words(refs, node->window_function.partition_by[i]);
+            }
+            add_words(refs, node->window_function.order_by_column);
+            break;
+        case NODE_TYPE_LIST:
+            for (int i = 0; i < node->list.node_count; i++) {
+                collect_references(node->list.nodes[i], refs);
+            }
+            break;
+        case NODE_TYPE_SUBQUERY:
+            collect_references(node->subquery.query, refs);
+            break;
+        case NODE_TYPE_SET_OP:
+            collect_references(node->set_op.left, refs);
+            collect_references(node->set_op.right, refs);
+            break;
+        case NODE_TYPE_CASE:
+            collect_references(node->case_expr.case_expr, refs);
+            for (int i = 0; i < node->case_expr.when_count; i++) {
+                collect_references(node->case_expr.when_exprs[i], refs);
+                collect_references(node->case_expr.then_exprs[i], refs);
+            }
+            collect_references(node->case_expr.else_expr, refs);
+            break;
+        default:
+            break;
+    }
+}
+
+static bool selects_all_columns(ASTNode* select_node) {
+    if (!select_node || select_node->type != NODE_TYPE_SELECT) return true;
+    for (int i = 0; i < select_node->select.column_count; i++) {
+        const char* col = select_node->select.columns[i];
+        size_t len = col ? strlen(col) : 0;
+        if (len == 0 || strcmp(col, "*") == 0 || (len >= 2 && strcmp(col + len - 2, ".*") == 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void set_scan_references(PlanNode* scan, ReferenceList* refs) {
+    scan->referenced_columns = malloc(sizeof(char*) * (refs->count > 0 ? refs->count : 1));
+    for (int i = 0; i < refs->count; i++) {
+        scan->referenced_columns[i] = strdup(refs->names[i]);
+    }
+    scan->referenced_column_count = refs->count;
+}
+
+static void prune_projection(PlanNode* relation, ASTNode* query_ast) {
+    if (relation->type != PLAN_JOIN || selects_all_columns(query_ast->query.select)) return;
+
+    ReferenceList refs = {0};
+    collect_references(query_ast, &refs);
+
+    for (PlanNode* node = relation; node; node = node->input) {
+        if (node->type == PLAN_JOIN) {
+            set_scan_references(node->right, &refs);
+        } else {
+            set_scan_references(node, &refs);
+            break;
+        }
+    }
+
+    for (int i = 0; i < refs.count; i++) {
+        free(refs.names[i]);
+    }
+    free(refs.names);
+}
+
+/* file sets */
+
+static bool names_file_column(ReferenceList* refs) {
+    for (int i = 0; i < refs->count; i++) {
+        const char* dot = strrchr(refs->names[i], '.');
+        if (strcasecmp(dot ? dot + 1 : refs->names[i], FILE_SET_COLUMN) == 0) return true;
+    }
+    return false;
+}
+
+/* scans of several files: the filter of a single-table query is also tried on partition
+ * columns before loading (join queries push their conjuncts into the scans instead), and
+ * FILE_SET_COLUMN is added when the query names it */
+static void prepare_file_scans(PlanNode* relation, PlanNode* filter, ASTNode* query_ast) {
+    bool any = false;
+    for (PlanNode* node = relation; node; node = node->input) {
+        PlanNode* scan = node->type == PLAN_JOIN ? node->right : node;
+        if (scan->type == PLAN_SCAN && scan->source) {
+            ASTNode* source = scan->source;
+            bool files = source->type == NODE_TYPE_JOIN
+                             ? is_file_set_source(source->join.table, source->join.file_count)
+                             : is_file_set_source(source->from.table, source->from.file_count);
+            any = any || files;
+        }
+        if (node->type != PLAN_JOIN) break;
+    }
+    if (!any) return;
+
+    ReferenceList refs = {0};
+    collect_references(query_ast, &refs);
+    bool file_column = names_file_column(&refs);
+    for (int i = 0; i < refs.count; i++) {
+        free(refs.names[i]);
+    }
+    free(refs.names);
+
+    for (PlanNode* node = relation; node; node = node->input) {
+        PlanNode* scan = node->type == PLAN_JOIN ? node->right : node;
+        if (scan->type == PLAN_SCAN) scan->file_column = file_column;
+        if (node->type != PLAN_JOIN) break;
+    }
+    if (relation->type == PLAN_SCAN && filter && !filter->always_false) {
+        relation->prune_predicates = malloc(sizeof(ASTNode*) * (filter->predicate_count ? filter->predicate_count : 1));
+        for (int i = 0; i < filter->predicate_count; i++) {
+            relation->prune_predicates[i] = filter->predicates[i];
+            retainNode(filter->predicates[i]);
+        }
+        relation->prune_predicate_count = filter->predicate_count;
+    }
+}
+
+/* limit pushdown */
+
+static bool has_window_functions(ASTNode* select_node) {
+    if (!select_node || !select_node->select.column_nodes) return false;
+    for (int i = 0; i < select_node->select.column_count; i++) {
+        ASTNode* col = select_node->select.column_nodes[i];
+        if (col && col->type == NODE_TYPE_WINDOW_FUNCTION) return true;
+    }
+    return false;
+}
+
+static void push_down_limit(PlanNode* top, PlanNode* output, PlanNode* filter) {
+    if (top->type != PLAN_LIMIT || top->limit < 0 || top->input != output) return;
+    if (output->type != PLAN_PROJECT || has_window_functions(output->query->query.select)) return;
+
+    long long rows = (long long)top->limit + (top->offset > 0 ? top->offset : 0);
+    int row_limit = rows > INT_MAX ? INT_MAX : (int)rows;
+
+    output->row_limit = row_limit;
+    if (filter) filter->row_limit = row_limit;
+}
+
+/* rules for one query, top is its outermost operator */
+static void optimize_query(PlanNode* top) {
+    PlanNode* output = top;
+    while (output && output->type != PLAN_PROJECT && output->type != PLAN_AGGREGATE) {
+        output = output->input;
+    }
+    if (!output) return;
+
+    ASTNode* query_ast = output->query;
+    PlanNode* filter = output->input && output->input->type == PLAN_FILTER ? output->input : NULL;
+    PlanNode* parent = filter ? filter : output;
+
+    if (filter) {
+        QueryContext* scratch = context_create(query_ast);
+        fold_filter_constants(scratch, filter);
+        context_free(scratch);
+
+        push_down_predicates(filter);
+        if (filter->predicate_count == 0 && !filter->always_false) {
+            // everything was folded away or pushed into scans
+            output->input = filter->input;
+            filter->input = NULL;
+            plan_free_node(filter);
+            filter = NULL;
+            parent = output;
+        }
+    }
+
+    ASTNode* group_by = query_ast->query.group_by;
+    bool grouped = group_by && group_by->group_by.column_count > 0;
+    bool order_hidden = plan_find_node(top, PLAN_SORT) || (output->type == PLAN_AGGREGATE && !grouped);
+    if (order_hidden) {
+        parent->input = reorder_joins(parent->input);
+    }
+
+    prune_projection(parent->input, query_ast);
+    prepare_file_scans(parent->input, filter, query_ast);
+    push_down_limit(top, output, filter);
+}
+
+static void optimize_node(PlanNode* node) {
+    if (!node) return;
+
+    if (node->type == PLAN_SET_OP) {
+        optimize_node(node->input);
+        optimize_node(node->right);
+        return;
+    }
+    optimize_query(node);
+}
+
+void plan_optimize(QueryPlan* plan) {
+    if (!plan) return;
+    optimize_node(plan->root);
+}
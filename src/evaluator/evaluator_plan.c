@@ -0,0 +1,217 @@
+/* evaluator_plan.c - logical query plan built from the AST */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "evaluator.h"
+#include "parser.h"
+#include "evaluator/evaluator_plan.h"
+#include "evaluator/evaluator_aggregates.h"
+
+PlanNode* plan_node_create(PlanNodeType type) {
+    PlanNode* node = calloc(1, sizeof(PlanNode));
+    node->type = type;
+    node->table_index = -1;
+    node->row_limit = -1;
+    node->limit = -1;
+    node->offset = -1;
+    return node;
+}
+
+/* append a predicate, the node keeps its own reference */
+void plan_add_predicate(PlanNode* node, ASTNode* predicate) {
+    node->predicates = realloc(node->predicates, sizeof(ASTNode*) * (node->predicate_count + 1));
+    node->predicates[node->predicate_count++] = predicate;
+    retainNode(predicate);
+}
+
+/* split a condition on top level AND, conjuncts are borrowed from the condition */
+void plan_collect_conjuncts(ASTNode* condition, ASTNode*** conjuncts, int* count) {
+    if (!condition) return;
+
+    if (condition->type == NODE_TYPE_CONDITION &&
+        strcasecmp(condition->condition.operator, "AND") == 0) {
+        plan_collect_conjuncts(condition->condition.left, conjuncts, count);
+        plan_collect_conjuncts(condition->condition.right, conjuncts, count);
+        return;
+    }
+
+    *conjuncts = realloc(*conjuncts, sizeof(ASTNode*) * (*count + 1));
+    (*conjuncts)[(*count)++] = condition;
+}
+
+/* first node of the given type on the input chain, joins are not descended */
+PlanNode* plan_find_node(PlanNode* root, PlanNodeType type) {
+    for (PlanNode* node = root; node; node = node->input) {
+        if (node->type == type) return node;
+        if (node->type == PLAN_SET_OP) return NULL;
+    }
+    return NULL;
+}
+
+const char* plan_node_name(PlanNodeType type) {
+    switch (type) {
+        case PLAN_SCAN: return "Scan";
+        case PLAN_JOIN: return "Join";
+        case PLAN_FILTER: return "Filter";
+        case PLAN_AGGREGATE: return "Aggregate";
+        case PLAN_PROJECT: return "Project";
+        case PLAN_SORT: return "Sort";
+        case PLAN_DISTINCT: return "Distinct";
+        case PLAN_LIMIT: return "Limit";
+        case PLAN_SET_OP: return "SetOp";
+    }
+    return "Unknown";
+}
+
+static bool is_grouped_query(ASTNode* query_ast) {
+    ASTNode* group_by = query_ast->query.group_by;
+    return group_by && group_by->type == NODE_TYPE_GROUP_BY &&
+           group_by->group_by.columns && group_by->group_by.column_count > 0;
+}
+
+static PlanNode* build_node(ASTNode* ast);
+
+/* Scan of FROM, one Join + Scan per JOIN clause, then the operators above them */
+static PlanNode* build_query_node(ASTNode* query_ast) {
+    ASTNode* from = query_ast->query.from;
+
+    PlanNode* node = plan_node_create(PLAN_SCAN);
+    node->source = from;
+    node->table_index = 0;
+    node->query = query_ast;
+    if (from && from->type == NODE_TYPE_FROM) {
+        node->alias = from->from.alias ? from->from.alias : (from->from.subquery ? "subquery" : "main");
+    }
+
+    for (int j = 0; j < query_ast->query.join_count; j++) {
+        ASTNode* join_node = query_ast->query.joins[j];
+        if (join_node->type != NODE_TYPE_JOIN) continue;
+
+        PlanNode* scan = plan_node_create(PLAN_SCAN);
+        scan->source = join_node;
+        scan->alias = join_node->join.alias ? join_node->join.alias : "right";
+        scan->table_index = j + 1;
+        scan->query = query_ast;
+
+        PlanNode* join = plan_node_create(PLAN_JOIN);
+        join->input = node;
+        join->right = scan;
+        join->join = join_node;
+        join->query = query_ast;
+        node = join;
+    }
+
+    if (query_ast->query.where) {
+        PlanNode* filter = plan_node_create(PLAN_FILTER);
+        filter->input = node;
+        filter->query = query_ast;
+
+        ASTNode** conjuncts = NULL;
+        int conjunct_count = 0;
+        plan_collect_conjuncts(query_ast->query.where, &conjuncts, &conjunct_count);
+        for (int i = 0; i < conjunct_count; i++) {
+            plan_add_predicate(filter, conjuncts[i]);
+        }
+        free(conjuncts);
+        node = filter;
+    }
+
+    PlanNodeType output_type = PLAN_PROJECT;
+    if (is_grouped_query(query_ast) || has_aggregate_functions(query_ast->query.select)) {
+        output_type = PLAN_AGGREGATE;
+    }
+    PlanNode* output = plan_node_create(output_type);
+    output->input = node;
+    output->query = query_ast;
+    node = output;
+
+    ASTNode* order_by = query_ast->query.order_by;
+    if (order_by && order_by->type == NODE_TYPE_ORDER_BY && order_by->order_by.column) {
+        PlanNode* sort = plan_node_create(PLAN_SORT);
+        sort->input = node;
+        sort->query = query_ast;
+        node = sort;
+    }
+
+    if (query_ast->query.select && query_ast->query.select->select.distinct) {
+        PlanNode* distinct = plan_node_create(PLAN_DISTINCT);
+        distinct->input = node;
+        distinct->query = query_ast;
+        node = distinct;
+    }
+
+    if (query_ast->query.limit >= 0 || query_ast->query.offset >= 0) {
+        PlanNode* limit = plan_node_create(PLAN_LIMIT);
+        limit->input = node;
+        limit->query = query_ast;
+        limit->limit = query_ast->query.limit;
+        limit->offset = query_ast->query.offset;
+        node = limit;
+    }
+
+    return node;
+}
+
+static PlanNode* build_node(ASTNode* ast) {
+    if (!ast) return NULL;
+
+    if (ast->type == NODE_TYPE_SET_OP) {
+        PlanNode* left = build_node(ast->set_op.left);
+        PlanNode* right = build_node(ast->set_op.right);
+        if (!left || !right) {
+            plan_free_node(left);
+            plan_free_node(right);
+            return NULL;
+        }
+
+        PlanNode* node = plan_node_create(PLAN_SET_OP);
+        node->input = left;
+        node->right = right;
+        node->set_op = ast->set_op.op_type;
+        node->query = ast;
+        return node;
+    }
+
+    if (ast->type != NODE_TYPE_QUERY) return NULL;
+    return build_query_node(ast);
+}
+
+QueryPlan* plan_build(ASTNode* query_ast) {
+    PlanNode* root = build_node(query_ast);
+    if (!root) return NULL;
+
+    QueryPlan* plan = calloc(1, sizeof(QueryPlan));
+    plan->root = root;
+    plan->query = query_ast;
+    return plan;
+}
+
+void plan_free_node(PlanNode* node) {
+    if (!node) return;
+
+    plan_free_node(node->input);
+    plan_free_node(node->right);
+
+    for (int i = 0; i < node->predicate_count; i++) {
+        releaseNode(node->predicates[i]);
+    }
+    free(node->predicates);
+    for (int i = 0; i < node->prune_predicate_count; i++) {
+        releaseNode(node->prune_predicates[i]);
+    }
+    free(node->prune_predicates);
+
+    for (int i = 0; i < node->referenced_column_count; i++) {
+        free(node->referenced_columns[i]);
+    }
+    free(node->referenced_columns);
+    free(node);
+}
+
+void plan_free(QueryPlan* plan) {
+    if (!plan) return;
+    plan_free_node(plan->root);
+    free(plan);
+}
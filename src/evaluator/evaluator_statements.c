@@ -7,320 +7,368 @@
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <unistd.h>
+#endif
 #include "evaluator.h"
 #include "parser.h"
 #include "csv_reader.h"
 #include "mmap.h"
+#include "output_writer.h"
+#include "row_sink.h"
+#include "string_utils.h"
 #include "evaluator/evaluator_statements.h"
 #include "evaluator/evaluator_core.h"
 #include "evaluator/evaluator_expressions.h"
+#include "evaluator/evaluator_conditions.h"
+#include "evaluator/evaluator_subquery.h"
 
 extern CsvConfig global_csv_config;
 
-/* evaluate INSERT statement */
-ResultSet* evaluate_insert(ASTNode* insert_node) {
-    // load existing table
-    CsvTable* table = load_table_from_string(insert_node->insert.table);
-    if (!table) {
-        fprintf(stderr, "Error: Could not load table '%s'\n", insert_node->insert.table);
-        return NULL;
-    }
-    
-    // validate column count
-    int value_count = insert_node->insert.value_count;
+/* a one row result holding message, as DML and DDL statements return */
+static ResultSet* message_result(const char* filename, const char* message) {
+    ResultSet* result = malloc(sizeof(ResultSet));
+    result->filename = strdup(filename);
+    result->data = NULL;
+    result->file_size = 0;
+    result->fd = -1;
+    result->arena = NULL;
+    result->column_count = 1;
+    result->columns = malloc(sizeof(Column));
+    result->columns[0].name = strdup("message");
+    result->columns[0].inferred_type = VALUE_TYPE_STRING;
+    result->row_count = 1;
+    result->row_capacity = 1;
+    result->rows = malloc(sizeof(Row));
+    result->rows[0].column_count = 1;
+    result->rows[0].values = malloc(sizeof(Value));
+    result->rows[0].values[0].type = VALUE_TYPE_STRING;
+    result->rows[0].values[0].string_value = strdup(message);
+    result->has_header = true;
+    result->delimiter = ',';
+    result->quote = '"';
+    return result;
+}
+
+/* the file a statement names, without the quotes around it */
+static char* statement_path(const char* filename) {
+    const char* start = filename;
+    const char* end = filename + strlen(filename);
+    if (*start == '"' || *start == '\'') start++;
+    if (end > start && (*(end-1) == '"' || *(end-1) == '\'')) end--;
+    return cq_strndup(start, end - start);
+}
+
+/* the columns of a table named in a statement, without its rows */
+static CsvTable* load_table_header(const char* filename, bool* terminated) {
+    char* clean_filename = statement_path(filename);
+    CsvTable* table = csv_load_header(clean_filename, global_csv_config, terminated);
+    free(clean_filename);
+    return table;
+}
+
+/* the table column each inserted value goes to, NULL with an error when the column list names
+ * a column the table lacks or the count differs from the table's */
+static int* insert_targets(ASTNode* insert_node, CsvTable* table, int value_count) {
     if (insert_node->insert.columns) {
-        // column list specified
         if (insert_node->insert.column_count != value_count) {
             fprintf(stderr, "Error: Column count (%d) does not match value count (%d)\n",
                     insert_node->insert.column_count, value_count);
-            csv_free(table);
             return NULL;
         }
-    } else {
-        // no column list, values must match all columns
-        if (value_count != table->column_count) {
-            fprintf(stderr, "Error: Value count (%d) does not match table column count (%d)\n",
-                    value_count, table->column_count);
-            csv_free(table);
-            return NULL;
-        }
-    }
-    
-    // create new row
-    Row new_row;
-    new_row.column_count = table->column_count;
-    new_row.values = calloc(table->column_count, sizeof(Value));
-    
-    // initialize all values as NULL
-    for (int i = 0; i < table->column_count; i++) {
-        new_row.values[i].type = VALUE_TYPE_NULL;
+    } else if (value_count != table->column_count) {
+        fprintf(stderr, "Error: Value count (%d) does not match table column count (%d)\n",
+                value_count, table->column_count);
+        return NULL;
     }
     
-    // fill in values
+    int* targets = malloc(sizeof(int) * (value_count ? value_count : 1));
     for (int i = 0; i < value_count; i++) {
-        int target_col = i;
-        
-        // if column list specified, find target column index
+        targets[i] = i;
         if (insert_node->insert.columns) {
             const char* col_name = insert_node->insert.columns[i];
-            target_col = csv_get_column_index(table, col_name);
-            if (target_col < 0) {
+            targets[i] = csv_get_column_index(table, col_name);
+            if (targets[i] < 0) {
                 fprintf(stderr, "Error: Column '%s' not found in table\n", col_name);
-                free(new_row.values);
-                csv_free(table);
+                free(targets);
                 return NULL;
             }
         }
-        
-        // evaluate value expression
-        ASTNode* val_node = insert_node->insert.values[i];
+    }
+    return targets;
+}
+
+/* one VALUES row in table order, columns left out of the list are NULL */
+static bool evaluate_insert_row(ASTNode** value_nodes, int value_count, const int* targets, Value* row) {
+    for (int i = 0; i < value_count; i++) {
+        ASTNode* val_node = value_nodes[i];
+        Value* target = &row[targets[i]];
+        value_free(target);
         
         // for simple literals, convert directly
         if (val_node->type == NODE_TYPE_LITERAL) {
             const char* literal = val_node->literal;
-            Value parsed = parse_value(literal, strlen(literal));
-            new_row.values[target_col] = parsed;
+            *target = parse_value(literal, strlen(literal));
         } else if (val_node->type == NODE_TYPE_BINARY_OP) {
             // evaluate arithmetic expression
             QueryContext temp_ctx = {0};
-            Value result = evaluate_expression(&temp_ctx, val_node, NULL, 0);
-            new_row.values[target_col] = result;
+            *target = evaluate_expression(&temp_ctx, val_node, NULL, 0);
         } else {
             fprintf(stderr, "Error: Unsupported value expression in INSERT\n");
-            free(new_row.values);
-            csv_free(table);
-            return NULL;
+            return false;
         }
     }
-    
-    // add row to table
-    if (table->row_count >= table->row_capacity) {
-        table->row_capacity = table->row_capacity ? table->row_capacity * 2 : 8;
-        table->rows = realloc(table->rows, sizeof(Row) * table->row_capacity);
-    }
-    table->rows[table->row_count++] = new_row;
-    
-    // save table back to file
-    if (!csv_save(insert_node->insert.table, table)) {
-        fprintf(stderr, "Error: Could not save table '%s'\n", insert_node->insert.table);
-        csv_free(table);
-        return NULL;
+    return true;
+}
+
+/* INSERT ... SELECT: the query's rows appended as they are produced */
+typedef struct {
+    RowSink base;
+    OutputWriter* out;
+    CsvTable* table;
+    const int* targets;
+    int value_count;
+    Value* row;                 // one record in table order, NULL where no value goes
+    int rows;
+    bool failed;
+} InsertSink;
+
+static void insert_sink_begin(RowSink* sink, const Column* columns, int column_count) {
+    (void)columns;
+    InsertSink* insert = (InsertSink*)sink;
+    if (column_count != insert->value_count) {
+        fprintf(stderr, "Error: SELECT returns %d columns, INSERT expects %d\n", column_count, insert->value_count);
+        insert->failed = true;
     }
-    
-    // return result message
-    ResultSet* result = malloc(sizeof(ResultSet));
-    result->filename = strdup("INSERT result");
-    result->data = NULL;
-    result->file_size = 0;
-    result->fd = -1;
-    result->column_count = 1;
-    result->columns = malloc(sizeof(Column));
-    result->columns[0].name = strdup("message");
-    result->columns[0].inferred_type = VALUE_TYPE_STRING;
-    result->row_count = 1;
-    result->row_capacity = 1;
-    result->rows = malloc(sizeof(Row));
-    result->rows[0].column_count = 1;
-    result->rows[0].values = malloc(sizeof(Value));
-    result->rows[0].values[0].type = VALUE_TYPE_STRING;
-    result->rows[0].values[0].string_value = malloc(100);
-    snprintf(result->rows[0].values[0].string_value, 100, "Inserted 1 row");
-    result->has_header = true;
-    result->delimiter = ',';
-    result->quote = '"';
-    
-    csv_free(table);
-    return result;
 }
 
-/* evaluate UPDATE statement */
-ResultSet* evaluate_update(ASTNode* update_node) {
-    // load existing table
-    CsvTable* table = load_table_from_string(update_node->update.table);
+static bool insert_sink_row(RowSink* sink, const Row* row) {
+    InsertSink* insert = (InsertSink*)sink;
+    if (insert->failed) return false;
+    for (int i = 0; i < insert->value_count; i++) insert->row[insert->targets[i]] = row->values[i];
+    writer_csv_row(insert->out, insert->row, insert->table->column_count, insert->table->delimiter,
+                   insert->table->quote);
+    insert->rows++;
+    return true;
+}
+
+static bool insert_sink_end(RowSink* sink) {
+    (void)sink;
+    return true;
+}
+
+/* evaluate INSERT statement: the rows are appended to the file, which is never read past its
+ * first line, so the cost follows the rows inserted rather than the size of the table */
+ResultSet* evaluate_insert(ASTNode* insert_node) {
+    bool terminated;
+    CsvTable* table = load_table_header(insert_node->insert.table, &terminated);
     if (!table) {
-        fprintf(stderr, "Error: Could not load table '%s'\n", update_node->update.table);
+        fprintf(stderr, "Error: Could not load table '%s'\n", insert_node->insert.table);
         return NULL;
     }
     
-    // create context for condition evaluation
-    QueryContext ctx;
-    ctx.tables = malloc(sizeof(TableRef));
-    ctx.tables[0].alias = strdup("__main__");
-    ctx.tables[0].table = table;
-    ctx.table_count = 1;
-    ctx.query = NULL;
-    ctx.outer_row = NULL;
-    ctx.outer_table = NULL;
-    
-    int updated_count = 0;
+    int value_count = insert_node->insert.value_count;
+    if (insert_node->insert.query) {
+        // the width of a SELECT is known once it runs, the column list sets the expected one
+        value_count = insert_node->insert.columns ? insert_node->insert.column_count : table->column_count;
+    }
+    int* targets = insert_targets(insert_node, table, value_count);
+    if (!targets) {
+        csv_free(table);
+        return NULL;
+    }
+    Value* row = calloc(table->column_count ? table->column_count : 1, sizeof(Value));
     
-    // process each row
-    for (int row = 0; row < table->row_count; row++) {
-        // check WHERE condition
-        bool matches = true;
-        if (update_node->update.where) {
-            matches = evaluate_condition(&ctx, update_node->update.where, &table->rows[row], 0);
+    OutputWriter out;
+    int inserted = 0;
+    bool ok = true;
+    if (!insert_node->insert.query) {
+        // every row is formatted before the file is touched, so a bad value inserts nothing
+        // and the rows land with one write
+        writer_open_memory(&out);
+        if (!terminated) writer_putc(&out, '\n');
+        for (int r = 0; r < insert_node->insert.row_count && ok; r++) {
+            ok = evaluate_insert_row(insert_node->insert.values + (size_t)r * value_count, value_count, targets, row);
+            if (ok) {
+                writer_csv_row(&out, row, table->column_count, table->delimiter, table->quote);
+                inserted++;
+            }
         }
+        size_t length;
+        char* records = writer_take_memory(&out, &length);
+        writer_close(&out);
         
-        if (matches) {
-            // update columns
-            for (int i = 0; i < update_node->update.assignment_count; i++) {
-                ASTNode* assignment = update_node->update.assignments[i];
-                const char* col_name = assignment->assignment.column;
-                
-                int col_idx = csv_get_column_index(table, col_name);
-                if (col_idx < 0) {
-                    fprintf(stderr, "Error: Column '%s' not found\n", col_name);
-                    context_free(&ctx);
-                    csv_free(table);
-                    return NULL;
-                }
-                
-                // Note: We don't free old value because it may point to mmap'd data
-                // The value will be overwritten and csv_save will write the new value
-                
-                // evaluate new value
-                ASTNode* val_node = assignment->assignment.value;
-                if (val_node->type == NODE_TYPE_LITERAL) {
-                    const char* literal = val_node->literal;
-                    Value parsed = parse_value(literal, strlen(literal));
-                    table->rows[row].values[col_idx] = parsed;
-                } else {
-                    Value result = evaluate_expression(&ctx, val_node, &table->rows[row], 0);
-                    table->rows[row].values[col_idx] = result;
-                }
+        if (ok) {
+            ok = writer_open_append(&out, table->filename);
+            if (ok) {
+                writer_write(&out, records, length);
+                ok = writer_close(&out);
             }
-            updated_count++;
+            if (!ok) perror("write");
+        }
+        free(records);
+        for (int i = 0; i < table->column_count; i++) value_free(&row[i]);
+    } else if (!writer_open_append(&out, table->filename)) {
+        perror("open");
+        ok = false;
+    } else {
+        if (!terminated) writer_putc(&out, '\n');
+        InsertSink sink = {{insert_sink_begin, insert_sink_row, insert_sink_end, NULL, NULL},
+                           &out, table, targets, value_count, row, 0, false};
+        ok = evaluate_query_to_sink(insert_node->insert.query, &sink.base) && !sink.failed;
+        sink.base.end(&sink.base);
+        inserted = sink.rows;
+        if (!writer_close(&out)) {
+            perror("write");
+            ok = false;
         }
+#if !defined(_WIN32) && !defined(_WIN64)
+        // the rows of a query that failed part way are taken back off the end
+        if (!ok && truncate(table->filename, (off_t)table->file_size) != 0) perror("truncate");
+#endif
     }
+    free(row);
+    free(targets);
     
-    // save table back to file
-    if (!csv_save(update_node->update.table, table)) {
-        fprintf(stderr, "Error: Could not save table '%s'\n", update_node->update.table);
-        free(ctx.tables[0].alias);
-        free(ctx.tables);
+    if (!ok) {
+        fprintf(stderr, "Error: Could not save table '%s'\n", insert_node->insert.table);
         csv_free(table);
         return NULL;
     }
     
-    // return result message
-    ResultSet* result = malloc(sizeof(ResultSet));
-    result->filename = strdup("UPDATE result");
-    result->data = NULL;
-    result->file_size = 0;
-    result->fd = -1;
-    result->column_count = 1;
-    result->columns = malloc(sizeof(Column));
-    result->columns[0].name = strdup("message");
-    result->columns[0].inferred_type = VALUE_TYPE_STRING;
-    result->row_count = 1;
-    result->row_capacity = 1;
-    result->rows = malloc(sizeof(Row));
-    result->rows[0].column_count = 1;
-    result->rows[0].values = malloc(sizeof(Value));
-    result->rows[0].values[0].type = VALUE_TYPE_STRING;
-    result->rows[0].values[0].string_value = malloc(100);
-    snprintf(result->rows[0].values[0].string_value, 100, "Updated %d row(s)", updated_count);
-    result->has_header = true;
-    result->delimiter = ',';
-    result->quote = '"';
-    
-    // free context manually (don't use context_free to avoid double-free of table)
-    free(ctx.tables[0].alias);
-    free(ctx.tables);
+    char message[64];
+    snprintf(message, sizeof(message), "Inserted %d row%s", inserted, inserted == 1 ? "" : "s");
     csv_free(table);
-    return result;
+    return message_result("INSERT result", message);
 }
 
-/* evaluate DELETE statement */
-ResultSet* evaluate_delete(ASTNode* delete_node) {
-    // load existing table
-    CsvTable* table = load_table_from_string(delete_node->delete_stmt.table);
-    if (!table) {
-        fprintf(stderr, "Error: Could not load table '%s'\n", delete_node->delete_stmt.table);
-        return NULL;
+/* UPDATE and DELETE: the file is streamed record by record into a new version of itself,
+ * renamed over it once complete, so memory stays constant and a failure or a crash leaves
+ * the old file. records the WHERE clause does not match are copied as the bytes they were,
+ * runs of them with one write, and only updated records are formatted again. deletes when
+ * assignments is NULL, returns the number of records matched or -1 */
+static int rewrite_table(const char* table_name, ASTNode* where, ASTNode** assignments, int assignment_count) {
+    char* path = statement_path(table_name);
+    CsvRecordReader* reader = csv_records_open(path, global_csv_config);
+    if (!reader) {
+        fprintf(stderr, "Error: Could not load table '%s'\n", table_name);
+        free(path);
+        return -1;
+    }
+    CsvTable* table = csv_records_table(reader);
+    
+    // the assigned columns are checked before anything is written
+    int* targets = malloc(sizeof(int) * (assignment_count ? assignment_count : 1));
+    for (int i = 0; i < assignment_count; i++) {
+        const char* col_name = assignments[i]->assignment.column;
+        targets[i] = csv_get_column_index(table, col_name);
+        if (targets[i] < 0) {
+            fprintf(stderr, "Error: Column '%s' not found\n", col_name);
+            free(targets);
+            csv_records_close(reader);
+            free(path);
+            return -1;
+        }
+    }
+    
+    OutputWriter out;
+    if (!writer_open_replace(&out, path)) {
+        perror("open");
+        free(targets);
+        csv_records_close(reader);
+        free(path);
+        return -1;
     }
     
     // create context for condition evaluation
-    QueryContext ctx;
+    QueryContext ctx = {0};
     ctx.tables = malloc(sizeof(TableRef));
     ctx.tables[0].alias = strdup("__main__");
     ctx.tables[0].table = table;
     ctx.table_count = 1;
-    ctx.query = NULL;
-    ctx.outer_row = NULL;
-    ctx.outer_table = NULL;
     
-    // find rows to delete
-    Row** rows_to_keep = malloc(sizeof(Row*) * table->row_count);
-    int keep_count = 0;
-    int deleted_count = 0;
+    Value* updated = malloc(sizeof(Value) * (table->column_count ? table->column_count : 1));
+    Value* assigned = malloc(sizeof(Value) * (assignment_count ? assignment_count : 1));
+    int matched = 0;
     
-    for (int row = 0; row < table->row_count; row++) {
-        bool matches = evaluate_condition(&ctx, delete_node->delete_stmt.where, &table->rows[row], 0);
+    // bytes read but not written yet: the header, then every record since the last match
+    size_t pending_length;
+    const char* pending = csv_records_head(reader, &pending_length);
+    const char* record;
+    size_t length;
+    Row* row;
+    while ((row = csv_records_next(reader, &record, &length))) {
+        if (where && !evaluate_condition(&ctx, where, row, 0)) {
+            pending_length += length;
+            continue;
+        }
+        matched++;
+        writer_write(&out, pending, pending_length);
+        pending = record + length;
+        pending_length = 0;
+        if (!assignments) continue;
         
-        if (!matches) {
-            // keep this row
-            rows_to_keep[keep_count++] = &table->rows[row];
-        } else {
-            // delete this row - free string values
-            deleted_count++;
-            for (int col = 0; col < table->rows[row].column_count; col++) {
-                if (table->rows[row].values[col].type == VALUE_TYPE_STRING) {
-                    free(table->rows[row].values[col].string_value);
-                }
+        // every assignment sees the values the record had before the update
+        for (int i = 0; i < assignment_count; i++) {
+            ASTNode* val_node = assignments[i]->assignment.value;
+            if (val_node->type == NODE_TYPE_LITERAL) {
+                const char* literal = val_node->literal;
+                assigned[i] = parse_value(literal, strlen(literal));
+            } else {
+                assigned[i] = evaluate_expression(&ctx, val_node, row, 0);
             }
-            free(table->rows[row].values);
         }
+        memcpy(updated, row->values, sizeof(Value) * table->column_count);
+        for (int i = 0; i < assignment_count; i++) updated[targets[i]] = assigned[i];
+        writer_csv_row(&out, updated, table->column_count, table->delimiter, table->quote);
+        for (int i = 0; i < assignment_count; i++) value_free(&assigned[i]);
     }
     
-    // rebuild rows array
-    Row* new_rows = malloc(sizeof(Row) * keep_count);
-    for (int i = 0; i < keep_count; i++) {
-        new_rows[i] = *rows_to_keep[i];
-    }
-    free(rows_to_keep);
-    free(table->rows);
-    table->rows = new_rows;
-    table->row_count = keep_count;
-    table->row_capacity = keep_count;
-    
-    // save table back to file
-    if (!csv_save(delete_node->delete_stmt.table, table)) {
-        fprintf(stderr, "Error: Could not save table '%s'\n", delete_node->delete_stmt.table);
-        free(ctx.tables[0].alias);
-        free(ctx.tables);
-        csv_free(table);
-        return NULL;
-    }
-    
-    // return result message
-    ResultSet* result = malloc(sizeof(ResultSet));
-    result->filename = strdup("DELETE result");
-    result->data = NULL;
-    result->file_size = 0;
-    result->fd = -1;
-    result->column_count = 1;
-    result->columns = malloc(sizeof(Column));
-    result->columns[0].name = strdup("message");
-    result->columns[0].inferred_type = VALUE_TYPE_STRING;
-    result->row_count = 1;
-    result->row_capacity = 1;
-    result->rows = malloc(sizeof(Row));
-    result->rows[0].column_count = 1;
-    result->rows[0].values = malloc(sizeof(Value));
-    result->rows[0].values[0].type = VALUE_TYPE_STRING;
-    result->rows[0].values[0].string_value = malloc(100);
-    snprintf(result->rows[0].values[0].string_value, 100, "Deleted %d row(s)", deleted_count);
-    result->has_header = true;
-    result->delimiter = ',';
-    result->quote = '"';
+    // the rest of the records point into the file, they are written before it is closed
+    if (matched > 0) writer_write(&out, pending, pending_length);
     
     // free context manually, don't use context_free to avoid double-free of table
     free(ctx.tables[0].alias);
     free(ctx.tables);
-    csv_free(table);
-    return result;
+    free_compiled_in_lists(&ctx);
+    free_subquery_caches(&ctx);
+    free(updated);
+    free(assigned);
+    free(targets);
+    
+    // the old file is closed and unmapped before the new one replaces it, which Windows
+    // refuses for a file still open. a statement that matched nothing leaves the file as it is
+    csv_records_close(reader);
+    bool saved = true;
+    if (matched == 0) {
+        writer_discard(&out);
+    } else {
+        saved = writer_close(&out);
+        if (!saved) fprintf(stderr, "Error: Could not save table '%s'\n", table_name);
+    }
+    free(path);
+    return saved ? matched : -1;
+}
+
+/* evaluate UPDATE statement */
+ResultSet* evaluate_update(ASTNode* update_node) {
+    int updated_count = rewrite_table(update_node->update.table, update_node->update.where,
+                                      update_node->update.assignments, update_node->update.assignment_count);
+    if (updated_count < 0) return NULL;
+    
+    char message[64];
+    snprintf(message, sizeof(message), "Updated %d row(s)", updated_count);
+    return message_result("UPDATE result", message);
+}
+
+/* evaluate DELETE statement */
+ResultSet* evaluate_delete(ASTNode* delete_node) {
+    int deleted_count = rewrite_table(delete_node->delete_stmt.table, delete_node->delete_stmt.where, NULL, 0);
+    if (deleted_count < 0) return NULL;
+    
+    char message[64];
+    snprintf(message, sizeof(message), "Deleted %d row(s)", deleted_count);
+    return message_result("DELETE result", message);
 }
 
 /* evaluate CREATE TABLE statement */
@@ -340,6 +388,8 @@ ResultSet* evaluate_create_table(ASTNode* create_node) {
         table->data = NULL;
         table->file_size = 0;
         table->fd = -1;
+        table->arena = NULL;
+        table->arrow = false;
         table->column_count = create_node->create_table.column_count;
         table->columns = malloc(sizeof(Column) * table->column_count);
         
@@ -370,6 +420,7 @@ ResultSet* evaluate_create_table(ASTNode* create_node) {
         result->data = NULL;
         result->file_size = 0;
         result->fd = -1;
+        result->arena = NULL;
         result->column_count = 1;
         result->columns = malloc(sizeof(Column));
         result->columns[0].name = strdup("message");
@@ -414,6 +465,7 @@ ResultSet* evaluate_create_table(ASTNode* create_node) {
         result->data = NULL;
         result->file_size = 0;
         result->fd = -1;
+        result->arena = NULL;
         result->column_count = 1;
         result->columns = malloc(sizeof(Column));
         result->columns[0].name = strdup("message");
@@ -602,6 +654,7 @@ ResultSet* evaluate_alter_table(ASTNode* alter_node) {
     result->data = NULL;
     result->file_size = 0;
     result->fd = -1;
+    result->arena = NULL;
     result->column_count = 1;
     result->columns = malloc(sizeof(Column));
     result->columns[0].name = strdup("message");
@@ -0,0 +1,208 @@
+/* evaluator_stats.c - table statistics and cost based join ordering */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "csv_reader.h"
+#include "evaluator/evaluator_stats.h"
+#include "evaluator/evaluator_hash.h"
+
+/* orders of up to this many joins are searched exhaustively, longer chains greedily */
+#define EXHAUSTIVE_JOIN_LIMIT 7
+
+/* ===== HyperLogLog ===== */
+
+void hll_init(HyperLogLog* hll) {
+    memset(hll->registers, 0, sizeof(hll->registers));
+}
+
+void hll_add(HyperLogLog* hll, uint64_t hash) {
+    int index = (int)(hash >> (64 - HLL_PRECISION));
+    uint64_t rest = (hash << HLL_PRECISION) | (1ULL << (HLL_PRECISION - 1));
+
+    // rank is the position of the first set bit in the remaining hash bits
+    uint8_t rank = 1;
+    while (!(rest & 0x8000000000000000ULL)) {
+        rest <<= 1;
+        rank++;
+    }
+    if (rank > hll->registers[index]) hll->registers[index] = rank;
+}
+
+double hll_estimate(const HyperLogLog* hll) {
+    double m = HLL_REGISTERS;
+    double sum = 0;
+    int zeros = 0;
+    for (int i = 0; i < HLL_REGISTERS; i++) {
+        sum += ldexp(1.0, -hll->registers[i]);
+        if (hll->registers[i] == 0) zeros++;
+    }
+
+    double estimate = (0.7213 / (1.0 + 1.079 / m)) * m * m / sum;
+    // small range correction, linear counting is more accurate while registers are empty
+    if (estimate <= 2.5 * m && zeros > 0) {
+        estimate = m * log(m / zeros);
+    }
+    return estimate;
+}
+
+/* ===== table statistics ===== */
+
+TableStats* table_stats_collect(CsvTable* table, const bool* wanted) {
+    TableStats* stats = calloc(1, sizeof(TableStats));
+    stats->row_count = table->row_count;
+    stats->column_count = table->column_count;
+    stats->columns = calloc(table->column_count > 0 ? table->column_count : 1, sizeof(ColumnStats));
+
+    HyperLogLog* sketch = malloc(sizeof(HyperLogLog));
+    for (int c = 0; c < table->column_count; c++) {
+        if (wanted && !wanted[c]) continue;
+        ColumnStats* column = &stats->columns[c];
+        Value* min = NULL;
+        Value* max = NULL;
+        hll_init(sketch);
+
+        for (int r = 0; r < table->row_count; r++) {
+            Row* row = &table->rows[r];
+            if (c >= row->column_count || row->values[c].type == VALUE_TYPE_NULL) {
+                column->null_count++;
+                continue;
+            }
+            Value* value = &row->values[c];
+            hll_add(sketch, value_hash(value));
+            if (!min || value_compare(value, min) < 0) min = value;
+            if (!max || value_compare(value, max) > 0) max = value;
+        }
+
+        column->distinct = table->row_count > column->null_count ? hll_estimate(sketch) : 0;
+        if (min) {
+            column->has_range = true;
+            column->min = value_copy(min);
+            column->max = value_copy(max);
+        }
+    }
+    free(sketch);
+    return stats;
+}
+
+void table_stats_free(TableStats* stats) {
+    if (!stats) return;
+    for (int c = 0; c < stats->column_count; c++) {
+        if (stats->columns[c].has_range) {
+            value_free(&stats->columns[c].min);
+            value_free(&stats->columns[c].max);
+        }
+    }
+    free(stats->columns);
+    free(stats);
+}
+
+/* classic 1 / max(distinct) estimate, zero when the key ranges do not overlap */
+double stats_join_selectivity(const ColumnStats* left, double left_rows,
+                              const ColumnStats* right, double right_rows) {
+    if (left->has_range && right->has_range &&
+        value_class(&left->min) == value_class(&right->min) &&
+        value_class(&left->max) == value_class(&right->max)) {
+        if (value_compare((Value*)&left->max, (Value*)&right->min) < 0 ||
+            value_compare((Value*)&right->max, (Value*)&left->min) < 0) {
+            return 0;
+        }
+    }
+
+    // an intermediate result cannot hold more distinct keys than rows
+    double left_distinct = left->distinct < left_rows ? left->distinct : left_rows;
+    double right_distinct = right->distinct < right_rows ? right->distinct : right_rows;
+    double distinct = left_distinct > right_distinct ? left_distinct : right_distinct;
+    return distinct >= 1 ? 1.0 / distinct : 1.0;
+}
+
+/* ===== join ordering ===== */
+
+typedef struct {
+    const JoinCandidate* joins;
+    int join_count;
+    bool exhaustive;
+    bool* placed;               // per join
+    int* order;
+    double* rows;
+    int* best_order;
+    double* best_rows;
+    double best_cost;
+    bool found;
+} OrderSearch;
+
+static bool relation_available(OrderSearch* search, int relation) {
+    return relation == 0 || search->placed[relation - 1];
+}
+
+static double step_rows(const JoinCandidate* join, double current_rows) {
+    double selectivity = stats_join_selectivity(join->left_key, current_rows,
+                                                join->right_key, join->right_rows);
+    return current_rows * join->right_rows * selectivity;
+}
+
+static void search_order(OrderSearch* search, int depth, double current_rows, double cost) {
+    if (search->found && cost >= search->best_cost) return;
+
+    if (depth == search->join_count) {
+        search->found = true;
+        search->best_cost = cost;
+        memcpy(search->best_order, search->order, sizeof(int) * search->join_count);
+        memcpy(search->best_rows, search->rows, sizeof(double) * search->join_count);
+        return;
+    }
+
+    // greedy mode only follows the cheapest next join
+    int greedy_pick = -1;
+    double greedy_rows = 0;
+    for (int j = 0; j < search->join_count; j++) {
+        const JoinCandidate* join = &search->joins[j];
+        if (search->placed[j] || !relation_available(search, join->left_relation)) continue;
+
+        double rows = step_rows(join, current_rows);
+        if (!search->exhaustive) {
+            if (greedy_pick < 0 || rows < greedy_rows) {
+                greedy_pick = j;
+                greedy_rows = rows;
+            }
+            continue;
+        }
+
+        search->placed[j] = true;
+        search->order[depth] = j;
+        search->rows[depth] = rows;
+        search_order(search, depth + 1, rows, cost + rows);
+        search->placed[j] = false;
+    }
+
+    if (greedy_pick >= 0) {
+        search->placed[greedy_pick] = true;
+        search->order[depth] = greedy_pick;
+        search->rows[depth] = greedy_rows;
+        search_order(search, depth + 1, greedy_rows, cost + greedy_rows);
+        search->placed[greedy_pick] = false;
+    }
+}
+
+bool join_order_choose(double base_rows, const JoinCandidate* joins, int join_count,
+                       int* order, double* estimated_rows) {
+    if (join_count <= 0) return true;
+
+    OrderSearch search = {0};
+    search.joins = joins;
+    search.join_count = join_count;
+    search.exhaustive = join_count <= EXHAUSTIVE_JOIN_LIMIT;
+    search.placed = calloc(join_count, sizeof(bool));
+    search.order = malloc(sizeof(int) * join_count);
+    search.rows = malloc(sizeof(double) * join_count);
+    search.best_order = order;
+    search.best_rows = estimated_rows;
+
+    search_order(&search, 0, base_rows, 0);
+
+    free(search.placed);
+    free(search.order);
+    free(search.rows);
+    return search.found;
+}
@@ -0,0 +1,755 @@
+/* evaluator_subquery.c - cached evaluation of scalar and IN subqueries
+ *
+ * every execution of a subquery records which outer columns resolve_column
+ * handed out. a subquery that reads none is uncorrelated and runs once per
+ * query; otherwise results are memoized by the values of the outer columns
+ * read so far. evaluation is deterministic, so two outer rows that agree on
+ * those columns take the same path through the subquery and get the same result.
+ * when a run reads a column that is not part of the key yet, the key grows and
+ * older entries are dropped.
+ *
+ * aggregate subqueries whose only link to the outer query is a conjunction of
+ * inner_column = outer_column equalities are decorrelated instead: the inner
+ * table is filtered and grouped by the inner columns once, which turns the
+ * per row subquery into a hash lookup. IN subqueries of the same shape, without
+ * the aggregate, become a semi join the same way: one set of selected values per
+ * group, probed with the outer row's key */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "evaluator.h"
+#include "csv_reader.h"
+#include "string_utils.h"
+#include "evaluator/evaluator_internal.h"
+#include "evaluator/evaluator_hash.h"
+#include "evaluator/evaluator_utils.h"
+#include "evaluator/evaluator_joins.h"
+#include "evaluator/evaluator_conditions.h"
+#include "evaluator/evaluator_expressions.h"
+#include "evaluator/evaluator_aggregates.h"
+#include "evaluator/evaluator_subquery.h"
+#include "profile.h"
+
+static void clear_entries(SubqueryCache* cache) {
+    for (int i = 0; i < cache->capacity; i++) {
+        SubqueryMemoEntry* entry = &cache->entries[i];
+        if (!entry->used) continue;
+        for (int k = 0; k < entry->key.column_count; k++) {
+            value_free(&entry->key.values[k]);
+        }
+        free(entry->key.values);
+        value_free(&entry->value);
+        value_hash_set_free(entry->members);
+    }
+    free(cache->entries);
+    cache->entries = NULL;
+    cache->capacity = 0;
+    cache->count = 0;
+}
+
+static void reset_cache(SubqueryCache* cache, CsvTable* outer_table) {
+    clear_entries(cache);
+    free(cache->key_columns);
+    free(cache->probe_values);
+    free(cache->inner_key_types);
+    if (cache->decorrelated) {
+        value_free(&cache->empty_group_value);
+    }
+    cache->key_columns = NULL;
+    cache->probe_values = NULL;
+    cache->inner_key_types = NULL;
+    cache->key_count = 0;
+    cache->decorrelation_tried = false;
+    cache->decorrelated = false;
+    cache->outer_table = outer_table;
+}
+
+static SubqueryCache* get_subquery_cache(QueryContext* ctx, ASTNode* subquery, CsvTable* outer_table) {
+    for (int i = 0; i < ctx->subquery_cache_count; i++) {
+        SubqueryCache* cache = &ctx->subquery_caches[i];
+        if (cache->subquery == subquery) {
+            // same subquery evaluated against another table (e.g. a JOIN condition)
+            if (cache->outer_table != outer_table) {
+                reset_cache(cache, outer_table);
+            }
+            return cache;
+        }
+    }
+
+    ctx->subquery_caches = realloc(ctx->subquery_caches, sizeof(SubqueryCache) * (ctx->subquery_cache_count + 1));
+    SubqueryCache* cache = &ctx->subquery_caches[ctx->subquery_cache_count++];
+    memset(cache, 0, sizeof(SubqueryCache));
+    cache->subquery = subquery;
+    cache->outer_table = outer_table;
+    return cache;
+}
+
+/* build the lookup key for the outer row, values are borrowed */
+static Row probe_key(SubqueryCache* cache, Row* outer_row) {
+    Row probe;
+    probe.column_count = cache->key_count;
+    probe.values = cache->probe_values;
+    for (int k = 0; k < cache->key_count; k++) {
+        probe.values[k] = outer_row->values[cache->key_columns[k]];
+    }
+    return probe;
+}
+
+static int find_entry_slot(SubqueryMemoEntry* entries, int capacity, uint64_t hash, const Row* key) {
+    int mask = capacity - 1;
+    int slot = (int)(hash & (uint64_t)mask);
+
+    PROFILE_COUNT(hash_probes);
+    while (entries[slot].used) {
+        if (entries[slot].hash == hash && rows_equal(&entries[slot].key, key, key->column_count)) {
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+        PROFILE_COUNT(hash_probes);
+    }
+    return slot;
+}
+
+static void grow_entries(SubqueryCache* cache) {
+    int new_capacity = cache->capacity ? cache->capacity * 2 : 16;
+    SubqueryMemoEntry* new_entries = calloc(new_capacity, sizeof(SubqueryMemoEntry));
+    int mask = new_capacity - 1;
+
+    for (int i = 0; i < cache->capacity; i++) {
+        if (!cache->entries[i].used) continue;
+        int slot = (int)(cache->entries[i].hash & (uint64_t)mask);
+        while (new_entries[slot].used) slot = (slot + 1) & mask;
+        new_entries[slot] = cache->entries[i];
+    }
+
+    free(cache->entries);
+    cache->entries = new_entries;
+    cache->capacity = new_capacity;
+}
+
+/* add every outer column read by the last run to the key, returns true if the key changed */
+static bool extend_key(SubqueryCache* cache, const bool* columns_read, int column_count) {
+    bool grew = false;
+    for (int c = 0; c < column_count; c++) {
+        if (!columns_read[c]) continue;
+
+        bool present = false;
+        for (int k = 0; k < cache->key_count; k++) {
+            if (cache->key_columns[k] == c) {
+                present = true;
+                break;
+            }
+        }
+        if (present) continue;
+
+        cache->key_columns = realloc(cache->key_columns, sizeof(int) * (cache->key_count + 1));
+        cache->key_columns[cache->key_count++] = c;
+        grew = true;
+    }
+
+    if (grew) {
+        cache->probe_values = realloc(cache->probe_values, sizeof(Value) * cache->key_count);
+    }
+    return grew;
+}
+
+static bool entry_result(const SubqueryMemoEntry* entry, Value* out, int* row_count, int* column_count) {
+    if (row_count) *row_count = entry->row_count;
+    if (column_count) *column_count = entry->column_count;
+
+    if (entry->row_count != 1 || entry->column_count != 1) {
+        return false;
+    }
+    value_deep_copy(out, &entry->value);
+    return true;
+}
+
+/* store an entry under a deep copy of key, the entry's values are taken over */
+static SubqueryMemoEntry* insert_entry(SubqueryCache* cache, const Row* key, SubqueryMemoEntry* entry) {
+    if ((cache->count + 1) * 2 > cache->capacity) {
+        grow_entries(cache);
+    }
+
+    entry->hash = row_hash(key, key->column_count);
+    entry->key.column_count = key->column_count;
+    entry->key.values = malloc(sizeof(Value) * (key->column_count > 0 ? key->column_count : 1));
+    for (int k = 0; k < key->column_count; k++) {
+        value_deep_copy(&entry->key.values[k], &key->values[k]);
+    }
+    entry->used = true;
+
+    int slot = find_entry_slot(cache->entries, cache->capacity, entry->hash, &entry->key);
+    cache->entries[slot] = *entry;
+    cache->count++;
+    return &cache->entries[slot];
+}
+
+/* execute the subquery and keep the shape and scalar value of its result, or with membership
+ * the set of values of a one column result */
+static SubqueryMemoEntry run_subquery(ASTNode* subquery, Row* outer_row, CsvTable* outer_table,
+                                      bool* columns_read, bool membership) {
+    SubqueryMemoEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.value.type = VALUE_TYPE_NULL;
+    entry.row_count = -1;
+
+    ResultSet* subquery_result = evaluate_correlated_query(subquery, outer_row, outer_table, columns_read);
+    if (subquery_result) {
+        entry.row_count = subquery_result->row_count;
+        entry.column_count = subquery_result->column_count;
+        if (membership && entry.column_count == 1) {
+            entry.members = value_hash_set_create(entry.row_count);
+            for (int i = 0; i < entry.row_count; i++) {
+                value_hash_set_add(entry.members, &subquery_result->rows[i].values[0]);
+            }
+        } else if (entry.row_count == 1 && entry.column_count == 1) {
+            value_deep_copy(&entry.value, &subquery_result->rows[0].values[0]);
+        }
+        csv_free(subquery_result);
+    }
+    return entry;
+}
+
+/* ===== decorrelation ===== */
+
+typedef enum {
+    COLUMN_REF_INNER,
+    COLUMN_REF_OUTER,
+    COLUMN_REF_UNKNOWN
+} ColumnRef;
+
+/* where an identifier of the subquery resolves, following resolve_column */
+static ColumnRef classify_column(QueryContext* inner, CsvTable* outer_table, const char* name, int* outer_index) {
+    if (strcmp(name, "*") == 0) return COLUMN_REF_INNER;
+    if (csv_get_column_index(inner->tables[0].table, name) >= 0) return COLUMN_REF_INNER;
+
+    const char* col_name = name;
+    const char* dot = strchr(name, '.');
+    if (dot) {
+        char* table_alias = cq_strndup(name, dot - name);
+        TableRef* table_ref = context_get_table(inner, table_alias);
+        free(table_alias);
+
+        col_name = dot + 1;
+        if (table_ref && csv_get_column_index(table_ref->table, col_name) >= 0) {
+            return COLUMN_REF_INNER;
+        }
+    }
+
+    int col_index = csv_get_column_index(outer_table, col_name);
+    if (col_index >= 0) {
+        if (outer_index) *outer_index = col_index;
+        return COLUMN_REF_OUTER;
+    }
+    return COLUMN_REF_UNKNOWN;
+}
+
+/* true if the expression reads inner columns only, nested subqueries never see our outer row */
+static bool is_inner_expression(QueryContext* inner, CsvTable* outer_table, ASTNode* expr) {
+    if (!expr) return true;
+
+    switch (expr->type) {
+        case NODE_TYPE_LITERAL:
+        case NODE_TYPE_SUBQUERY:
+            return true;
+        case NODE_TYPE_IDENTIFIER:
+            return classify_column(inner, outer_table, expr->identifier, NULL) == COLUMN_REF_INNER;
+        case NODE_TYPE_BINARY_OP:
+            return is_inner_expression(inner, outer_table, expr->binary_op.left) &&
+                   is_inner_expression(inner, outer_table, expr->binary_op.right);
+        case NODE_TYPE_CONDITION:
+            return is_inner_expression(inner, outer_table, expr->condition.left) &&
+                   is_inner_expression(inner, outer_table, expr->condition.right);
+        case NODE_TYPE_FUNCTION:
+            for (int i = 0; i < expr->function.arg_count; i++) {
+                if (!is_inner_expression(inner, outer_table, expr->function.args[i])) return false;
+            }
+            return true;
+        case NODE_TYPE_LIST:
+            for (int i = 0; i < expr->list.node_count; i++) {
+                if (!is_inner_expression(inner, outer_table, expr->list.nodes[i])) return false;
+            }
+            return true;
+        case NODE_TYPE_CASE:
+            if (!is_inner_expression(inner, outer_table, expr->case_expr.case_expr)) return false;
+            if (!is_inner_expression(inner, outer_table, expr->case_expr.else_expr)) return false;
+            for (int i = 0; i < expr->case_expr.when_count; i++) {
+                if (!is_inner_expression(inner, outer_table, expr->case_expr.when_exprs[i]) ||
+                    !is_inner_expression(inner, outer_table, expr->case_expr.then_exprs[i])) {
+                    return false;
+                }
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void collect_conjuncts(ASTNode* condition, ASTNode*** conjuncts, int* count) {
+    if (!condition) return;
+
+    if (condition->type == NODE_TYPE_CONDITION && strcasecmp(condition->condition.operator, "AND") == 0) {
+        collect_conjuncts(condition->condition.left, conjuncts, count);
+        collect_conjuncts(condition->condition.right, conjuncts, count);
+        return;
+    }
+
+    *conjuncts = realloc(*conjuncts, sizeof(ASTNode*) * (*count + 1));
+    (*conjuncts)[(*count)++] = condition;
+}
+
+/* inner_column = outer_column in either order */
+static bool match_correlation(QueryContext* inner, CsvTable* outer_table, ASTNode* condition,
+                              ASTNode** inner_side, int* outer_index) {
+    if (condition->type != NODE_TYPE_CONDITION || strcmp(condition->condition.operator, "=") != 0) return false;
+
+    ASTNode* left = condition->condition.left;
+    ASTNode* right = condition->condition.right;
+    if (!left || !right || left->type != NODE_TYPE_IDENTIFIER || right->type != NODE_TYPE_IDENTIFIER) return false;
+
+    ColumnRef left_ref = classify_column(inner, outer_table, left->identifier, outer_index);
+    ColumnRef right_ref = classify_column(inner, outer_table, right->identifier, outer_index);
+
+    if (left_ref == COLUMN_REF_INNER && right_ref == COLUMN_REF_OUTER) {
+        *inner_side = left;
+        return true;
+    }
+    if (left_ref == COLUMN_REF_OUTER && right_ref == COLUMN_REF_INNER) {
+        *inner_side = right;
+        return true;
+    }
+    return false;
+}
+
+/* subquery shapes that are a single aggregate over one table */
+static bool is_decorrelation_candidate(ASTNode* query) {
+    if (!query || query->type != NODE_TYPE_QUERY) return false;
+    if (!query->query.from || query->query.join_count > 0 || query->query.having) return false;
+    if (!query->query.where) return false;
+    if (query->query.group_by && query->query.group_by->group_by.column_count > 0) return false;
+
+    // a single row survives any LIMIT of at least one and no OFFSET
+    if (query->query.limit == 0 || query->query.offset > 0) return false;
+
+    ASTNode* select_node = query->query.select;
+    if (!select_node || select_node->select.column_count != 1 || !select_node->select.column_nodes) return false;
+
+    ASTNode* column = select_node->select.column_nodes[0];
+    return column && column->type == NODE_TYPE_FUNCTION && is_aggregate_function(column->function.name);
+}
+
+/* IN subquery shapes that select one plain expression from one table, no LIMIT or OFFSET
+ * since they would cut the rows of all groups at once */
+static bool is_membership_candidate(ASTNode* query) {
+    if (!query || query->type != NODE_TYPE_QUERY) return false;
+    if (!query->query.from || query->query.join_count > 0 || query->query.having) return false;
+    if (!query->query.where) return false;
+    if (query->query.group_by && query->query.group_by->group_by.column_count > 0) return false;
+    if (query->query.limit >= 0 || query->query.offset > 0) return false;
+
+    ASTNode* select_node = query->query.select;
+    if (!select_node || select_node->select.column_count != 1 || !select_node->select.column_nodes) return false;
+
+    ASTNode* column = select_node->select.column_nodes[0];
+    if (!column || (column->type == NODE_TYPE_IDENTIFIER && strcmp(column->identifier, "*") == 0)) return false;
+    return column->type != NODE_TYPE_FUNCTION || !is_aggregate_function(column->function.name);
+}
+
+/* add a group for key unless an equal key is present, returns the group index */
+static int find_or_add_group(GroupResult* groups, Row** group_keys, int** slots, int* slot_capacity,
+                             const Row* key) {
+    if ((groups->group_count + 1) * 2 > *slot_capacity) {
+        int new_capacity = *slot_capacity * 2;
+        int* new_slots = malloc(sizeof(int) * new_capacity);
+        for (int i = 0; i < new_capacity; i++) new_slots[i] = -1;
+        for (int g = 0; g < groups->group_count; g++) {
+            int slot = (int)(row_hash(&(*group_keys)[g], key->column_count) & (uint64_t)(new_capacity - 1));
+            while (new_slots[slot] >= 0) slot = (slot + 1) & (new_capacity - 1);
+            new_slots[slot] = g;
+        }
+        free(*slots);
+        *slots = new_slots;
+        *slot_capacity = new_capacity;
+    }
+
+    int mask = *slot_capacity - 1;
+    int slot = (int)(row_hash(key, key->column_count) & (uint64_t)mask);
+    while ((*slots)[slot] >= 0) {
+        int g = (*slots)[slot];
+        if (rows_equal(&(*group_keys)[g], key, key->column_count)) return g;
+        slot = (slot + 1) & mask;
+    }
+
+    if (groups->group_count >= groups->group_capacity) {
+        groups->group_capacity *= 2;
+        groups->groups = realloc(groups->groups, sizeof(GroupedRows) * groups->group_capacity);
+        *group_keys = realloc(*group_keys, sizeof(Row) * groups->group_capacity);
+    }
+
+    int g = groups->group_count++;
+    GroupedRows* group = &groups->groups[g];
+    group->group_key = strdup("");
+    group->row_capacity = 4;
+    group->rows = malloc(sizeof(Row*) * group->row_capacity);
+    group->row_count = 0;
+
+    // key values are borrowed from the inner table
+    (*group_keys)[g].column_count = key->column_count;
+    (*group_keys)[g].values = malloc(sizeof(Value) * key->column_count);
+    memcpy((*group_keys)[g].values, key->values, sizeof(Value) * key->column_count);
+
+    (*slots)[slot] = g;
+    return g;
+}
+
+/* aggregate every group of the inner table in one pass and fill the cache with the results */
+static void fill_decorrelated(SubqueryCache* cache, QueryContext* inner, ASTNode** filters, int filter_count,
+                              ASTNode** inner_keys) {
+    CsvTable* table = inner->tables[0].table;
+    int key_count = cache->key_count;
+
+    GroupResult* groups = calloc(1, sizeof(GroupResult));
+    groups->group_capacity = 16;
+    groups->groups = malloc(sizeof(GroupedRows) * groups->group_capacity);
+    Row* group_keys = malloc(sizeof(Row) * groups->group_capacity);
+    int slot_capacity = 32;
+    int* slots = malloc(sizeof(int) * slot_capacity);
+    for (int i = 0; i < slot_capacity; i++) slots[i] = -1;
+
+    Value* key_values = malloc(sizeof(Value) * key_count);
+    Row key = { .values = key_values, .column_count = key_count };
+    Value null_value = { .type = VALUE_TYPE_NULL };
+
+    for (int i = 0; i < table->row_count; i++) {
+        Row* row = &table->rows[i];
+
+        bool matches = true;
+        for (int f = 0; f < filter_count && matches; f++) {
+            matches = evaluate_condition(inner, filters[f], row, 0);
+        }
+        if (!matches) continue;
+
+        for (int k = 0; k < key_count; k++) {
+            Value* value = resolve_column(inner, inner_keys[k]->identifier, row, 0);
+            key_values[k] = value ? *value : null_value;
+            cache->inner_key_types[k] |= value_class(&key_values[k]);
+        }
+
+        int g = find_or_add_group(groups, &group_keys, &slots, &slot_capacity, &key);
+        GroupedRows* group = &groups->groups[g];
+        if (group->row_count >= group->row_capacity) {
+            group->row_capacity *= 2;
+            group->rows = realloc(group->rows, sizeof(Row*) * group->row_capacity);
+        }
+        group->rows[group->row_count++] = row;
+    }
+
+    // trailing empty group gives the aggregate over no rows, e.g. COUNT = 0
+    int key_group_count = groups->group_count;
+    if (groups->group_count >= groups->group_capacity) {
+        groups->group_capacity *= 2;
+        groups->groups = realloc(groups->groups, sizeof(GroupedRows) * groups->group_capacity);
+    }
+    GroupedRows* empty = &groups->groups[groups->group_count++];
+    empty->group_key = strdup("");
+    empty->rows = NULL;
+    empty->row_count = 0;
+    empty->row_capacity = 0;
+
+    ResultSet* result = build_aggregated_result(inner, groups, inner->query->query.select);
+
+    for (int g = 0; g < key_group_count; g++) {
+        SubqueryMemoEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.row_count = 1;
+        entry.column_count = 1;
+        value_deep_copy(&entry.value, &result->rows[g].values[0]);
+        insert_entry(cache, &group_keys[g], &entry);
+        free(group_keys[g].values);
+    }
+    value_deep_copy(&cache->empty_group_value, &result->rows[key_group_count].values[0]);
+
+    csv_free(result);
+    free_groups(groups);
+    free(group_keys);
+    free(slots);
+    free(key_values);
+}
+
+/* collect the selected values of every group of the inner table into its cache entry, the
+ * semi join form of an IN subquery */
+static void fill_membership(SubqueryCache* cache, QueryContext* inner, ASTNode** filters, int filter_count,
+                            ASTNode** inner_keys) {
+    CsvTable* table = inner->tables[0].table;
+    ASTNode* selected = inner->query->query.select->select.column_nodes[0];
+    int key_count = cache->key_count;
+
+    Value* key_values = malloc(sizeof(Value) * key_count);
+    Row key = { .values = key_values, .column_count = key_count };
+    Value null_value = { .type = VALUE_TYPE_NULL };
+
+    for (int i = 0; i < table->row_count; i++) {
+        Row* row = &table->rows[i];
+
+        bool matches = true;
+        for (int f = 0; f < filter_count && matches; f++) {
+            matches = evaluate_condition(inner, filters[f], row, 0);
+        }
+        if (!matches) continue;
+
+        for (int k = 0; k < key_count; k++) {
+            Value* value = resolve_column(inner, inner_keys[k]->identifier, row, 0);
+            key_values[k] = value ? *value : null_value;
+            cache->inner_key_types[k] |= value_class(&key_values[k]);
+        }
+
+        SubqueryMemoEntry* entry = NULL;
+        uint64_t hash = row_hash(&key, key_count);
+        if (cache->capacity > 0) {
+            int slot = find_entry_slot(cache->entries, cache->capacity, hash, &key);
+            if (cache->entries[slot].used) entry = &cache->entries[slot];
+        }
+        if (!entry) {
+            SubqueryMemoEntry group;
+            memset(&group, 0, sizeof(group));
+            group.column_count = 1;
+            group.members = value_hash_set_create(0);
+            entry = insert_entry(cache, &key, &group);
+        }
+        entry->row_count++;
+
+        Value selected_value = evaluate_expression(inner, selected, row, 0);
+        value_hash_set_add(entry->members, &selected_value);
+        value_free(&selected_value);
+    }
+    free(key_values);
+}
+
+/* rewrite the subquery into a grouped aggregate, or with membership a set per group, joined
+ * on its correlation columns */
+static bool try_decorrelate(SubqueryCache* cache, CsvTable* outer_table, bool membership) {
+    ASTNode* query = cache->subquery;
+    if (!outer_table) return false;
+    if (membership ? !is_membership_candidate(query) : !is_decorrelation_candidate(query)) return false;
+
+    QueryContext* inner = context_create(query);
+    const char* table_alias = NULL;
+    CsvTable* source_table = load_from_table(query->query.from, &table_alias, inner);
+    if (!source_table) {
+        context_free(inner);
+        return false;
+    }
+    inner->table_count = 1;
+    inner->tables = malloc(sizeof(TableRef));
+    inner->tables[0].alias = strdup(table_alias);
+    inner->tables[0].table = source_table;
+
+    ASTNode** conjuncts = NULL;
+    int conjunct_count = 0;
+    collect_conjuncts(query->query.where, &conjuncts, &conjunct_count);
+
+    ASTNode** filters = malloc(sizeof(ASTNode*) * conjunct_count);
+    ASTNode** inner_keys = malloc(sizeof(ASTNode*) * conjunct_count);
+    int* outer_keys = malloc(sizeof(int) * conjunct_count);
+    int filter_count = 0;
+    int key_count = 0;
+    bool eligible = is_inner_expression(inner, outer_table, query->query.select->select.column_nodes[0]);
+
+    for (int i = 0; i < conjunct_count && eligible; i++) {
+        if (is_inner_expression(inner, outer_table, conjuncts[i])) {
+            filters[filter_count++] = conjuncts[i];
+        } else if (match_correlation(inner, outer_table, conjuncts[i], &inner_keys[key_count], &outer_keys[key_count])) {
+            key_count++;
+        } else {
+            eligible = false;
+        }
+    }
+
+    // without a correlation column the memo already runs the subquery once
+    if (eligible && key_count > 0) {
+        cache->key_columns = outer_keys;
+        cache->key_count = key_count;
+        cache->probe_values = malloc(sizeof(Value) * key_count);
+        cache->inner_key_types = calloc(key_count, sizeof(int));
+        if (membership) {
+            fill_membership(cache, inner, filters, filter_count, inner_keys);
+        } else {
+            fill_decorrelated(cache, inner, filters, filter_count, inner_keys);
+        }
+        cache->decorrelated = true;
+        outer_keys = NULL;
+    }
+
+    free(outer_keys);
+    free(inner_keys);
+    free(filters);
+    free(conjuncts);
+    context_free(inner);
+    return cache->decorrelated;
+}
+
+static bool evaluate_decorrelated(SubqueryCache* cache, Row* outer_row, CsvTable* outer_table, Value* out,
+                                  int* row_count, int* column_count) {
+    // a hash probe can not reproduce equality between values of different classes,
+    // such rows run the subquery itself
+    for (int k = 0; k < cache->key_count; k++) {
+        int outer_class = value_class(&outer_row->values[cache->key_columns[k]]);
+        if (outer_class && (cache->inner_key_types[k] & ~outer_class)) {
+            SubqueryMemoEntry entry = run_subquery(cache->subquery, outer_row, outer_table, NULL, false);
+            bool ok = entry_result(&entry, out, row_count, column_count);
+            value_free(&entry.value);
+            return ok;
+        }
+    }
+
+    Row probe = probe_key(cache, outer_row);
+    uint64_t hash = row_hash(&probe, probe.column_count);
+    int slot = cache->capacity > 0 ? find_entry_slot(cache->entries, cache->capacity, hash, &probe) : -1;
+    if (slot >= 0 && cache->entries[slot].used) {
+        return entry_result(&cache->entries[slot], out, row_count, column_count);
+    }
+
+    if (row_count) *row_count = 1;
+    if (column_count) *column_count = 1;
+    value_deep_copy(out, &cache->empty_group_value);
+    return true;
+}
+
+/* ===== evaluation ===== */
+
+static void free_entry_values(SubqueryMemoEntry* entry) {
+    value_free(&entry->value);
+    value_hash_set_free(entry->members);
+    entry->members = NULL;
+}
+
+/* the memoized result for the outer row, running the subquery on a miss. a result that can
+ * not be keyed, without an outer row, is left in *uncached for the caller to free */
+static SubqueryMemoEntry* memo_entry(SubqueryCache* cache, Row* outer_row, CsvTable* outer_table,
+                                     bool membership, SubqueryMemoEntry* uncached) {
+    // a keyed cache needs an outer row to build the key from
+    bool cacheable = (outer_row != NULL || cache->key_count == 0);
+
+    if (cacheable && cache->count > 0) {
+        Row probe = probe_key(cache, outer_row);
+        uint64_t hash = row_hash(&probe, probe.column_count);
+        int slot = find_entry_slot(cache->entries, cache->capacity, hash, &probe);
+        if (cache->entries[slot].used) {
+            return &cache->entries[slot];
+        }
+    }
+
+    // cache miss, run the subquery and record the outer columns it reads
+    int outer_column_count = (outer_row && outer_table) ? outer_table->column_count : 0;
+    bool* columns_read = outer_column_count > 0 ? calloc(outer_column_count, sizeof(bool)) : NULL;
+
+    *uncached = run_subquery(cache->subquery, outer_row, outer_table, columns_read, membership);
+    cache->evaluations++;
+
+    if (columns_read && extend_key(cache, columns_read, outer_column_count)) {
+        // entries keyed on fewer columns can not be probed with the new key
+        clear_entries(cache);
+        cacheable = true;
+    }
+    free(columns_read);
+
+    if (!cacheable) return uncached;
+
+    Row probe = probe_key(cache, outer_row);
+    return insert_entry(cache, &probe, uncached);
+}
+
+bool evaluate_scalar_subquery(QueryContext* ctx, ASTNode* subquery, Row* outer_row,
+                              CsvTable* outer_table, Value* out,
+                              int* row_count, int* column_count) {
+    out->type = VALUE_TYPE_NULL;
+    if (row_count) *row_count = -1;
+    if (column_count) *column_count = 0;
+    if (!ctx || !subquery) return false;
+
+    SubqueryCache* cache = get_subquery_cache(ctx, subquery, outer_table);
+
+    if (!cache->decorrelation_tried && outer_row) {
+        cache->decorrelation_tried = true;
+        try_decorrelate(cache, outer_table, false);
+    }
+
+    if (cache->decorrelated) {
+        if (outer_row) {
+            return evaluate_decorrelated(cache, outer_row, outer_table, out, row_count, column_count);
+        }
+        SubqueryMemoEntry entry = run_subquery(subquery, outer_row, outer_table, NULL, false);
+        bool ok = entry_result(&entry, out, row_count, column_count);
+        value_free(&entry.value);
+        return ok;
+    }
+
+    SubqueryMemoEntry uncached;
+    SubqueryMemoEntry* entry = memo_entry(cache, outer_row, outer_table, false, &uncached);
+    bool ok = entry_result(entry, out, row_count, column_count);
+    if (entry == &uncached) free_entry_values(&uncached);
+    return ok;
+}
+
+/* the decorrelated set of the outer row's key, NULL for a key no inner row has. a key of
+ * another class than the inner ones runs the subquery into *uncached, as for scalars */
+static SubqueryMemoEntry* decorrelated_members(SubqueryCache* cache, Row* outer_row, CsvTable* outer_table,
+                                              SubqueryMemoEntry* uncached) {
+    for (int k = 0; k < cache->key_count; k++) {
+        int outer_class = value_class(&outer_row->values[cache->key_columns[k]]);
+        if (outer_class && (cache->inner_key_types[k] & ~outer_class)) {
+            *uncached = run_subquery(cache->subquery, outer_row, outer_table, NULL, true);
+            return uncached;
+        }
+    }
+
+    Row probe = probe_key(cache, outer_row);
+    uint64_t hash = row_hash(&probe, probe.column_count);
+    int slot = cache->capacity > 0 ? find_entry_slot(cache->entries, cache->capacity, hash, &probe) : -1;
+    return slot >= 0 && cache->entries[slot].used ? &cache->entries[slot] : NULL;
+}
+
+bool evaluate_in_subquery(QueryContext* ctx, ASTNode* subquery, Row* outer_row, CsvTable* outer_table,
+                          const Value* needle, bool* found) {
+    *found = false;
+    if (!ctx || !subquery) return true;
+
+    SubqueryCache* cache = get_subquery_cache(ctx, subquery, outer_table);
+
+    if (!cache->decorrelation_tried && outer_row) {
+        cache->decorrelation_tried = true;
+        try_decorrelate(cache, outer_table, true);
+    }
+
+    SubqueryMemoEntry uncached;
+    memset(&uncached, 0, sizeof(uncached));
+    SubqueryMemoEntry* entry;
+    if (cache->decorrelated && outer_row) {
+        entry = decorrelated_members(cache, outer_row, outer_table, &uncached);
+        if (!entry) return true;
+    } else if (cache->decorrelated) {
+        uncached = run_subquery(subquery, outer_row, outer_table, NULL, true);
+        entry = &uncached;
+    } else {
+        entry = memo_entry(cache, outer_row, outer_table, true, &uncached);
+    }
+
+    // a failed subquery behaves as an empty set
+    bool ok = entry->row_count < 0 || entry->column_count == 1;
+    *found = entry->members && value_hash_set_contains(entry->members, needle);
+    if (entry == &uncached) free_entry_values(&uncached);
+    return ok;
+}
+
+void free_subquery_caches(QueryContext* ctx) {
+    if (!ctx) return;
+
+    for (int i = 0; i < ctx->subquery_cache_count; i++) {
+        reset_cache(&ctx->subquery_caches[i], NULL);
+    }
+    free(ctx->subquery_caches);
+    ctx->subquery_caches = NULL;
+    ctx->subquery_cache_count = 0;
+}
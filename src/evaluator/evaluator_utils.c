@@ -14,7 +14,10 @@
 #include "evaluator/evaluator_window.h"
 #include "evaluator/evaluator_core.h"
 #include "evaluator/evaluator_functions.h"
+#include "evaluator/evaluator_hash.h"
+#include "evaluator/evaluator_subquery.h"
 #include "evaluator/evaluator_internal.h"
+#include "profile.h"
 
 /* forward declarations */
 static int parse_function_arguments(const char* args_str, QueryContext* ctx, 
@@ -23,6 +26,7 @@ static int parse_function_arguments(const char* args_str, QueryContext* ctx,
 /* deep copy a value to handle string duplication */
 void value_deep_copy(Value* dst, const Value* src) {
     if (!dst || !src) return;
+    PROFILE_COUNT(deep_copies);
     
     dst->type = src->type;
     
@@ -41,6 +45,10 @@ void value_deep_copy(Value* dst, const Value* src) {
             break;
         case VALUE_TYPE_STRING:
             dst->string_value = src->string_value ? strdup(src->string_value) : NULL;
+            if (profile_counters.enabled && dst->string_value) {
+                profile_counters.allocations++;
+                profile_counters.allocated_bytes += (long long)strlen(dst->string_value) + 1;
+            }
             break;
     }
 }
@@ -245,22 +253,29 @@ Value evaluate_column_expression(const char* col_spec, QueryContext* ctx,
     return result;
 }
 
-/* build result for non-aggregated queries */
-ResultSet* build_result(QueryContext* ctx, Row** filtered_rows, int row_count) {
-    if (!ctx || !ctx->query) return NULL;
-    
-    // create result table
-    ResultSet* result = calloc(1, sizeof(ResultSet));
-    result->filename = strdup("query_result");
-    result->has_header = true;
-    result->delimiter = ',';
-    result->quote = '"';
-    
-    // get selected columns from SELECT clause
+/* display name of a SELECT column and the column text it reads, "a.x AS y" is named y and reads a.x */
+static char* projected_column_name(const char* col_spec, char col_name[256]) {
+    char* alias = extract_column_alias(col_spec);
+    if (alias) {
+        const char* as_pos = cq_strcasestr(col_spec, " AS ");
+        int col_len = as_pos - col_spec;
+        strncpy(col_name, col_spec, col_len);
+        col_name[col_len] = '\0';
+        return alias;
+    }
+    
+    strcpy(col_name, col_spec);
+    // a function is shown as written, a column without its table prefix
+    if (strchr(col_name, '(')) return strdup(col_name);
+    const char* dot = strchr(col_name, '.');
+    return strdup(dot ? dot + 1 : col_name);
+}
+
+/* resolve the SELECT list against the table of ctx once, * expands to every table column */
+Projection* projection_create(QueryContext* ctx) {
     ASTNode* select_node = ctx->query->query.select;
-    if (!select_node) return result;
+    CsvTable* table = ctx->tables[0].table;
     
-    // check if we have * in the column list - need to expand it
     bool has_star = false;
     for (int i = 0; i < select_node->select.column_count; i++) {
         if (strcmp(select_node->select.columns[i], "*") == 0) {
@@ -269,204 +284,113 @@ ResultSet* build_result(QueryContext* ctx, Row** filtered_rows, int row_count) {
         }
     }
     
-    if (has_star) {
-        // expand * to all columns
-        int total_columns = (select_node->select.column_count - 1) + ctx->tables[0].table->column_count;
-        result->column_count = total_columns;
-        result->columns = malloc(sizeof(Column) * total_columns);
-        
-        // build column specs array with * expanded
-        char** expanded_specs = malloc(sizeof(char*) * total_columns);
-        int* column_indices = malloc(sizeof(int) * total_columns);
-        int* original_indices = malloc(sizeof(int) * total_columns); // track original column index
-        int col_idx = 0;
-        
-        for (int i = 0; i < select_node->select.column_count; i++) {
-            if (strcmp(select_node->select.columns[i], "*") == 0) {
-                // expand * to all table columns
-                for (int j = 0; j < ctx->tables[0].table->column_count; j++) {
-                    expanded_specs[col_idx] = strdup(ctx->tables[0].table->columns[j].name);
-                    result->columns[col_idx].name = strdup(ctx->tables[0].table->columns[j].name);
-                    result->columns[col_idx].inferred_type = VALUE_TYPE_STRING;
-                    column_indices[col_idx] = j;
-                    original_indices[col_idx] = -1; // star columns don't have AST nodes
-                    col_idx++;
-                }
-            } else {
-                // regular column or function
-                expanded_specs[col_idx] = strdup(select_node->select.columns[i]);
-                original_indices[col_idx] = i; // track which original column this is
-                
-                // parse column name for display
-                const char* col_spec = select_node->select.columns[i];
-                char col_name[256];
-                const char* as_pos = cq_strcasestr(col_spec, " AS ");
-                if (as_pos) {
-                    const char* alias_start = as_pos + 4;
-                    result->columns[col_idx].name = strdup(alias_start);
-                    
-                    int col_len = as_pos - col_spec;
-                    strncpy(col_name, col_spec, col_len);
-                    col_name[col_len] = '\0';
-                } else {
-                    strcpy(col_name, col_spec);
-                    if (strchr(col_name, '(')) {
-                        result->columns[col_idx].name = strdup(col_name);
-                    } else {
-                        const char* dot = strchr(col_name, '.');
-                        if (dot) {
-                            result->columns[col_idx].name = strdup(dot + 1);
-                        } else {
-                            result->columns[col_idx].name = strdup(col_name);
-                        }
-                    }
-                }
-                
-                result->columns[col_idx].inferred_type = VALUE_TYPE_STRING;
-                
-                // find column index (if not a function)
-                column_indices[col_idx] = -1;
-                if (!strchr(col_name, '(')) {
-                    column_indices[col_idx] = find_column_index(ctx->tables[0].table, col_name);
-                }
-                
+    Projection* projection = calloc(1, sizeof(Projection));
+    int total_columns = select_node->select.column_count;
+    if (has_star) total_columns += table->column_count - 1;
+    projection->column_count = total_columns;
+    projection->columns = malloc(sizeof(Column) * (total_columns > 0 ? total_columns : 1));
+    projection->specs = malloc(sizeof(char*) * (total_columns > 0 ? total_columns : 1));
+    projection->column_indices = malloc(sizeof(int) * (total_columns > 0 ? total_columns : 1));
+    projection->nodes = malloc(sizeof(ASTNode*) * (total_columns > 0 ? total_columns : 1));
+    
+    int col_idx = 0;
+    for (int i = 0; i < select_node->select.column_count; i++) {
+        const char* col_spec = select_node->select.columns[i];
+        if (strcmp(col_spec, "*") == 0) {
+            // star columns have no AST nodes
+            for (int j = 0; j < table->column_count; j++) {
+                projection->specs[col_idx] = strdup(table->columns[j].name);
+                projection->columns[col_idx].name = strdup(table->columns[j].name);
+                projection->columns[col_idx].inferred_type = VALUE_TYPE_STRING;
+                projection->column_indices[col_idx] = j;
+                projection->nodes[col_idx] = NULL;
                 col_idx++;
             }
+            continue;
         }
         
-        // build rows with expanded columns
-        result->row_count = row_count;
-        result->row_capacity = row_count;
-        result->rows = malloc(sizeof(Row) * row_count);
+        char col_name[256];
+        projection->specs[col_idx] = strdup(col_spec);
+        projection->columns[col_idx].name = projected_column_name(col_spec, col_name);
+        projection->columns[col_idx].inferred_type = VALUE_TYPE_STRING;
+        projection->nodes[col_idx] = select_node->select.column_nodes ? select_node->select.column_nodes[i] : NULL;
         
-        for (int i = 0; i < row_count; i++) {
-            result->rows[i].column_count = result->column_count;
-            result->rows[i].values = malloc(sizeof(Value) * result->column_count);
-            
-            for (int j = 0; j < result->column_count; j++) {
-                // check if this column has an AST node (expression, subquery, etc.)
-                int orig_idx = original_indices[j];
-                if (orig_idx >= 0 && select_node->select.column_nodes && 
-                    select_node->select.column_nodes[orig_idx]) {
-                    ASTNode* col_node = select_node->select.column_nodes[orig_idx];
-                    
-                    if (col_node->type == NODE_TYPE_SUBQUERY) {
-                        // evaluate scalar subquery that may be correlated
-                        ResultSet* subquery_result = evaluate_query_internal(col_node->subquery.query, 
-                            filtered_rows[i], ctx->tables[0].table);
-                        
-                        if (!subquery_result) {
-                            result->rows[i].values[j].type = VALUE_TYPE_NULL;
-                        } else if (subquery_result->row_count != 1 || subquery_result->column_count != 1) {
-                            fprintf(stderr, "error: scalar subquery must return exactly one row and one column (got %d rows, %d columns)\n",
-                                    subquery_result->row_count, subquery_result->column_count);
-                            csv_free(subquery_result);
-                            result->rows[i].values[j].type = VALUE_TYPE_NULL;
-                        } else {
-                            value_deep_copy(&result->rows[i].values[j], &subquery_result->rows[0].values[0]);
-                            csv_free(subquery_result);
-                        }
-                    } else if (col_node->type == NODE_TYPE_WINDOW_FUNCTION) {
-                        // window functions evaluated separately
-                        result->rows[i].values[j].type = VALUE_TYPE_NULL;
-                    } else {
-                        // evaluate any expression like identifier, binary_op, function, etc.
-                        Value tmp = evaluate_expression(ctx, col_node, filtered_rows[i], 0);
-                        result->rows[i].values[j] = value_copy(&tmp);
-                    }
-                } else {
-                    // regular column from table or string-based expression
-                    Value tmp = evaluate_column_expression(
-                        expanded_specs[j], ctx, filtered_rows[i], column_indices, j
-                    );
-                    result->rows[i].values[j] = value_copy(&tmp);
-                }
-            }
+        // functions are evaluated per row, columns are found in the source table
+        projection->column_indices[col_idx] = -1;
+        if (!strchr(col_name, '(')) {
+            projection->column_indices[col_idx] = find_column_index(table, col_name);
         }
-        
-        // evaluate window functions (after all rows are created)
-        if (select_node->select.column_nodes) {
-            for (int j = 0; j < result->column_count; j++) {
-                int orig_idx = original_indices[j];
-                if (orig_idx >= 0) {
-                    ASTNode* col_node = select_node->select.column_nodes[orig_idx];
-                    if (col_node && col_node->type == NODE_TYPE_WINDOW_FUNCTION) {
-                        Value* win_results = evaluate_window_function(col_node, ctx, filtered_rows, row_count);
-                        if (win_results) {
-                            for (int i = 0; i < row_count; i++) {
-                                value_deep_copy(&result->rows[i].values[j], &win_results[i]);
-                                if (win_results[i].type == VALUE_TYPE_STRING && win_results[i].string_value) {
-                                    free((char*)win_results[i].string_value);
-                                }
-                            }
-                            free(win_results);
-                        }
-                    }
-                }
+        col_idx++;
+    }
+    
+    return projection;
+}
+
+bool projection_has_window(Projection* projection) {
+    for (int j = 0; j < projection->column_count; j++) {
+        if (projection->nodes[j] && projection->nodes[j]->type == NODE_TYPE_WINDOW_FUNCTION) return true;
+    }
+    return false;
+}
+
+void projection_row(Projection* projection, QueryContext* ctx, Row* row, Value* values) {
+    for (int j = 0; j < projection->column_count; j++) {
+        ASTNode* col_node = projection->nodes[j];
+        if (!col_node) {
+            // regular column from table or string-based expression
+            values[j] = evaluate_column_expression(projection->specs[j], ctx, row, projection->column_indices, j);
+        } else if (col_node->type == NODE_TYPE_SUBQUERY) {
+            // evaluate scalar subquery that may be correlated, cached across rows
+            // validation, it must return exactly 1 row and 1 column
+            int sub_rows, sub_cols;
+            if (!evaluate_scalar_subquery(ctx, col_node->subquery.query, row, ctx->tables[0].table,
+                                          &values[j], &sub_rows, &sub_cols) && sub_rows >= 0) {
+                fprintf(stderr, "error: scalar subquery must return exactly one row and one column (got %d rows, %d columns)\n",
+                        sub_rows, sub_cols);
             }
+        } else if (col_node->type == NODE_TYPE_WINDOW_FUNCTION) {
+            // window functions are evaluated separately for all rows at once
+            values[j].type = VALUE_TYPE_NULL;
+        } else {
+            // evaluate any expression like identifier, binary_op, function, etc.
+            values[j] = evaluate_expression(ctx, col_node, row, 0);
         }
-        
-        for (int i = 0; i < result->column_count; i++) {
-            free(expanded_specs[i]);
-        }
-        free(expanded_specs);
-        free(column_indices);
-        free(original_indices);
-        
-        return result;
     }
+}
+
+void projection_free(Projection* projection) {
+    if (!projection) return;
+    for (int j = 0; j < projection->column_count; j++) {
+        free(projection->specs[j]);
+        free(projection->columns[j].name);
+    }
+    free(projection->columns);
+    free(projection->specs);
+    free(projection->column_indices);
+    free(projection->nodes);
+    free(projection);
+}
+
+/* build result for non-aggregated queries */
+ResultSet* build_result(QueryContext* ctx, Row** filtered_rows, int row_count) {
+    if (!ctx || !ctx->query) return NULL;
     
-    // normal SELECT without * 
-    result->column_count = select_node->select.column_count;
-    result->columns = malloc(sizeof(Column) * result->column_count);
+    // create result table
+    ResultSet* result = calloc(1, sizeof(ResultSet));
+    result->filename = strdup("query_result");
+    result->has_header = true;
+    result->delimiter = ',';
+    result->quote = '"';
     
-    // build column index mapping and extract aliases
-    int* column_indices = malloc(sizeof(int) * result->column_count);
-    char** column_specs = malloc(sizeof(char*) * result->column_count);  // store full specs for functions
+    // get selected columns from SELECT clause
+    ASTNode* select_node = ctx->query->query.select;
+    if (!select_node) return result;
     
-    for (int i = 0; i < result->column_count; i++) {
-        const char* col_spec = select_node->select.columns[i];
-        column_specs[i] = strdup(col_spec);
-        char col_name[256];
-        
-        // parse "column" or "column AS alias"
-        char* alias = extract_column_alias(col_spec);
-        if (alias) {
-            // extract column name
-            const char* as_pos = cq_strcasestr(col_spec, " AS ");
-            int col_len = as_pos - col_spec;
-            strncpy(col_name, col_spec, col_len);
-            col_name[col_len] = '\0';
-            
-            result->columns[i].name = alias;
-        } else {
-            strcpy(col_name, col_spec);
-            
-            // check if it's a function - if so, use function call as display name
-            if (strchr(col_name, '(')) {
-                result->columns[i].name = strdup(col_name);
-            } else {
-                // for regular columns, use only column name without table prefix
-                const char* dot = strchr(col_name, '.');
-                if (dot) {
-                    result->columns[i].name = strdup(dot + 1);
-                } else {
-                    result->columns[i].name = strdup(col_name);
-                }
-            }
-        }
-        
-        result->columns[i].inferred_type = VALUE_TYPE_STRING;
-        column_indices[i] = -1;
-        
-        // skip column lookup if it's a function (will be evaluated later)
-        if (strchr(col_name, '(')) {
-            continue;
-        }
-        
-        // find column in source table
-        column_indices[i] = find_column_index(ctx->tables[0].table, col_name);
-    }
+    // the result takes over the column names
+    Projection* projection = projection_create(ctx);
+    result->column_count = projection->column_count;
+    result->columns = projection->columns;
+    projection->columns = calloc(projection->column_count > 0 ? projection->column_count : 1, sizeof(Column));
     
     // build rows
     result->row_count = row_count;
@@ -476,75 +400,27 @@ ResultSet* build_result(QueryContext* ctx, Row** filtered_rows, int row_count) {
     for (int i = 0; i < row_count; i++) {
         result->rows[i].column_count = result->column_count;
         result->rows[i].values = malloc(sizeof(Value) * result->column_count);
-        
-        // copy values from filtered row based on column mapping
-        for (int j = 0; j < result->column_count; j++) {
-            // check if this column has an AST node (expression, subquery, etc.)
-            if (select_node->select.column_nodes && select_node->select.column_nodes[j]) {
-                ASTNode* col_node = select_node->select.column_nodes[j];
-                
-                if (col_node->type == NODE_TYPE_SUBQUERY) {
-                    // evaluate scalar subquery that may be correlated
-                    ResultSet* subquery_result = evaluate_query_internal(col_node->subquery.query, 
-                        filtered_rows[i], ctx->tables[0].table);
-                    
-                    // validation, it must return exactly 1 row and 1 column
-                    if (!subquery_result) {
-                        result->rows[i].values[j].type = VALUE_TYPE_NULL;
-                    } else if (subquery_result->row_count != 1 || subquery_result->column_count != 1) {
-                        fprintf(stderr, "error: scalar subquery must return exactly one row and one column (got %d rows, %d columns)\n",
-                                subquery_result->row_count, subquery_result->column_count);
-                        csv_free(subquery_result);
-                        result->rows[i].values[j].type = VALUE_TYPE_NULL;
-                    } else {
-                        // copy the single value from subquery result
-                        value_deep_copy(&result->rows[i].values[j], &subquery_result->rows[0].values[0]);
-                        csv_free(subquery_result);
-                    }
-                } else if (col_node->type == NODE_TYPE_WINDOW_FUNCTION) {
-                    // window functions are evaluated separately for all rows at once
-                    // skip here, will be handled after all rows are created
-                    result->rows[i].values[j].type = VALUE_TYPE_NULL;
-                } else {
-                    // evaluate any expression like identifier, binary_op, function, etc.
-                    Value tmp = evaluate_expression(ctx, col_node, filtered_rows[i], 0);
-                    result->rows[i].values[j] = value_copy(&tmp);
-                }
-            } else {
-                Value tmp = evaluate_column_expression(
-                    column_specs[j], ctx, filtered_rows[i], column_indices, j
-                );
-                result->rows[i].values[j] = value_copy(&tmp);
-            }
-        }
+        projection_row(projection, ctx, filtered_rows[i], result->rows[i].values);
     }
     
-    // free temporary arrays
-    for (int i = 0; i < result->column_count; i++) {
-        free(column_specs[i]);
-    }
-    free(column_specs);
-    free(column_indices);
-    
     // evaluate window functions (after all rows are created)
-    if (select_node->select.column_nodes) {
-        for (int j = 0; j < result->column_count; j++) {
-            ASTNode* col_node = select_node->select.column_nodes[j];
-            if (col_node && col_node->type == NODE_TYPE_WINDOW_FUNCTION) {
-                Value* win_results = evaluate_window_function(col_node, ctx, filtered_rows, row_count);
-                if (win_results) {
-                    for (int i = 0; i < row_count; i++) {
-                        value_deep_copy(&result->rows[i].values[j], &win_results[i]);
-                        if (win_results[i].type == VALUE_TYPE_STRING && win_results[i].string_value) {
-                            free((char*)win_results[i].string_value);
-                        }
+    for (int j = 0; j < result->column_count; j++) {
+        ASTNode* col_node = projection->nodes[j];
+        if (col_node && col_node->type == NODE_TYPE_WINDOW_FUNCTION) {
+            Value* win_results = evaluate_window_function(col_node, ctx, filtered_rows, row_count);
+            if (win_results) {
+                for (int i = 0; i < row_count; i++) {
+                    value_deep_copy(&result->rows[i].values[j], &win_results[i]);
+                    if (win_results[i].type == VALUE_TYPE_STRING && win_results[i].string_value) {
+                        free((char*)win_results[i].string_value);
                     }
-                    free(win_results);
                 }
+                free(win_results);
             }
         }
     }
     
+    projection_free(projection);
     return result;
 }
 
@@ -732,42 +608,16 @@ void apply_limit_offset(ResultSet* result, int limit, int offset) {
     result->row_count = count;
 }
 
-/* helper function to check if two rows are equal (all values match) */
-static bool rows_equal(Row* row1, Row* row2, int column_count) {
-    if (!row1 || !row2) return false;
-    
-    for (int i = 0; i < column_count; i++) {
-        if (value_compare(&row1->values[i], &row2->values[i]) != 0) {
-            return false;
-        }
-    }
-    return true;
-}
-
-/* helper function to check if a row exists in a result set */
-static bool row_exists_in_result(ResultSet* result, Row* row) {
-    for (int i = 0; i < result->row_count; i++) {
-        if (rows_equal(&result->rows[i], row, result->column_count)) {
-            return true;
-        }
-    }
-    return false;
-}
-
-/* helper function to copy a row */
-static Row copy_row(Row* source, int column_count) {
-    Row new_row;
-    new_row.column_count = column_count;
-    new_row.values = malloc(sizeof(Value) * column_count);
-    
-    for (int i = 0; i < column_count; i++) {
-        value_deep_copy(&new_row.values[i], &source->values[i]);
+/* move the rows of a set operation input into the result or free them, the input is left empty */
+static void take_row(ResultSet* result, Row* row, bool keep) {
+    if (keep) {
+        result->rows[result->row_count++] = *row;
+    } else {
+        free_row_range(row, 0, 1);
     }
-    
-    return new_row;
 }
 
-/* UNION operation - combine two result sets (optionally removing duplicates) */
+/* UNION operation - combine two result sets (optionally removing duplicates), both inputs are consumed */
 ResultSet* set_union(ResultSet* left, ResultSet* right, bool include_duplicates) {
     if (!left || !right) return NULL;
     
@@ -776,27 +626,28 @@ ResultSet* set_union(ResultSet* left, ResultSet* right, bool include_duplicates)
     
     // allocate rows
     result->row_capacity = left->row_count + right->row_count;
-    result->rows = malloc(sizeof(Row) * result->row_capacity);
+    result->rows = malloc(sizeof(Row) * (result->row_capacity > 0 ? result->row_capacity : 1));
     result->row_count = 0;
     
-    // add all rows from left
-    for (int i = 0; i < left->row_count; i++) {
-        result->rows[result->row_count++] = copy_row(&left->rows[i], left->column_count);
-    }
+    // rows already emitted, only needed when removing duplicates
+    RowHashSet* seen = include_duplicates ? NULL
+                     : row_hash_set_create(left->column_count, result->row_capacity);
     
-    // add rows from right
-    for (int i = 0; i < right->row_count; i++) {
-        // if not UNION ALL, check for duplicates
-        if (!include_duplicates && row_exists_in_result(result, &right->rows[i])) {
-            continue;
+    ResultSet* inputs[2] = {left, right};
+    for (int s = 0; s < 2; s++) {
+        for (int i = 0; i < inputs[s]->row_count; i++) {
+            Row* row = &inputs[s]->rows[i];
+            take_row(result, row, !seen || row_hash_set_insert(seen, row));
         }
-        result->rows[result->row_count++] = copy_row(&right->rows[i], right->column_count);
     }
     
+    row_hash_set_free(seen);
+    left->row_count = 0;
+    right->row_count = 0;
     return result;
 }
 
-/* INTERSECT operation - return rows that exist in both result sets */
+/* INTERSECT operation - return rows that exist in both result sets, the rows of left are consumed */
 ResultSet* set_intersect(ResultSet* left, ResultSet* right) {
     if (!left || !right) return NULL;
     
@@ -805,32 +656,29 @@ ResultSet* set_intersect(ResultSet* left, ResultSet* right) {
     
     // allocate rows (at most left->row_count)
     result->row_capacity = left->row_count;
-    result->rows = malloc(sizeof(Row) * result->row_capacity);
+    result->rows = malloc(sizeof(Row) * (result->row_capacity > 0 ? result->row_capacity : 1));
     result->row_count = 0;
     
-    // add rows from left that also exist in right
+    // build side is right, left is streamed through it
+    RowHashSet* right_rows = row_hash_set_create(left->column_count, right->row_count);
+    for (int j = 0; j < right->row_count; j++) {
+        row_hash_set_insert(right_rows, &right->rows[j]);
+    }
+    RowHashSet* emitted = row_hash_set_create(left->column_count, left->row_count);
+    
     for (int i = 0; i < left->row_count; i++) {
-        // check if this row exists in right
-        bool found = false;
-        for (int j = 0; j < right->row_count; j++) {
-            if (rows_equal(&left->rows[i], &right->rows[j], left->column_count)) {
-                found = true;
-                break;
-            }
-        }
-        
-        if (found) {
-            // avoid duplicates in result
-            if (!row_exists_in_result(result, &left->rows[i])) {
-                result->rows[result->row_count++] = copy_row(&left->rows[i], left->column_count);
-            }
-        }
+        Row* row = &left->rows[i];
+        // keep rows present in right, avoiding duplicates in result
+        take_row(result, row, row_hash_set_contains(right_rows, row) && row_hash_set_insert(emitted, row));
     }
     
+    row_hash_set_free(right_rows);
+    row_hash_set_free(emitted);
+    left->row_count = 0;
     return result;
 }
 
-/* EXCEPT operation - return rows from left that don't exist in right */
+/* EXCEPT operation - return rows from left that don't exist in right, the rows of left are consumed */
 ResultSet* set_except(ResultSet* left, ResultSet* right) {
     if (!left || !right) return NULL;
     
@@ -839,28 +687,24 @@ ResultSet* set_except(ResultSet* left, ResultSet* right) {
     
     // allocate rows (at most left->row_count)
     result->row_capacity = left->row_count;
-    result->rows = malloc(sizeof(Row) * result->row_capacity);
+    result->rows = malloc(sizeof(Row) * (result->row_capacity > 0 ? result->row_capacity : 1));
     result->row_count = 0;
     
-    // add rows from left that don't exist in right
+    RowHashSet* right_rows = row_hash_set_create(left->column_count, right->row_count);
+    for (int j = 0; j < right->row_count; j++) {
+        row_hash_set_insert(right_rows, &right->rows[j]);
+    }
+    RowHashSet* emitted = row_hash_set_create(left->column_count, left->row_count);
+    
     for (int i = 0; i < left->row_count; i++) {
-        // check if this row exists in right
-        bool found = false;
-        for (int j = 0; j < right->row_count; j++) {
-            if (rows_equal(&left->rows[i], &right->rows[j], left->column_count)) {
-                found = true;
-                break;
-            }
-        }
-        
-        if (!found) {
-            // avoid duplicates in result
-            if (!row_exists_in_result(result, &left->rows[i])) {
-                result->rows[result->row_count++] = copy_row(&left->rows[i], left->column_count);
-            }
-        }
+        Row* row = &left->rows[i];
+        // keep rows missing from right, avoiding duplicates in result
+        take_row(result, row, !row_hash_set_contains(right_rows, row) && row_hash_set_insert(emitted, row));
     }
     
+    row_hash_set_free(right_rows);
+    row_hash_set_free(emitted);
+    left->row_count = 0;
     return result;
 }
 
@@ -868,40 +712,19 @@ ResultSet* set_except(ResultSet* left, ResultSet* right) {
 void apply_distinct(ResultSet* result) {
     if (!result || result->row_count <= 1) return;
     
-    // hash-based deduplication using a simple approach:
-    // we'll track which rows to keep and compact the array
+    // first pass marks the first occurrence of every row, the set borrows
+    // row pointers so compaction has to wait until all rows are probed
     bool* keep = calloc(result->row_count, sizeof(bool));
     int unique_count = 0;
+    RowHashSet* seen = row_hash_set_create(result->column_count, result->row_count);
     
-    // compare each row with previously kept rows
     for (int i = 0; i < result->row_count; i++) {
-        bool is_duplicate = false;
-        
-        // check if this row is duplicate of any previous kept row
-        for (int j = 0; j < i; j++) {
-            if (!keep[j]) continue;
-            
-            // compare all values in the row
-            bool rows_equal_flag = true;
-            for (int col = 0; col < result->column_count; col++) {
-                if (value_compare(&result->rows[i].values[col], 
-                                 &result->rows[j].values[col]) != 0) {
-                    rows_equal_flag = false;
-                    break;
-                }
-            }
-            
-            if (rows_equal_flag) {
-                is_duplicate = true;
-                break;
-            }
-        }
-        
-        if (!is_duplicate) {
+        if (row_hash_set_insert(seen, &result->rows[i])) {
             keep[i] = true;
             unique_count++;
         }
     }
+    row_hash_set_free(seen);
     
     // if all rows are unique, nothing to do
     if (unique_count == result->row_count) {
@@ -931,7 +754,7 @@ void apply_distinct(ResultSet* result) {
     free(keep);
 }
 
-/* convert result set to csv table */
+/* convert result set to csv table, the rows move into the table and result is left empty */
 CsvTable* result_to_csv_table(ResultSet* result) {
     if (!result) return NULL;
     
@@ -940,32 +763,35 @@ CsvTable* result_to_csv_table(ResultSet* result) {
     table->has_header = result->has_header;
     table->delimiter = result->delimiter;
     table->quote = result->quote;
+    table->fd = -1;
     
     // copy columns
     table->column_count = result->column_count;
-    table->columns = malloc(sizeof(Column) * table->column_count);
+    table->columns = malloc(sizeof(Column) * (table->column_count > 0 ? table->column_count : 1));
     for (int i = 0; i < table->column_count; i++) {
         table->columns[i].name = strdup(result->columns[i].name);
         table->columns[i].inferred_type = result->columns[i].inferred_type;
     }
     
-    // copy rows
+    // move rows, the arena takes over their malloc blocks so the table can be
+    // shared by joins like a scanned file
+    table->arena = arena_create();
+    table->rows = result->rows;
     table->row_count = result->row_count;
-    table->row_capacity = result->row_capacity;
-    table->rows = malloc(sizeof(Row) * table->row_count);
-    
+    table->row_capacity = result->row_count;
     for (int i = 0; i < table->row_count; i++) {
-        table->rows[i].column_count = result->rows[i].column_count;
-        table->rows[i].values = malloc(sizeof(Value) * table->rows[i].column_count);
-        
-        for (int j = 0; j < table->rows[i].column_count; j++) {
-            Value* src = &result->rows[i].values[j];
-            Value* dst = &table->rows[i].values[j];
-            
-            value_deep_copy(dst, src);
+        Row* row = &table->rows[i];
+        for (int j = 0; j < row->column_count; j++) {
+            if (row->values[j].type == VALUE_TYPE_STRING) {
+                arena_adopt(table->arena, row->values[j].string_value);
+            }
         }
+        arena_adopt(table->arena, row->values);
     }
     
+    result->rows = NULL;
+    result->row_count = 0;
+    result->row_capacity = 0;
     return table;
 }
 
@@ -981,26 +807,3 @@ void free_row_range(Row* rows, int start, int end) {
         free(rows[i].values);
     }
 }
-
-/* helper to apply WHERE filtering */
-Row** filter_rows(QueryContext* ctx, ASTNode* where_clause, int* out_filtered_count) {
-    int filtered_capacity = ctx->tables[0].table->row_count;
-    Row** filtered_rows = malloc(sizeof(Row*) * filtered_capacity);
-    int filtered_count = 0;
-    
-    for (int i = 0; i < ctx->tables[0].table->row_count; i++) {
-        Row* row = &ctx->tables[0].table->rows[i];
-        
-        bool matches = true;
-        if (where_clause) {
-            matches = evaluate_condition(ctx, where_clause, row, 0);
-        }
-        
-        if (matches) {
-            filtered_rows[filtered_count++] = row;
-        }
-    }
-    
-    *out_filtered_count = filtered_count;
-    return filtered_rows;
-}
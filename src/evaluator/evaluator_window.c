@@ -193,6 +193,14 @@ Value* evaluate_window_function(ASTNode* win_func, QueryContext* ctx, Row** rows
         }
     }
     
+    // a running SUM has one type for every row of the column, from all of its cells
+    ValueType sum_type = VALUE_TYPE_NULL;
+    if (strcasecmp(func_name, "SUM") == 0 && win_func->window_function.arg_count > 0 &&
+        win_func->window_function.args[0]->type == NODE_TYPE_IDENTIFIER) {
+        sum_type = sum_cell_type(rows, row_count, ctx->tables[0].table,
+                                 win_func->window_function.args[0]->identifier);
+    }
+    
     // process each partition
     for (int p = 0; p < partition_count; p++) {
         int* indices = partition_row_indices[p];
@@ -339,7 +347,7 @@ Value* evaluate_window_function(ASTNode* win_func, QueryContext* ctx, Row** rows
                 }
                 
                 results[row_idx] = evaluate_aggregate(func_name, partition_rows, i + 1, 
-                    ctx->tables[0].table, col_name);
+                    ctx->tables[0].table, col_name, sum_type);
                 free(partition_rows);
             }
         }
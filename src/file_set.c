@@ -0,0 +1,375 @@
+/* file_set.c - several files, glob patterns and hive partitions read as one table */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <sys/stat.h>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <glob.h>
+#include <pthread.h>
+#include <unistd.h>
+#define FILE_SET_PARALLEL 1
+#endif
+
+#include "file_set.h"
+#include "profile.h"
+
+/* value of a partition hive could not name */
+#define HIVE_DEFAULT_PARTITION "__HIVE_DEFAULT_PARTITION__"
+
+bool file_set_is_pattern(const char* name) {
+    if (!strpbrk(name, "*?[")) return false;
+    struct stat statbuf;
+    return stat(name, &statbuf) != 0;
+}
+
+static void add_path(FileSet* set, int* capacity, const char* path) {
+    if (set->count >= *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 16;
+        set->paths = realloc(set->paths, sizeof(char*) * *capacity);
+    }
+    set->paths[set->count++] = strdup(path);
+}
+
+/* hive escapes path characters as %XX */
+static char* unescape(const char* str, size_t len) {
+    char* out = malloc(len + 1);
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (str[i] == '%' && i + 2 < len && isxdigit((unsigned char)str[i + 1]) && isxdigit((unsigned char)str[i + 2])) {
+            char hex[3] = {str[i + 1], str[i + 2], '\0'};
+            out[n++] = (char)strtol(hex, NULL, 16);
+            i += 2;
+        } else {
+            out[n++] = str[i];
+        }
+    }
+    out[n] = '\0';
+    return out;
+}
+
+static int partition_index(FileSet* set, const char* name) {
+    for (int i = 0; i < set->partition_count; i++) {
+        if (strcasecmp(set->partition_names[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+/* the column type of a union: equal types stay, numbers widen to DOUBLE, anything else is STRING */
+static ValueType unify_type(ValueType a, ValueType b) {
+    if (a == b) return a;
+    if ((a == VALUE_TYPE_INTEGER || a == VALUE_TYPE_DOUBLE) && (b == VALUE_TYPE_INTEGER || b == VALUE_TYPE_DOUBLE)) {
+        return VALUE_TYPE_DOUBLE;
+    }
+    return VALUE_TYPE_STRING;
+}
+
+/* key=value directories of every path become partition columns */
+static void find_partitions(FileSet* set) {
+    // names first, so that the value matrix has its final width
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1) {
+            set->partition_values = calloc((size_t)set->count * (set->partition_count ? set->partition_count : 1), sizeof(Value));
+        }
+        for (int f = 0; f < set->count; f++) {
+            const char* part = set->paths[f];
+            const char* slash;
+            while ((slash = strchr(part, '/')) != NULL) {
+                const char* equals = memchr(part, '=', slash - part);
+                if (equals && equals > part) {
+                    char* key = unescape(part, equals - part);
+                    int index = partition_index(set, key);
+                    if (pass == 0 && index < 0) {
+                        set->partition_names = realloc(set->partition_names, sizeof(char*) * (set->partition_count + 1));
+                        set->partition_names[set->partition_count++] = key;
+                        key = NULL;
+                    } else if (pass == 1) {
+                        char* text = unescape(equals + 1, slash - equals - 1);
+                        Value* value = &set->partition_values[(size_t)f * set->partition_count + index];
+                        value_free(value);
+                        if (strcmp(text, HIVE_DEFAULT_PARTITION) == 0) {
+                            value->type = VALUE_TYPE_NULL;
+                        } else {
+                            // typed like a CSV cell
+                            *value = parse_value(text, strlen(text));
+                        }
+                        free(text);
+                    }
+                    free(key);
+                }
+                part = slash + 1;
+            }
+        }
+    }
+}
+
+FileSet* file_set_expand(char** names, int name_count) {
+    FileSet* set = calloc(1, sizeof(FileSet));
+    int capacity = 0;
+
+    for (int i = 0; i < name_count; i++) {
+        if (!file_set_is_pattern(names[i])) {
+            add_path(set, &capacity, names[i]);
+            continue;
+        }
+#ifdef FILE_SET_PARALLEL
+        glob_t matches;
+        int rc = glob(names[i], 0, NULL, &matches);
+        if (rc == 0) {
+            for (size_t m = 0; m < matches.gl_pathc; m++) add_path(set, &capacity, matches.gl_pathv[m]);
+        }
+        globfree(&matches);
+        if (rc == 0) continue;
+#endif
+        fprintf(stderr, "Error: no files match '%s'\n", names[i]);
+        file_set_free(set);
+        return NULL;
+    }
+    find_partitions(set);
+    return set;
+}
+
+void file_set_free(FileSet* set) {
+    if (!set) return;
+    for (int i = 0; i < set->count; i++) {
+        free(set->paths[i]);
+        for (int p = 0; p < set->partition_count; p++) {
+            value_free(&set->partition_values[(size_t)i * set->partition_count + p]);
+        }
+    }
+    for (int p = 0; p < set->partition_count; p++) free(set->partition_names[p]);
+    free(set->paths);
+    free(set->partition_names);
+    free(set->partition_values);
+    free(set);
+}
+
+static void add_column(CsvTable* table, const char* name, ValueType type) {
+    table->columns = realloc(table->columns, sizeof(Column) * (table->column_count + 1));
+    table->columns[table->column_count].name = strdup(name);
+    table->columns[table->column_count].inferred_type = type;
+    table->column_count++;
+}
+
+CsvTable* file_set_partitions(const FileSet* set, bool file_column) {
+    CsvTable* table = calloc(1, sizeof(CsvTable));
+    table->filename = strdup(FILE_SET_COLUMN);
+    table->fd = -1;
+    table->has_header = true;
+    for (int p = 0; p < set->partition_count; p++) add_column(table, set->partition_names[p], VALUE_TYPE_STRING);
+    if (file_column) add_column(table, FILE_SET_COLUMN, VALUE_TYPE_STRING);
+
+    table->rows = malloc(sizeof(Row) * (set->count ? set->count : 1));
+    table->row_count = set->count;
+    table->row_capacity = set->count;
+    for (int f = 0; f < set->count; f++) {
+        Row* row = &table->rows[f];
+        row->column_count = table->column_count;
+        row->values = malloc(sizeof(Value) * (table->column_count ? table->column_count : 1));
+        memcpy(row->values, &set->partition_values[(size_t)f * set->partition_count], sizeof(Value) * set->partition_count);
+        if (file_column) {
+            row->values[set->partition_count].type = VALUE_TYPE_STRING;
+            row->values[set->partition_count].string_value = set->paths[f];
+        }
+    }
+    return table;
+}
+
+void file_set_partitions_free(CsvTable* partitions) {
+    // the values belong to the set
+    for (int i = 0; i < partitions->row_count; i++) free(partitions->rows[i].values);
+    partitions->row_count = 0;
+    csv_free(partitions);
+}
+
+/* ===== loading ===== */
+
+typedef struct {
+    const FileSet* set;
+    const bool* keep;
+    CsvConfig config;
+    CsvTable** tables;
+    int next;
+#ifdef FILE_SET_PARALLEL
+    pthread_mutex_t lock;
+#endif
+} LoadQueue;
+
+static void* load_files(void* arg) {
+    LoadQueue* queue = arg;
+    for (;;) {
+#ifdef FILE_SET_PARALLEL
+        pthread_mutex_lock(&queue->lock);
+#endif
+        int f = queue->next++;
+#ifdef FILE_SET_PARALLEL
+        pthread_mutex_unlock(&queue->lock);
+#endif
+        if (f >= queue->set->count) return NULL;
+        if (!queue->keep || queue->keep[f]) queue->tables[f] = csv_load(queue->set->paths[f], queue->config);
+    }
+}
+
+/* copy of a partition or path value for one row: arena strings are shared by the rows of a file */
+static Value row_value(Value value, Arena* arena, char** shared) {
+    if (value.type != VALUE_TYPE_STRING) return value;
+    if (arena) {
+        if (!*shared) *shared = arena_strdup(arena, value.string_value);
+        value.string_value = *shared;
+    } else {
+        value.string_value = strdup(value.string_value);
+    }
+    return value;
+}
+
+/* move the rows of a loaded file into the table, rearranged to its columns */
+static void append_file(CsvTable* table, CsvTable* file, const FileSet* set, int f, const int* partition_columns,
+                        int file_column) {
+    int* map = malloc(sizeof(int) * (file->column_count ? file->column_count : 1));
+    bool identity = file->column_count == table->column_count;
+    for (int c = 0; c < file->column_count; c++) {
+        map[c] = csv_get_column_index(table, file->columns[c].name);
+        if (map[c] != c) identity = false;
+    }
+
+    Value path = {.type = VALUE_TYPE_STRING, .string_value = set->paths[f]};
+    char* shared_path = NULL;
+    char** shared_partitions = calloc(set->partition_count ? set->partition_count : 1, sizeof(char*));
+
+    for (int r = 0; r < file->row_count; r++) {
+        Row* row = &file->rows[r];
+        if (identity) {
+            table->rows[table->row_count++] = *row;
+            continue;
+        }
+        size_t bytes = sizeof(Value) * table->column_count;
+        Value* values = table->arena ? arena_alloc(table->arena, bytes) : malloc(bytes);
+        for (int c = 0; c < table->column_count; c++) {
+            values[c].type = VALUE_TYPE_NULL;
+            values[c].int_value = 0;
+        }
+        for (int c = 0; c < row->column_count && c < file->column_count; c++) values[map[c]] = row->values[c];
+        for (int p = 0; p < set->partition_count; p++) {
+            if (partition_columns[p] < 0) continue;
+            Value value = set->partition_values[(size_t)f * set->partition_count + p];
+            values[partition_columns[p]] = row_value(value, table->arena, &shared_partitions[p]);
+        }
+        if (file_column >= 0) values[file_column] = row_value(path, table->arena, &shared_path);
+        if (!file->arena) free(row->values);
+
+        table->rows[table->row_count].values = values;
+        table->rows[table->row_count].column_count = table->column_count;
+        table->row_count++;
+    }
+
+    // the rows now belong to the table, the file keeps nothing to free
+    if (file->arena) arena_absorb(table->arena, file->arena);
+    file->row_count = 0;
+    free(shared_partitions);
+    free(map);
+}
+
+static int load_threads(int files) {
+    int threads = 1;
+#ifdef FILE_SET_PARALLEL
+    // profile counters are not shared safely, profiled loads run one file at a time
+    if (!profile_counters.enabled) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (threads > FILE_SET_THREADS) threads = FILE_SET_THREADS;
+    if (threads > files) threads = files;
+    return threads < 1 ? 1 : threads;
+}
+
+CsvTable* file_set_load(const FileSet* set, const bool* keep, bool file_column, const char* name, CsvConfig config) {
+    LoadQueue queue = {.set = set, .keep = keep, .config = config, .next = 0};
+    queue.tables = calloc(set->count ? set->count : 1, sizeof(CsvTable*));
+    int kept = 0;
+    for (int f = 0; f < set->count; f++) kept += !keep || keep[f];
+
+#ifdef FILE_SET_PARALLEL
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_t workers[FILE_SET_THREADS];
+    int threads = load_threads(kept);
+    int started = 0;
+    while (started < threads - 1 && pthread_create(&workers[started], NULL, load_files, &queue) == 0) started++;
+    load_files(&queue);
+    for (int i = 0; i < started; i++) pthread_join(workers[i], NULL);
+    pthread_mutex_destroy(&queue.lock);
+#else
+    (void)load_threads;
+    load_files(&queue);
+#endif
+
+    bool ok = true;
+    for (int f = 0; f < set->count; f++) {
+        if ((!keep || keep[f]) && !queue.tables[f]) ok = false;
+    }
+    CsvTable* table = NULL;
+    if (ok) {
+        table = calloc(1, sizeof(CsvTable));
+        table->filename = strdup(name);
+        table->fd = -1;
+        table->delimiter = config.delimiter;
+        table->quote = config.quote;
+        table->has_header = true;
+        table->arena = config.arena ? arena_create() : NULL;
+
+        // union of the data columns, then the partitions a file does not already hold
+        long long total = 0;
+        for (int f = 0; f < set->count; f++) {
+            CsvTable* file = queue.tables[f];
+            if (!file) continue;
+            total += file->row_count;
+            table->file_size += file->file_size;
+            for (int c = 0; c < file->column_count; c++) {
+                int index = csv_get_column_index(table, file->columns[c].name);
+                if (index < 0) {
+                    add_column(table, file->columns[c].name, file->columns[c].inferred_type);
+                } else {
+                    table->columns[index].inferred_type = unify_type(table->columns[index].inferred_type,
+                                                                     file->columns[c].inferred_type);
+                }
+            }
+        }
+        int* partition_columns = malloc(sizeof(int) * (set->partition_count ? set->partition_count : 1));
+        for (int p = 0; p < set->partition_count; p++) {
+            partition_columns[p] = -1;
+            if (csv_get_column_index(table, set->partition_names[p]) >= 0) continue;
+            ValueType type = VALUE_TYPE_NULL;
+            for (int f = 0; f < set->count; f++) {
+                Value* value = &set->partition_values[(size_t)f * set->partition_count + p];
+                if (value->type != VALUE_TYPE_NULL) type = type == VALUE_TYPE_NULL ? value->type : unify_type(type, value->type);
+            }
+            partition_columns[p] = table->column_count;
+            add_column(table, set->partition_names[p], type == VALUE_TYPE_NULL ? VALUE_TYPE_STRING : type);
+        }
+        int file_index = -1;
+        if (file_column && csv_get_column_index(table, FILE_SET_COLUMN) < 0) {
+            file_index = table->column_count;
+            add_column(table, FILE_SET_COLUMN, VALUE_TYPE_STRING);
+        }
+
+        if (total > 0x7fffffff) {
+            fprintf(stderr, "Error: '%s' holds more rows than one table can\n", name);
+            ok = false;
+        } else {
+            table->rows = malloc(sizeof(Row) * (total > 0 ? total : 1));
+            table->row_capacity = (int)total;
+            for (int f = 0; f < set->count; f++) {
+                if (queue.tables[f]) append_file(table, queue.tables[f], set, f, partition_columns, file_index);
+            }
+        }
+        free(partition_columns);
+    }
+
+    for (int f = 0; f < set->count; f++) csv_free(queue.tables[f]);
+    free(queue.tables);
+    if (!ok) {
+        csv_free(table);
+        return NULL;
+    }
+    return table;
+}
@@ -0,0 +1,241 @@
+/* flatbuffer.c - FlatBuffers encoder and bounds checked decoder for the Arrow metadata */
+
+#include <stdlib.h>
+#include <string.h>
+#include "flatbuffer.h"
+
+void flatbuf_init(FlatBuilder* fb) {
+    memset(fb, 0, sizeof(FlatBuilder));
+}
+
+void flatbuf_reset(FlatBuilder* fb) {
+    fb->size = 0;
+    fb->min_align = 1;
+    fb->field_count = 0;
+}
+
+void flatbuf_free(FlatBuilder* fb) {
+    free(fb->data);
+    flatbuf_init(fb);
+}
+
+/* room for len more bytes in front of the used part, which stays at the end */
+static void reserve(FlatBuilder* fb, size_t len) {
+    if (fb->size + len <= fb->capacity) return;
+    size_t capacity = fb->capacity ? fb->capacity * 2 : 1024;
+    while (capacity < fb->size + len) capacity *= 2;
+    uint8_t* data = malloc(capacity);
+    if (fb->size) memcpy(data + capacity - fb->size, fb->data + fb->capacity - fb->size, fb->size);
+    free(fb->data);
+    fb->data = data;
+    fb->capacity = capacity;
+}
+
+static void push(FlatBuilder* fb, const void* bytes, size_t len) {
+    reserve(fb, len);
+    fb->size += len;
+    memcpy(fb->data + fb->capacity - fb->size, bytes, len);
+}
+
+/* pad so that after additional more bytes the position is a multiple of align */
+static void prep(FlatBuilder* fb, size_t align, size_t additional) {
+    if (align > fb->min_align) fb->min_align = align;
+    size_t pad = (0 - (fb->size + additional)) & (align - 1);
+    reserve(fb, pad + additional);
+    memset(fb->data + fb->capacity - fb->size - pad, 0, pad);
+    fb->size += pad;
+}
+
+/* an offset written now, pointing forward to ref */
+static void push_offset(FlatBuilder* fb, FlatRef ref) {
+    prep(fb, 4, 0);
+    uint32_t offset = (uint32_t)(fb->size + 4 - ref);
+    push(fb, &offset, 4);
+}
+
+static FlatRef end_vector(FlatBuilder* fb, int count) {
+    uint32_t length = (uint32_t)count;
+    push(fb, &length, 4);
+    return (FlatRef)fb->size;
+}
+
+FlatRef flatbuf_string(FlatBuilder* fb, const char* str) {
+    size_t len = strlen(str);
+    prep(fb, 4, len + 1);
+    push(fb, "", 1);
+    push(fb, str, len);
+    return end_vector(fb, (int)len);
+}
+
+FlatRef flatbuf_struct_vector(FlatBuilder* fb, const void* elems, size_t elem_size, int count, size_t align) {
+    size_t len = elem_size * (size_t)count;
+    prep(fb, 4, len);
+    prep(fb, align, len);
+    if (len) push(fb, elems, len);
+    return end_vector(fb, count);
+}
+
+FlatRef flatbuf_table_vector(FlatBuilder* fb, const FlatRef* tables, int count) {
+    prep(fb, 4, 4 * (size_t)count);
+    for (int i = count - 1; i >= 0; i--) push_offset(fb, tables[i]);
+    return end_vector(fb, count);
+}
+
+void flatbuf_start_table(FlatBuilder* fb) {
+    fb->table_start = fb->size;
+    fb->field_count = 0;
+    memset(fb->fields, 0, sizeof(fb->fields));
+}
+
+static void add_field(FlatBuilder* fb, int field, const void* value, size_t len) {
+    prep(fb, len, 0);
+    push(fb, value, len);
+    fb->fields[field] = (FlatRef)fb->size;
+    if (field >= fb->field_count) fb->field_count = field + 1;
+}
+
+void flatbuf_add_u8(FlatBuilder* fb, int field, uint8_t value) {
+    add_field(fb, field, &value, 1);
+}
+
+void flatbuf_add_i16(FlatBuilder* fb, int field, int16_t value) {
+    add_field(fb, field, &value, 2);
+}
+
+void flatbuf_add_i32(FlatBuilder* fb, int field, int32_t value) {
+    add_field(fb, field, &value, 4);
+}
+
+void flatbuf_add_i64(FlatBuilder* fb, int field, int64_t value) {
+    add_field(fb, field, &value, 8);
+}
+
+void flatbuf_add_ref(FlatBuilder* fb, int field, FlatRef ref) {
+    push_offset(fb, ref);
+    fb->fields[field] = (FlatRef)fb->size;
+    if (field >= fb->field_count) fb->field_count = field + 1;
+}
+
+/* the table starts with the signed distance back to its vtable, which is written in front of it */
+FlatRef flatbuf_end_table(FlatBuilder* fb) {
+    int32_t placeholder = 0;
+    prep(fb, 4, 0);
+    push(fb, &placeholder, 4);
+    FlatRef table = (FlatRef)fb->size;
+
+    for (int f = fb->field_count - 1; f >= 0; f--) {
+        uint16_t offset = fb->fields[f] ? (uint16_t)(table - fb->fields[f]) : 0;
+        push(fb, &offset, 2);
+    }
+    uint16_t object_size = (uint16_t)(table - fb->table_start);
+    uint16_t vtable_size = (uint16_t)((fb->field_count + 2) * 2);
+    push(fb, &object_size, 2);
+    push(fb, &vtable_size, 2);
+
+    int32_t to_vtable = (int32_t)(fb->size - table);
+    memcpy(fb->data + fb->capacity - table, &to_vtable, 4);
+    fb->field_count = 0;
+    return table;
+}
+
+const uint8_t* flatbuf_finish(FlatBuilder* fb, FlatRef root, size_t* size) {
+    prep(fb, fb->min_align > 4 ? fb->min_align : 4, 4);
+    push_offset(fb, root);
+    *size = fb->size;
+    return fb->data + fb->capacity - fb->size;
+}
+
+/* ===== decoding ===== */
+
+static bool in_bounds(size_t size, size_t position, size_t len) {
+    return position <= size && len <= size - position;
+}
+
+static uint32_t read_u32(const uint8_t* buffer, size_t position) {
+    uint32_t value;
+    memcpy(&value, buffer + position, 4);
+    return value;
+}
+
+static uint16_t read_u16(const uint8_t* buffer, size_t position) {
+    uint16_t value;
+    memcpy(&value, buffer + position, 2);
+    return value;
+}
+
+/* the table at position, with its vtable inside the buffer */
+static bool table_at(const uint8_t* buffer, size_t size, size_t position, FlatTable* table) {
+    if (!in_bounds(size, position, 4)) return false;
+    int64_t vtable = (int64_t)position - (int32_t)read_u32(buffer, position);
+    if (vtable < 0 || !in_bounds(size, (size_t)vtable, 4)) return false;
+    if (!in_bounds(size, (size_t)vtable, read_u16(buffer, (size_t)vtable))) return false;
+    table->buffer = buffer;
+    table->size = size;
+    table->position = position;
+    return true;
+}
+
+/* position of a field's value, 0 if the field is absent */
+static size_t field_position(const FlatTable* table, int field) {
+    size_t vtable = table->position - (int32_t)read_u32(table->buffer, table->position);
+    uint16_t vtable_size = read_u16(table->buffer, vtable);
+    size_t entry = 4 + 2 * (size_t)field;
+    if (entry + 2 > vtable_size) return 0;
+    uint16_t offset = read_u16(table->buffer, vtable + entry);
+    return offset ? table->position + offset : 0;
+}
+
+/* the object an offset field points to */
+static size_t follow(const FlatTable* table, size_t position) {
+    if (!position || !in_bounds(table->size, position, 4)) return 0;
+    size_t target = position + read_u32(table->buffer, position);
+    return target < table->size ? target : 0;
+}
+
+bool flatbuf_root(const uint8_t* buffer, size_t size, FlatTable* root) {
+    if (size < 4) return false;
+    return table_at(buffer, size, read_u32(buffer, 0), root);
+}
+
+int64_t flatbuf_get_int(const FlatTable* table, int field, int width, int64_t default_value) {
+    size_t position = field_position(table, field);
+    if (!position || !in_bounds(table->size, position, (size_t)width)) return default_value;
+    const uint8_t* p = table->buffer + position;
+    switch (width) {
+        case 1: return *p;
+        case 2: { int16_t v; memcpy(&v, p, 2); return v; }
+        case 4: { int32_t v; memcpy(&v, p, 4); return v; }
+        default: { int64_t v; memcpy(&v, p, 8); return v; }
+    }
+}
+
+bool flatbuf_has_field(const FlatTable* table, int field) {
+    return field_position(table, field) != 0;
+}
+
+bool flatbuf_get_table(const FlatTable* table, int field, FlatTable* child) {
+    size_t target = follow(table, field_position(table, field));
+    return target && table_at(table->buffer, table->size, target, child);
+}
+
+const char* flatbuf_get_string(const FlatTable* table, int field, size_t* len) {
+    size_t target = follow(table, field_position(table, field));
+    if (!target || !in_bounds(table->size, target, 4)) return NULL;
+    *len = read_u32(table->buffer, target);
+    if (!in_bounds(table->size, target + 4, *len)) return NULL;
+    return (const char*)table->buffer + target + 4;
+}
+
+int flatbuf_get_vector(const FlatTable* table, int field, size_t elem_size, size_t* elements) {
+    size_t target = follow(table, field_position(table, field));
+    if (!target || !in_bounds(table->size, target, 4)) return -1;
+    uint32_t count = read_u32(table->buffer, target);
+    if (count > INT32_MAX || (elem_size && count > (table->size - target - 4) / elem_size)) return -1;
+    *elements = target + 4;
+    return (int)count;
+}
+
+bool flatbuf_vector_table(const FlatTable* table, size_t elements, int index, FlatTable* child) {
+    size_t target = follow(table, elements + 4 * (size_t)index);
+    return target && table_at(table->buffer, table->size, target, child);
+}
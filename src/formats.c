@@ -2,267 +2,656 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <pthread.h>
+#include <unistd.h>
+#endif
 
 #include "formats.h"
 #include "utils.h"
+#include "output_writer.h"
+#include "arrow.h"
 
-/* CSV print table */
-void csv_print_table(CsvTable* table, int max_rows) {
-    if (!table) return;
-    if (table->column_count <= 0) return;
+#define MAX_COL_WIDTH 40
 
-    const int MAX_COL_WIDTH = 40;
-    int inspect_rows = (max_rows > 0 && max_rows < table->row_count) ? max_rows : table->row_count;
-    int* widths = calloc(table->column_count, sizeof(int));
-    if (!widths) return;
+/* one output format fed row by row, the writer is opened by begin */
+typedef struct {
+    RowSink base;
+    OutputFormat format;
+    bool vertical;              // table: one line per column
+    char* filename;             // NULL prints to standard output
+    char delimiter;             // CSV files
+
+    bool opened;
+    int open_errno;             // why the file could not be created, 0 if it was
+    OutputWriter out;
+
+    Column* columns;            // names copied by begin
+    int column_count;
+    long long row_count;
+
+    /* table: the first width_rows rows are kept as text until the column widths are fixed,
+     * a whole result given at once is measured in full instead */
+    int width_rows;
+    bool whole_result;
+    char** cells;
+    int buffered;
+    int* widths;
+    int name_width;             // vertical: longest column name
+} FormatSink;
+
+/* ===== CSV ===== */
+
+/* comma separated, values printed as they are, the -p csv output */
+static void csv_plain_begin(FormatSink* sink) {
+    for (int c = 0; c < sink->column_count; c++) {
+        if (c) writer_putc(&sink->out, ',');
+        writer_puts(&sink->out, sink->columns[c].name);
+    }
+    writer_putc(&sink->out, '\n');
+}
 
-    for (int c = 0; c < table->column_count; c++) {
-        widths[c] = (int)strlen(table->columns[c].name);
-        if (widths[c] > MAX_COL_WIDTH) widths[c] = MAX_COL_WIDTH;
+static void csv_plain_row(const FormatSink* sink, OutputWriter* out, const Row* row) {
+    for (int c = 0; c < sink->column_count; c++) {
+        if (c) writer_putc(out, ',');
+        if (c < row->column_count) writer_value(out, &row->values[c]);
     }
+    writer_putc(out, '\n');
+}
 
-    for (int r = 0; r < inspect_rows; r++) {
-        if (r >= table->row_count) break;
-        for (int c = 0; c < table->column_count; c++) {
-            if (c >= table->rows[r].column_count) continue;
-            char* s = value_to_string(&table->rows[r].values[c]);
-            int len = (int)strlen(s);
-            if (len > MAX_COL_WIDTH) len = MAX_COL_WIDTH;
-            if (len > widths[c]) widths[c] = len;
-            free(s);
+/* CSV file: strings are quoted when needed, NULL is an empty field */
+static void csv_file_begin(FormatSink* sink) {
+    for (int c = 0; c < sink->column_count; c++) {
+        if (c > 0) writer_putc(&sink->out, sink->delimiter);
+        writer_puts(&sink->out, sink->columns[c].name);
+    }
+    writer_putc(&sink->out, '\n');
+}
+
+static void csv_file_row(const FormatSink* sink, OutputWriter* out, const Row* row) {
+    for (int c = 0; c < row->column_count; c++) {
+        if (c > 0) writer_putc(out, sink->delimiter);
+
+        const Value* val = &row->values[c];
+        if (val->type == VALUE_TYPE_STRING) {
+            writer_csv_string(out, val->string_value ? val->string_value : "", sink->delimiter, '"');
+        } else if (val->type != VALUE_TYPE_NULL) {
+            writer_value(out, val);
         }
     }
+    writer_putc(out, '\n');
+}
 
-    for (int c = 0; c < table->column_count; c++) if (widths[c] < 3) widths[c] = 3;
+/* ===== JSON, NDJSON ===== */
+
+/* a NULL cell, or a string cell reading NULL, is a JSON null */
+static bool json_null(const Value* value) {
+    return value->type == VALUE_TYPE_NULL ||
+           (value->type == VALUE_TYPE_STRING && value->string_value && strcmp(value->string_value, "NULL") == 0);
+}
 
-    for (int c = 0; c < table->column_count; c++) {
-        printf("%-*s", widths[c] + 1, table->columns[c].name);
-        if (c < table->column_count - 1) printf(" | ");
+static void json_object(const FormatSink* sink, OutputWriter* out, const Row* row) {
+    writer_putc(out, '{');
+    for (int c = 0; c < sink->column_count; c++) {
+        if (c) writer_write(out, ", ", 2);
+        writer_putc(out, '"');
+        writer_puts(out, sink->columns[c].name);
+        writer_write(out, "\": ", 3);
+        if (c >= row->column_count || json_null(&row->values[c])) {
+            writer_write(out, "null", 4);
+            continue;
+        }
+        const Value* value = &row->values[c];
+        if (value->type == VALUE_TYPE_INTEGER || value->type == VALUE_TYPE_DOUBLE) {
+            writer_value(out, value);
+        } else if (value->type == VALUE_TYPE_STRING) {
+            writer_json_string(out, value->string_value ? value->string_value : "");
+        } else {
+            char scratch[VALUE_TEXT_SIZE];
+            size_t len;
+            const char* text = value_text(value, scratch, &len);
+            writer_putc(out, '"');
+            writer_write(out, text, len);
+            writer_putc(out, '"');
+        }
     }
-    printf("\n");
+    writer_putc(out, '}');
+}
 
-    for (int c = 0; c < table->column_count; c++) {
-        for (int k = 0; k < widths[c] + 1; k++) putchar('-');
-        if (c < table->column_count - 1) printf("-+-");
+static void json_row(const FormatSink* sink, OutputWriter* out, const Row* row, long long row_number) {
+    if (row_number) writer_write(out, ",\n", 2);
+    writer_write(out, "  ", 2);
+    json_object(sink, out, row);
+}
+
+/* one object per line */
+static void ndjson_row(const FormatSink* sink, OutputWriter* out, const Row* row) {
+    json_object(sink, out, row);
+    writer_putc(out, '\n');
+}
+
+/* ===== markdown, YAML ===== */
+
+static void markdown_begin(FormatSink* sink) {
+    OutputWriter* out = &sink->out;
+    for (int c = 0; c < sink->column_count; c++) {
+        writer_write(out, c ? " | " : " ", c ? 3 : 1);
+        writer_puts(out, sink->columns[c].name);
     }
-    printf("\n");
-
-    int rows_to_print = inspect_rows;
-    for (int r = 0; r < rows_to_print; r++) {
-        for (int c = 0; c < table->column_count; c++) {
-            char* s = NULL;
-            if (r < table->row_count && c < table->rows[r].column_count) s = value_to_string(&table->rows[r].values[c]);
-            else s = strdup("");
-
-            int len = (int)strlen(s);
-            if (len <= widths[c]) printf("%-*s", widths[c] + 1, s);
-            else {
-                if (widths[c] > 3) {
-                    int keep = widths[c] - 3;
-                    fwrite(s, 1, keep, stdout);
-                    printf("...");
-                    putchar(' ');
-                } else {
-                    for (int k = 0; k < widths[c] && k < len; k++) putchar(s[k]);
-                    putchar(' ');
-                }
-            }
-            free(s);
-            if (c < table->column_count - 1) printf(" | ");
-        }
-        printf("\n");
+    writer_putc(out, '\n');
+    for (int c = 0; c < sink->column_count; c++) {
+        writer_write(out, c ? " | ---" : " ---", c ? 6 : 4);
     }
+    writer_putc(out, '\n');
+}
 
-    if (max_rows > 0 && table->row_count > max_rows) printf("... (%d more rows)\n", table->row_count - max_rows);
+static void markdown_row(const FormatSink* sink, OutputWriter* out, const Row* row) {
+    for (int c = 0; c < sink->column_count; c++) {
+        writer_write(out, c ? " | " : " ", c ? 3 : 1);
+        if (c < row->column_count) writer_value(out, &row->values[c]);
+    }
+    writer_putc(out, '\n');
+}
 
-    free(widths);
+static void yaml_row(const FormatSink* sink, OutputWriter* out, const Row* row) {
+    writer_write(out, "-\n", 2);
+    for (int c = 0; c < sink->column_count; c++) {
+        writer_write(out, "  ", 2);
+        writer_puts(out, sink->columns[c].name);
+        writer_write(out, ": ", 2);
+        if (c < row->column_count) writer_value(out, &row->values[c]);
+        else writer_write(out, "null", 4);
+        writer_putc(out, '\n');
+    }
 }
 
-/* JSON printer */
-void print_json(ResultSet* res) {
-    if (!res) return;
-    printf("[");
-    for (int r = 0; r < res->row_count; r++) {
-        if (r) printf(",\n");
-        printf("  {");
-        for (int c = 0; c < res->column_count; c++) {
-            if (c) printf(", ");
-            char* key = res->columns[c].name;
-            char* val = NULL;
-            if (c < res->rows[r].column_count) val = value_to_string(&res->rows[r].values[c]);
-            printf("\"%s\": ", key);
-            if (!val || strcmp(val, "NULL") == 0) {
-                printf("null");
-            } else {
-                ValueType t = res->rows[r].values[c].type;
-                if (t == VALUE_TYPE_INTEGER || t == VALUE_TYPE_DOUBLE) printf("%s", val);
-                else {
-                    putchar('"');
-                    for (char* p = val; *p; p++) {
-                        if (*p == '\\' || *p == '"') { putchar('\\'); putchar(*p); }
-                        else if (*p == '\n') printf("\\n");
-                        else putchar(*p);
-                    }
-                    putchar('"');
-                }
-            }
-            if (val) free(val);
-        }
-        printf("}");
+/* ===== table ===== */
+
+static void table_cell(const FormatSink* sink, OutputWriter* out, int c, const char* s, size_t len) {
+    int width = sink->widths[c];
+    // a row after the first width_rows may not fit, its cell grows out of line instead of
+    // cutting the value short
+    if (len > (size_t)width) width = len < MAX_COL_WIDTH ? (int)len : MAX_COL_WIDTH;
+    if (len <= (size_t)width) {
+        writer_write(out, s, len);
+        writer_pad(out, ' ', width + 1 - (int)len);
+    } else if (width > 3) {
+        writer_write(out, s, width - 3);
+        writer_write(out, "... ", 4);
+    } else {
+        writer_write(out, s, width);
+        writer_putc(out, ' ');
     }
-    printf("\n]\n");
+    if (c < sink->column_count - 1) writer_write(out, " | ", 3);
 }
 
-/* Markdown printer */
-void print_markdown(ResultSet* res) {
-    if (!res) return;
-    for (int c = 0; c < res->column_count; c++) {
-        if (c) printf(" |");
-        printf(" %s", res->columns[c].name);
+static void table_row(const FormatSink* sink, OutputWriter* out, const Row* row) {
+    char scratch[VALUE_TEXT_SIZE];
+    for (int c = 0; c < sink->column_count; c++) {
+        const char* s = "";
+        size_t len = 0;
+        if (c < row->column_count) s = value_text(&row->values[c], scratch, &len);
+        table_cell(sink, out, c, s, len);
+    }
+    writer_putc(out, '\n');
+}
+
+/* widths start from the column names, each cell then widens its column up to MAX_COL_WIDTH */
+static void table_widths_begin(FormatSink* sink) {
+    int columns = sink->column_count;
+    sink->widths = malloc(sizeof(int) * (columns > 0 ? columns : 1));
+    for (int c = 0; c < columns; c++) {
+        sink->widths[c] = (int)strlen(sink->columns[c].name);
+        if (sink->widths[c] > MAX_COL_WIDTH) sink->widths[c] = MAX_COL_WIDTH;
+    }
+}
+
+static void table_widen(FormatSink* sink, int c, size_t len) {
+    int shown = len > MAX_COL_WIDTH ? MAX_COL_WIDTH : (int)len;
+    if (shown > sink->widths[c]) sink->widths[c] = shown;
+}
+
+static void table_header(FormatSink* sink) {
+    int columns = sink->column_count;
+    for (int c = 0; c < columns; c++) if (sink->widths[c] < 3) sink->widths[c] = 3;
+
+    OutputWriter* out = &sink->out;
+    for (int c = 0; c < columns; c++) {
+        writer_puts(out, sink->columns[c].name);
+        writer_pad(out, ' ', sink->widths[c] + 1 - (int)strlen(sink->columns[c].name));
+        if (c < columns - 1) writer_write(out, " | ", 3);
+    }
+    writer_putc(out, '\n');
+    for (int c = 0; c < columns; c++) {
+        writer_pad(out, '-', sink->widths[c] + 1);
+        if (c < columns - 1) writer_write(out, "-+-", 3);
     }
-    printf("\n");
-    for (int c = 0; c < res->column_count; c++) {
-        if (c) printf(" |");
-        printf(" ---");
+    writer_putc(out, '\n');
+}
+
+/* fix the widths from the names and the buffered rows, then print the header and those rows */
+static void table_layout(FormatSink* sink) {
+    int columns = sink->column_count;
+    table_widths_begin(sink);
+    for (int r = 0; r < sink->buffered; r++) {
+        for (int c = 0; c < columns; c++) table_widen(sink, c, strlen(sink->cells[(size_t)r * columns + c]));
     }
-    printf("\n");
-    for (int r = 0; r < res->row_count; r++) {
-        for (int c = 0; c < res->column_count; c++) {
-            if (c) printf(" |");
-            char* val = NULL;
-            if (c < res->rows[r].column_count) val = value_to_string(&res->rows[r].values[c]);
-            printf(" %s", val ? val : "");
-            if (val) free(val);
+    table_header(sink);
+
+    OutputWriter* out = &sink->out;
+    for (int r = 0; r < sink->buffered; r++) {
+        for (int c = 0; c < columns; c++) {
+            char* s = sink->cells[(size_t)r * columns + c];
+            table_cell(sink, out, c, s, strlen(s));
+            free(s);
         }
-        printf("\n");
+        writer_putc(out, '\n');
     }
+    free(sink->cells);
+    sink->cells = NULL;
+    sink->buffered = 0;
 }
 
-/* YAML printer */
-void print_yaml(ResultSet* res) {
-    if (!res) return;
-    for (int r = 0; r < res->row_count; r++) {
-        printf("-\n");
-        for (int c = 0; c < res->column_count; c++) {
-            char* key = res->columns[c].name;
-            char* val = NULL;
-            if (c < res->rows[r].column_count) val = value_to_string(&res->rows[r].values[c]);
-            printf("  %s: %s\n", key, val ? val : "null");
-            if (val) free(val);
+/* fix the widths from every row of a whole result and print the header, the rows are
+ * then formatted as any others without being held back */
+static void table_measure(FormatSink* sink, const Row* rows, int count) {
+    table_widths_begin(sink);
+    char scratch[VALUE_TEXT_SIZE];
+    for (int r = 0; r < count; r++) {
+        for (int c = 0; c < sink->column_count && c < rows[r].column_count; c++) {
+            size_t len = 0;
+            value_text(&rows[r].values[c], scratch, &len);
+            table_widen(sink, c, len);
         }
     }
+    table_header(sink);
 }
 
-/* Vertical table printer (one column per line) */
-void csv_print_table_vertical(CsvTable* table, int max_rows) {
-    if (!table) return;
-    int max_name_len = 0;
-    for (int i = 0; i < table->column_count; i++) {
-        int len = (int)strlen(table->columns[i].name);
-        if (len > max_name_len) max_name_len = len;
+/* rows are held back until width_rows of them have been seen */
+static void table_push(FormatSink* sink, const Row* row) {
+    if (sink->buffered == sink->width_rows) {
+        table_layout(sink);
+        table_row(sink, &sink->out, row);
+        return;
     }
 
-    int rows_to_print = (max_rows > 0 && max_rows < table->row_count) ? max_rows : table->row_count;
-    for (int i = 0; i < rows_to_print; i++) {
-        printf("*************************** %d. row ***************************\n", i + 1);
-        for (int j = 0; j < table->column_count && j < table->rows[i].column_count; j++) {
-            char* str = value_to_string(&table->rows[i].values[j]);
-            printf("%*s: %s\n", max_name_len, table->columns[j].name, str);
-            free(str);
-        }
+    int columns = sink->column_count;
+    if (!sink->cells) sink->cells = malloc(sizeof(char*) * ((size_t)sink->width_rows * columns + 1));
+    char scratch[VALUE_TEXT_SIZE];
+    for (int c = 0; c < columns; c++) {
+        size_t len = 0;
+        const char* s = c < row->column_count ? value_text(&row->values[c], scratch, &len) : "";
+        char* text = malloc(len + 1);
+        memcpy(text, s, len);
+        text[len] = '\0';
+        sink->cells[(size_t)sink->buffered * columns + c] = text;
     }
+    sink->buffered++;
+}
 
-    if (max_rows > 0 && table->row_count > max_rows) {
-        printf("... (%d more rows)\n", table->row_count - max_rows);
+static void vertical_row(const FormatSink* sink, OutputWriter* out, const Row* row, long long row_number) {
+    writer_puts(out, "*************************** ");
+    writer_int(out, row_number + 1);
+    writer_puts(out, ". row ***************************\n");
+    for (int j = 0; j < sink->column_count && j < row->column_count; j++) {
+        writer_pad(out, ' ', sink->name_width - (int)strlen(sink->columns[j].name));
+        writer_puts(out, sink->columns[j].name);
+        writer_write(out, ": ", 2);
+        writer_value(out, &row->values[j]);
+        writer_putc(out, '\n');
     }
 }
 
-bool write_output_file(const char* filename, ResultSet* res, OutputFormat fmt, char delimiter) {
-    if (!filename || !res) return false;
-    if (fmt == FMT_AUTO) fmt = FMT_CSV;
-
-    if (fmt == FMT_JSON) {
-        FILE* f = fopen(filename, "w");
-        if (!f) return false;
-        fprintf(f, "[");
-        for (int r = 0; r < res->row_count; r++) {
-            if (r) fprintf(f, ",\n");
-            fprintf(f, "  {");
-            for (int c = 0; c < res->column_count; c++) {
-                if (c) fprintf(f, ", ");
-                char* key = res->columns[c].name;
-                char* val = NULL;
-                if (c < res->rows[r].column_count) val = value_to_string(&res->rows[r].values[c]);
-                fprintf(f, "\"%s\": ", key);
-                if (!val || strcmp(val, "NULL") == 0) {
-                    fprintf(f, "null");
-                } else {
-                    ValueType t = res->rows[r].values[c].type;
-                    if (t == VALUE_TYPE_INTEGER || t == VALUE_TYPE_DOUBLE) fprintf(f, "%s", val);
-                    else {
-                        fprintf(f, "\"");
-                        for (char* p = val; *p; p++) {
-                            if (*p == '\\' || *p == '"') { fprintf(f, "\\%c", *p); }
-                            else if (*p == '\n') fprintf(f, "\\n");
-                            else fputc(*p, f);
-                        }
-                        fprintf(f, "\"");
-                    }
-                }
-                if (val) free(val);
+/* ===== sink ===== */
+
+static void format_begin(RowSink* base, const Column* columns, int column_count) {
+    FormatSink* sink = (FormatSink*)base;
+    sink->column_count = column_count;
+    sink->columns = malloc(sizeof(Column) * (column_count > 0 ? column_count : 1));
+    for (int c = 0; c < column_count; c++) {
+        sink->columns[c].name = strdup(columns[c].name);
+        sink->columns[c].inferred_type = columns[c].inferred_type;
+        int len = (int)strlen(columns[c].name);
+        if (len > sink->name_width) sink->name_width = len;
+    }
+
+    if (sink->filename) {
+        if (!writer_open(&sink->out, sink->filename)) {
+            sink->open_errno = errno;
+            if (sink->format == FMT_CSV) {
+                fprintf(stderr, "Error: Cannot open output file '%s'\n", sink->filename);
             }
-            fprintf(f, "}");
+            return;
         }
-        fprintf(f, "\n]\n");
-        fclose(f);
-        return true;
+    } else {
+        writer_open_fd(&sink->out, WRITER_STDOUT);
+    }
+    sink->opened = true;
+
+    switch (sink->format) {
+        case FMT_CSV:
+            if (sink->filename) csv_file_begin(sink);
+            else csv_plain_begin(sink);
+            break;
+        case FMT_JSON:
+            writer_putc(&sink->out, '[');
+            break;
+        case FMT_MARKDOWN:
+            markdown_begin(sink);
+            break;
+        default:
+            break;
     }
+}
+
+/* a table still collecting the rows its widths are taken from */
+static bool table_pending(const FormatSink* sink) {
+    return sink->format == FMT_TABLE && !sink->vertical && !sink->widths && sink->column_count > 0;
+}
+
+/* format one row into out; reads nothing but the columns, the widths and the settings of sink,
+ * so rows can be formatted on several threads at once */
+static void format_write_row(const FormatSink* sink, OutputWriter* out, const Row* row, long long row_number) {
+    switch (sink->format) {
+        case FMT_CSV:
+            if (sink->filename) csv_file_row(sink, out, row);
+            else csv_plain_row(sink, out, row);
+            break;
+        case FMT_JSON:
+            json_row(sink, out, row, row_number);
+            break;
+        case FMT_NDJSON:
+            ndjson_row(sink, out, row);
+            break;
+        case FMT_MARKDOWN:
+            markdown_row(sink, out, row);
+            break;
+        case FMT_YAML:
+            yaml_row(sink, out, row);
+            break;
+        default:
+            if (sink->vertical) vertical_row(sink, out, row, row_number);
+            else if (sink->column_count > 0) table_row(sink, out, row);
+            break;
+    }
+}
+
+static bool format_row(RowSink* base, const Row* row) {
+    FormatSink* sink = (FormatSink*)base;
+    if (!sink->opened) return false;
+
+    if (table_pending(sink)) table_push(sink, row);
+    else format_write_row(sink, &sink->out, row, sink->row_count);
+    sink->row_count++;
+    return true;
+}
+
+/* ===== parallel formatting ===== */
+
+int output_threads = 0;
+
+/* without pthreads every row is formatted on the calling thread */
+#if !defined(_WIN32) && !defined(_WIN64)
+static int format_thread_count(void) {
+    int threads = output_threads > 0 ? output_threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    return threads < MAX_OUTPUT_THREADS ? threads : MAX_OUTPUT_THREADS;
+}
 
-    if (fmt == FMT_MARKDOWN) {
-        FILE* f = fopen(filename, "w");
-        if (!f) return false;
-        for (int c = 0; c < res->column_count; c++) {
-            if (c) fprintf(f, " |");
-            fprintf(f, " %s", res->columns[c].name);
+typedef struct {
+    char* text;
+    size_t length;
+    bool done;
+} FormattedChunk;
+
+/* the workers take chunks in order and format each into its own memory writer, the calling
+ * thread writes the finished chunks out in order; workers stay at most window chunks ahead
+ * of it so the text held in memory is bounded */
+typedef struct {
+    const FormatSink* sink;
+    const Row* rows;
+    int count;
+    long long first_row;        // row number of rows[0]
+    FormattedChunk* chunks;
+    int chunk_count;
+    int next;                   // next chunk a worker takes
+    int written;                // chunks written out
+    int window;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} FormatBatch;
+
+static void* format_worker(void* arg) {
+    FormatBatch* batch = arg;
+    OutputWriter out;
+    writer_open_memory(&out);
+
+    pthread_mutex_lock(&batch->lock);
+    for (;;) {
+        while (batch->next < batch->chunk_count && batch->next >= batch->written + batch->window) {
+            pthread_cond_wait(&batch->changed, &batch->lock);
         }
-        fprintf(f, "\n");
-        for (int c = 0; c < res->column_count; c++) {
-            if (c) fprintf(f, " |");
-            fprintf(f, " ---");
+        if (batch->next == batch->chunk_count) break;
+        int chunk = batch->next++;
+        pthread_mutex_unlock(&batch->lock);
+
+        int first = chunk * FORMAT_CHUNK_ROWS;
+        int last = first + FORMAT_CHUNK_ROWS < batch->count ? first + FORMAT_CHUNK_ROWS : batch->count;
+        for (int r = first; r < last; r++) {
+            format_write_row(batch->sink, &out, &batch->rows[r], batch->first_row + r);
         }
-        fprintf(f, "\n");
-        for (int r = 0; r < res->row_count; r++) {
-            for (int c = 0; c < res->column_count; c++) {
-                if (c) fprintf(f, " |");
-                char* val = NULL;
-                if (c < res->rows[r].column_count) val = value_to_string(&res->rows[r].values[c]);
-                fprintf(f, " %s", val ? val : "");
-                if (val) free(val);
-            }
-            fprintf(f, "\n");
+        size_t length;
+        char* text = writer_take_memory(&out, &length);
+
+        pthread_mutex_lock(&batch->lock);
+        batch->chunks[chunk].text = text;
+        batch->chunks[chunk].length = length;
+        batch->chunks[chunk].done = true;
+        pthread_cond_broadcast(&batch->changed);
+    }
+    pthread_mutex_unlock(&batch->lock);
+
+    writer_close(&out);
+    return NULL;
+}
+
+/* false if no worker could be started, nothing has been written then */
+static bool format_parallel(FormatSink* sink, const Row* rows, int count, int threads) {
+    FormatBatch batch = {
+        .sink = sink,
+        .rows = rows,
+        .count = count,
+        .first_row = sink->row_count,
+        .chunk_count = (count + FORMAT_CHUNK_ROWS - 1) / FORMAT_CHUNK_ROWS,
+        .window = threads * 2,
+    };
+    batch.chunks = calloc((size_t)batch.chunk_count, sizeof(FormattedChunk));
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.changed, NULL);
+
+    if (threads > batch.chunk_count) threads = batch.chunk_count;
+    pthread_t workers[MAX_OUTPUT_THREADS];
+    int started = 0;
+    while (started < threads && pthread_create(&workers[started], NULL, format_worker, &batch) == 0) started++;
+
+    if (started > 0) {
+        for (int c = 0; c < batch.chunk_count; c++) {
+            pthread_mutex_lock(&batch.lock);
+            while (!batch.chunks[c].done) pthread_cond_wait(&batch.changed, &batch.lock);
+            pthread_mutex_unlock(&batch.lock);
+
+            writer_write(&sink->out, batch.chunks[c].text, batch.chunks[c].length);
+            free(batch.chunks[c].text);
+
+            pthread_mutex_lock(&batch.lock);
+            batch.written++;
+            pthread_cond_broadcast(&batch.changed);
+            pthread_mutex_unlock(&batch.lock);
         }
-        fclose(f);
+        for (int t = 0; t < started; t++) pthread_join(workers[t], NULL);
+    }
+
+    pthread_cond_destroy(&batch.changed);
+    pthread_mutex_destroy(&batch.lock);
+    free(batch.chunks);
+    return started > 0;
+}
+#endif
+
+static bool format_rows(RowSink* base, const Row* rows, int count) {
+    FormatSink* sink = (FormatSink*)base;
+    if (!sink->opened) return false;
+
+    // a whole result is measured in full, else the rows the widths are taken from go one by one
+    if (table_pending(sink) && sink->whole_result && sink->buffered == 0) table_measure(sink, rows, count);
+    int r = 0;
+    for (; r < count && table_pending(sink); r++) format_row(base, &rows[r]);
+
+#if !defined(_WIN32) && !defined(_WIN64)
+    int threads = format_thread_count();
+    if (threads > 1 && count - r >= 2 * FORMAT_CHUNK_ROWS && format_parallel(sink, rows + r, count - r, threads)) {
+        sink->row_count += count - r;
         return true;
     }
+#endif
+    for (; r < count; r++) format_row(base, &rows[r]);
+    return true;
+}
 
-    if (fmt == FMT_YAML) {
-        FILE* f = fopen(filename, "w");
-        if (!f) return false;
-        for (int r = 0; r < res->row_count; r++) {
-            fprintf(f, "-\n");
-            for (int c = 0; c < res->column_count; c++) {
-                char* key = res->columns[c].name;
-                char* val = NULL;
-                if (c < res->rows[r].column_count) val = value_to_string(&res->rows[r].values[c]);
-                fprintf(f, "  %s: %s\n", key, val ? val : "null");
-                if (val) free(val);
-            }
+static void format_expect(RowSink* base, int row_count) {
+    (void)row_count;
+    ((FormatSink*)base)->whole_result = true;
+}
+
+static bool format_end(RowSink* base) {
+    FormatSink* sink = (FormatSink*)base;
+    bool ok = true;
+
+    if (sink->opened) {
+        if (sink->format == FMT_JSON) {
+            writer_write(&sink->out, "\n]\n", 3);
+        } else if (table_pending(sink)) {
+            table_layout(sink);
         }
-        fclose(f);
-        return true;
+        ok = writer_close(&sink->out);
+
+        // standard output never reports failure, a CSV file reports its own
+        if (!sink->filename) {
+            ok = true;
+        } else if (sink->format == FMT_CSV) {
+            if (ok) printf("Result written to '%s'\n", sink->filename);
+            else fprintf(stderr, "Error: Cannot write output file '%s'\n", sink->filename);
+            ok = true;
+        }
+    } else if (sink->open_errno) {
+        ok = sink->format == FMT_CSV;
+        errno = sink->open_errno;
     }
 
-    // default: CSV
-    write_csv_file(filename, res, delimiter);
-    return true;
+    for (int c = 0; c < sink->column_count; c++) free(sink->columns[c].name);
+    free(sink->columns);
+    free(sink->widths);
+    free(sink->filename);
+    free(sink);
+    return ok;
+}
+
+static FormatSink* format_sink_new(OutputFormat fmt) {
+    FormatSink* sink = calloc(1, sizeof(FormatSink));
+    sink->base.begin = format_begin;
+    sink->base.row = format_row;
+    sink->base.end = format_end;
+    sink->base.rows = format_rows;
+    sink->base.expect = format_expect;
+    sink->format = fmt == FMT_AUTO ? FMT_TABLE : fmt;
+    sink->width_rows = TABLE_WIDTH_ROWS;
+    return sink;
+}
+
+RowSink* format_sink_create(OutputFormat fmt, bool vertical) {
+    if (fmt == FMT_ARROW) return arrow_sink_create(NULL);
+    FormatSink* sink = format_sink_new(fmt);
+    sink->vertical = vertical;
+    return &sink->base;
+}
+
+RowSink* format_file_sink_create(const char* filename, OutputFormat fmt, char delimiter) {
+    // there is no table file format, it is written as CSV
+    if (fmt == FMT_AUTO || fmt == FMT_TABLE) fmt = FMT_CSV;
+    if (fmt == FMT_ARROW) return arrow_sink_create(filename);
+    FormatSink* sink = format_sink_new(fmt);
+    sink->filename = strdup(filename);
+    sink->delimiter = delimiter;
+    return &sink->base;
+}
+
+/* ===== materialized results ===== */
+
+static void print_rows(RowSink* sink, CsvTable* table, int row_count) {
+    sink->begin(sink, table->columns, table->column_count);
+    for (int r = 0; r < row_count; r++) sink->row(sink, &table->rows[r]);
+    sink->end(sink);
+}
+
+/* CSV print table */
+void csv_print_table(CsvTable* table, int max_rows) {
+    if (!table) return;
+    if (table->column_count <= 0) return;
+
+    int inspect_rows = (max_rows > 0 && max_rows < table->row_count) ? max_rows : table->row_count;
+    FormatSink* sink = format_sink_new(FMT_TABLE);
+    sink->width_rows = inspect_rows;
+    print_rows(&sink->base, table, inspect_rows);
+
+    if (max_rows > 0 && table->row_count > max_rows) printf("... (%d more rows)\n", table->row_count - max_rows);
+}
+
+/* Vertical table printer (one column per line) */
+void csv_print_table_vertical(CsvTable* table, int max_rows) {
+    if (!table) return;
+    int rows_to_print = (max_rows > 0 && max_rows < table->row_count) ? max_rows : table->row_count;
+    print_rows(format_sink_create(FMT_TABLE, true), table, rows_to_print);
+
+    if (max_rows > 0 && table->row_count > max_rows) {
+        printf("... (%d more rows)\n", table->row_count - max_rows);
+    }
+}
+
+static void print_format(OutputFormat fmt, ResultSet* res) {
+    if (!res) return;
+    print_rows(format_sink_create(fmt, false), res, res->row_count);
+}
+
+/* JSON printer */
+void print_json(ResultSet* res) {
+    print_format(FMT_JSON, res);
+}
+
+/* NDJSON printer */
+void print_ndjson(ResultSet* res) {
+    print_format(FMT_NDJSON, res);
+}
+
+/* Markdown printer */
+void print_markdown(ResultSet* res) {
+    print_format(FMT_MARKDOWN, res);
+}
+
+/* YAML printer */
+void print_yaml(ResultSet* res) {
+    print_format(FMT_YAML, res);
+}
+
+/* CSV printer */
+void print_csv(ResultSet* res) {
+    print_format(FMT_CSV, res);
+}
+
+bool write_output_file(const char* filename, ResultSet* res, OutputFormat fmt, char delimiter) {
+    if (!filename || !res) return false;
+    RowSink* sink = format_file_sink_create(filename, fmt, delimiter);
+    row_sink_push_result(sink, res);
+    return sink->end(sink);
 }
@@ -0,0 +1,307 @@
+/* input_stream.c - gzip and zstd input decompressed, and pipes read, on a background thread */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <pthread.h>
+#include <unistd.h>
+#define INPUT_THREADS 1
+#else
+#include <io.h>
+#define read _read
+#endif
+#ifdef CQ_ZLIB
+#include <zlib.h>
+#endif
+#ifdef CQ_ZSTD
+#include <zstd.h>
+#endif
+
+#include "input_stream.h"
+
+/* zlib counts its input in 32 bit units */
+#define INPUT_CHUNK (1 << 30)
+
+typedef struct {
+    char* data;
+    long length;                // bytes held, 0 for the end and -1 for an error
+} InputBlock;
+
+struct InputStream {
+    InputCompression compression;
+    const char* input;
+    size_t input_size;
+    size_t input_position;      // bytes handed to the decoder
+    int fd;                     // descriptor read instead of input, -1 for none
+    bool finished;              // the decoder reached the end of its last frame
+    char error[128];
+#ifdef CQ_ZLIB
+    z_stream zlib;
+#endif
+#ifdef CQ_ZSTD
+    ZSTD_DCtx* zstd;
+    ZSTD_inBuffer zstd_input;
+#endif
+
+    /* ring of blocks: head is the oldest filled one, count are filled */
+    InputBlock blocks[INPUT_BLOCKS];
+    int head;
+    int count;
+    bool holding;               // the caller still reads blocks[head]
+#ifdef INPUT_THREADS
+    pthread_t thread;
+    bool thread_started;
+    bool closing;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+#endif
+};
+
+InputCompression input_compression(const char* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    if (size >= 2 && bytes[0] == 0x1f && bytes[1] == 0x8b) return INPUT_GZIP;
+    if (size >= 4 && bytes[0] == 0x28 && bytes[1] == 0xb5 && bytes[2] == 0x2f && bytes[3] == 0xfd) return INPUT_ZSTD;
+    return INPUT_PLAIN;
+}
+
+static long fail(InputStream* in, const char* message) {
+    snprintf(in->error, sizeof(in->error), "%s", message);
+    return -1;
+}
+
+/* ===== decoders, each fills out with up to capacity bytes ===== */
+
+#ifdef CQ_ZLIB
+static long inflate_block(InputStream* in, char* out, size_t capacity) {
+    z_stream* z = &in->zlib;
+    z->next_out = (Bytef*)out;
+    z->avail_out = (uInt)capacity;
+
+    while (z->avail_out > 0 && !in->finished) {
+        if (z->avail_in == 0 && in->input_position < in->input_size) {
+            size_t chunk = in->input_size - in->input_position;
+            if (chunk > INPUT_CHUNK) chunk = INPUT_CHUNK;
+            z->next_in = (Bytef*)in->input + in->input_position;
+            z->avail_in = (uInt)chunk;
+            in->input_position += chunk;
+        }
+        int rc = inflate(z, Z_NO_FLUSH);
+        if (rc == Z_STREAM_END) {
+            // concatenated members, as written by pigz or cat a.gz b.gz, read as one file;
+            // like gzip, bytes after the last member that are not another one are ignored
+            const unsigned char* next = z->avail_in ? z->next_in : (const unsigned char*)in->input + in->input_position;
+            size_t left = z->avail_in ? z->avail_in : in->input_size - in->input_position;
+            if (left >= 2 && next[0] == 0x1f && next[1] == 0x8b) {
+                inflateReset(z);
+            } else {
+                in->finished = true;
+            }
+        } else if (rc == Z_BUF_ERROR && z->avail_in == 0 && in->input_position == in->input_size) {
+            return fail(in, "the gzip data is truncated");
+        } else if (rc != Z_OK && rc != Z_BUF_ERROR) {
+            return fail(in, z->msg ? z->msg : "damaged gzip data");
+        }
+    }
+    return (long)(capacity - z->avail_out);
+}
+#endif
+
+#ifdef CQ_ZSTD
+static long zstd_block(InputStream* in, char* out, size_t capacity) {
+    ZSTD_outBuffer output = { out, capacity, 0 };
+    ZSTD_inBuffer* input = &in->zstd_input;
+
+    while (output.pos < output.size && !in->finished) {
+        size_t rc = ZSTD_decompressStream(in->zstd, &output, input);
+        if (ZSTD_isError(rc)) return fail(in, ZSTD_getErrorName(rc));
+        if (input->pos == input->size && output.pos < output.size) {
+            // a frame still expecting data at the end of the input is cut short
+            if (rc != 0) return fail(in, "the zstd data is truncated");
+            in->finished = true;
+        }
+    }
+    return (long)output.pos;
+}
+#endif
+
+/* fill the block from the descriptor, short only at the end of the input */
+static long read_block(InputStream* in, char* out, size_t capacity) {
+    size_t length = 0;
+    while (length < capacity) {
+        long n = (long)read(in->fd, out + length, capacity - length);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return fail(in, strerror(errno));
+        if (n == 0) {
+            in->finished = true;
+            break;
+        }
+        length += (size_t)n;
+    }
+    if (in->input_position == 0 && input_compression(out, length) != INPUT_PLAIN) {
+        return fail(in, "compressed input cannot be read from a pipe, decompress it first (zcat, zstdcat)");
+    }
+    in->input_position += length;
+    return (long)length;
+}
+
+static long decode_block(InputStream* in, char* out, size_t capacity) {
+    if (in->finished) return 0;
+    if (in->fd >= 0) return read_block(in, out, capacity);
+    switch (in->compression) {
+#ifdef CQ_ZLIB
+        case INPUT_GZIP: return inflate_block(in, out, capacity);
+#endif
+#ifdef CQ_ZSTD
+        case INPUT_ZSTD: return zstd_block(in, out, capacity);
+#endif
+        default: {
+            size_t length = in->input_size - in->input_position;
+            if (length > capacity) length = capacity;
+            memcpy(out, in->input + in->input_position, length);
+            in->input_position += length;
+            in->finished = in->input_position == in->input_size;
+            return (long)length;
+        }
+    }
+}
+
+/* ===== block ring ===== */
+
+#ifdef INPUT_THREADS
+static void* decode_thread(void* arg) {
+    InputStream* in = arg;
+    for (;;) {
+        pthread_mutex_lock(&in->lock);
+        while (in->count == INPUT_BLOCKS && !in->closing) pthread_cond_wait(&in->changed, &in->lock);
+        if (in->closing) {
+            pthread_mutex_unlock(&in->lock);
+            return NULL;
+        }
+        InputBlock* block = &in->blocks[(in->head + in->count) % INPUT_BLOCKS];
+        pthread_mutex_unlock(&in->lock);
+
+        long length = decode_block(in, block->data, INPUT_BLOCK_SIZE);
+
+        pthread_mutex_lock(&in->lock);
+        block->length = length;
+        in->count++;
+        pthread_cond_broadcast(&in->changed);
+        pthread_mutex_unlock(&in->lock);
+        if (length <= 0) return NULL;
+    }
+}
+#endif
+
+static InputStream* start_stream(InputStream* in) {
+    for (int i = 0; i < INPUT_BLOCKS; i++) in->blocks[i].data = malloc(INPUT_BLOCK_SIZE);
+#ifdef INPUT_THREADS
+    pthread_mutex_init(&in->lock, NULL);
+    pthread_cond_init(&in->changed, NULL);
+#endif
+    if (in->error[0]) {
+        // every read reports the error
+        in->blocks[0].length = -1;
+        in->count = 1;
+        return in;
+    }
+#ifdef INPUT_THREADS
+    in->thread_started = pthread_create(&in->thread, NULL, decode_thread, in) == 0;
+#endif
+    return in;
+}
+
+InputStream* input_stream_open(const char* data, size_t size, InputCompression compression) {
+    InputStream* in = calloc(1, sizeof(InputStream));
+    in->compression = compression;
+    in->input = data;
+    in->input_size = size;
+    in->fd = -1;
+
+    switch (compression) {
+        case INPUT_GZIP:
+#ifdef CQ_ZLIB
+            // 15 + 32: any window size, gzip or zlib header detected automatically
+            if (inflateInit2(&in->zlib, 15 + 32) != Z_OK) fail(in, "zlib could not be initialized");
+#else
+            fail(in, "gzip input needs cq built with zlib");
+#endif
+            break;
+        case INPUT_ZSTD:
+#ifdef CQ_ZSTD
+            in->zstd = ZSTD_createDCtx();
+            in->zstd_input.src = data;
+            in->zstd_input.size = size;
+            in->zstd_input.pos = 0;
+#else
+            fail(in, "zstd input needs cq built with ZSTD=1");
+#endif
+            break;
+        case INPUT_PLAIN:
+            break;
+    }
+
+    return start_stream(in);
+}
+
+InputStream* input_stream_open_fd(int fd) {
+    InputStream* in = calloc(1, sizeof(InputStream));
+    in->compression = INPUT_PLAIN;
+    in->fd = fd;
+    return start_stream(in);
+}
+
+long input_stream_next(InputStream* in, const char** block) {
+#ifdef INPUT_THREADS
+    if (in->thread_started) {
+        pthread_mutex_lock(&in->lock);
+        if (in->holding) {
+            in->head = (in->head + 1) % INPUT_BLOCKS;
+            in->count--;
+            in->holding = false;
+            pthread_cond_broadcast(&in->changed);
+        }
+        while (in->count == 0) pthread_cond_wait(&in->changed, &in->lock);
+        InputBlock* next = &in->blocks[in->head];
+        in->holding = next->length > 0;     // the end and errors stay for later calls
+        pthread_mutex_unlock(&in->lock);
+        *block = next->data;
+        return next->length;
+    }
+#endif
+    // decoded on the calling thread, one block is enough
+    InputBlock* next = &in->blocks[0];
+    if (in->count == 0) next->length = decode_block(in, next->data, INPUT_BLOCK_SIZE);
+    if (next->length <= 0) in->count = 1;
+    *block = next->data;
+    return next->length;
+}
+
+const char* input_stream_error(const InputStream* in) {
+    return in->error;
+}
+
+void input_stream_close(InputStream* in) {
+    if (!in) return;
+#ifdef INPUT_THREADS
+    if (in->thread_started) {
+        pthread_mutex_lock(&in->lock);
+        in->closing = true;
+        pthread_cond_broadcast(&in->changed);
+        pthread_mutex_unlock(&in->lock);
+        pthread_join(in->thread, NULL);
+    }
+    pthread_mutex_destroy(&in->lock);
+    pthread_cond_destroy(&in->changed);
+#endif
+#ifdef CQ_ZLIB
+    if (in->compression == INPUT_GZIP) inflateEnd(&in->zlib);
+#endif
+#ifdef CQ_ZSTD
+    if (in->zstd) ZSTD_freeDCtx(in->zstd);
+#endif
+    for (int i = 0; i < INPUT_BLOCKS; i++) free(in->blocks[i].data);
+    free(in);
+}
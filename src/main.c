@@ -10,6 +10,7 @@
 #include "csv_reader.h"
 #include "formats.h"
 #include "utils.h"
+#include "profile.h"
 #include "tui/tui_core.h"
 #include "tui/terminal.h"
 
@@ -26,6 +27,24 @@ static bool is_csv_file(const char* path) {
     return len > 4 && strcmp(path + len - 4, ".csv") == 0;
 }
 
+/* counters go to stderr so they never mix with query output */
+static void finish_profiling(bool profile, const char* trace_file) {
+    if (profile) profile_report(stderr);
+    if (trace_file) profile_write_trace(trace_file);
+    profile_reset();
+}
+
+/* printer of -p, writer of -o, or both fed the same rows */
+static RowSink* open_output_sink(bool print, OutputFormat print_format, bool vertical,
+                                 const char* output_file, OutputFormat file_format, char delimiter) {
+    RowSink* sink = print ? format_sink_create(print_format, vertical) : NULL;
+    if (output_file) {
+        RowSink* file_sink = format_file_sink_create(output_file, file_format, delimiter);
+        sink = sink ? row_sink_tee(sink, file_sink) : file_sink;
+    }
+    return sink;
+}
+
 static int run_tui_mode(const char* path, char input_separator) {
     global_csv_config.delimiter = input_separator;
     global_csv_config.quote = '"';
@@ -53,6 +72,10 @@ static int run_cli_mode(int argc, char* argv[]) {
     bool print_table = false;
     bool vertical_output = false;
     bool query_allocated = false;  // track if we need to free query
+    bool profile = false;
+    char* trace_file = NULL;
+    char* schema_spec = NULL;
+    int sample_rows = 0;
     char input_separator = ',';
     char output_delimiter = ',';
     
@@ -63,6 +86,11 @@ static int run_cli_mode(int argc, char* argv[]) {
         {"force", no_argument, 0, 'F'},
         {"help", no_argument, 0, 'h'},
         {"format", required_argument, 0, 'O'},
+        {"output-threads", required_argument, 0, 'W'},
+        {"profile", no_argument, 0, 'P'},
+        {"sample-rows", required_argument, 0, 'R'},
+        {"schema", required_argument, 0, 'S'},
+        {"trace", required_argument, 0, 'T'},
         {0, 0, 0, 0}
     };
     
@@ -85,6 +113,7 @@ static int run_cli_mode(int argc, char* argv[]) {
                 break;
             case 'c':
                 print_count = true;
+                report_join_order = true;
                 break;
             case 'p':
                 print_table = true;
@@ -94,6 +123,8 @@ static int run_cli_mode(int argc, char* argv[]) {
                     else if (strcasecmp(optarg, "markdown") == 0 || strcasecmp(optarg, "md") == 0) print_format = FMT_MARKDOWN;
                     else if (strcasecmp(optarg, "yaml") == 0 || strcasecmp(optarg, "yml") == 0) print_format = FMT_YAML;
                     else if (strcasecmp(optarg, "json") == 0) print_format = FMT_JSON;
+                    else if (strcasecmp(optarg, "ndjson") == 0) print_format = FMT_NDJSON;
+                    else if (strcasecmp(optarg, "arrow") == 0) print_format = FMT_ARROW;
                 } else if (optind < argc && argv[optind][0] != '-') {
                     char* next_arg = argv[optind];
                     if (strcasecmp(next_arg, "csv") == 0) {
@@ -111,6 +142,12 @@ static int run_cli_mode(int argc, char* argv[]) {
                     } else if (strcasecmp(next_arg, "json") == 0) {
                         print_format = FMT_JSON;
                         optind++;
+                    } else if (strcasecmp(next_arg, "ndjson") == 0) {
+                        print_format = FMT_NDJSON;
+                        optind++;
+                    } else if (strcasecmp(next_arg, "arrow") == 0) {
+                        print_format = FMT_ARROW;
+                        optind++;
                     } else {
                         print_format = FMT_TABLE;
                     }
@@ -125,6 +162,8 @@ static int run_cli_mode(int argc, char* argv[]) {
                     else if (strcasecmp(optarg, "markdown") == 0 || strcasecmp(optarg, "md") == 0) file_format = FMT_MARKDOWN;
                     else if (strcasecmp(optarg, "yaml") == 0 || strcasecmp(optarg, "yml") == 0) file_format = FMT_YAML;
                     else if (strcasecmp(optarg, "json") == 0) file_format = FMT_JSON;
+                    else if (strcasecmp(optarg, "ndjson") == 0) file_format = FMT_NDJSON;
+                    else if (strcasecmp(optarg, "arrow") == 0 || strcasecmp(optarg, "feather") == 0) file_format = FMT_ARROW;
                 }
                 break;
             case 's':
@@ -140,6 +179,29 @@ static int run_cli_mode(int argc, char* argv[]) {
             case 'F':
                 force_delete = true;
                 break;
+            case 'P':
+                profile = true;
+                break;
+            case 'T':
+                trace_file = optarg;
+                break;
+            case 'S':
+                schema_spec = optarg;
+                break;
+            case 'R':
+                sample_rows = atoi(optarg);
+                if (sample_rows <= 0) {
+                    fprintf(stderr, "Error: --sample-rows expects a positive number of lines\n");
+                    return 1;
+                }
+                break;
+            case 'W':
+                output_threads = atoi(optarg);
+                if (output_threads <= 0) {
+                    fprintf(stderr, "Error: --output-threads expects a positive number of threads\n");
+                    return 1;
+                }
+                break;
             default:
                 print_help(argv[0]);
                 return 1;
@@ -157,6 +219,7 @@ static int run_cli_mode(int argc, char* argv[]) {
     } else if (query) {
         // check if query is "-" which means read from stdin
         if (strcmp(query, "-") == 0) {
+            csv_claim_stdin();
             query = read_query_from_stdin();
             if (!query) {
                 return 1;
@@ -175,21 +238,54 @@ static int run_cli_mode(int argc, char* argv[]) {
     global_csv_config.delimiter = input_separator;
     global_csv_config.quote = '"';
     global_csv_config.has_header = true;
+    global_csv_config.sample_rows = sample_rows;
+    CsvSchema* schema = NULL;
+    if (schema_spec) {
+        schema = csv_schema_parse(schema_spec);
+        if (!schema) return 1;
+        global_csv_config.schema = schema;
+    }
+    
+    if (profile || trace_file) {
+        profile_begin(trace_file != NULL);
+    }
     
     // parse SQL query
+    double phase_start = profile_clock_ms();
     ASTNode* ast = parse(query);
     if (!ast) {
         fprintf(stderr, "Error: Parsing failed\n");
+        csv_schema_free(schema);
         return 1;
     }
+    profile_span("phase", "parse", NULL, phase_start, profile_clock_ms());
     
-    // evaluate query
-    ResultSet* result = evaluate_query(ast);
-    if (!result) {
+    // evaluate query, -p and -o stream the rows into their printers as they are produced;
+    // -c prints its totals before the rows and waits for the whole result
+    phase_start = profile_clock_ms();
+    ResultSet* result = NULL;
+    bool streamed = (print_table || output_file) && !print_count;
+    bool evaluated;
+    if (streamed) {
+        RowSink* sink = open_output_sink(print_table, print_format, vertical_output,
+                                         output_file, file_format, output_delimiter);
+        evaluated = evaluate_query_to_sink(ast, sink);
+        if (!sink->end(sink)) {
+            perror("write_output_file");
+        }
+    } else {
+        result = evaluate_query(ast);
+        evaluated = result != NULL;
+    }
+    if (!evaluated) {
         fprintf(stderr, "Error: Query evaluation failed\n");
+        finish_profiling(profile, trace_file);
         releaseNode(ast);
+        csv_schema_free(schema);
         return 1;
     }
+    profile_span("phase", "evaluate", NULL, phase_start, profile_clock_ms());
+    phase_start = profile_clock_ms();
     
     // output results based on flags
     if (print_count) {
@@ -197,53 +293,33 @@ static int run_cli_mode(int argc, char* argv[]) {
         printf("Columns: %d\n", result->column_count);
     }
 
-    
-    if (print_table) {
-        OutputFormat use = print_format;
-        if (use == FMT_AUTO) use = FMT_TABLE;
-        if (use == FMT_JSON) print_json(result);
-        else if (use == FMT_MARKDOWN) print_markdown(result);
-        else if (use == FMT_YAML) print_yaml(result);
-        else if (use == FMT_CSV) {
-            for (int i = 0; i < result->column_count; i++) {
-                printf("%s", result->columns[i].name);
-                if (i < result->column_count - 1) printf(",");
-            }
-            printf("\n");
-            for (int r = 0; r < result->row_count; r++) {
-                for (int c = 0; c < result->column_count; c++) {
-                    char* val = value_to_string(&result->rows[r].values[c]);
-                    if (val) {
-                        printf("%s", val);
-                        free(val);
-                    }
-                    if (c < result->column_count - 1) printf(",");
-                }
-                printf("\n");
-            }
-        }
-        else {
-            if (vertical_output) csv_print_table_vertical(result, result->row_count);
-            else csv_print_table(result, result->row_count);
-        }
-    }
-
-    if (output_file) {
-        OutputFormat fout = file_format;
-        if (fout == FMT_AUTO) fout = FMT_CSV;
-        if (!write_output_file(output_file, result, fout, output_delimiter)) {
+    if (!streamed && (print_table || output_file)) {
+        RowSink* sink = open_output_sink(print_table, print_format, vertical_output,
+                                         output_file, file_format, output_delimiter);
+        row_sink_push_result(sink, result);
+        if (!sink->end(sink)) {
             perror("write_output_file");
         }
     }
 
-    // if no output options specified, default to count
+    // if no output options specified, default to count, EXPLAIN prints its plan lines
     if (!print_count && !print_table && !output_file) {
-        printf("Count: %d\n", result->row_count);
+        if (ast->type == NODE_TYPE_EXPLAIN) {
+            for (int r = 0; r < result->row_count; r++) {
+                printf("%s\n", result->rows[r].values[0].string_value);
+            }
+        } else {
+            printf("Count: %d\n", result->row_count);
+        }
     }
     
+    profile_span("phase", "output", NULL, phase_start, profile_clock_ms());
+    finish_profiling(profile, trace_file);
+    
     // cleanup
     csv_free(result);
     releaseNode(ast);
+    csv_schema_free(schema);
     if (query_allocated) {
         free(query);
     }
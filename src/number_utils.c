@@ -0,0 +1,132 @@
+#include "number_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+
+/* number parsing without strtoll / strtod on the common path */
+
+/* a uint64 holds any 19 digit number, longer digit strings take the libc path */
+#define FAST_DIGITS 19
+
+/* doubles with a mantissa up to 2^53 and at most 22 fraction digits are exact after one
+ * correctly rounded division (Clinger's fast path) */
+#define EXACT_MANTISSA (1ULL << 53)
+#define EXACT_POWERS 22
+
+static const double powers_of_ten[EXACT_POWERS + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+/* eight ASCII digits read as one little endian word, checked and converted with a few
+ * multiplies instead of a loop */
+static inline bool eight_digits(const char* p, uint32_t* out) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    // every byte is 0x30..0x39: high nibble 3, and adding 6 does not carry into it
+    if (((word & 0xF0F0F0F0F0F0F0F0ULL) |
+         (((word + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) != 0x3333333333333333ULL) {
+        return false;
+    }
+    word -= 0x3030303030303030ULL;
+    word = word * 10 + (word >> 8);     // pairs of digits
+    word = (((word & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+            (((word >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+    *out = (uint32_t)word;
+    return true;
+}
+#else
+static inline bool eight_digits(const char* p, uint32_t* out) {
+    uint32_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        if (p[i] < '0' || p[i] > '9') return false;
+        value = value * 10 + (uint32_t)(p[i] - '0');
+    }
+    *out = value;
+    return true;
+}
+#endif
+
+/* accumulates the digits at *p, returns how many were read */
+static size_t read_digits(const char** p, const char* end, uint64_t* mantissa) {
+    const char* start = *p;
+    const char* q = *p;
+    uint64_t m = *mantissa;
+    uint32_t block;
+
+    // wraps around past FAST_DIGITS digits, the caller then takes the slow path
+    while (end - q >= 8 && eight_digits(q, &block)) {
+        m = m * 100000000ULL + block;
+        q += 8;
+    }
+    while (q < end && *q >= '0' && *q <= '9') {
+        m = m * 10 + (uint64_t)(*q - '0');
+        q++;
+    }
+    *p = q;
+    *mantissa = m;
+    return (size_t)(q - start);
+}
+
+/* libc parse of a number too long for the fast path, on a terminated copy */
+static void parse_number_slow(const char* str, size_t len, bool is_double, Value* value) {
+    char buffer[64];
+    char* copy = len < sizeof(buffer) ? buffer : malloc(len + 1);
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+
+    if (is_double) {
+        value->type = VALUE_TYPE_DOUBLE;
+        value->double_value = strtod(copy, NULL);
+    } else {
+        value->type = VALUE_TYPE_INTEGER;
+        value->int_value = strtoll(copy, NULL, 10);
+    }
+    if (copy != buffer) free(copy);
+}
+
+bool parse_number(const char* str, size_t len, Value* value) {
+    const char* p = str;
+    const char* end = str + len;
+
+    bool negative = false;
+    if (p < end && (*p == '+' || *p == '-')) negative = *p++ == '-';
+
+    uint64_t mantissa = 0;
+    size_t int_digits = read_digits(&p, end, &mantissa);
+    size_t fraction_digits = 0;
+    bool has_dot = false;
+    if (p < end && *p == '.') {
+        has_dot = true;
+        p++;
+        fraction_digits = read_digits(&p, end, &mantissa);
+    }
+    if (p != end || int_digits + fraction_digits == 0) return false;
+
+    if (int_digits + fraction_digits > FAST_DIGITS) {
+        parse_number_slow(str, len, has_dot, value);
+        return true;
+    }
+
+    if (!has_dot) {
+        value->type = VALUE_TYPE_INTEGER;
+        if (mantissa > (uint64_t)LLONG_MAX + negative) {
+            value->int_value = negative ? LLONG_MIN : LLONG_MAX;
+        } else {
+            value->int_value = negative ? (long long)(0 - mantissa) : (long long)mantissa;
+        }
+        return true;
+    }
+
+    if (mantissa > EXACT_MANTISSA || fraction_digits > EXACT_POWERS) {
+        parse_number_slow(str, len, true, value);
+        return true;
+    }
+    double result = (double)mantissa / powers_of_ten[fraction_digits];
+    value->type = VALUE_TYPE_DOUBLE;
+    value->double_value = negative ? -result : result;
+    return true;
+}
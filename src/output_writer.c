@@ -0,0 +1,454 @@
+/* output_writer.c - buffered, allocation free formatting for the result writers */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#include <io.h>
+#define write _write
+#define close _close
+#else
+#include <unistd.h>
+#endif
+#include "output_writer.h"
+
+/* the buffer of a closed writer is kept for the next one */
+static char* spare_buffer = NULL;
+
+static void writer_init(OutputWriter* writer, int fd, bool owns_fd) {
+    writer->fd = fd;
+    writer->owns_fd = owns_fd;
+    writer->failed = false;
+    writer->length = 0;
+    writer->buffer = spare_buffer ? spare_buffer : malloc(WRITER_BUFFER_SIZE);
+    spare_buffer = NULL;
+    writer->memory = NULL;
+    writer->memory_length = 0;
+    writer->memory_capacity = 0;
+    writer->replace_path = NULL;
+    writer->target_path = NULL;
+}
+
+bool writer_open(OutputWriter* writer, const char* filename) {
+#if defined(_WIN32) || defined(_WIN64)
+    int fd = _open(filename, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, 0644);
+#else
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+    if (fd < 0) return false;
+    writer_init(writer, fd, true);
+    return true;
+}
+
+bool writer_open_append(OutputWriter* writer, const char* filename) {
+#if defined(_WIN32) || defined(_WIN64)
+    int fd = _open(filename, _O_WRONLY | _O_APPEND | _O_BINARY);
+#else
+    int fd = open(filename, O_WRONLY | O_APPEND);
+#endif
+    if (fd < 0) return false;
+    writer_init(writer, fd, true);
+    return true;
+}
+
+bool writer_open_replace(OutputWriter* writer, const char* filename) {
+    size_t size = strlen(filename) + sizeof(".cq-XXXXXX");
+    char* temp = malloc(size);
+    snprintf(temp, size, "%s.cq-XXXXXX", filename);
+#if defined(_WIN32) || defined(_WIN64)
+    int fd = _mktemp_s(temp, size) == 0 ? _open(temp, _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY, 0644) : -1;
+#else
+    // in the same directory, since rename cannot move a file to another file system
+    int fd = mkstemp(temp);
+    if (fd >= 0) {
+        // the new version keeps the permissions of the file it replaces
+        struct stat st;
+        fchmod(fd, stat(filename, &st) == 0 ? (st.st_mode & 07777) : 0644);
+    }
+#endif
+    if (fd < 0) {
+        free(temp);
+        return false;
+    }
+    writer_init(writer, fd, true);
+    writer->replace_path = temp;
+    writer->target_path = strdup(filename);
+    return true;
+}
+
+void writer_open_fd(OutputWriter* writer, int fd) {
+    fflush(stdout);
+    fflush(stderr);
+    writer_init(writer, fd, false);
+}
+
+void writer_open_memory(OutputWriter* writer) {
+    writer->fd = WRITER_MEMORY;
+    writer->owns_fd = false;
+    writer->failed = false;
+    writer->length = 0;
+    // not the spare buffer, which belongs to the calling thread
+    writer->buffer = malloc(WRITER_BUFFER_SIZE);
+    writer->memory = NULL;
+    writer->memory_length = 0;
+    writer->memory_capacity = 0;
+    writer->replace_path = NULL;
+    writer->target_path = NULL;
+}
+
+static void append_memory(OutputWriter* writer, const char* data, size_t len) {
+    // an empty write must not reach memcpy while the buffer is still NULL
+    if (len == 0) return;
+    if (writer->memory_length + len > writer->memory_capacity) {
+        size_t capacity = writer->memory_capacity ? writer->memory_capacity * 2 : WRITER_BUFFER_SIZE;
+        while (capacity < writer->memory_length + len) capacity *= 2;
+        writer->memory = realloc(writer->memory, capacity);
+        writer->memory_capacity = capacity;
+    }
+    memcpy(writer->memory + writer->memory_length, data, len);
+    writer->memory_length += len;
+}
+
+static void write_all(OutputWriter* writer, const char* data, size_t len) {
+    if (writer->fd == WRITER_MEMORY) {
+        append_memory(writer, data, len);
+        return;
+    }
+    while (len > 0 && !writer->failed) {
+        ssize_t written = write(writer->fd, data, len);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            writer->failed = true;
+            break;
+        }
+        data += written;
+        len -= (size_t)written;
+    }
+}
+
+void writer_flush(OutputWriter* writer) {
+    write_all(writer, writer->buffer, writer->length);
+    writer->length = 0;
+}
+
+char* writer_take_memory(OutputWriter* writer, size_t* len) {
+    writer_flush(writer);
+    char* memory = writer->memory;
+    *len = writer->memory_length;
+    writer->memory = NULL;
+    writer->memory_length = 0;
+    writer->memory_capacity = 0;
+    return memory;
+}
+
+/* put the finished temporary file in place of the target in one step, false leaves the
+ * target as it was */
+static bool replace_file(const char* from, const char* to) {
+#if defined(_WIN32) || defined(_WIN64)
+    // rename does not replace an existing file there
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+bool writer_close(OutputWriter* writer) {
+    writer_flush(writer);
+#if !defined(_WIN32) && !defined(_WIN64)
+    // the data is on disk before the rename makes it the file
+    if (writer->replace_path && !writer->failed && fsync(writer->fd) != 0) writer->failed = true;
+#endif
+    if (writer->owns_fd && close(writer->fd) != 0) writer->failed = true;
+
+    if (writer->replace_path) {
+        // the target is untouched unless the replace succeeded, so the copy can go
+        if (writer->failed || !replace_file(writer->replace_path, writer->target_path)) {
+            writer->failed = true;
+            remove(writer->replace_path);
+        }
+        free(writer->replace_path);
+        free(writer->target_path);
+        writer->replace_path = NULL;
+        writer->target_path = NULL;
+    }
+
+    if (writer->fd == WRITER_MEMORY) {
+        free(writer->memory);
+        free(writer->buffer);
+    } else if (!spare_buffer) {
+        spare_buffer = writer->buffer;
+    } else {
+        free(writer->buffer);
+    }
+    writer->buffer = NULL;
+    return !writer->failed;
+}
+
+void writer_discard(OutputWriter* writer) {
+    // failed output is never renamed into place
+    writer->length = 0;
+    writer->failed = true;
+    writer_close(writer);
+}
+
+void writer_write(OutputWriter* writer, const char* data, size_t len) {
+    if (writer->length + len > WRITER_BUFFER_SIZE) {
+        writer_flush(writer);
+        // large blocks skip the buffer
+        if (len >= WRITER_BUFFER_SIZE) {
+            write_all(writer, data, len);
+            return;
+        }
+    }
+    memcpy(writer->buffer + writer->length, data, len);
+    writer->length += len;
+}
+
+void writer_puts(OutputWriter* writer, const char* str) {
+    writer_write(writer, str, strlen(str));
+}
+
+void writer_pad(OutputWriter* writer, char c, int count) {
+    for (int i = 0; i < count; i++) writer_putc(writer, c);
+}
+
+/* ===== number and date formatting ===== */
+
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/* decimal digits of value, two at a time from the end, returns the length */
+static size_t format_unsigned(char* out, unsigned long long value) {
+    char digits[24];
+    char* p = digits + sizeof(digits);
+    while (value >= 100) {
+        unsigned pair = (unsigned)(value % 100);
+        value /= 100;
+        p -= 2;
+        memcpy(p, digit_pairs + pair * 2, 2);
+    }
+    if (value >= 10) {
+        p -= 2;
+        memcpy(p, digit_pairs + value * 2, 2);
+    } else {
+        *--p = (char)('0' + value);
+    }
+    size_t len = (size_t)(digits + sizeof(digits) - p);
+    memcpy(out, p, len);
+    return len;
+}
+
+static size_t format_int(char* out, long long value) {
+    if (value < 0) {
+        *out = '-';
+        return 1 + format_unsigned(out + 1, 0 - (unsigned long long)value);
+    }
+    return format_unsigned(out, (unsigned long long)value);
+}
+
+/* "%.2f" without printf: the exact product x * 100 is p + error (fma), and the sign of
+ * p - floor(p) - 0.5 + error decides the rounding, ties go to even like printf does.
+ * values whose hundredths do not fit in a double mantissa take snprintf */
+static size_t format_fixed2(char* out, double value) {
+    double x = fabs(value);
+    if (!(x < 1e13)) return (size_t)snprintf(out, VALUE_TEXT_SIZE, "%.2f", value);
+
+    double p = x * 100.0;
+    double error = fma(x, 100.0, -p);
+    double whole = floor(p);
+    double excess = (p - whole - 0.5) + error;
+    unsigned long long hundredths = (unsigned long long)whole;
+    if (excess > 0 || (excess == 0 && (hundredths & 1))) hundredths++;
+
+    size_t len = 0;
+    if (signbit(value)) out[len++] = '-';
+    len += format_unsigned(out + len, hundredths / 100);
+    out[len++] = '.';
+    memcpy(out + len, digit_pairs + (hundredths % 100) * 2, 2);
+    return len + 2;
+}
+
+static size_t format_iso_date(char* out, DateValue date) {
+    int year = date.year;
+    if (year < 0 || year > 9999 || date.month < 0 || date.month > 99 || date.day < 0 || date.day > 99) {
+        return (size_t)snprintf(out, VALUE_TEXT_SIZE, "%04d-%02d-%02d", year, date.month, date.day);
+    }
+    memcpy(out, digit_pairs + (year / 100) * 2, 2);
+    memcpy(out + 2, digit_pairs + (year % 100) * 2, 2);
+    out[4] = '-';
+    memcpy(out + 5, digit_pairs + (date.month % 100) * 2, 2);
+    out[7] = '-';
+    memcpy(out + 8, digit_pairs + (date.day % 100) * 2, 2);
+    return 10;
+}
+
+/* room for a formatted value at the end of the buffer */
+static char* reserve(OutputWriter* writer) {
+    if (WRITER_BUFFER_SIZE - writer->length < VALUE_TEXT_SIZE) writer_flush(writer);
+    return writer->buffer + writer->length;
+}
+
+void writer_int(OutputWriter* writer, long long value) {
+    writer->length += format_int(reserve(writer), value);
+}
+
+void writer_fixed2(OutputWriter* writer, double value) {
+    writer->length += format_fixed2(reserve(writer), value);
+}
+
+void writer_date(OutputWriter* writer, DateValue date) {
+    writer->length += format_iso_date(reserve(writer), date);
+}
+
+const char* value_text(const Value* value, char scratch[VALUE_TEXT_SIZE], size_t* len) {
+    switch (value->type) {
+        case VALUE_TYPE_INTEGER:
+            *len = format_int(scratch, value->int_value);
+            return scratch;
+        case VALUE_TYPE_DOUBLE:
+            *len = format_fixed2(scratch, value->double_value);
+            return scratch;
+        case VALUE_TYPE_DATE:
+            *len = format_iso_date(scratch, value->date_value);
+            return scratch;
+        case VALUE_TYPE_STRING: {
+            const char* str = value->string_value ? value->string_value : "";
+            *len = strlen(str);
+            return str;
+        }
+        case VALUE_TYPE_NULL:
+            break;
+    }
+    *len = 4;
+    return "NULL";
+}
+
+void writer_value(OutputWriter* writer, const Value* value) {
+    switch (value->type) {
+        case VALUE_TYPE_INTEGER:
+            writer_int(writer, value->int_value);
+            break;
+        case VALUE_TYPE_DOUBLE:
+            writer_fixed2(writer, value->double_value);
+            break;
+        case VALUE_TYPE_DATE:
+            writer_date(writer, value->date_value);
+            break;
+        case VALUE_TYPE_STRING:
+            if (value->string_value) writer_puts(writer, value->string_value);
+            break;
+        case VALUE_TYPE_NULL:
+            writer_write(writer, "NULL", 4);
+            break;
+    }
+}
+
+/* ===== escaping ===== */
+
+#define BYTES_ONES 0x0101010101010101ULL
+#define BYTES_HIGHS 0x8080808080808080ULL
+
+/* nonzero when a byte of word equals c */
+static inline uint64_t word_has_byte(uint64_t word, unsigned char c) {
+    uint64_t x = word ^ (BYTES_ONES * c);
+    return (x - BYTES_ONES) & ~x & BYTES_HIGHS;
+}
+
+/* length of the prefix of str without any of the four stop bytes, eight bytes per step */
+static size_t plain_span(const char* str, size_t len, const char stops[4]) {
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, str + i, sizeof(word));
+        if (word_has_byte(word, (unsigned char)stops[0]) | word_has_byte(word, (unsigned char)stops[1]) |
+            word_has_byte(word, (unsigned char)stops[2]) | word_has_byte(word, (unsigned char)stops[3])) {
+            break;
+        }
+    }
+    for (; i < len; i++) {
+        char c = str[i];
+        if (c == stops[0] || c == stops[1] || c == stops[2] || c == stops[3]) return i;
+    }
+    return len;
+}
+
+void writer_csv_string(OutputWriter* writer, const char* str, char delimiter, char quote) {
+    size_t len = strlen(str);
+    const char stops[4] = {delimiter, quote, '\n', '\r'};
+    if (plain_span(str, len, stops) == len) {
+        writer_write(writer, str, len);
+        return;
+    }
+
+    // quoted, every quote doubled
+    writer_putc(writer, quote);
+    const char* end = str + len;
+    while (str < end) {
+        const char* next = memchr(str, quote, (size_t)(end - str));
+        if (!next) {
+            writer_write(writer, str, (size_t)(end - str));
+            break;
+        }
+        writer_write(writer, str, (size_t)(next - str) + 1);
+        writer_putc(writer, quote);
+        str = next + 1;
+    }
+    writer_putc(writer, quote);
+}
+
+void writer_csv_row(OutputWriter* writer, const Value* values, int count, char delimiter, char quote) {
+    for (int i = 0; i < count; i++) {
+        if (i > 0) writer_putc(writer, delimiter);
+        const Value* value = &values[i];
+        switch (value->type) {
+            case VALUE_TYPE_NULL:
+                // an empty field
+                break;
+            case VALUE_TYPE_INTEGER:
+                writer_int(writer, value->int_value);
+                break;
+            case VALUE_TYPE_DOUBLE: {
+                // full precision so that a saved table loads back unchanged
+                char number[32];
+                int len = snprintf(number, sizeof(number), "%.15g", value->double_value);
+                writer_write(writer, number, (size_t)len);
+                break;
+            }
+            case VALUE_TYPE_DATE:
+                writer_date(writer, value->date_value);
+                break;
+            case VALUE_TYPE_STRING:
+                writer_csv_string(writer, value->string_value, delimiter, quote);
+                break;
+        }
+    }
+    writer_putc(writer, '\n');
+}
+
+void writer_json_string(OutputWriter* writer, const char* str) {
+    static const char stops[4] = {'"', '\\', '\n', '\n'};
+    size_t len = strlen(str);
+    writer_putc(writer, '"');
+    while (len > 0) {
+        size_t plain = plain_span(str, len, stops);
+        writer_write(writer, str, plain);
+        if (plain == len) break;
+        if (str[plain] == '\n') {
+            writer_write(writer, "\\n", 2);
+        } else {
+            writer_putc(writer, '\\');
+            writer_putc(writer, str[plain]);
+        }
+        str += plain + 1;
+        len -= plain + 1;
+    }
+    writer_putc(writer, '"');
+}
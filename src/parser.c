@@ -117,24 +117,10 @@ ASTNode* parse_query_internal(Parser* parser) {
     return root;
 }
 
-// public API function, parses SQL query and returns AST
-ASTNode* parse(const char* sql) {
-    int token_count = 0;
-    Token* tokens = tokenize(sql, &token_count);
-    
-    if (!tokens) {
-        return NULL;
-    }
-    
-    Parser* parser = parser_init(tokens, token_count);
-    
-    // parse first query
+/* a query followed by any UNION, INTERSECT and EXCEPT, chained from the left */
+ASTNode* parse_compound_query(Parser* parser) {
     ASTNode* left = parse_query_internal(parser);
-    if (!left) {
-        parser_free(parser);
-        freeTokens(tokens, token_count);
-        return NULL;
-    }
+    if (!left) return NULL;
     
     // check for set operations (UNION, INTERSECT, EXCEPT)
     while (1) {
@@ -170,8 +156,6 @@ ASTNode* parse(const char* sql) {
         ASTNode* right = parse_query_internal(parser);
         if (!right) {
             releaseNode(left);
-            parser_free(parser);
-            freeTokens(tokens, token_count);
             return NULL;
         }
         
@@ -184,8 +168,54 @@ ASTNode* parse(const char* sql) {
         left = set_op;  // for chaining multiple operations
     }
     
+    return left;
+}
+
+// public API function, parses SQL query and returns AST
+ASTNode* parse(const char* sql) {
+    int token_count = 0;
+    Token* tokens = tokenize(sql, &token_count);
+    
+    if (!tokens) {
+        return NULL;
+    }
+    
+    Parser* parser = parser_init(tokens, token_count);
+    
+    // EXPLAIN [ANALYZE] prefix, the words are not reserved so columns can still use them
+    bool explain = false;
+    bool analyze = false;
+    Token* first = parser_current_token(parser);
+    if ((first->type == TOKEN_TYPE_IDENTIFIER || first->type == TOKEN_TYPE_KEYWORD) &&
+        strcasecmp(first->value, "EXPLAIN") == 0) {
+        explain = true;
+        parser_advance(parser);
+        
+        Token* next = parser_current_token(parser);
+        if ((next->type == TOKEN_TYPE_IDENTIFIER || next->type == TOKEN_TYPE_KEYWORD) &&
+            strcasecmp(next->value, "ANALYZE") == 0) {
+            analyze = true;
+            parser_advance(parser);
+        }
+    }
+    
+    // parse the query with its set operations
+    ASTNode* left = parse_compound_query(parser);
+    if (!left) {
+        parser_free(parser);
+        freeTokens(tokens, token_count);
+        return NULL;
+    }
+    
     parser_free(parser);
     freeTokens(tokens, token_count);
     
+    if (explain) {
+        ASTNode* explain_node = create_node(NODE_TYPE_EXPLAIN);
+        explain_node->explain.query = left;
+        explain_node->explain.analyze = analyze;
+        return explain_node;
+    }
+    
     return left;
 }
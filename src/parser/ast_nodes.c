@@ -99,11 +99,15 @@ void releaseNode(ASTNode* node) {
             free(node->from.table);
             releaseNode(node->from.subquery);
             free(node->from.alias);
+            for (int i = 0; i < node->from.file_count; i++) free(node->from.files[i]);
+            free(node->from.files);
             break;
         case NODE_TYPE_JOIN:
             free(node->join.table);
             free(node->join.alias);
             releaseNode(node->join.condition);
+            for (int i = 0; i < node->join.file_count; i++) free(node->join.files[i]);
+            free(node->join.files);
             break;
         case NODE_TYPE_SUBQUERY:
             releaseNode(node->subquery.query);
@@ -126,11 +130,12 @@ void releaseNode(ASTNode* node) {
                 free(node->insert.columns);
             }
             if (node->insert.values) {
-                for (int i = 0; i < node->insert.value_count; i++) {
+                for (int i = 0; i < node->insert.value_count * node->insert.row_count; i++) {
                     releaseNode(node->insert.values[i]);
                 }
                 free(node->insert.values);
             }
+            releaseNode(node->insert.query);
             break;
         case NODE_TYPE_UPDATE:
             free(node->update.table);
@@ -177,6 +182,9 @@ void releaseNode(ASTNode* node) {
             }
             releaseNode(node->case_expr.else_expr);
             break;
+        case NODE_TYPE_EXPLAIN:
+            releaseNode(node->explain.query);
+            break;
         case NODE_TYPE_ASSIGNMENT:
             free(node->assignment.column);
             releaseNode(node->assignment.value);
@@ -444,10 +452,16 @@ void printAst(ASTNode* node, int depth) {
                 }
                 printf("\n");
             }
-            print_indent(depth + 1);
-            printf("VALUES:\n");
-            for (int i = 0; i < node->insert.value_count; i++) {
-                printAst(node->insert.values[i], depth + 2);
+            if (node->insert.query) {
+                printAst(node->insert.query, depth + 1);
+                break;
+            }
+            for (int r = 0; r < node->insert.row_count; r++) {
+                print_indent(depth + 1);
+                printf("VALUES:\n");
+                for (int i = 0; i < node->insert.value_count; i++) {
+                    printAst(node->insert.values[r * node->insert.value_count + i], depth + 2);
+                }
             }
             break;
         case NODE_TYPE_UPDATE:
@@ -504,6 +518,10 @@ void printAst(ASTNode* node, int depth) {
                     break;
             }
             break;
+        case NODE_TYPE_EXPLAIN:
+            printf("EXPLAIN%s:\n", node->explain.analyze ? " ANALYZE" : "");
+            printAst(node->explain.query, depth + 1);
+            break;
         case NODE_TYPE_ASSIGNMENT:
             printf("ASSIGN: %s = ", node->assignment.column);
             if (node->assignment.value) {
@@ -36,11 +36,12 @@ ASTNode* parse_select(Parser* parser) {
     while (1) {
         Token* token = parser_current_token(parser);
         
-        // resize arrays if needed
-        node->select.columns = ensure_capacity(node->select.columns, &capacity, 
-                                               node->select.column_count, sizeof(char*));
-        node->select.column_nodes = ensure_capacity(node->select.column_nodes, &capacity, 
-                                                    node->select.column_count, sizeof(ASTNode*));
+        // resize arrays if needed, both grow together
+        if (node->select.column_count >= capacity) {
+            capacity *= 2;
+            node->select.columns = realloc(node->select.columns, sizeof(char*) * capacity);
+            node->select.column_nodes = realloc(node->select.column_nodes, sizeof(ASTNode*) * capacity);
+        }
         
         // check for scalar subquery: SELECT ...
         if (token->type == TOKEN_TYPE_PUNCTUATION && strcmp(token->value, "(") == 0) {
@@ -189,7 +190,7 @@ ASTNode* parse_from(Parser* parser) {
     }
     
     // expect a string literal filename or identifier table name
-    node->from.table = parse_table_name(parser);
+    node->from.table = parse_table_source(parser, &node->from.files, &node->from.file_count);
     if (!node->from.table) {
         releaseNode(node);
         return NULL;
@@ -302,7 +303,7 @@ ASTNode* parse_join(Parser* parser) {
     node->join.join_type = join_type;
     
     // parse table name
-    node->join.table = parse_table_name(parser);
+    node->join.table = parse_table_source(parser, &node->join.files, &node->join.file_count);
     if (!node->join.table) {
         releaseNode(node);
         return NULL;
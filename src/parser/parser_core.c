@@ -107,11 +107,73 @@ char* parse_table_name(Parser* parser) {
     } else if (token->type == TOKEN_TYPE_IDENTIFIER) {
         // unquoted identifier with optional extension
         return parse_qualified_identifier(parser);
+    } else if (token->type == TOKEN_TYPE_OPERATOR && strcmp(token->value, "-") == 0) {
+        // standard input
+        parser_advance(parser);
+        return strdup("-");
     }
     
     return NULL;
 }
 
+/* helper: parse a FROM or JOIN source, a table name or read_csv('a.csv', ...) (brackets around
+ * the list, as in read_csv(['a.csv', 'b.csv']), are allowed). more than one file is returned in
+ * files, with a name for the whole list */
+char* parse_table_source(Parser* parser, char*** files, int* file_count) {
+    *files = NULL;
+    *file_count = 0;
+    Token* token = parser_current_token(parser);
+    Token* next = parser_peek_token(parser, 1);
+    if (token->type != TOKEN_TYPE_IDENTIFIER || strcasecmp(token->value, "read_csv") != 0 ||
+        next->type != TOKEN_TYPE_PUNCTUATION || strcmp(next->value, "(") != 0) {
+        return parse_table_name(parser);
+    }
+    parser_advance(parser); // read_csv
+    parser_advance(parser); // '('
+
+    char** names = NULL;
+    int count = 0;
+    size_t length = strlen("read_csv([])");
+    for (;;) {
+        token = parser_current_token(parser);
+        if (token->type != TOKEN_TYPE_LITERAL) {
+            fprintf(stderr, "Error: read_csv expects quoted file names\n");
+            break;
+        }
+        names = realloc(names, sizeof(char*) * (count + 1));
+        names[count++] = strdup(token->value);
+        length += strlen(token->value) + 4;
+        parser_advance(parser);
+        if (parser_match(parser, TOKEN_TYPE_PUNCTUATION, ",")) {
+            parser_advance(parser);
+            continue;
+        }
+        if (parser_expect(parser, TOKEN_TYPE_PUNCTUATION, ")")) {
+            if (count == 1) {
+                char* table = names[0];
+                free(names);
+                return table;
+            }
+            // the list reads back in EXPLAIN as it was written
+            char* table = malloc(length + 1);
+            strcpy(table, "read_csv([");
+            for (int i = 0; i < count; i++) {
+                strcat(table, i ? ", '" : "'");
+                strcat(table, names[i]);
+                strcat(table, "'");
+            }
+            strcat(table, "])");
+            *files = names;
+            *file_count = count;
+            return table;
+        }
+        break;
+    }
+    for (int i = 0; i < count; i++) free(names[i]);
+    free(names);
+    return NULL;
+}
+
 /* helper: parse optional alias (with or without AS keyword) */
 char* parse_optional_alias(Parser* parser, const char** excluded_keywords, int excluded_count) {
     Token* token = parser_current_token(parser);
@@ -78,6 +78,16 @@ ASTNode* parse_insert(Parser* parser) {
         }
     }
     
+    // INSERT INTO table SELECT ..., the rows of a query
+    if (parser_match(parser, TOKEN_TYPE_KEYWORD, "SELECT")) {
+        node->insert.query = parse_compound_query(parser);
+        if (!node->insert.query) {
+            releaseNode(node);
+            return NULL;
+        }
+        return node;
+    }
+    
     // VALUES (parser_expect already advances)
     if (!parser_expect(parser, TOKEN_TYPE_KEYWORD, "VALUES")) {
         fprintf(stderr, "Error: Expected VALUES in INSERT statement\n");
@@ -85,43 +95,64 @@ ASTNode* parse_insert(Parser* parser) {
         return NULL;
     }
     
-    // (value1, value2, value3) (parser_expect already advances)
-    if (!parser_expect(parser, TOKEN_TYPE_PUNCTUATION, "(")) {
-        fprintf(stderr, "Error: Expected '(' after VALUES\n");
-        releaseNode(node);
-        return NULL;
-    }
-    
     int capacity = 4;
     node->insert.values = malloc(sizeof(ASTNode*) * capacity);
     node->insert.value_count = 0;
+    node->insert.row_count = 0;
     
+    // (value1, value2, value3), (value1, value2, value3) ... (parser_expect already advances)
+    int count = 0;
     while (1) {
-        ASTNode* value = parse_expression(parser);
-        if (!value) {
-            fprintf(stderr, "Error: Expected value in VALUES list\n");
+        if (!parser_expect(parser, TOKEN_TYPE_PUNCTUATION, "(")) {
+            fprintf(stderr, "Error: Expected '(' after VALUES\n");
             releaseNode(node);
             return NULL;
         }
         
-        if (node->insert.value_count >= capacity) {
-            capacity *= 2;
-            node->insert.values = realloc(node->insert.values, sizeof(ASTNode*) * capacity);
+        int row_values = 0;
+        while (1) {
+            ASTNode* value = parse_expression(parser);
+            if (!value) {
+                fprintf(stderr, "Error: Expected value in VALUES list\n");
+                // one row of every value parsed so far, for releaseNode
+                node->insert.row_count = 1;
+                node->insert.value_count = count;
+                releaseNode(node);
+                return NULL;
+            }
+            
+            if (count >= capacity) {
+                capacity *= 2;
+                node->insert.values = realloc(node->insert.values, sizeof(ASTNode*) * capacity);
+            }
+            node->insert.values[count++] = value;
+            row_values++;
+            
+            if (parser_match(parser, TOKEN_TYPE_PUNCTUATION, ",")) {
+                parser_advance(parser);
+            } else {
+                break;
+            }
         }
         
-        node->insert.values[node->insert.value_count++] = value;
-        
-        if (parser_match(parser, TOKEN_TYPE_PUNCTUATION, ",")) {
-            parser_advance(parser);
-        } else {
-            break;
+        // every row has as many values as the first one
+        bool mismatch = node->insert.row_count > 0 && row_values != node->insert.value_count;
+        if (node->insert.row_count == 0) node->insert.value_count = row_values;
+        node->insert.row_count++;
+        if (mismatch) {
+            fprintf(stderr, "Error: VALUES row %d has %d values, the first row has %d\n",
+                    node->insert.row_count, row_values, node->insert.value_count);
         }
-    }
-    
-    if (!parser_expect(parser, TOKEN_TYPE_PUNCTUATION, ")")) {
-        fprintf(stderr, "Error: Expected ')' after VALUES list\n");
-        releaseNode(node);
-        return NULL;
+        if (mismatch || !parser_expect(parser, TOKEN_TYPE_PUNCTUATION, ")")) {
+            if (!mismatch) fprintf(stderr, "Error: Expected ')' after VALUES list\n");
+            node->insert.value_count = count;
+            node->insert.row_count = 1;
+            releaseNode(node);
+            return NULL;
+        }
+        
+        if (!parser_match(parser, TOKEN_TYPE_PUNCTUATION, ",")) break;
+        parser_advance(parser);
     }
     
     return node;
@@ -0,0 +1,160 @@
+/* profile.c - hot path counters and Chrome trace output for --profile / --trace */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <sys/resource.h>
+#endif
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#include "profile.h"
+#include "csv_reader.h"
+
+ProfileCounters profile_counters = {0};
+
+typedef struct {
+    const char* category;
+    char* name;
+    char* detail;
+    double start_ms;
+    double end_ms;
+} TraceSpan;
+
+static TraceSpan* spans = NULL;
+static int span_count = 0;
+static int span_capacity = 0;
+static double origin_ms = 0;
+
+double profile_clock_ms(void) {
+#if defined(_WIN32) || defined(_WIN64)
+    return (double)clock() * 1000.0 / CLOCKS_PER_SEC;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+#endif
+}
+
+long profile_peak_memory_kb(void) {
+#if defined(_WIN32) || defined(_WIN64)
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024;  // bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+void profile_begin(bool record_trace) {
+    profile_reset();
+    profile_counters.enabled = true;
+    profile_counters.tracing = record_trace;
+    origin_ms = profile_clock_ms();
+}
+
+void profile_reset(void) {
+    for (int i = 0; i < span_count; i++) {
+        free(spans[i].name);
+        free(spans[i].detail);
+    }
+    free(spans);
+    spans = NULL;
+    span_count = 0;
+    span_capacity = 0;
+    memset(&profile_counters, 0, sizeof(profile_counters));
+}
+
+void profile_span(const char* category, const char* name, const char* detail,
+                  double start_ms, double end_ms) {
+    if (!profile_counters.tracing) return;
+
+    if (span_count >= span_capacity) {
+        span_capacity = span_capacity ? span_capacity * 2 : 64;
+        spans = realloc(spans, sizeof(TraceSpan) * span_capacity);
+    }
+    TraceSpan* span = &spans[span_count++];
+    span->category = category;
+    span->name = strdup(name);
+    span->detail = detail ? strdup(detail) : NULL;
+    span->start_ms = start_ms;
+    span->end_ms = end_ms;
+}
+
+void profile_report(FILE* out) {
+    ProfileCounters* c = &profile_counters;
+
+    fprintf(out, "Profile:\n");
+    fprintf(out, "  csv_load:            %lld file%s, %lld rows, %lld bytes in %.3f ms",
+            c->csv_files, c->csv_files == 1 ? "" : "s", c->csv_rows, c->csv_bytes, c->csv_ms);
+    if (c->csv_ms > 0) {
+        fprintf(out, " (%.0f rows/s)", c->csv_rows * 1000.0 / c->csv_ms);
+    }
+    fprintf(out, "\n");
+
+    long long parsed = 0;
+    for (int i = 0; i < 5; i++) parsed += c->parse_values[i];
+    fprintf(out, "  parse_value:         %lld calls (null=%lld, integer=%lld, double=%lld, string=%lld, date=%lld)\n",
+            parsed, c->parse_values[VALUE_TYPE_NULL], c->parse_values[VALUE_TYPE_INTEGER],
+            c->parse_values[VALUE_TYPE_DOUBLE], c->parse_values[VALUE_TYPE_STRING],
+            c->parse_values[VALUE_TYPE_DATE]);
+    fprintf(out, "  evaluate_expression: %lld calls\n", c->expressions);
+    fprintf(out, "  value_deep_copy:     %lld calls\n", c->deep_copies);
+    fprintf(out, "  hash table probes:   %lld\n", c->hash_probes);
+    fprintf(out, "  value allocations:   %lld (%lld bytes)\n", c->allocations, c->allocated_bytes);
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 heap = mallinfo2();
+    fprintf(out, "  heap in use:         %zu KB\n", heap.uordblks / 1024);
+#endif
+    fprintf(out, "  peak memory:         %ld KB\n", profile_peak_memory_kb());
+    fprintf(out, "  total time:          %.3f ms\n", profile_clock_ms() - origin_ms);
+}
+
+static void write_json_string(FILE* file, const char* str) {
+    fputc('"', file);
+    for (const unsigned char* p = (const unsigned char*)str; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            fprintf(file, "\\%c", *p);
+        } else if (*p < 0x20) {
+            fprintf(file, "\\u%04x", *p);
+        } else {
+            fputc(*p, file);
+        }
+    }
+    fputc('"', file);
+}
+
+bool profile_write_trace(const char* filename) {
+    FILE* file = fopen(filename, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot write trace file '%s'\n", filename);
+        return false;
+    }
+
+    // complete events, timestamps in microseconds since profiling started
+    fprintf(file, "{\"traceEvents\":[\n");
+    for (int i = 0; i < span_count; i++) {
+        TraceSpan* span = &spans[i];
+        fprintf(file, "  {\"name\":");
+        write_json_string(file, span->name);
+        fprintf(file, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1",
+                span->category, (span->start_ms - origin_ms) * 1000.0,
+                (span->end_ms - span->start_ms) * 1000.0);
+        if (span->detail) {
+            fprintf(file, ",\"args\":{\"detail\":");
+            write_json_string(file, span->detail);
+            fprintf(file, "}");
+        }
+        fprintf(file, "}%s\n", i < span_count - 1 ? "," : "");
+    }
+    fprintf(file, "],\"displayTimeUnit\":\"ms\"}\n");
+
+    fclose(file);
+    return true;
+}
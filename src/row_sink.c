@@ -0,0 +1,72 @@
+#include <stdlib.h>
+#include "row_sink.h"
+
+bool row_sink_push_rows(RowSink* sink, const Row* rows, int count) {
+    if (sink->rows) return sink->rows(sink, rows, count);
+    for (int r = 0; r < count; r++) {
+        if (!sink->row(sink, &rows[r])) return false;
+    }
+    return true;
+}
+
+void row_sink_push_result(RowSink* sink, ResultSet* result) {
+    sink->begin(sink, result->columns, result->column_count);
+    if (sink->expect) sink->expect(sink, result->row_count);
+    row_sink_push_rows(sink, result->rows, result->row_count);
+}
+
+typedef struct {
+    RowSink base;
+    RowSink* first;
+    RowSink* second;
+    bool first_open;            // a sink that refused a row is not fed again
+    bool second_open;
+} TeeSink;
+
+static void tee_begin(RowSink* sink, const Column* columns, int column_count) {
+    TeeSink* tee = (TeeSink*)sink;
+    tee->first->begin(tee->first, columns, column_count);
+    tee->second->begin(tee->second, columns, column_count);
+}
+
+static bool tee_row(RowSink* sink, const Row* row) {
+    TeeSink* tee = (TeeSink*)sink;
+    if (tee->first_open) tee->first_open = tee->first->row(tee->first, row);
+    if (tee->second_open) tee->second_open = tee->second->row(tee->second, row);
+    return tee->first_open || tee->second_open;
+}
+
+static bool tee_rows(RowSink* sink, const Row* rows, int count) {
+    TeeSink* tee = (TeeSink*)sink;
+    if (tee->first_open) tee->first_open = row_sink_push_rows(tee->first, rows, count);
+    if (tee->second_open) tee->second_open = row_sink_push_rows(tee->second, rows, count);
+    return tee->first_open || tee->second_open;
+}
+
+static void tee_expect(RowSink* sink, int row_count) {
+    TeeSink* tee = (TeeSink*)sink;
+    if (tee->first->expect) tee->first->expect(tee->first, row_count);
+    if (tee->second->expect) tee->second->expect(tee->second, row_count);
+}
+
+static bool tee_end(RowSink* sink) {
+    TeeSink* tee = (TeeSink*)sink;
+    bool first_ok = tee->first->end(tee->first);
+    bool second_ok = tee->second->end(tee->second);
+    free(tee);
+    return first_ok && second_ok;
+}
+
+RowSink* row_sink_tee(RowSink* first, RowSink* second) {
+    TeeSink* tee = malloc(sizeof(TeeSink));
+    tee->base.begin = tee_begin;
+    tee->base.row = tee_row;
+    tee->base.end = tee_end;
+    tee->base.rows = tee_rows;
+    tee->base.expect = tee_expect;
+    tee->first = first;
+    tee->second = second;
+    tee->first_open = true;
+    tee->second_open = true;
+    return &tee->base;
+}
@@ -7,6 +7,7 @@
 #include "evaluator.h"
 #include "string_utils.h"
 #include "utils.h"
+#include "formats.h"
 
 
 /* Portable string functions for cross-platform compatibility */
@@ -102,20 +103,29 @@ void print_help(const char* program_name) {
     printf("  -q <query>   SQL query to execute (use '-' to read from stdin)\n");
     printf("  -f <file>    Read SQL query from file\n");
     printf("  -o <file>    Write result as CSV to output file\n");
-    printf("  -c           Print count of rows that match the query\n");
+    printf("  -c           Print count of rows that match the query (and the chosen join order on stderr)\n");
     printf("  -p           Print result as formatted table to stdout\n");
-    printf("  -p [format]  Print result to stdout. Optional formats: csv, table, markdown, yaml, json (default: table)\n");
+    printf("  -p [format]  Print result to stdout. Optional formats: csv, table, markdown, yaml, json, ndjson, arrow (default: table)\n");
     printf("  -v           Print result in vertical format (one column per line)\n");
-    printf("  -O, --format <format>  When used with -o <file>, write output file in given format (csv, markdown, yaml, json).\n");
+    printf("  -O, --format <format>  When used with -o <file>, write output file in given format (csv, markdown, yaml, json, ndjson, arrow).\n");
     printf("  -s <char>    Field separator for input CSV (default: ',')\n");
     printf("  -d <char>    Output delimiter for -o option (default: ',')\n");
     printf("  -F, --force  Allow DELETE without WHERE clause (dangerous!)\n");
+    printf("  --profile    Print engine counters (rows parsed, expressions, copies, hash probes) to stderr\n");
+    printf("  --trace <file>  Write a Chrome trace event JSON with spans for each phase and operator\n");
+    printf("  --schema <spec|file>  Declare column types as name:type,... (int, double, string, date), skipping inference\n");
+    printf("  --sample-rows <n>  Lines sampled per file to infer column types (default: %d)\n", CSV_SAMPLE_ROWS);
+    printf("  --output-threads <n>  Threads formatting large results for -p and -o (default: one per processor, at most %d)\n", MAX_OUTPUT_THREADS);
     printf("\nExamples:\n");
     printf("  %s -q \"SELECT name, age WHERE age > 30\" -p\n", program_name);
     printf("  %s -f query.sql -p\n", program_name);
     printf("  echo \"SELECT * WHERE active = 1\" | %s -q - -p\n", program_name);
+    printf("  zcat data.csv.gz | %s -q \"SELECT city, COUNT(*) FROM - GROUP BY city\" -p\n", program_name);
     printf("  %s -q \"SELECT * FROM data.tsv\" -s '\\t' -p\n", program_name);
     printf("  %s -q \"SELECT * FROM data.csv LIMIT 5\" -v\n", program_name);
+    printf("  %s -q \"EXPLAIN ANALYZE SELECT city, COUNT(*) FROM data.csv GROUP BY city\"\n", program_name);
+    printf("  %s -q \"SELECT city, COUNT(*) FROM data.csv GROUP BY city\" --profile --trace out.json\n", program_name);
+    printf("  %s -q \"SELECT zip, amount FROM data.csv\" --schema zip:string,amount:double -p\n", program_name);
 }
 
 /*
@@ -217,77 +227,3 @@ char* read_query_from_stdin(void) {
     
     return query;
 }
-
-/* wsrite ResultSet to CSV file */
-void write_csv_file(const char* filename, ResultSet* result, char delimiter) {
-    FILE* f = fopen(filename, "w");
-    if (!f) {
-        fprintf(stderr, "Error: Cannot open output file '%s'\n", filename);
-        return;
-    }
-    
-    // header
-    for (int i = 0; i < result->column_count; i++) {
-        if (i > 0) fprintf(f, "%c", delimiter);
-        fprintf(f, "%s", result->columns[i].name);
-    }
-    fprintf(f, "\n");
-    
-    // rows
-    for (int i = 0; i < result->row_count; i++) {
-        Row* row = &result->rows[i];
-        for (int j = 0; j < row->column_count; j++) {
-            if (j > 0) fprintf(f, "%c", delimiter);
-            
-            Value* val = &row->values[j];
-            switch (val->type) {
-                case VALUE_TYPE_NULL:
-                    break;
-                case VALUE_TYPE_INTEGER:
-                    fprintf(f, "%lld", val->int_value);
-                    break;
-                case VALUE_TYPE_DOUBLE:
-                    fprintf(f, "%.2f", val->double_value);
-                    break;
-                case VALUE_TYPE_DATE:
-                    fprintf(f, "%04d-%02d-%02d", 
-                            val->date_value.year,
-                            val->date_value.month,
-                            val->date_value.day);
-                    break;
-                case VALUE_TYPE_STRING: {
-                    // check if string contains delimiter, newline, or quote char
-                    bool needs_quoting = false;
-                    if (val->string_value) {
-                        for (const char* p = val->string_value; *p; p++) {
-                            if (*p == delimiter || *p == '"' || *p == '\n' || *p == '\r') {
-                                needs_quoting = true;
-                                break;
-                            }
-                        }
-                    }
-                    
-                    if (needs_quoting) {
-                        fprintf(f, "\"");
-                        // escape quotes by doubling them
-                        for (const char* p = val->string_value; *p; p++) {
-                            if (*p == '"') {
-                                fprintf(f, "\"\"");
-                            } else {
-                                fprintf(f, "%c", *p);
-                            }
-                        }
-                        fprintf(f, "\"");
-                    } else {
-                        fprintf(f, "%s", val->string_value ? val->string_value : "");
-                    }
-                    break;
-                }
-            }
-        }
-        fprintf(f, "\n");
-    }
-    
-    fclose(f);
-    printf("Result written to '%s'\n", filename);
-}
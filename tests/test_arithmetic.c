@@ -155,6 +155,100 @@ void test_complex_expression_with_alias(void) {
     TEST_PASS();
 }
 
+void test_int64_exact(void) {
+    TEST_START("Integers above 2^53 compare, add and sum exactly");
+    
+    FILE* f = fopen("test_arith_big.csv", "w");
+    fprintf(f, "id,v\n1,9007199254740993\n2,9007199254740992\n3,-5\n");
+    fclose(f);
+    
+    ASSERT_EQUAL(1, execute_query_count("SELECT * FROM 'test_arith_big.csv' WHERE v = 9007199254740992"));
+    ASSERT_EQUAL(1, execute_query_count("SELECT * FROM 'test_arith_big.csv' WHERE v > 9007199254740992"));
+    ASSERT_EQUAL(1, execute_query_count("SELECT * FROM 'test_arith_big.csv' WHERE v + 1 = 9007199254740994"));
+    ASSERT_EQUAL(2, execute_query_count("SELECT * FROM 'test_arith_big.csv' WHERE v >= 9007199254740992.0"));
+    ASSERT_EQUAL(3, execute_query_count("SELECT DISTINCT v FROM 'test_arith_big.csv'"));
+    
+    ASTNode* ast = parse("SELECT SUM(v), SUM(id), AVG(id), id / 2 FROM 'test_arith_big.csv' WHERE id = 2");
+    ResultSet* result = evaluate_query(ast);
+    ASSERT_NOT_NULL(result);
+    ASSERT_EQUAL(VALUE_TYPE_INTEGER, result->rows[0].values[0].type);
+    ASSERT_TRUE(result->rows[0].values[0].int_value == 9007199254740992LL);
+    ASSERT_EQUAL(VALUE_TYPE_INTEGER, result->rows[0].values[1].type);
+    ASSERT_EQUAL(VALUE_TYPE_DOUBLE, result->rows[0].values[2].type);
+    csv_free(result);
+    releaseNode(ast);
+    
+    ast = parse("SELECT SUM(v) FROM 'test_arith_big.csv'");
+    result = evaluate_query(ast);
+    ASSERT_NOT_NULL(result);
+    ASSERT_EQUAL(VALUE_TYPE_INTEGER, result->rows[0].values[0].type);
+    ASSERT_TRUE(result->rows[0].values[0].int_value == 18014398509481980LL);
+    csv_free(result);
+    releaseNode(ast);
+    
+    remove("test_arith_big.csv");
+    TEST_PASS();
+}
+
+void test_empty_sum_type(void) {
+    TEST_START("SUM over no rows keeps the column's type");
+    
+    FILE* f = fopen("test_arith_empty.csv", "w");
+    fprintf(f, "id,price\n1,2.50\n2,4.25\n");
+    fclose(f);
+    
+    ASTNode* ast = parse("SELECT SUM(price), SUM(id) FROM 'test_arith_empty.csv' WHERE id > 5");
+    ResultSet* result = evaluate_query(ast);
+    ASSERT_NOT_NULL(result);
+    ASSERT_EQUAL(VALUE_TYPE_DOUBLE, result->rows[0].values[0].type);
+    ASSERT_TRUE(result->rows[0].values[0].double_value == 0);
+    ASSERT_EQUAL(VALUE_TYPE_INTEGER, result->rows[0].values[1].type);
+    ASSERT_TRUE(result->rows[0].values[1].int_value == 0);
+    csv_free(result);
+    releaseNode(ast);
+    
+    remove("test_arith_empty.csv");
+    TEST_PASS();
+}
+
+void test_group_sum_type(void) {
+    TEST_START("SUM gives every group of a column the same type");
+    
+    // integral amounts in a column that also holds fractions, and a group of zeros
+    FILE* f = fopen("test_arith_groups.csv", "w");
+    fprintf(f, "oid,cid,amt\n1,1,100.25\n2,1,50.25\n3,2,75\n4,5,20\n5,3,0\n6,2,0\n");
+    fclose(f);
+    
+    const char* queries[] = {
+        "SELECT cid, SUM(amt) FROM 'test_arith_groups.csv' GROUP BY cid",
+        "SELECT s.cid, SUM(s.amt) FROM (SELECT cid, amt FROM 'test_arith_groups.csv') s GROUP BY s.cid",
+    };
+    for (int q = 0; q < 2; q++) {
+        ASTNode* ast = parse(queries[q]);
+        ResultSet* result = evaluate_query(ast);
+        ASSERT_NOT_NULL(result);
+        ASSERT_EQUAL(4, result->row_count);
+        for (int r = 0; r < result->row_count; r++) {
+            ASSERT_EQUAL(VALUE_TYPE_DOUBLE, result->rows[r].values[1].type);
+        }
+        csv_free(result);
+        releaseNode(ast);
+    }
+    
+    // and an integer column stays exact in every group
+    ASTNode* ast = parse("SELECT cid, SUM(oid) FROM 'test_arith_groups.csv' GROUP BY cid");
+    ResultSet* result = evaluate_query(ast);
+    ASSERT_NOT_NULL(result);
+    for (int r = 0; r < result->row_count; r++) {
+        ASSERT_EQUAL(VALUE_TYPE_INTEGER, result->rows[r].values[1].type);
+    }
+    csv_free(result);
+    releaseNode(ast);
+    
+    remove("test_arith_groups.csv");
+    TEST_PASS();
+}
+
 int main(void) {
     printf("=== Arithmetic Expression Tests ===\n\n");
     
@@ -181,6 +275,9 @@ int main(void) {
     test_arithmetic_with_where_using_same_expression();
     test_expression_with_alias();
     test_complex_expression_with_alias();
+    test_int64_exact();
+    test_empty_sum_type();
+    test_group_sum_type();
     
     print_test_summary();
     
@@ -1,8 +1,17 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include "csv_reader.h"
+#include "input_stream.h"
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+#ifdef CQ_ZLIB
+#include <zlib.h>
+#endif
 
 void test_csv_load() {
     printf("Running test_csv_load...\n");
@@ -80,6 +89,267 @@ void test_csv_print() {
     printf("✓ test_csv_print passed\n\n");
 }
 
+void test_arena() {
+    printf("Running test_arena...\n");
+    
+    Arena* arena = arena_create();
+    char* first = arena_strdup(arena, "hello");
+    int* numbers = arena_alloc(arena, sizeof(int) * 3);
+    assert(((size_t)numbers % 8) == 0);
+    numbers[0] = 1;
+    numbers[2] = 3;
+    
+    // larger than the first chunk, served from a chunk of its own
+    char* big = arena_alloc(arena, 100000);
+    memset(big, 'x', 100000);
+    assert(strcmp(first, "hello") == 0);
+    
+    Arena* other = arena_create();
+    char* moved = arena_strndup(other, "world!", 5);
+    arena_absorb(arena, other);
+    assert(other->head == NULL && other->bytes_used == 0);
+    assert(strcmp(moved, "world") == 0);
+    assert(arena->bytes_used >= 100000 + 16);
+    
+    arena_destroy(other);
+    arena_destroy(arena);
+    printf("✓ test_arena passed\n\n");
+}
+
+void test_csv_arena_load() {
+    printf("Running test_csv_arena_load...\n");
+    
+    CsvConfig config = csv_config_default();
+    CsvTable* plain = csv_load("data/test_data.csv", config);
+    config.arena = true;
+    CsvTable* table = csv_load("data/test_data.csv", config);
+    
+    assert(plain->arena == NULL);
+    assert(table->arena != NULL);
+    assert(table->row_count == plain->row_count);
+    for (int i = 0; i < table->row_count; i++) {
+        assert(table->rows[i].column_count == plain->rows[i].column_count);
+        for (int j = 0; j < table->rows[i].column_count; j++) {
+            assert(value_compare(&table->rows[i].values[j], &plain->rows[i].values[j]) == 0);
+        }
+    }
+    
+    csv_free(plain);
+    csv_free(table);
+    printf("✓ test_csv_arena_load passed\n\n");
+}
+
+void test_csv_interned_strings() {
+    printf("Running test_csv_interned_strings...\n");
+    
+    FILE* f = fopen("test_csv_intern.csv", "w");
+    fprintf(f, "id,category,note\n");
+    for (int i = 0; i < 2000; i++) {
+        fprintf(f, "%d, %s ,note %d\n", i, i % 2 ? "books" : "toys", i);
+    }
+    fclose(f);
+    
+    CsvConfig config = csv_config_default();
+    config.arena = true;
+    CsvTable* table = csv_load("test_csv_intern.csv", config);
+    assert(table->row_count == 2000);
+    
+    // repeated values of a column share one trimmed copy
+    Value* first = &table->rows[0].values[1];
+    Value* third = &table->rows[2].values[1];
+    assert(strcmp(first->string_value, "toys") == 0);
+    assert(first->string_value == third->string_value);
+    assert(value_compare(first, third) == 0);
+    assert(strcmp(table->rows[1].values[1].string_value, "books") == 0);
+    
+    // unique values keep their own copies
+    assert(strcmp(table->rows[1999].values[2].string_value, "note 1999") == 0);
+    assert(table->rows[0].values[2].string_value != table->rows[1].values[2].string_value);
+    
+    csv_free(table);
+    remove("test_csv_intern.csv");
+    printf("✓ test_csv_interned_strings passed\n\n");
+}
+
+void test_csv_sampled_types() {
+    printf("Running test_csv_sampled_types...\n");
+    
+    FILE* f = fopen("test_csv_types.csv", "w");
+    assert(f != NULL);
+    fprintf(f, "id,price,zip,day\n");
+    for (int i = 0; i < 3000; i++) {
+        // price only turns fractional past the first lines, a few cells break the column type
+        if (i == 7) fprintf(f, "%d,N/A,01234,20240105\n", i);
+        else if (i < 2000) fprintf(f, "%d,%d,%05d,2024-03-%02d\n", i, i * 2, i, i % 28 + 1);
+        else fprintf(f, "%d,%d.5,%05d,2024-03-%02d\n", i, i, i, i % 28 + 1);
+    }
+    fclose(f);
+    
+    CsvConfig config = csv_config_default();
+    config.sample_rows = 100;
+    CsvTable* table = csv_load("test_csv_types.csv", config);
+    assert(table != NULL);
+    assert(table->row_count == 3000);
+    assert(table->columns[0].inferred_type == VALUE_TYPE_INTEGER);
+    assert(table->columns[1].inferred_type == VALUE_TYPE_DOUBLE);
+    assert(table->columns[3].inferred_type == VALUE_TYPE_DATE);
+    
+    // cells outside the column parser keep their own type
+    assert(table->rows[7].values[1].type == VALUE_TYPE_STRING);
+    assert(strcmp(table->rows[7].values[1].string_value, "N/A") == 0);
+    assert(table->rows[7].values[3].type == VALUE_TYPE_DATE);
+    assert(table->rows[7].values[3].date_value.day == 5);
+    assert(table->rows[6].values[1].type == VALUE_TYPE_INTEGER);
+    assert(table->rows[6].values[1].int_value == 12);
+    assert(table->rows[2999].values[1].type == VALUE_TYPE_DOUBLE);
+    assert(table->rows[2999].values[1].double_value == 2999.5);
+    assert(table->rows[12].values[2].type == VALUE_TYPE_INTEGER);
+    assert(table->rows[12].values[2].int_value == 12);
+    csv_free(table);
+    
+    // declared columns skip inference
+    CsvSchema* schema = csv_schema_parse("zip:string, price : double,day:date");
+    assert(schema != NULL);
+    assert(schema->column_count == 3);
+    config.schema = schema;
+    table = csv_load("test_csv_types.csv", config);
+    assert(table->columns[0].inferred_type == VALUE_TYPE_INTEGER);
+    assert(table->columns[1].inferred_type == VALUE_TYPE_DOUBLE);
+    assert(table->columns[2].inferred_type == VALUE_TYPE_STRING);
+    assert(table->rows[7].values[2].type == VALUE_TYPE_STRING);
+    assert(strcmp(table->rows[7].values[2].string_value, "01234") == 0);
+    assert(table->rows[6].values[1].type == VALUE_TYPE_DOUBLE);
+    assert(table->rows[6].values[1].double_value == 12.0);
+    assert(table->rows[7].values[1].type == VALUE_TYPE_STRING);
+    csv_free(table);
+    csv_schema_free(schema);
+    
+    assert(csv_schema_parse("zip:blob") == NULL);
+    assert(csv_schema_parse("zip") == NULL);
+    
+    remove("test_csv_types.csv");
+    printf("✓ test_csv_sampled_types passed\n\n");
+}
+
+#ifdef CQ_ZLIB
+/* gzip input is decompressed block by block, lines cut by a block boundary included */
+void test_csv_gzip_load() {
+    printf("Running test_csv_gzip_load...\n");
+    
+    // over three blocks of text, so that block boundaries cut lines
+    FILE* f = fopen("test_csv_gzip.csv", "w");
+    gzFile gz = gzopen("test_csv_gzip.csv.gz", "wb");
+    assert(f != NULL && gz != NULL);
+    char line[256];
+    int rows = 0;
+    for (size_t written = 0; written < 3 * INPUT_BLOCK_SIZE; rows++) {
+        int len = snprintf(line, sizeof(line), "%d,name %d,2024-01-%02d\n", rows, rows % 97, rows % 28 + 1);
+        if (rows == 0) {
+            fputs("id,name,day\n", f);
+            gzputs(gz, "id,name,day\n");
+        }
+        fputs(line, f);
+        gzwrite(gz, line, len);
+        written += len;
+    }
+    fclose(f);
+    gzclose(gz);
+    
+    CsvConfig config = csv_config_default();
+    CsvTable* plain = csv_load("test_csv_gzip.csv", config);
+    CsvTable* table = csv_load("test_csv_gzip.csv.gz", config);
+    assert(plain != NULL && table != NULL);
+    assert(table->row_count == rows && plain->row_count == rows);
+    for (int c = 0; c < 3; c++) assert(table->columns[c].inferred_type == plain->columns[c].inferred_type);
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < 3; c++) {
+            assert(table->rows[r].values[c].type == plain->rows[r].values[c].type);
+            assert(value_compare(&table->rows[r].values[c], &plain->rows[r].values[c]) == 0);
+        }
+    }
+    csv_free(plain);
+    csv_free(table);
+    
+    // a truncated file is an error, not a short table
+    f = fopen("test_csv_gzip.csv.gz", "rb");
+    char head[4096];
+    size_t size = fread(head, 1, sizeof(head), f);
+    fclose(f);
+    f = fopen("test_csv_gzip.csv.gz", "wb");
+    fwrite(head, 1, size, f);
+    fclose(f);
+    assert(csv_load("test_csv_gzip.csv.gz", config) == NULL);
+    
+    remove("test_csv_gzip.csv");
+    remove("test_csv_gzip.csv.gz");
+    printf("✓ test_csv_gzip_load passed\n\n");
+}
+#endif
+
+#if !defined(_WIN32) && !defined(_WIN64)
+/* standard input is read from a pipe block by block, the same rows as the file it carries */
+void test_csv_stdin_load() {
+    printf("Running test_csv_stdin_load...\n");
+    
+    FILE* f = fopen("test_csv_stdin.csv", "w");
+    assert(f != NULL);
+    fputs("id,name,day\n", f);
+    int rows = 0;
+    for (long written = 0; written < 2 * INPUT_BLOCK_SIZE + 1000; rows++) {
+        written += fprintf(f, "%d,\"name, %d\",2024-02-%02d\n", rows, rows % 89, rows % 29 + 1);
+    }
+    fclose(f);
+    
+    // a child writes the file into a pipe that becomes standard input
+    int pipe_fds[2];
+    assert(pipe(pipe_fds) == 0);
+    pid_t child = fork();
+    assert(child >= 0);
+    if (child == 0) {
+        close(pipe_fds[0]);
+        FILE* in = fopen("test_csv_stdin.csv", "r");
+        char buffer[4096];
+        size_t n;
+        while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+            if (write(pipe_fds[1], buffer, n) != (ssize_t)n) _exit(1);
+        }
+        _exit(0);
+    }
+    close(pipe_fds[1]);
+    int saved_stdin = dup(0);
+    dup2(pipe_fds[0], 0);
+    close(pipe_fds[0]);
+    
+    CsvConfig config = csv_config_default();
+    CsvTable* table = csv_load(CSV_STDIN, config);
+    CsvTable* plain = csv_load("test_csv_stdin.csv", config);
+    int status;
+    waitpid(child, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    
+    assert(table != NULL && plain != NULL);
+    assert(table->row_count == rows && plain->row_count == rows);
+    assert(table->file_size == plain->file_size);
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < 3; c++) {
+            assert(table->rows[r].values[c].type == plain->rows[r].values[c].type);
+            assert(value_compare(&table->rows[r].values[c], &plain->rows[r].values[c]) == 0);
+        }
+    }
+    
+    // it is read only once, and never written
+    assert(csv_load(CSV_STDIN, config) == NULL);
+    assert(!csv_save(CSV_STDIN, table));
+    
+    csv_free(plain);
+    csv_free(table);
+    dup2(saved_stdin, 0);
+    close(saved_stdin);
+    remove("test_csv_stdin.csv");
+    printf("✓ test_csv_stdin_load passed\n\n");
+}
+#endif
+
 int main(void) {
     printf("=== CSV Reader Test Suite ===\n\n");
     
@@ -87,6 +357,16 @@ int main(void) {
     test_csv_values();
     test_csv_no_header();
     test_csv_print();
+    test_arena();
+    test_csv_arena_load();
+    test_csv_interned_strings();
+    test_csv_sampled_types();
+#ifdef CQ_ZLIB
+    test_csv_gzip_load();
+#endif
+#if !defined(_WIN32) && !defined(_WIN64)
+    test_csv_stdin_load();
+#endif
     
     printf("=== All CSV tests passed! ===\n");
     return 0;
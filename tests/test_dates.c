@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <limits.h>
 #include "test_framework.h"
 #include "test_helpers.h"
 #include "parser.h"
@@ -74,10 +75,10 @@ void test_date_arithmetic(void) {
     DateValue result;
     
     // add days
-    result = date_add_days(date, 10);
+    ASSERT_TRUE(date_add_days(date, 10, &result));
     ASSERT_TRUE(result.year == 2025 && result.month == 1 && result.day == 25);
     
-    result = date_add_days(date, 20);
+    ASSERT_TRUE(date_add_days(date, 20, &result));
     ASSERT_TRUE(result.year == 2025 && result.month == 2 && result.day == 4);
     TEST_PASS();
 }
@@ -89,10 +90,10 @@ void test_date_arithmetic_months(void) {
     DateValue result;
     
     // add months
-    result = date_add_months(date, 2);
+    ASSERT_TRUE(date_add_months(date, 2, &result));
     ASSERT_TRUE(result.year == 2025 && result.month == 3 && result.day == 15);
     
-    result = date_add_months(date, 13);
+    ASSERT_TRUE(date_add_months(date, 13, &result));
     ASSERT_TRUE(result.year == 2026 && result.month == 2 && result.day == 15);
     TEST_PASS();
 }
@@ -104,11 +105,50 @@ void test_date_arithmetic_years(void) {
     DateValue result;
     
     // add years
-    result = date_add_years(date, 5);
+    ASSERT_TRUE(date_add_years(date, 5, &result));
     ASSERT_TRUE(result.year == 2030 && result.month == 1 && result.day == 15);
     TEST_PASS();
 }
 
+void test_date_arithmetic_range(void) {
+    TEST_START("Date arithmetic - out of range years");
+    
+    DateValue date = {2024, 10, 16};
+    DateValue result;
+    
+    // the last years a date holds, and going back across month boundaries
+    ASSERT_TRUE(date_add_years(date, DATE_MAX_YEAR - 2024, &result));
+    ASSERT_EQUAL(DATE_MAX_YEAR, result.year);
+    ASSERT_TRUE(date_add_months(date, -11, &result));
+    ASSERT_TRUE(result.year == 2023 && result.month == 11 && result.day == 16);
+    ASSERT_TRUE(date_add_days(date, -(date_to_days(date) - date_to_days((DateValue){DATE_MIN_YEAR, 1, 1})), &result));
+    ASSERT_TRUE(result.year == DATE_MIN_YEAR && result.month == 1 && result.day == 1);
+    
+    // past them the result is an error rather than a wrapped year
+    ASSERT_TRUE(!date_add_years(date, 40000, &result));
+    ASSERT_TRUE(!date_add_years(date, -40000, &result));
+    ASSERT_TRUE(!date_add_months(date, 12LL * 40000, &result));
+    ASSERT_TRUE(!date_add_days(date, 365LL * 40000, &result));
+    ASSERT_TRUE(!date_add_days(date, LLONG_MIN, &result));
+    
+    // keys keep date order across negative years
+    DateValue before = {-5, 12, 31};
+    DateValue after = {3, 1, 1};
+    ASSERT_TRUE(date_key(before) < date_key(after));
+    
+    // in SQL an out of range result is NULL
+    ASTNode* ast = parse("SELECT DATE_ADD('2024-10-16', 40000, 'year'), DATE_SUB('2024-10-16', 1, 'year') FROM 'data/events.csv' LIMIT 1");
+    ASSERT_NOT_NULL(ast);
+    ResultSet* rs = evaluate_query(ast);
+    ASSERT_NOT_NULL(rs);
+    ASSERT_EQUAL(VALUE_TYPE_NULL, rs->rows[0].values[0].type);
+    ASSERT_EQUAL(VALUE_TYPE_DATE, rs->rows[0].values[1].type);
+    ASSERT_EQUAL(2023, rs->rows[0].values[1].date_value.year);
+    csv_free(rs);
+    releaseNode(ast);
+    TEST_PASS();
+}
+
 void test_date_differences(void) {
     TEST_START("Date differences");
     
@@ -125,6 +165,31 @@ void test_date_differences(void) {
     TEST_PASS();
 }
 
+void test_date_day_numbers(void) {
+    TEST_START("Packed dates and day numbers");
+    
+    // a date fits in 32 bits, keeping a Value at 16 bytes
+    ASSERT_EQUAL(4, (int)sizeof(DateValue));
+    ASSERT_EQUAL(16, (int)sizeof(Value));
+    
+    DateValue epoch = {1970, 1, 1};
+    DateValue leap = {2024, 2, 29};
+    DateValue first = {1000, 1, 1};
+    ASSERT_EQUAL(0, date_to_days(epoch));
+    ASSERT_EQUAL(19782, date_to_days(leap));
+    ASSERT_EQUAL(-354285, date_to_days(first));
+    
+    // round trip across a century boundary that is not a leap year
+    DateValue date = {2100, 2, 28};
+    DateValue next;
+    ASSERT_TRUE(days_to_date(date_to_days(date) + 1, &next));
+    ASSERT_EQUAL(2100, next.year);
+    ASSERT_EQUAL(3, next.month);
+    ASSERT_EQUAL(1, next.day);
+    ASSERT_TRUE(date_key(date) < date_key(next));
+    TEST_PASS();
+}
+
 /* test date SQL functions */
 void test_date_sql_functions(void) {
     TEST_START("Date SQL functions - YEAR, MONTH, DAY");
@@ -259,7 +324,9 @@ int main(void) {
     test_date_arithmetic();
     test_date_arithmetic_months();
     test_date_arithmetic_years();
+    test_date_arithmetic_range();
     test_date_differences();
+    test_date_day_numbers();
     test_date_sql_functions();
     test_date_comparison_where();
     test_date_add_function();
@@ -152,6 +152,43 @@ void test_distinct_with_limit() {
     printf("  PASSED\n\n");
 }
 
+void test_distinct_many_rows() {
+    printf("Test: SELECT DISTINCT over many rows...\n");
+    
+    // 20000 rows cycling through 500 keys, with blank rows mixed in
+    FILE* f = fopen("test_distinct_many.csv", "w");
+    fprintf(f, "k,tag\n");
+    for (int i = 0; i < 20000; i++) {
+        if (i % 1000 == 0) {
+            fprintf(f, ",\n");
+        } else {
+            fprintf(f, "%d,t%d\n", i % 500, (i % 500) % 7);
+        }
+    }
+    fclose(f);
+    
+    const char* query = "SELECT DISTINCT k, tag FROM test_distinct_many.csv";
+    ASTNode* ast = parse(query);
+    assert(ast != NULL);
+    
+    ResultSet* result = evaluate_query(ast);
+    assert(result != NULL);
+    // 500 keys plus a single blank row
+    assert(result->row_count == 501);
+    printf("  Result has %d distinct rows\n", result->row_count);
+    
+    // first occurrence order is preserved
+    assert(result->rows[0].values[0].type == VALUE_TYPE_STRING);
+    assert(result->rows[0].values[1].type == VALUE_TYPE_NULL);
+    assert(result->rows[1].values[0].int_value == 1);
+    
+    csv_free(result);
+    releaseNode(ast);
+    
+    remove("test_distinct_many.csv");
+    printf("  PASSED\n\n");
+}
+
 int main() {
     printf("=== DISTINCT Functionality Tests ===\n\n");
     
@@ -159,6 +196,7 @@ int main() {
     test_distinct_single_column();
     test_distinct_with_order_by();
     test_distinct_with_limit();
+    test_distinct_many_rows();
     
     printf("=== All DISTINCT tests passed! ===\n");
     return 0;
@@ -89,6 +89,78 @@ void test_insert_specific_columns() {
     TEST_PASS();
 }
 
+// test INSERT of several VALUES rows and of a SELECT
+void test_insert_multiple_rows() {
+    TEST_START("INSERT several rows");
+    
+    // no newline after the last row, the inserted rows must still start on their own line
+    const char* test_file = "data/test_insert_rows.csv";
+    create_test_file(test_file, "id,name,age\n1,Alice,25");
+    
+    ASTNode* ast = parse("INSERT INTO 'data/test_insert_rows.csv' VALUES (2, 'Bob', 30), (3, 'Carol, Jr.', 41)");
+    ASSERT_NOT_NULL(ast);
+    ResultSet* result = evaluate_query(ast);
+    ASSERT_NOT_NULL(result);
+    ASSERT_TRUE(strcmp(result->rows[0].values[0].string_value, "Inserted 2 rows") == 0);
+    releaseNode(ast);
+    csv_free(result);
+    
+    // the rows of a query, into the named columns
+    ast = parse("INSERT INTO 'data/test_insert_rows.csv' (name, id) "
+                "SELECT name, id + 10 FROM 'data/test_insert_rows.csv' WHERE age > 26");
+    ASSERT_NOT_NULL(ast);
+    result = evaluate_query(ast);
+    ASSERT_NOT_NULL(result);
+    releaseNode(ast);
+    csv_free(result);
+    
+    CsvConfig config = csv_config_default();
+    CsvTable* table = csv_load(test_file, config);
+    ASSERT_NOT_NULL(table);
+    ASSERT_EQUAL(5, table->row_count);
+    ASSERT_EQUAL(2, csv_get_value_by_name(table, 1, "id")->int_value);
+    ASSERT_TRUE(strcmp(csv_get_value_by_name(table, 2, "name")->string_value, "Carol, Jr.") == 0);
+    ASSERT_EQUAL(13, csv_get_value_by_name(table, 4, "id")->int_value);
+    ASSERT_TRUE(csv_get_value_by_name(table, 4, "age")->type == VALUE_TYPE_NULL);
+    csv_free(table);
+    unlink(test_file);
+    
+    TEST_PASS();
+}
+
+// test that a failed INSERT leaves the file as it was
+void test_insert_failure() {
+    TEST_START("INSERT failure leaves the table unchanged");
+    
+    const char* test_file = "data/test_insert_failure.csv";
+    const char* content = "id,name\n1,Alice\n";
+    create_test_file(test_file, content);
+    
+    const char* statements[] = {
+        "INSERT INTO 'data/test_insert_failure.csv' VALUES (2, 'Bob', 30)",
+        "INSERT INTO 'data/test_insert_failure.csv' (id, missing) VALUES (2, 'Bob')",
+        "INSERT INTO 'data/test_insert_failure.csv' SELECT id FROM 'data/test_insert_failure.csv'",
+    };
+    for (size_t i = 0; i < sizeof(statements) / sizeof(statements[0]); i++) {
+        ASTNode* ast = parse(statements[i]);
+        ASSERT_NOT_NULL(ast);
+        ResultSet* result = evaluate_query(ast);
+        ASSERT_NULL(result);
+        releaseNode(ast);
+    }
+    
+    char buffer[64] = {0};
+    FILE* f = fopen(test_file, "r");
+    ASSERT_NOT_NULL(f);
+    size_t length = fread(buffer, 1, sizeof(buffer) - 1, f);
+    fclose(f);
+    ASSERT_EQUAL(strlen(content), length);
+    ASSERT_TRUE(strcmp(buffer, content) == 0);
+    unlink(test_file);
+    
+    TEST_PASS();
+}
+
 // test UPDATE single column
 void test_update_single_column() {
     TEST_START("UPDATE single column");
@@ -262,6 +334,45 @@ void test_delete_complex_condition() {
     TEST_PASS();
 }
 
+// test that UPDATE and DELETE copy the records they do not change as they were
+void test_rewrite_untouched_records() {
+    TEST_START("UPDATE and DELETE keep untouched records");
+    
+    const char* test_file = "data/test_rewrite.csv";
+    create_test_file(test_file, "\"id\",name,score\r\n1,\"Alice, A.\",85.50\r\n2,Bob,90\r\n3,Carol,70.0");
+    
+    const char* statements[] = {
+        "UPDATE 'data/test_rewrite.csv' SET score = score + 5, name = 'Bobby' WHERE id = 2",
+        "DELETE FROM 'data/test_rewrite.csv' WHERE score < 80",
+    };
+    for (size_t i = 0; i < sizeof(statements) / sizeof(statements[0]); i++) {
+        ASTNode* ast = parse(statements[i]);
+        ASSERT_NOT_NULL(ast);
+        ResultSet* result = evaluate_query(ast);
+        ASSERT_NOT_NULL(result);
+        releaseNode(ast);
+        csv_free(result);
+    }
+    
+    // a statement that fails changes nothing
+    ASTNode* ast = parse("UPDATE 'data/test_rewrite.csv' SET missing = 1");
+    ASSERT_NOT_NULL(ast);
+    ASSERT_NULL(evaluate_query(ast));
+    releaseNode(ast);
+    
+    const char* expected = "\"id\",name,score\r\n1,\"Alice, A.\",85.50\r\n2,Bobby,95\n";
+    char buffer[128] = {0};
+    FILE* f = fopen(test_file, "r");
+    ASSERT_NOT_NULL(f);
+    size_t length = fread(buffer, 1, sizeof(buffer) - 1, f);
+    fclose(f);
+    ASSERT_EQUAL(strlen(expected), length);
+    ASSERT_TRUE(strcmp(buffer, expected) == 0);
+    unlink(test_file);
+    
+    TEST_PASS();
+}
+
 // test INSERT, UPDATE, DELETE sequence
 void test_dml_sequence() {
     TEST_START("INSERT, UPDATE, DELETE sequence");
@@ -310,11 +421,14 @@ int main() {
     
     test_insert_all_columns();
     test_insert_specific_columns();
+    test_insert_multiple_rows();
+    test_insert_failure();
     test_update_single_column();
     test_update_multiple_columns();
     test_update_all_rows();
     test_delete_simple();
     test_delete_complex_condition();
+    test_rewrite_untouched_records();
     test_dml_sequence();
     
     print_test_summary();
@@ -2,6 +2,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "evaluator.h"
 #include "parser.h"
@@ -185,6 +187,125 @@ void test_group_by_count() {
     printf("✓ test_group_by_count passed\n\n");
 }
 
+typedef struct {
+    RowSink base;
+    int column_count;
+    int rows;
+    int stop_after;
+} CountingSink;
+
+static void counting_begin(RowSink* sink, const Column* columns, int column_count) {
+    (void)columns;
+    ((CountingSink*)sink)->column_count = column_count;
+}
+
+static bool counting_row(RowSink* sink, const Row* row) {
+    CountingSink* counter = (CountingSink*)sink;
+    assert(row->column_count == counter->column_count);
+    return ++counter->rows != counter->stop_after;
+}
+
+static bool counting_end(RowSink* sink) {
+    (void)sink;
+    return true;
+}
+
+void test_query_to_sink() {
+    printf("Running test_query_to_sink...\n");
+
+    const char* queries[] = {
+        "SELECT name, age FROM 'data/test_data.csv' WHERE age > 25",
+        "SELECT name FROM 'data/test_data.csv' LIMIT 2 OFFSET 1",
+        "SELECT role, COUNT(*) FROM 'data/test_data.csv' GROUP BY role",
+        "SELECT a.name, b.name FROM 'data/test_data.csv' a JOIN 'data/test_data.csv' b ON a.role = b.role",
+    };
+    for (size_t q = 0; q < sizeof(queries) / sizeof(queries[0]); q++) {
+        ASTNode* ast = parse(queries[q]);
+        ResultSet* result = evaluate_query(ast);
+        assert(result != NULL);
+
+        // streamed or materialized, the sink sees the rows evaluate_query returns
+        CountingSink counter = {{counting_begin, counting_row, counting_end, NULL, NULL}, 0, 0, -1};
+        assert(evaluate_query_to_sink(ast, &counter.base));
+        assert(counter.column_count == result->column_count);
+        assert(counter.rows == result->row_count);
+
+        // a sink that wants no more rows stops the producer
+        CountingSink first = {{counting_begin, counting_row, counting_end, NULL, NULL}, 0, 0, 1};
+        assert(evaluate_query_to_sink(ast, &first.base));
+        assert(first.rows == 1);
+
+        csv_free(result);
+        releaseNode(ast);
+    }
+
+    printf("✓ test_query_to_sink passed\n\n");
+}
+
+static void write_test_file(const char* path, const char* text) {
+    FILE* f = fopen(path, "w");
+    assert(f);
+    fputs(text, f);
+    fclose(f);
+}
+
+static ResultSet* run_query(const char* sql) {
+    ASTNode* ast = parse(sql);
+    assert(ast != NULL);
+    ResultSet* result = evaluate_query(ast);
+    releaseNode(ast);
+    return result;
+}
+
+void test_file_sets() {
+    printf("Running test_file_sets...\n");
+
+    // two partitions with different columns, and one whose file cannot be read at all
+    mkdir("/tmp/test_file_set", 0755);
+    mkdir("/tmp/test_file_set/dt=2024-01-01", 0755);
+    mkdir("/tmp/test_file_set/dt=2024-01-02", 0755);
+    mkdir("/tmp/test_file_set/dt=2024-02-01", 0755);
+    write_test_file("/tmp/test_file_set/dt=2024-01-01/a.csv", "id,v\n1,10\n2,20\n");
+    write_test_file("/tmp/test_file_set/dt=2024-01-02/b.csv", "id,v,note\n3,30.5,x\n");
+    write_test_file("/tmp/test_file_set/dt=2024-02-01/c.csv", "\x1f\x8bnot gzip\n");
+
+    // a pattern reads the files as one table, the broken partition is skipped before loading
+    ResultSet* result = run_query("SELECT id, v, note, dt, _file FROM '/tmp/test_file_set/*/*.csv' "
+                                  "WHERE dt < '2024-02-01' ORDER BY id");
+    assert(result != NULL);
+    assert(result->row_count == 3 && result->column_count == 5);
+    assert(result->rows[0].values[2].type == VALUE_TYPE_NULL);
+    assert(strcmp(result->rows[2].values[2].string_value, "x") == 0);
+    char* dt = value_to_string(&result->rows[2].values[3]);
+    assert(strcmp(dt, "2024-01-02") == 0);
+    free(dt);
+    assert(strcmp(result->rows[0].values[4].string_value, "/tmp/test_file_set/dt=2024-01-01/a.csv") == 0);
+    csv_free(result);
+
+    // without the condition the broken file is loaded and fails the query
+    assert(run_query("SELECT id FROM '/tmp/test_file_set/*/*.csv'") == NULL);
+
+    // a read_csv list, joined, with the pruning conditions pushed into its scan
+    result = run_query("SELECT e.id, t.name FROM read_csv(['/tmp/test_file_set/dt=2024-01-01/a.csv', "
+                       "'/tmp/test_file_set/dt=2024-02-01/c.csv']) e JOIN 'data/test_data.csv' t ON e.id = t.id "
+                       "WHERE e.dt = '2024-01-01'");
+    assert(result != NULL);
+    assert(result->row_count == 2);
+    csv_free(result);
+
+    // a pattern matching nothing is an error
+    assert(run_query("SELECT * FROM '/tmp/test_file_set/none-*.csv'") == NULL);
+
+    remove("/tmp/test_file_set/dt=2024-01-01/a.csv");
+    remove("/tmp/test_file_set/dt=2024-01-02/b.csv");
+    remove("/tmp/test_file_set/dt=2024-02-01/c.csv");
+    rmdir("/tmp/test_file_set/dt=2024-01-01");
+    rmdir("/tmp/test_file_set/dt=2024-01-02");
+    rmdir("/tmp/test_file_set/dt=2024-02-01");
+    rmdir("/tmp/test_file_set");
+    printf("✓ test_file_sets passed\n\n");
+}
+
 int main(void) {
     printf("=== Evaluator Test Suite ===\n\n");
     
@@ -197,6 +318,8 @@ int main(void) {
     test_alias();
     test_group_by_avg();
     test_group_by_count();
+    test_query_to_sink();
+    test_file_sets();
     
     printf("=== All evaluator tests passed! ===\n");
     return 0;
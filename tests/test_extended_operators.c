@@ -113,6 +113,34 @@ void test_not_in_with_more_values(void) {
     TEST_PASS();
 }
 
+void test_in_with_subquery(void) {
+    TEST_START("IN with subquery");
+    int count = execute_query_count("SELECT name FROM 'data/test_data.csv' WHERE role IN (SELECT role FROM 'data/admins.csv');");
+    ASSERT_EQUAL(4, count);
+    TEST_PASS();
+}
+
+void test_not_in_with_subquery(void) {
+    TEST_START("NOT IN with subquery");
+    int count = execute_query_count("SELECT name FROM 'data/test_data.csv' WHERE role NOT IN (SELECT role FROM 'data/admins.csv');");
+    ASSERT_EQUAL(3, count);
+    TEST_PASS();
+}
+
+void test_in_with_mixed_numeric_list(void) {
+    TEST_START("IN with mixed numeric list");
+    int count = execute_query_count("SELECT name FROM 'data/test_data.csv' WHERE age IN (25.0, 10 + 20, 99);");
+    ASSERT_EQUAL(2, count);
+    TEST_PASS();
+}
+
+void test_in_with_column_list(void) {
+    TEST_START("IN with column references");
+    int count = execute_query_count("SELECT name FROM 'data/test_data.csv' WHERE 1 IN (active, id);");
+    ASSERT_EQUAL(5, count);
+    TEST_PASS();
+}
+
 void test_modulo_with_arithmetic(void) {
     TEST_START("Modulo with arithmetic");
     int count = execute_query_count("SELECT age, (age % 10) * 2 FROM 'data/test_data.csv';");
@@ -182,6 +210,10 @@ int main(void) {
     test_not_with_complex_condition();
     test_not_in_with_list();
     test_not_in_with_more_values();
+    test_in_with_subquery();
+    test_not_in_with_subquery();
+    test_in_with_mixed_numeric_list();
+    test_in_with_column_list();
     test_modulo_with_arithmetic();
     test_all_operators_combined();
     test_precedence_modulo_and_add();
@@ -2,9 +2,13 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <stdint.h>
+#include <unistd.h>
 
 #include "csv_reader.h"
 #include "formats.h"
+#include "output_writer.h"
+#include "arrow.h"
 
 static char* read_file_snippet(const char* path, size_t max_len) {
     FILE* f = fopen(path, "r");
@@ -55,9 +59,310 @@ void test_write_formats() {
     printf("✓ test_write_formats passed\n\n");
 }
 
+void test_output_writer() {
+    printf("Running test_output_writer...\n");
+
+    // formatted values read like printf and value_to_string
+    double doubles[] = {0.125, 0.375, 2.675, -0.001, -0.0, 1.005, 123456789.995, 1e20, -7.5};
+    for (size_t i = 0; i < sizeof(doubles) / sizeof(doubles[0]); i++) {
+        Value value = {.type = VALUE_TYPE_DOUBLE, .double_value = doubles[i]};
+        char scratch[VALUE_TEXT_SIZE];
+        char expected[VALUE_TEXT_SIZE];
+        size_t len;
+        const char* text = value_text(&value, scratch, &len);
+        snprintf(expected, sizeof(expected), "%.2f", doubles[i]);
+        assert(len == strlen(expected) && memcmp(text, expected, len) == 0);
+    }
+    Value values[] = {
+        {.type = VALUE_TYPE_INTEGER, .int_value = -9223372036854775807LL - 1},
+        {.type = VALUE_TYPE_DATE, .date_value = {.year = 2024, .month = 2, .day = 9}},
+        {.type = VALUE_TYPE_NULL},
+    };
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        char scratch[VALUE_TEXT_SIZE];
+        size_t len;
+        const char* text = value_text(&values[i], scratch, &len);
+        char* expected = value_to_string(&values[i]);
+        assert(len == strlen(expected) && memcmp(text, expected, len) == 0);
+        free(expected);
+    }
+
+    // escaping, and output larger than the buffer
+    const char* path = "/tmp/test_output_writer.txt";
+    OutputWriter out;
+    assert(writer_open(&out, path));
+    writer_csv_string(&out, "plain", ',', '"');
+    writer_putc(&out, ',');
+    writer_csv_string(&out, "a,\"b\"", ',', '"');
+    writer_putc(&out, ',');
+    writer_json_string(&out, "say \"hi\"\\\n");
+    writer_putc(&out, '\n');
+    for (int i = 0; i < 100000; i++) {
+        writer_int(&out, i);
+        writer_putc(&out, '\n');
+    }
+    assert(writer_close(&out));
+
+    char* text = read_file_snippet(path, 1 << 20);
+    assert(strncmp(text, "plain,\"a,\"\"b\"\"\",\"say \\\"hi\\\"\\\\\\n\"\n0\n1\n", 36) == 0);
+    assert(strstr(text, "\n99999\n") != NULL);
+    free(text);
+    remove(path);
+
+    printf("✓ test_output_writer passed\n\n");
+}
+
+void test_row_sinks() {
+    printf("Running test_row_sinks...\n");
+
+    CsvConfig config = csv_config_default();
+    CsvTable* table = csv_load("data/test_data.csv", config);
+    assert(table != NULL);
+
+    // rows pushed one at a time through two file sinks at once
+    const char* ndjson_path = "/tmp/test_row_sinks.ndjson";
+    const char* csv_path = "/tmp/test_row_sinks.csv";
+    RowSink* sink = row_sink_tee(format_file_sink_create(ndjson_path, FMT_NDJSON, ','),
+                                 format_file_sink_create(csv_path, FMT_CSV, ';'));
+    row_sink_push_result(sink, (ResultSet*)table);
+    assert(sink->end(sink));
+
+    char* n = read_file_snippet(ndjson_path, 4096);
+    assert(n && strncmp(n, "{\"id\": 1, \"name\": \"Alice\", ", 27) == 0);
+    int lines = 0;
+    for (char* p = n; *p; p++) lines += *p == '\n';
+    assert(lines == table->row_count);
+    free(n);
+
+    char* c = read_file_snippet(csv_path, 4096);
+    assert(c && strncmp(c, "id;name;age;role;height;active\n1;Alice;25;", 42) == 0);
+    free(c);
+
+    csv_free(table);
+    remove(ndjson_path);
+    remove(csv_path);
+
+    printf("✓ test_row_sinks passed\n\n");
+}
+
+/* every format of a batch big enough for the worker threads, compared with one thread */
+void test_parallel_formatting() {
+    printf("Running test_parallel_formatting...\n");
+
+    enum { ROWS = FORMAT_CHUNK_ROWS * 5 + 17 };
+    Column columns[3] = {{"id", VALUE_TYPE_INTEGER}, {"name", VALUE_TYPE_STRING}, {"price", VALUE_TYPE_DOUBLE}};
+    char names[4][16] = {"plain", "with,comma", "with \"quote\"", "NULL"};
+    Row* rows = malloc(sizeof(Row) * ROWS);
+    Value* values = malloc(sizeof(Value) * ROWS * 3);
+    for (int r = 0; r < ROWS; r++) {
+        rows[r].values = values + r * 3;
+        rows[r].column_count = 3;
+        rows[r].values[0].type = VALUE_TYPE_INTEGER;
+        rows[r].values[0].int_value = r;
+        rows[r].values[1].type = VALUE_TYPE_STRING;
+        rows[r].values[1].string_value = names[r % 4];
+        rows[r].values[2].type = r % 7 ? VALUE_TYPE_DOUBLE : VALUE_TYPE_NULL;
+        rows[r].values[2].double_value = r / 8.0;
+    }
+
+    OutputFormat formats[] = {FMT_CSV, FMT_JSON, FMT_NDJSON, FMT_MARKDOWN, FMT_YAML};
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+        const char* paths[2] = {"/tmp/test_parallel_1.out", "/tmp/test_parallel_4.out"};
+        for (int p = 0; p < 2; p++) {
+            output_threads = p ? 4 : 1;
+            RowSink* sink = format_file_sink_create(paths[p], formats[f], ',');
+            sink->begin(sink, columns, 3);
+            // two batches, so the second one continues the row numbering of the first
+            assert(row_sink_push_rows(sink, rows, 100));
+            assert(row_sink_push_rows(sink, rows + 100, ROWS - 100));
+            assert(sink->end(sink));
+        }
+        char* single = read_file_snippet(paths[0], 8 << 20);
+        char* parallel = read_file_snippet(paths[1], 8 << 20);
+        assert(single && parallel && strlen(single) > ROWS * 8);
+        assert(strcmp(single, parallel) == 0);
+        free(single);
+        free(parallel);
+        remove(paths[0]);
+        remove(paths[1]);
+    }
+    output_threads = 0;
+
+    free(values);
+    free(rows);
+    printf("✓ test_parallel_formatting passed\n\n");
+}
+
+/* a whole result is aligned to its widest cell, streamed rows to the first TABLE_WIDTH_ROWS */
+void test_table_widths() {
+    printf("Running test_table_widths...\n");
+
+    enum { ROWS = TABLE_WIDTH_ROWS + 1 };
+    Column columns[2] = {{"id", VALUE_TYPE_INTEGER}, {"amount", VALUE_TYPE_DOUBLE}};
+    Row* rows = malloc(sizeof(Row) * ROWS);
+    Value* values = malloc(sizeof(Value) * ROWS * 2);
+    for (int r = 0; r < ROWS; r++) {
+        rows[r].values = values + r * 2;
+        rows[r].column_count = 2;
+        rows[r].values[0].type = VALUE_TYPE_INTEGER;
+        rows[r].values[0].int_value = r % 10;
+        rows[r].values[1].type = VALUE_TYPE_DOUBLE;
+        rows[r].values[1].double_value = r < TABLE_WIDTH_ROWS ? 1 : 1234567.5;
+    }
+    ResultSet result = {0};
+    result.columns = columns;
+    result.column_count = 2;
+    result.rows = rows;
+    result.row_count = ROWS;
+
+    const char* path = "/tmp/test_table_widths.out";
+    for (int whole = 0; whole < 2; whole++) {
+        fflush(stdout);
+        int saved = dup(1);
+        FILE* f = fopen(path, "w");
+        dup2(fileno(f), 1);
+        RowSink* sink = format_sink_create(FMT_TABLE, false);
+        if (whole) {
+            row_sink_push_result(sink, &result);
+        } else {
+            sink->begin(sink, columns, 2);
+            assert(row_sink_push_rows(sink, rows, ROWS));
+        }
+        assert(sink->end(sink));
+        fflush(stdout);
+        dup2(saved, 1);
+        close(saved);
+        fclose(f);
+
+        // the header line against the last row, which holds the widest amount
+        char* text = read_file_snippet(path, 1 << 20);
+        assert(text);
+        size_t header = strcspn(text, "\n");
+        char* last = text + strlen(text) - 1;
+        while (last > text && last[-1] != '\n') last--;
+        size_t width = strcspn(last, "\n");
+        assert(whole ? width == header : width > header);
+        free(text);
+    }
+    remove(path);
+
+    free(values);
+    free(rows);
+    printf("✓ test_table_widths passed\n\n");
+}
+
+void test_arrow_output() {
+    printf("Running test_arrow_output...\n");
+
+    CsvConfig config = csv_config_default();
+    CsvTable* table = csv_load("data/test_data.csv", config);
+    assert(table != NULL);
+
+    const char* path = "/tmp/test_formats.arrow";
+    assert(write_output_file(path, (ResultSet*)table, FMT_ARROW, ','));
+
+    FILE* f = fopen(path, "rb");
+    assert(f);
+    unsigned char data[8192];
+    size_t size = fread(data, 1, sizeof(data), f);
+    fclose(f);
+
+    // magic, the schema message, ..., footer, footer length, magic
+    assert(size > 64 && size < sizeof(data));
+    assert(memcmp(data, ARROW_MAGIC "\0\0", 8) == 0);
+    uint32_t continuation;
+    memcpy(&continuation, data + 8, 4);
+    assert(continuation == ARROW_CONTINUATION);
+    assert(memcmp(data + size - 6, ARROW_MAGIC, 6) == 0);
+    int32_t footer_length;
+    memcpy(&footer_length, data + size - 10, 4);
+    assert(footer_length > 0 && (size_t)footer_length < size - 18);
+    // the stream before the footer ends with an empty message
+    assert(memcmp(data + size - 10 - footer_length - 8, "\xff\xff\xff\xff\0\0\0\0", 8) == 0);
+
+    csv_free(table);
+    remove(path);
+    printf("✓ test_arrow_output passed\n\n");
+}
+
+void test_arrow_input() {
+    printf("Running test_arrow_input...\n");
+
+    const char* sources[] = { "data/test_data.csv", "data/events.csv" };
+    const char* path = "/tmp/test_formats_input.arrow";
+    CsvConfig config = csv_config_default();
+
+    for (int s = 0; s < 2; s++) {
+        CsvTable* table = csv_load(sources[s], config);
+        assert(table != NULL);
+        assert(write_output_file(path, (ResultSet*)table, FMT_ARROW, ','));
+
+        // read back through csv_load, values come out typed as they went in
+        CsvTable* arrow = csv_load(path, config);
+        assert(arrow != NULL);
+        assert(arrow->arrow);
+        assert(arrow->column_count == table->column_count);
+        assert(arrow->row_count == table->row_count);
+        for (int c = 0; c < table->column_count; c++) {
+            assert(strcmp(arrow->columns[c].name, table->columns[c].name) == 0);
+        }
+        for (int r = 0; r < table->row_count; r++) {
+            for (int c = 0; c < table->column_count; c++) {
+                Value* expected = &table->rows[r].values[c];
+                Value* actual = &arrow->rows[r].values[c];
+                assert(actual->type == expected->type);
+                assert(value_compare(actual, expected) == 0);
+            }
+        }
+
+        // an Arrow table is never written back as CSV
+        assert(!csv_save(path, arrow));
+        csv_free(arrow);
+        csv_free(table);
+    }
+
+    // a truncated file is an error, not a short table
+    FILE* f = fopen(path, "rb");
+    assert(f);
+    char data[8192];
+    size_t size = fread(data, 1, sizeof(data), f);
+    fclose(f);
+    f = fopen(path, "wb");
+    assert(f);
+    fwrite(data, 1, size / 2, f);
+    fclose(f);
+    assert(csv_load(path, config) == NULL);
+
+    // a column of strings and numbers falls back to utf8, its doubles keep their precision
+    Column columns[1] = {{"mixed", VALUE_TYPE_STRING}};
+    Value values[2] = {{.type = VALUE_TYPE_STRING, .string_value = "text"},
+                       {.type = VALUE_TYPE_DOUBLE, .double_value = -0.005}};
+    Row rows[2] = {{&values[0], 1}, {&values[1], 1}};
+    ResultSet mixed = {0};
+    mixed.columns = columns;
+    mixed.column_count = 1;
+    mixed.rows = rows;
+    mixed.row_count = 2;
+    assert(write_output_file(path, &mixed, FMT_ARROW, ','));
+    CsvTable* arrow = csv_load(path, config);
+    assert(arrow != NULL && arrow->row_count == 2);
+    assert(arrow->rows[1].values[0].type == VALUE_TYPE_STRING);
+    assert(strcmp(arrow->rows[1].values[0].string_value, "-0.005") == 0);
+    csv_free(arrow);
+
+    remove(path);
+    printf("✓ test_arrow_input passed\n\n");
+}
+
 int main(void) {
     printf("=== Output Formats Test ===\n\n");
     test_write_formats();
+    test_output_writer();
+    test_row_sinks();
+    test_parallel_formatting();
+    test_table_widths();
+    test_arrow_output();
+    test_arrow_input();
     printf("=== Output Formats tests passed ===\n");
     return 0;
 }
@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/time.h>
+#include "../include/csv_reader.h"
+#include "../include/date_utils.h"
+#include "../include/number_utils.h"
+
+/* microbenchmark of the cell parsers against strtoll / strtod / parse_date, every fast
+ * result is checked bit for bit against the libc one before it is timed */
+
+#define CELL_COUNT 500000
+#define CELL_WIDTH 32
+
+static double get_time_ms(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (tv.tv_sec * 1000.0) + (tv.tv_usec / 1000.0);
+}
+
+static char* cells;
+static size_t lengths[CELL_COUNT];
+
+static void fill_cells(int kind) {
+    srand(42);
+    for (int i = 0; i < CELL_COUNT; i++) {
+        char* cell = cells + (size_t)i * CELL_WIDTH;
+        switch (kind) {
+            case 0:     // integers of 1 to 19 digits
+                snprintf(cell, CELL_WIDTH, "%s%lld", rand() % 4 ? "" : "-",
+                         ((long long)rand() << 31 | rand()) % (1LL << (rand() % 62 + 1)));
+                break;
+            case 1:     // prices and measurements
+                snprintf(cell, CELL_WIDTH, "%d.%0*d", rand() % 100000, rand() % 6 + 1, rand() % 100000);
+                break;
+            default:
+                snprintf(cell, CELL_WIDTH, "%04d-%02d-%02d", 1900 + rand() % 200, rand() % 12 + 1, rand() % 28 + 1);
+                break;
+        }
+        lengths[i] = strlen(cell);
+    }
+}
+
+static void test_number_edge_cases() {
+    printf("Running test_number_edge_cases...\n");
+
+    const char* integers[] = {"0", "-0", "+7", "0012", "9223372036854775807", "-9223372036854775808",
+                              "9223372036854775808", "-9223372036854775809", "99999999999999999999",
+                              "12345678", "123456789012345678"};
+    for (size_t i = 0; i < sizeof(integers) / sizeof(integers[0]); i++) {
+        Value value;
+        assert(parse_number(integers[i], strlen(integers[i]), &value));
+        assert(value.type == VALUE_TYPE_INTEGER);
+        assert(value.int_value == strtoll(integers[i], NULL, 10));
+    }
+
+    const char* doubles[] = {"1.", ".5", "-.5", "-0.0", "3.14159", "0.1", "9007199254740993.0",
+                             "123456789.123456789", "0.0000000000000000000000001", "1234567890123.25"};
+    for (size_t i = 0; i < sizeof(doubles) / sizeof(doubles[0]); i++) {
+        Value value;
+        assert(parse_number(doubles[i], strlen(doubles[i]), &value));
+        assert(value.type == VALUE_TYPE_DOUBLE);
+        double expected = strtod(doubles[i], NULL);
+        assert(memcmp(&value.double_value, &expected, sizeof(double)) == 0);
+    }
+
+    const char* invalid[] = {"", "+", "-", ".", "1.2.3", "1 2", " 1", "1e5", "12a45678", "0x10"};
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        Value value;
+        assert(!parse_number(invalid[i], strlen(invalid[i]), &value));
+    }
+
+    DateValue date;
+    assert(parse_date_iso("2024-02-29", 10, &date));
+    assert(date.year == 2024 && date.month == 2 && date.day == 29);
+    assert(!parse_date_iso("2023-02-29", 10, &date));
+    assert(!parse_date_iso("2024-1-05", 9, &date));
+    assert(!parse_date_iso("2024/01/05", 10, &date));
+    assert(parse_date("2024-1-5", &date) && date.month == 1 && date.day == 5);
+
+    printf("✓ test_number_edge_cases passed\n\n");
+}
+
+static void bench_integers() {
+    fill_cells(0);
+    // unsigned, since the sums of 500k 62 bit values wrap
+    unsigned long long slow_sum = 0;
+    unsigned long long fast_sum = 0;
+
+    double start = get_time_ms();
+    for (int i = 0; i < CELL_COUNT; i++) slow_sum += (unsigned long long)strtoll(cells + (size_t)i * CELL_WIDTH, NULL, 10);
+    double slow_ms = get_time_ms() - start;
+
+    start = get_time_ms();
+    for (int i = 0; i < CELL_COUNT; i++) {
+        Value value;
+        parse_number(cells + (size_t)i * CELL_WIDTH, lengths[i], &value);
+        fast_sum += (unsigned long long)value.int_value;
+    }
+    double fast_ms = get_time_ms() - start;
+
+    assert(slow_sum == fast_sum);
+    printf("  integers:  strtoll %8.2f ms   parse_number   %8.2f ms   %.1fx\n",
+           slow_ms, fast_ms, fast_ms > 0 ? slow_ms / fast_ms : 0);
+}
+
+static void bench_doubles() {
+    fill_cells(1);
+    for (int i = 0; i < CELL_COUNT; i++) {
+        const char* cell = cells + (size_t)i * CELL_WIDTH;
+        Value value;
+        assert(parse_number(cell, lengths[i], &value) && value.type == VALUE_TYPE_DOUBLE);
+        double expected = strtod(cell, NULL);
+        assert(memcmp(&value.double_value, &expected, sizeof(double)) == 0);
+    }
+
+    double slow_sum = 0;
+    double fast_sum = 0;
+    double start = get_time_ms();
+    for (int i = 0; i < CELL_COUNT; i++) slow_sum += strtod(cells + (size_t)i * CELL_WIDTH, NULL);
+    double slow_ms = get_time_ms() - start;
+
+    start = get_time_ms();
+    for (int i = 0; i < CELL_COUNT; i++) {
+        Value value;
+        parse_number(cells + (size_t)i * CELL_WIDTH, lengths[i], &value);
+        fast_sum += value.double_value;
+    }
+    double fast_ms = get_time_ms() - start;
+
+    assert(slow_sum == fast_sum);
+    printf("  doubles:   strtod  %8.2f ms   parse_number   %8.2f ms   %.1fx\n",
+           slow_ms, fast_ms, fast_ms > 0 ? slow_ms / fast_ms : 0);
+}
+
+static void bench_dates() {
+    fill_cells(2);
+    long slow_sum = 0;
+    long fast_sum = 0;
+
+    double start = get_time_ms();
+    for (int i = 0; i < CELL_COUNT; i++) {
+        DateValue date;
+        // the old DATE path: sscanf based formats tried in turn
+        if (parse_date_format(cells + (size_t)i * CELL_WIDTH, &date, DATE_FORMAT_ISO)) slow_sum += date_key(date);
+    }
+    double slow_ms = get_time_ms() - start;
+
+    start = get_time_ms();
+    for (int i = 0; i < CELL_COUNT; i++) {
+        DateValue date;
+        if (parse_date_iso(cells + (size_t)i * CELL_WIDTH, lengths[i], &date)) fast_sum += date_key(date);
+    }
+    double fast_ms = get_time_ms() - start;
+
+    assert(slow_sum == fast_sum);
+    printf("  dates:     sscanf  %8.2f ms   parse_date_iso %8.2f ms   %.1fx\n",
+           slow_ms, fast_ms, fast_ms > 0 ? slow_ms / fast_ms : 0);
+}
+
+int main(void) {
+    printf("=== Cell Parser Performance Test ===\n\n");
+
+    test_number_edge_cases();
+
+    cells = malloc((size_t)CELL_COUNT * CELL_WIDTH);
+    printf("Parsing %d cells of each kind:\n", CELL_COUNT);
+    bench_integers();
+    bench_doubles();
+    bench_dates();
+    free(cells);
+
+    printf("\n=== Test completed successfully ===\n");
+    return 0;
+}
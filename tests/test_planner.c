@@ -0,0 +1,355 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "parser.h"
+#include "evaluator.h"
+#include "csv_reader.h"
+#include "evaluator/evaluator_plan.h"
+#include "evaluator/evaluator_stats.h"
+#include "evaluator/evaluator_hash.h"
+
+static void write_planner_data(void) {
+    FILE* f = fopen("test_plan_people.csv", "w");
+    fprintf(f, "id,name,age,city\n");
+    fprintf(f, "1,ann,25,oslo\n");
+    fprintf(f, "2,bob,35,rome\n");
+    fprintf(f, "3,cid,45,oslo\n");
+    fprintf(f, "4,dan,55,rome\n");
+    fprintf(f, "5,eve,65,oslo\n");
+    fclose(f);
+
+    f = fopen("test_plan_orders.csv", "w");
+    fprintf(f, "oid,pid,amount\n");
+    fprintf(f, "10,1,100\n");
+    fprintf(f, "11,2,200\n");
+    fprintf(f, "12,2,300\n");
+    fprintf(f, "13,4,400\n");
+    fprintf(f, "14,9,500\n");
+    fclose(f);
+
+    f = fopen("test_plan_cities.csv", "w");
+    fprintf(f, "cname,country\n");
+    fprintf(f, "oslo,no\n");
+    fprintf(f, "rome,it\n");
+    fclose(f);
+}
+
+static void remove_planner_data(void) {
+    remove("test_plan_people.csv");
+    remove("test_plan_orders.csv");
+    remove("test_plan_cities.csv");
+}
+
+static ResultSet* run(const char* query, ASTNode** ast) {
+    *ast = parse(query);
+    assert(*ast != NULL);
+    ResultSet* result = evaluate_query(*ast);
+    assert(result != NULL);
+    return result;
+}
+
+static QueryPlan* optimized_plan(const char* query, ASTNode** ast) {
+    *ast = parse(query);
+    assert(*ast != NULL);
+    QueryPlan* plan = plan_build(*ast);
+    assert(plan != NULL);
+    plan_optimize(plan);
+    return plan;
+}
+
+static PlanNode* scan_with_alias(PlanNode* root, const char* alias) {
+    PlanNode* node = root;
+    while (node && node->type != PLAN_JOIN && node->type != PLAN_SCAN) node = node->input;
+    for (; node; node = node->input) {
+        PlanNode* scan = node->type == PLAN_JOIN ? node->right : node;
+        if (strcmp(scan->alias, alias) == 0) return scan;
+        if (node->type == PLAN_SCAN) break;
+    }
+    return NULL;
+}
+
+void test_predicate_pushdown() {
+    printf("Test: predicates over one joined table move to its scan...\n");
+
+    const char* query = "SELECT p.name, o.amount FROM 'test_plan_people.csv' p "
+                        "JOIN 'test_plan_orders.csv' o ON p.id = o.pid "
+                        "WHERE o.amount > 150 AND p.age < 50";
+    ASTNode* ast;
+    QueryPlan* plan = optimized_plan(query, &ast);
+
+    // both conjuncts were pushed, no filter remains above the join
+    assert(plan_find_node(plan->root, PLAN_FILTER) == NULL);
+    assert(scan_with_alias(plan->root, "o")->predicate_count == 1);
+    assert(scan_with_alias(plan->root, "p")->predicate_count == 1);
+    plan_free(plan);
+    releaseNode(ast);
+
+    ResultSet* result = run(query, &ast);
+    assert(result->row_count == 2);
+    assert(strcmp(result->rows[0].values[0].string_value, "bob") == 0);
+    assert(result->rows[0].values[1].int_value == 200);
+    assert(result->rows[1].values[1].int_value == 300);
+
+    csv_free(result);
+    releaseNode(ast);
+    printf("  PASSED\n\n");
+}
+
+void test_outer_join_keeps_filter() {
+    printf("Test: predicate on the null extended side of a LEFT JOIN is not pushed...\n");
+
+    const char* query = "SELECT p.id, o.amount FROM 'test_plan_people.csv' p "
+                        "LEFT JOIN 'test_plan_orders.csv' o ON p.id = o.pid "
+                        "WHERE o.amount > 150 AND p.age > 30";
+    ASTNode* ast;
+    QueryPlan* plan = optimized_plan(query, &ast);
+
+    PlanNode* filter = plan_find_node(plan->root, PLAN_FILTER);
+    assert(filter != NULL && filter->predicate_count == 1);
+    assert(scan_with_alias(plan->root, "o")->predicate_count == 0);
+    assert(scan_with_alias(plan->root, "p")->predicate_count == 1);
+    plan_free(plan);
+    releaseNode(ast);
+
+    ResultSet* result = run(query, &ast);
+    assert(result->row_count == 3);
+    assert(result->rows[0].values[0].int_value == 2);
+    assert(result->rows[2].values[0].int_value == 4);
+
+    csv_free(result);
+    releaseNode(ast);
+    printf("  PASSED\n\n");
+}
+
+void test_constant_folding() {
+    printf("Test: constant expressions in WHERE are folded...\n");
+
+    ASTNode* ast;
+    QueryPlan* plan = optimized_plan("SELECT id FROM 'test_plan_people.csv' WHERE age > 10 + 20 AND 2 > 1", &ast);
+
+    // the always true conjunct is gone, the sum became a literal
+    PlanNode* filter = plan_find_node(plan->root, PLAN_FILTER);
+    assert(filter != NULL && filter->predicate_count == 1);
+    ASTNode* right = filter->predicates[0]->condition.right;
+    assert(right->type == NODE_TYPE_LITERAL && strcmp(right->literal, "30") == 0);
+    plan_free(plan);
+    releaseNode(ast);
+
+    ResultSet* result = run("SELECT id FROM 'test_plan_people.csv' WHERE age > 10 + 20 AND 2 > 1", &ast);
+    assert(result->row_count == 4);
+    csv_free(result);
+    releaseNode(ast);
+
+    plan = optimized_plan("SELECT id FROM 'test_plan_people.csv' WHERE 1 = 0", &ast);
+    assert(plan_find_node(plan->root, PLAN_FILTER)->always_false);
+    plan_free(plan);
+    releaseNode(ast);
+
+    result = run("SELECT id FROM 'test_plan_people.csv' WHERE 1 = 0", &ast);
+    assert(result->row_count == 0);
+    assert(result->column_count == 1);
+    csv_free(result);
+    releaseNode(ast);
+    printf("  PASSED\n\n");
+}
+
+void test_limit_pushdown() {
+    printf("Test: LIMIT without ORDER BY stops filtering early...\n");
+
+    const char* query = "SELECT id FROM 'test_plan_people.csv' WHERE age > 30 LIMIT 2 OFFSET 1";
+    ASTNode* ast;
+    QueryPlan* plan = optimized_plan(query, &ast);
+    assert(plan_find_node(plan->root, PLAN_FILTER)->row_limit == 3);
+    assert(plan_find_node(plan->root, PLAN_PROJECT)->row_limit == 3);
+    plan_free(plan);
+    releaseNode(ast);
+
+    ResultSet* result = run(query, &ast);
+    assert(result->row_count == 2);
+    assert(result->rows[0].values[0].int_value == 3);
+    assert(result->rows[1].values[0].int_value == 4);
+    csv_free(result);
+    releaseNode(ast);
+
+    // a sort needs every row
+    plan = optimized_plan("SELECT id FROM 'test_plan_people.csv' ORDER BY age DESC LIMIT 2", &ast);
+    assert(plan_find_node(plan->root, PLAN_PROJECT)->row_limit == -1);
+    plan_free(plan);
+    releaseNode(ast);
+    printf("  PASSED\n\n");
+}
+
+void test_three_way_join_reordered() {
+    printf("Test: three way join with qualified WHERE and reordering...\n");
+
+    const char* query = "SELECT p.id, o.amount, c.country FROM 'test_plan_people.csv' p "
+                        "JOIN 'test_plan_orders.csv' o ON p.id = o.pid "
+                        "JOIN 'test_plan_cities.csv' c ON p.city = c.cname "
+                        "WHERE c.country = 'it' ORDER BY o.amount";
+    ASTNode* ast;
+    QueryPlan* plan = optimized_plan(query, &ast);
+
+    // the filtered cities table is joined first, unused columns are pruned
+    PlanNode* top_join = plan_find_node(plan->root, PLAN_JOIN);
+    assert(top_join != NULL);
+    assert(strcmp(top_join->right->alias, "o") == 0);
+    assert(strcmp(top_join->input->right->alias, "c") == 0);
+    assert(scan_with_alias(plan->root, "p")->referenced_columns != NULL);
+    plan_free(plan);
+    releaseNode(ast);
+
+    ResultSet* result = run(query, &ast);
+    assert(result->row_count == 3);
+    assert(result->rows[0].values[0].int_value == 2);
+    assert(result->rows[0].values[1].int_value == 200);
+    assert(result->rows[2].values[0].int_value == 4);
+    assert(strcmp(result->rows[2].values[2].string_value, "it") == 0);
+    csv_free(result);
+    releaseNode(ast);
+
+    // without pruning the joined columns keep FROM + JOIN order and one prefix
+    result = run("SELECT * FROM 'test_plan_people.csv' p "
+                 "JOIN 'test_plan_orders.csv' o ON p.id = o.pid "
+                 "JOIN 'test_plan_cities.csv' c ON p.city = c.cname", &ast);
+    assert(result->row_count == 4);
+    assert(result->column_count == 9);
+    assert(strcmp(result->columns[0].name, "p.id") == 0);
+    assert(strcmp(result->columns[4].name, "o.oid") == 0);
+    assert(strcmp(result->columns[8].name, "c.country") == 0);
+    csv_free(result);
+    releaseNode(ast);
+    printf("  PASSED\n\n");
+}
+
+void test_explain() {
+    printf("Test: EXPLAIN and EXPLAIN ANALYZE describe the plan...\n");
+
+    ASTNode* ast;
+    ResultSet* result = run("EXPLAIN SELECT p.name FROM 'test_plan_people.csv' p "
+                            "JOIN 'test_plan_orders.csv' o ON p.id = o.pid "
+                            "WHERE o.amount > 150 LIMIT 2", &ast);
+    assert(ast->type == NODE_TYPE_EXPLAIN && !ast->explain.analyze);
+    assert(result->column_count == 1);
+    assert(result->row_count == 5);
+    assert(strcmp(result->rows[0].values[0].string_value, "Limit 2") == 0);
+    assert(strstr(result->rows[2].values[0].string_value, "-> Join INNER hash ON p.id = o.pid") != NULL);
+    assert(strstr(result->rows[4].values[0].string_value, "Scan 'test_plan_orders.csv' AS o, filter: o.amount > 150") != NULL);
+    assert(strstr(result->rows[0].values[0].string_value, "time=") == NULL);
+    csv_free(result);
+    releaseNode(ast);
+
+    // a star is not counted as one column
+    result = run("EXPLAIN SELECT * FROM 'test_plan_people.csv'", &ast);
+    assert(strcmp(result->rows[0].values[0].string_value, "Project *") == 0);
+    csv_free(result);
+    releaseNode(ast);
+
+    result = run("EXPLAIN ANALYZE SELECT city, COUNT(*) FROM 'test_plan_people.csv' "
+                 "WHERE age > 30 GROUP BY city", &ast);
+    assert(ast->explain.analyze);
+    assert(result->row_count == 4);
+    assert(strstr(result->rows[0].values[0].string_value, "Aggregate GROUP BY city") != NULL);
+    assert(strstr(result->rows[0].values[0].string_value, "rows in=4 out=2") != NULL);
+    assert(strstr(result->rows[1].values[0].string_value, "rows in=5 out=4") != NULL);
+    assert(strstr(result->rows[2].values[0].string_value, "read=") != NULL);
+    assert(strncmp(result->rows[3].values[0].string_value, "Execution time:", 15) == 0);
+    csv_free(result);
+    releaseNode(ast);
+    printf("  PASSED\n\n");
+}
+
+void test_table_statistics() {
+    printf("Test: HyperLogLog distinct estimates and min / max...\n");
+
+    HyperLogLog hll;
+    hll_init(&hll);
+    for (int i = 0; i < 20000; i++) {
+        Value value = {.type = VALUE_TYPE_INTEGER, .int_value = i % 5000};
+        hll_add(&hll, value_hash(&value));
+    }
+    double estimate = hll_estimate(&hll);
+    assert(estimate > 4500 && estimate < 5500);
+
+    CsvTable* table = csv_load("test_plan_people.csv", csv_config_default());
+    assert(table != NULL);
+    TableStats* stats = table_stats_collect(table, NULL);
+    assert(stats->row_count == 5);
+    ColumnStats* age = &stats->columns[csv_get_column_index(table, "age")];
+    assert(age->has_range && age->min.int_value == 25 && age->max.int_value == 65);
+    ColumnStats* city = &stats->columns[csv_get_column_index(table, "city")];
+    assert(city->distinct > 1.5 && city->distinct < 2.5);
+    assert(strcmp(city->min.string_value, "oslo") == 0);
+    table_stats_free(stats);
+    csv_free(table);
+    printf("  PASSED\n\n");
+}
+
+void test_cost_based_join_order() {
+    printf("Test: join order chosen from statistics...\n");
+
+    // a fact table of 1000 rows against a key-unique dimension and a disjoint one
+    ColumnStats fact_key = {.distinct = 100};
+    ColumnStats dim_key = {.distinct = 100};
+    ColumnStats low_key = {.distinct = 10, .has_range = true,
+                           .min = {.type = VALUE_TYPE_INTEGER, .int_value = 0},
+                           .max = {.type = VALUE_TYPE_INTEGER, .int_value = 9}};
+    ColumnStats high_key = {.distinct = 10, .has_range = true,
+                            .min = {.type = VALUE_TYPE_INTEGER, .int_value = 100},
+                            .max = {.type = VALUE_TYPE_INTEGER, .int_value = 109}};
+    JoinCandidate joins[2] = {
+        {.left_relation = 0, .left_key = &fact_key, .right_key = &dim_key, .right_rows = 100},
+        {.left_relation = 0, .left_key = &low_key, .right_key = &high_key, .right_rows = 10},
+    };
+    int order[2];
+    double rows[2];
+    assert(join_order_choose(1000, joins, 2, order, rows));
+    assert(order[0] == 1 && order[1] == 0);
+    assert(rows[0] == 0);
+
+    // a join can only follow the join that provides its left key
+    joins[1].left_relation = 1;
+    assert(join_order_choose(1000, joins, 2, order, rows));
+    assert(order[0] == 0 && order[1] == 1);
+    assert(rows[0] > 999 && rows[0] < 1001);
+
+    ASTNode* ast;
+    const char* query = "SELECT COUNT(*) FROM 'test_plan_orders.csv' o "
+                        "JOIN 'test_plan_people.csv' p ON o.pid = p.id "
+                        "JOIN 'test_plan_cities.csv' c ON p.city = c.cname";
+    ResultSet* result = run(query, &ast);
+    assert(result->row_count == 1);
+    assert(result->rows[0].values[0].int_value == 4);
+    csv_free(result);
+    releaseNode(ast);
+
+    char explain[512];
+    snprintf(explain, sizeof(explain), "EXPLAIN ANALYZE %s", query);
+    result = run(explain, &ast);
+    assert(strstr(result->rows[1].values[0].string_value, "Join INNER hash") != NULL);
+    assert(strstr(result->rows[1].values[0].string_value, "order from table statistics") != NULL);
+    assert(strstr(result->rows[1].values[0].string_value, "out=4") != NULL);
+    csv_free(result);
+    releaseNode(ast);
+    printf("  PASSED\n\n");
+}
+
+int main() {
+    printf("=== Planner Tests ===\n\n");
+
+    write_planner_data();
+
+    test_predicate_pushdown();
+    test_outer_join_keeps_filter();
+    test_constant_folding();
+    test_limit_pushdown();
+    test_three_way_join_reordered();
+    test_explain();
+    test_table_statistics();
+    test_cost_based_join_order();
+
+    remove_planner_data();
+
+    printf("=== All planner tests passed! ===\n");
+    return 0;
+}
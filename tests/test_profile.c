@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "parser.h"
+#include "evaluator.h"
+#include "csv_reader.h"
+#include "profile.h"
+
+static void write_profile_data(void) {
+    FILE* f = fopen("test_profile_data.csv", "w");
+    fprintf(f, "id,name,score\n");
+    fprintf(f, "1,ann,1.5\n");
+    fprintf(f, "2,bob,2.5\n");
+    fprintf(f, "3,ann,3.5\n");
+    fprintf(f, "4,cid,\n");
+    fclose(f);
+}
+
+static void run_query(const char* query) {
+    ASTNode* ast = parse(query);
+    assert(ast != NULL);
+    ResultSet* result = evaluate_query(ast);
+    assert(result != NULL);
+    csv_free(result);
+    releaseNode(ast);
+}
+
+static char* read_file(const char* filename) {
+    FILE* f = fopen(filename, "r");
+    assert(f != NULL);
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char* data = malloc(size + 1);
+    size_t read = fread(data, 1, size, f);
+    data[read] = '\0';
+    fclose(f);
+    return data;
+}
+
+void test_counters_disabled() {
+    printf("Test: counters stay at zero unless profiling is enabled...\n");
+
+    profile_reset();
+    run_query("SELECT DISTINCT name FROM 'test_profile_data.csv'");
+    assert(profile_counters.csv_rows == 0);
+    assert(profile_counters.expressions == 0);
+    assert(profile_counters.hash_probes == 0);
+
+    printf("  PASSED\n\n");
+}
+
+void test_counters() {
+    printf("Test: profiling counts rows, parsed values, copies and probes...\n");
+
+    profile_begin(false);
+    run_query("SELECT DISTINCT name FROM 'test_profile_data.csv' WHERE id > 1");
+
+    assert(profile_counters.csv_files == 1);
+    assert(profile_counters.csv_rows == 4);
+    assert(profile_counters.csv_bytes > 0);
+    assert(profile_counters.parse_values[VALUE_TYPE_INTEGER] >= 4);
+    assert(profile_counters.parse_values[VALUE_TYPE_DOUBLE] == 3);
+    assert(profile_counters.parse_values[VALUE_TYPE_STRING] >= 4);
+    assert(profile_counters.expressions > 0);
+    assert(profile_counters.deep_copies > 0);
+    assert(profile_counters.hash_probes >= 3);
+    assert(profile_counters.allocations > 0);
+    assert(profile_counters.allocated_bytes >= profile_counters.allocations);
+
+    profile_reset();
+    assert(!profile_counters.enabled);
+    assert(profile_counters.csv_rows == 0);
+    printf("  PASSED\n\n");
+}
+
+void test_trace_output() {
+    printf("Test: --trace writes Chrome trace events for loads and operators...\n");
+
+    profile_begin(true);
+    double start = profile_clock_ms();
+    run_query("SELECT name, COUNT(*) FROM 'test_profile_data.csv' GROUP BY name");
+    profile_span("phase", "evaluate", NULL, start, profile_clock_ms());
+    assert(profile_write_trace("test_profile_trace.json"));
+    profile_reset();
+
+    char* trace = read_file("test_profile_trace.json");
+    assert(strncmp(trace, "{\"traceEvents\":[", 16) == 0);
+    assert(strstr(trace, "\"name\":\"csv_load\"") != NULL);
+    assert(strstr(trace, "\"detail\":\"test_profile_data.csv\"") != NULL);
+    assert(strstr(trace, "\"name\":\"Scan\"") != NULL);
+    assert(strstr(trace, "\"name\":\"Aggregate\"") != NULL);
+    assert(strstr(trace, "\"name\":\"evaluate\",\"cat\":\"phase\",\"ph\":\"X\"") != NULL);
+    free(trace);
+    remove("test_profile_trace.json");
+
+    printf("  PASSED\n\n");
+}
+
+int main() {
+    printf("=== Profile Tests ===\n\n");
+
+    write_profile_data();
+
+    test_counters_disabled();
+    test_counters();
+    test_trace_output();
+
+    remove("test_profile_data.csv");
+
+    printf("=== All profile tests passed! ===\n");
+    return 0;
+}
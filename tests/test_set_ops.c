@@ -5,6 +5,7 @@
 #include "parser.h"
 #include "evaluator.h"
 #include "csv_reader.h"
+#include "evaluator/evaluator_utils.h"
 
 void test_union() {
     printf("Test: UNION...\n");
@@ -265,6 +266,94 @@ void test_intersect_no_common() {
     printf("  PASSED\n\n");
 }
 
+void test_union_removes_all_duplicates() {
+    printf("Test: UNION removes duplicates from both sides...\n");
+    
+    FILE* f1 = fopen("test_union_dup_a.csv", "w");
+    fprintf(f1, "val\n1\n1\n2\n");
+    fclose(f1);
+    
+    FILE* f2 = fopen("test_union_dup_b.csv", "w");
+    fprintf(f2, "val\n2.0\n3\n3\n");
+    fclose(f2);
+    
+    const char* query = "SELECT * FROM test_union_dup_a.csv UNION SELECT * FROM test_union_dup_b.csv";
+    ASTNode* ast = parse(query);
+    assert(ast != NULL);
+    
+    ResultSet* result = evaluate_query(ast);
+    assert(result != NULL);
+    assert(result->row_count == 3); // 1, 2, 3 (2 and 2.0 are equal)
+    printf("  UNION result: %d unique rows\n", result->row_count);
+    
+    csv_free(result);
+    releaseNode(ast);
+    
+    // EXCEPT also returns distinct rows
+    query = "SELECT * FROM test_union_dup_a.csv EXCEPT SELECT * FROM test_union_dup_b.csv";
+    ast = parse(query);
+    assert(ast != NULL);
+    
+    result = evaluate_query(ast);
+    assert(result != NULL);
+    assert(result->row_count == 1); // 1
+    assert(result->rows[0].values[0].int_value == 1);
+    printf("  EXCEPT result: %d rows\n", result->row_count);
+    
+    csv_free(result);
+    releaseNode(ast);
+    
+    remove("test_union_dup_a.csv");
+    remove("test_union_dup_b.csv");
+    printf("  PASSED\n\n");
+}
+
+void test_set_ops_move_rows() {
+    printf("Test: set operations and subquery tables take over their input rows...\n");
+    
+    FILE* f1 = fopen("test_set_move.csv", "w");
+    fprintf(f1, "id,name\n");
+    fprintf(f1, "1,Alice\n");
+    fprintf(f1, "2,Bob\n");
+    fprintf(f1, "2,Bob\n");
+    fclose(f1);
+    
+    ASTNode* ast = parse("SELECT * FROM test_set_move.csv");
+    ResultSet* left = evaluate_query(ast);
+    ResultSet* right = evaluate_query(ast);
+    assert(left && right && left->row_count == 3);
+    
+    // the kept rows are moved, not copied
+    const char* alice = left->rows[0].values[1].string_value;
+    ResultSet* result = set_union(left, right, false);
+    assert(result->row_count == 2);
+    assert(result->rows[0].values[1].string_value == alice);
+    assert(left->row_count == 0 && right->row_count == 0);
+    csv_free(left);
+    csv_free(right);
+    
+    CsvTable* table = result_to_csv_table(result);
+    assert(table->row_count == 2 && result->row_count == 0);
+    assert(table->rows[0].values[1].string_value == alice);
+    assert(table->arena != NULL);
+    csv_free(result);
+    csv_free(table);
+    releaseNode(ast);
+    
+    // a subquery table is joined like a scanned file
+    ast = parse("SELECT s.name, t.id FROM (SELECT id, name FROM test_set_move.csv WHERE id = 2) s "
+                "JOIN test_set_move.csv t ON s.id = t.id");
+    result = evaluate_query(ast);
+    assert(result != NULL);
+    assert(result->row_count == 4);
+    assert(strcmp(result->rows[0].values[0].string_value, "Bob") == 0);
+    csv_free(result);
+    releaseNode(ast);
+    
+    remove("test_set_move.csv");
+    printf("  PASSED\n\n");
+}
+
 int main() {
     printf("=== Set Operations Tests (UNION, INTERSECT, EXCEPT) ===\n\n");
     
@@ -276,6 +365,8 @@ int main() {
     test_multiple_unions();
     test_union_different_columns();
     test_intersect_no_common();
+    test_union_removes_all_duplicates();
+    test_set_ops_move_rows();
     
     printf("=== All set operation tests passed! ===\n");
     return 0;
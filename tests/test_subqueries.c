@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "parser.h"
+#include "evaluator.h"
+#include "csv_reader.h"
+
+static void write_subquery_data(void) {
+    FILE* f = fopen("test_subq_outer.csv", "w");
+    fprintf(f, "id,grp,a,b,flag\n");
+    fprintf(f, "1,x,10,20,1\n");
+    fprintf(f, "2,x,10,30,0\n");
+    fprintf(f, "3,y,10,20,0\n");
+    fprintf(f, "4,x,10,20,1\n");
+    fprintf(f, "5,y,11,40,0\n");
+    fclose(f);
+
+    f = fopen("test_subq_inner.csv", "w");
+    fprintf(f, "k,v\n");
+    fprintf(f, "1,x\n");
+    fprintf(f, "2,x\n");
+    fprintf(f, "3,y\n");
+    fclose(f);
+
+    f = fopen("test_subq_one.csv", "w");
+    fprintf(f, "one\n");
+    fprintf(f, "1\n");
+    fclose(f);
+}
+
+static void remove_subquery_data(void) {
+    remove("test_subq_outer.csv");
+    remove("test_subq_inner.csv");
+    remove("test_subq_one.csv");
+}
+
+static ResultSet* run(const char* query, ASTNode** ast) {
+    *ast = parse(query);
+    assert(*ast != NULL);
+    ResultSet* result = evaluate_query(*ast);
+    assert(result != NULL);
+    return result;
+}
+
+void test_uncorrelated_scalar_in_select() {
+    printf("Test: uncorrelated scalar subquery in SELECT...\n");
+
+    ASTNode* ast;
+    ResultSet* result = run("SELECT id, (SELECT MAX(b) FROM 'test_subq_outer.csv') AS m "
+                            "FROM 'test_subq_outer.csv'", &ast);
+    assert(result->row_count == 5);
+    for (int i = 0; i < result->row_count; i++) {
+        assert(result->rows[i].values[1].type == VALUE_TYPE_INTEGER);
+        assert(result->rows[i].values[1].int_value == 40);
+    }
+
+    csv_free(result);
+    releaseNode(ast);
+    printf("  PASSED\n\n");
+}
+
+void test_uncorrelated_scalar_in_where() {
+    printf("Test: uncorrelated scalar subquery in WHERE...\n");
+
+    // AVG(b) = 26
+    ASTNode* ast;
+    ResultSet* result = run("SELECT id FROM 'test_subq_outer.csv' "
+                            "WHERE b > (SELECT AVG(b) FROM 'test_subq_outer.csv')", &ast);
+    assert(result->row_count == 2);
+    assert(result->rows[0].values[0].int_value == 2);
+    assert(result->rows[1].values[0].int_value == 5);
+
+    csv_free(result);
+    releaseNode(ast);
+    printf("  PASSED\n\n");
+}
+
+void test_correlated_repeated_keys() {
+    printf("Test: correlated subquery with repeated outer keys...\n");
+
+    ASTNode* ast;
+    ResultSet* result = run("SELECT id, (SELECT COUNT(*) FROM 'test_subq_inner.csv' i WHERE i.v = o.grp) AS n "
+                            "FROM 'test_subq_outer.csv' o", &ast);
+    assert(result->row_count == 5);
+
+    long long expected[] = {2, 2, 1, 2, 1};
+    for (int i = 0; i < 5; i++) {
+        assert(result->rows[i].values[1].int_value == expected[i]);
+    }
+
+    csv_free(result);
+    releaseNode(ast);
+    printf("  PASSED\n\n");
+}
+
+void test_correlated_in_where() {
+    printf("Test: correlated subquery in WHERE...\n");
+
+    ASTNode* ast;
+    ResultSet* result = run("SELECT id FROM 'test_subq_outer.csv' "
+                            "WHERE a < (SELECT COUNT(*) FROM 'test_subq_inner.csv' WHERE v = grp) * 10", &ast);
+    assert(result->row_count == 3);
+    assert(result->rows[0].values[0].int_value == 1);
+    assert(result->rows[1].values[0].int_value == 2);
+    assert(result->rows[2].values[0].int_value == 4);
+
+    csv_free(result);
+    releaseNode(ast);
+    printf("  PASSED\n\n");
+}
+
+void test_correlated_columns_depend_on_branch() {
+    printf("Test: correlated subquery reading different outer columns per row...\n");
+
+    // rows with flag = 1 only read a, the others only read b, the memo key
+    // must still distinguish rows that agree on flag and a but not on b
+    ASTNode* ast;
+    ResultSet* result = run("SELECT id, (SELECT CASE WHEN flag = 1 THEN a ELSE b END FROM 'test_subq_one.csv') AS pick "
+                            "FROM 'test_subq_outer.csv'", &ast);
+    assert(result->row_count == 5);
+
+    long long expected[] = {10, 30, 20, 10, 40};
+    for (int i = 0; i < 5; i++) {
+        assert(result->rows[i].values[1].int_value == expected[i]);
+    }
+
+    csv_free(result);
+    releaseNode(ast);
+    printf("  PASSED\n\n");
+}
+
+void test_decorrelated_aggregate_per_key() {
+    printf("Test: correlated aggregate over many keys...\n");
+
+    // 2000 customers, orders only for even ids, amount = id % 7 + 1 and id % 7 + 2
+    FILE* f = fopen("test_subq_customers.csv", "w");
+    fprintf(f, "id,name\n");
+    for (int i = 0; i < 2000; i++) {
+        fprintf(f, "%d,c%d\n", i, i);
+    }
+    fclose(f);
+
+    f = fopen("test_subq_orders.csv", "w");
+    fprintf(f, "oid,customer_id,amount,status\n");
+    for (int i = 0; i < 2000; i += 2) {
+        fprintf(f, "%d,%d,%d,open\n", 2 * i, i, i % 7 + 1);
+        fprintf(f, "%d,%d,%d,closed\n", 2 * i + 1, i, i % 7 + 2);
+    }
+    fclose(f);
+
+    ASTNode* ast;
+    ResultSet* result = run("SELECT id, "
+                            "(SELECT COUNT(*) FROM 'test_subq_orders.csv' o WHERE o.customer_id = c.id) AS n, "
+                            "(SELECT MAX(amount) FROM 'test_subq_orders.csv' o "
+                            "WHERE c.id = o.customer_id AND o.status = 'open') AS top "
+                            "FROM 'test_subq_customers.csv' c", &ast);
+    assert(result->row_count == 2000);
+
+    for (int i = 0; i < 2000; i++) {
+        Value* n = &result->rows[i].values[1];
+        Value* top = &result->rows[i].values[2];
+        if (i % 2 == 0) {
+            assert(n->int_value == 2);
+            double top_value = top->type == VALUE_TYPE_DOUBLE ? top->double_value : (double)top->int_value;
+            assert(top_value == i % 7 + 1);
+        } else {
+            // customers without orders get the aggregate over no rows
+            assert(n->int_value == 0);
+            assert(top->type == VALUE_TYPE_NULL);
+        }
+    }
+
+    csv_free(result);
+    releaseNode(ast);
+
+    remove("test_subq_customers.csv");
+    remove("test_subq_orders.csv");
+    printf("  PASSED\n\n");
+}
+
+void test_correlated_in_subquery() {
+    printf("Test: correlated IN and NOT IN subqueries...\n");
+
+    // 20 facts with k1 = i % 7 and k2 = i % 5, 6 dimension rows with k2 = i % 4
+    FILE* f = fopen("test_subq_facts.csv", "w");
+    fprintf(f, "k1,k2,v\n");
+    for (int i = 0; i < 20; i++) {
+        fprintf(f, "%d,%d,%d\n", i % 7, i % 5, i);
+    }
+    fclose(f);
+
+    f = fopen("test_subq_dims.csv", "w");
+    fprintf(f, "k2,w\n");
+    for (int i = 0; i < 6; i++) {
+        fprintf(f, "%d,%d\n", i % 4, i);
+    }
+    fclose(f);
+
+    // row counts as sqlite returns them: a semi join, an anti join, a correlation that is not
+    // an equality and an uncorrelated subquery
+    const char* queries[] = {
+        "SELECT k1 FROM 'test_subq_facts.csv' f WHERE k2 IN "
+        "(SELECT k2 FROM 'test_subq_dims.csv' d WHERE d.k2 = f.k1)",
+        "SELECT k1 FROM 'test_subq_facts.csv' f WHERE k2 NOT IN "
+        "(SELECT k2 FROM 'test_subq_dims.csv' d WHERE d.k2 = f.k1)",
+        "SELECT k1 FROM 'test_subq_facts.csv' f WHERE k2 IN "
+        "(SELECT k2 FROM 'test_subq_dims.csv' d WHERE d.k2 < f.k1)",
+        "SELECT k1 FROM 'test_subq_facts.csv' f WHERE k2 IN "
+        "(SELECT k2 FROM 'test_subq_dims.csv' d WHERE w > 2)",
+    };
+    int expected[] = {4, 16, 10, 12};
+    for (int q = 0; q < 4; q++) {
+        ASTNode* ast;
+        ResultSet* result = run(queries[q], &ast);
+        assert(result->row_count == expected[q]);
+        csv_free(result);
+        releaseNode(ast);
+    }
+
+    remove("test_subq_facts.csv");
+    remove("test_subq_dims.csv");
+    printf("  PASSED\n\n");
+}
+
+int main() {
+    printf("=== Subquery Tests ===\n\n");
+
+    write_subquery_data();
+
+    test_uncorrelated_scalar_in_select();
+    test_uncorrelated_scalar_in_where();
+    test_correlated_repeated_keys();
+    test_correlated_in_where();
+    test_correlated_columns_depend_on_branch();
+    test_decorrelated_aggregate_per_key();
+    test_correlated_in_subquery();
+
+    remove_subquery_data();
+
+    printf("=== All subquery tests passed! ===\n");
+    return 0;
+}